@@ -13,9 +13,6 @@ using bela::ErrCanceled;
 using bela::ErrEnded;
 using bela::ErrGeneral;
 using bela::ErrUnimplemented;
-constexpr long ErrExtractGeneral = 800000;
-constexpr long ErrAnotherWay = 800001;
-constexpr long ErrNoOverlayArchive = 800002;
 namespace fs = std::filesystem;
 class File {
 public:
@@ -64,11 +61,18 @@ inline std::wstring FileDestination(std::wstring_view arfile) {
 
 std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string_view child_path,
                                              bool always_utf8 = true);
+std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string_view child_path, bool always_utf8,
+                                             uint32_t codePage);
+// DetectCodePage runs encoding detection once over a sample of non-UTF-8 names of an archive
+uint32_t DetectCodePage(std::string_view sample);
 //
 std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8);
+std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8, uint32_t codePage);
 bool IsHarmfulPath(std::string_view child_path);
 std::optional<fs::path> JoinSanitizeFsPath(const fs::path &root, std::string_view child_path, bool always_utf8,
                                            std::wstring &encoded_path);
+std::optional<fs::path> JoinSanitizeFsPath(const fs::path &root, std::string_view child_path, bool always_utf8,
+                                           uint32_t codePage, std::wstring &encoded_path);
 
 //
 bool CheckFormat(bela::io::FD &fd, file_format_t &afmt, int64_t &offset, bela::error_code &ec);
@@ -0,0 +1,87 @@
+// baulk cab headers
+#ifndef BAULK_ARCHIVE_CAB_HPP
+#define BAULK_ARCHIVE_CAB_HPP
+#include <bela/base.hpp>
+#include <bela/time.hpp>
+#if defined(_WIN32)
+#include <bela/io.hpp>
+#endif
+#include <functional>
+#include <mutex>
+#include <span>
+
+namespace baulk::archive::cab {
+// https://docs.microsoft.com/en-us/previous-versions/bb417343(v=msdn.10)
+enum method_t : uint16_t {
+  CAB_NONE = 0,    // stored
+  CAB_MSZIP = 1,   // deflate blocks with shared 32K history
+  CAB_QUANTUM = 2, // quantum (unsupported)
+  CAB_LZX = 3,     // lzx, window 2^15..2^21
+};
+
+struct Folder {
+  int64_t offset{0};       /* first CFDATA block, relative to cabinet */
+  int64_t size{0};         /* uncompressed bytes referenced by files */
+  uint16_t blocks{0};      /* number of CFDATA blocks */
+  uint16_t compression{0}; /* typeCompress */
+  method_t Method() const { return static_cast<method_t>(compression & 0x000F); }
+  int WindowBits() const { return (compression >> 8) & 0x1F; }
+};
+
+struct File {
+  std::string name;      /* file name, UTF-8 when IsFileNameUTF8 */
+  int64_t size{0};       /* uncompressed size */
+  int64_t offset{0};     /* uncompressed offset in folder */
+  uint16_t folder{0};    /* folder index */
+  uint16_t attributes{0};
+  bela::Time time; /* last modified date */
+  bool IsFileNameUTF8() const { return (attributes & 0x80) != 0; }
+};
+
+using Writer = std::function<bool(const void *data, size_t len)>;
+// ReaderAt reads a cabinet embedded in another container (msi streams), pos is relative to the cabinet
+using ReaderAt = std::function<bool(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec)>;
+// Opener is called once for each file of the folder in offset order, leave w empty to skip the file
+using Opener = std::function<bool(const File &file, Writer &w, bela::error_code &ec)>;
+class Reader {
+public:
+  Reader() = default;
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader() = default;
+#if defined(_WIN32)
+  bool OpenReader(std::wstring_view file, bela::error_code &ec);
+  bool OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec);
+#endif
+  // the ReaderAt entry is the portable one, the cabinet parser and decoders do not touch the file system
+  bool OpenReader(ReaderAt &&readerAt_, int64_t size_, bela::error_code &ec);
+  const auto &Files() const { return files; }
+  const auto &Folders() const { return folders; }
+  int64_t CompressedSize() const { return compressed_size; }
+  int64_t UncompressedSize() const { return uncompressed_size; }
+  // Folders are independent streams, DecompressFolder can be called concurrently for different folders
+  bool DecompressFolder(size_t index, const Opener &opener, bela::error_code &ec) const;
+
+private:
+#if defined(_WIN32)
+  bela::io::FD fd;
+#endif
+  ReaderAt readerAt;
+  mutable std::mutex readMutex; // bela::io::FD::ReadAt seeks, serialize concurrent block reads
+  int64_t size{bela::SizeUnInitialized};
+  int64_t baseOffset{0};
+  int64_t compressed_size{0};
+  int64_t uncompressed_size{0};
+  size_t dataReserved{0}; // cbCFData
+  std::vector<Folder> folders;
+  std::vector<File> files;
+  std::vector<std::vector<size_t>> folderFiles; // file indexes of each folder sorted by offset
+  bool Initialize(bela::error_code &ec);
+  bool readAt(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const;
+  bool readBlock(int64_t &position, std::vector<uint8_t> &payload, uint16_t &uncompressed,
+                 bela::error_code &ec) const;
+};
+
+} // namespace baulk::archive::cab
+
+#endif
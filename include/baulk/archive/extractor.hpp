@@ -6,7 +6,13 @@
 #include <baulk/archive.hpp>
 #include <baulk/archive/zip.hpp>
 #include <baulk/archive/tar.hpp>
+#include <baulk/archive/nsis.hpp>
+#include <baulk/archive/inno.hpp>
+#include <baulk/archive/cab.hpp>
+#include <baulk/archive/msi.hpp>
 #include <functional>
+#include <atomic>
+#include <thread>
 
 namespace baulk::archive {
 namespace fs = std::filesystem;
@@ -72,7 +78,7 @@ private:
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(linkname));
       return false;
     }
-    std::filesystem::path linkPath(baulk::archive::EncodeToNativePath(linkname, always_utf8));
+    std::filesystem::path linkPath(baulk::archive::EncodeToNativePath(linkname, always_utf8, reader.CodePage()));
     if (linkPath.is_absolute()) {
       return baulk::archive::NewSymlink(_New_symlink, linkPath, opts.overwrite_mode, ec);
     }
@@ -81,7 +87,8 @@ private:
 
   bool extract_entry(const File &file, const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
     std::wstring encoded_path;
-    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, file.IsFileNameUTF8(), encoded_path);
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, file.IsFileNameUTF8(), reader.CodePage(),
+                                                  encoded_path);
     if (!out) {
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
       return false;
@@ -227,6 +234,452 @@ private:
   }
 };
 } // namespace tar
+namespace nsis {
+using Filter = std::function<bool(const File &file, const std::wstring &relative_name)>;
+using OnProgress = std::function<bool(size_t bytes)>;
+class Extractor {
+public:
+  Extractor(const ExtractorOptions &opts_) noexcept : opts(opts_) {}
+  Extractor(const Extractor &) = delete;
+  Extractor &operator=(const Extractor &) = delete;
+  auto CompressedSize() const { return reader.CompressedSize(); }
+  bool OpenReader(bela::io::FD &fd, const fs::path &dest, int64_t size, int64_t offset, bela::error_code &ec) {
+    std::error_code e;
+    if (destination = fs::absolute(dest, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+      return false;
+    }
+    return reader.OpenReader(fd.NativeFD(), size, offset, ec);
+  }
+  bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    const File *last = nullptr;
+    fs::path lastOut;
+    for (const auto &file : reader.Files()) {
+      // files outside $INSTDIR ($PLUGINSDIR, $TEMP ...) are installer internals
+      if (file.name.starts_with('$')) {
+        continue;
+      }
+      std::wstring encoded_path;
+      auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, true, encoded_path);
+      if (!out) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+        if (opts.ignore_error) {
+          continue;
+        }
+        return false;
+      }
+      if (filter && !filter(file, encoded_path)) {
+        ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+        return false;
+      }
+      // nsis shares data between identical files, copy the extracted one instead of decoding again
+      if (last != nullptr && last->position == file.position) {
+        if (!copy_entry(lastOut, *out, ec) && !opts.ignore_error) {
+          return false;
+        }
+        continue;
+      }
+      if (!extract_entry(file, *out, progress, ec)) {
+        if (ec.code == bela::ErrCanceled || opts.ignore_error == false) {
+          return false;
+        }
+        continue;
+      }
+      last = &file;
+      lastOut = std::move(*out);
+    }
+    return true;
+  }
+
+private:
+  ExtractorOptions opts;
+  Reader reader;
+  fs::path destination;
+  bool copy_entry(const fs::path &source, const fs::path &out, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(out.parent_path(), e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    auto options = opts.overwrite_mode ? fs::copy_options::overwrite_existing : fs::copy_options::skip_existing;
+    if (fs::copy_file(source, out, options, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::copy_file() ");
+      return false;
+    }
+    return true;
+  }
+  bool extract_entry(const File &file, const fs::path &out, const OnProgress &progress, bela::error_code &ec) {
+    auto fd = baulk::archive::File::NewFile(out, file.time, opts.overwrite_mode, ec);
+    if (!fd) {
+      return false;
+    }
+    bela::error_code writeEc;
+    if (!reader.Decompress(
+            file,
+            [&](const void *data, size_t len) {
+              if (progress && !progress(len)) {
+                // canceled
+                return false;
+              }
+              return fd->WriteFull(data, len, writeEc);
+            },
+            ec)) {
+      fd->Discard();
+      return false;
+    }
+    return true;
+  }
+};
+} // namespace nsis
+namespace inno {
+using Filter = std::function<bool(const File &file, const std::wstring &relative_name)>;
+using OnProgress = std::function<bool(size_t bytes)>;
+class Extractor {
+public:
+  Extractor(const ExtractorOptions &opts_) noexcept : opts(opts_) {}
+  Extractor(const Extractor &) = delete;
+  Extractor &operator=(const Extractor &) = delete;
+  auto CompressedSize() const { return reader.CompressedSize(); }
+  bool OpenReader(bela::io::FD &fd, const fs::path &dest, int64_t size, int64_t offset, bela::error_code &ec) {
+    std::error_code e;
+    if (destination = fs::absolute(dest, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+      return false;
+    }
+    return reader.OpenReader(fd.NativeFD(), size, offset, ec);
+  }
+  bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    const File *last = nullptr;
+    fs::path lastOut;
+    // Files() only lists the files installed under {app}
+    for (const auto &file : reader.Files()) {
+      std::wstring encoded_path;
+      auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, true, encoded_path);
+      if (!out) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+        if (opts.ignore_error) {
+          continue;
+        }
+        return false;
+      }
+      if (filter && !filter(file, encoded_path)) {
+        ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+        return false;
+      }
+      // the compiler stores identical files once, copy the extracted one instead of decoding again
+      if (last != nullptr && last->location == file.location) {
+        if (!copy_entry(lastOut, *out, ec) && !opts.ignore_error) {
+          return false;
+        }
+        continue;
+      }
+      if (!extract_entry(file, *out, progress, ec)) {
+        if (ec.code == bela::ErrCanceled || opts.ignore_error == false) {
+          return false;
+        }
+        continue;
+      }
+      last = &file;
+      lastOut = std::move(*out);
+    }
+    return true;
+  }
+
+private:
+  ExtractorOptions opts;
+  Reader reader;
+  fs::path destination;
+  bool copy_entry(const fs::path &source, const fs::path &out, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(out.parent_path(), e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    auto options = opts.overwrite_mode ? fs::copy_options::overwrite_existing : fs::copy_options::skip_existing;
+    if (fs::copy_file(source, out, options, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::copy_file() ");
+      return false;
+    }
+    return true;
+  }
+  bool extract_entry(const File &file, const fs::path &out, const OnProgress &progress, bela::error_code &ec) {
+    auto fd = baulk::archive::File::NewFile(out, file.time, opts.overwrite_mode, ec);
+    if (!fd) {
+      return false;
+    }
+    bela::error_code writeEc;
+    if (!reader.Decompress(
+            file,
+            [&](const void *data, size_t len) {
+              if (progress && !progress(len)) {
+                // canceled
+                return false;
+              }
+              return fd->WriteFull(data, len, writeEc);
+            },
+            ec)) {
+      fd->Discard();
+      return false;
+    }
+    return true;
+  }
+};
+} // namespace inno
+namespace cab {
+using Filter = std::function<bool(const File &file, const std::wstring &relative_name)>;
+using OnProgress = std::function<bool(size_t bytes)>;
+// Folders are independent compressed streams, each worker decodes whole folders
+class Extractor {
+public:
+  Extractor(const ExtractorOptions &opts_) noexcept : opts(opts_) {}
+  Extractor(const Extractor &) = delete;
+  Extractor &operator=(const Extractor &) = delete;
+  auto UncompressedSize() const { return reader.UncompressedSize(); }
+  auto CompressedSize() const { return reader.CompressedSize(); }
+  bool OpenReader(bela::io::FD &fd, const fs::path &dest, int64_t size, int64_t offset, bela::error_code &ec) {
+    std::error_code e;
+    if (destination = fs::absolute(dest, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+      return false;
+    }
+    return reader.OpenReader(fd.NativeFD(), size, offset, ec);
+  }
+  bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    std::atomic_size_t next{0};
+    std::atomic_bool canceled{false};
+    std::mutex mu; // guards filter, progress and firstEc
+    bela::error_code firstEc;
+    auto opener = [&](const File &file, Writer &w, bela::error_code &oec) -> bool {
+      return open_entry(file, filter, progress, mu, canceled, w, oec);
+    };
+    auto worker = [&]() {
+      for (;;) {
+        auto index = next++;
+        if (index >= reader.Folders().size() || canceled) {
+          return;
+        }
+        bela::error_code fec;
+        if (reader.DecompressFolder(index, opener, fec)) {
+          continue;
+        }
+        if (fec.code != bela::ErrCanceled && opts.ignore_error) {
+          continue;
+        }
+        std::scoped_lock lock(mu);
+        if (!firstEc) {
+          firstEc = std::move(fec);
+        }
+        canceled = true;
+      }
+    };
+    auto concurrency = (std::min)(reader.Folders().size(),
+                                  static_cast<size_t>((std::max)(std::thread::hardware_concurrency(), 1U)));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < concurrency; i++) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : workers) {
+      t.join();
+    }
+    if (firstEc) {
+      ec = std::move(firstEc);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  ExtractorOptions opts;
+  Reader reader;
+  fs::path destination;
+  bool open_entry(const File &file, const Filter &filter, const OnProgress &progress, std::mutex &mu,
+                  std::atomic_bool &canceled, Writer &w, bela::error_code &ec) {
+    if (canceled) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+      return false;
+    }
+    std::wstring encoded_path;
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, file.IsFileNameUTF8(), encoded_path);
+    if (!out) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+      return opts.ignore_error;
+    }
+    if (filter) {
+      std::scoped_lock lock(mu);
+      if (!filter(file, encoded_path)) {
+        ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+        return false;
+      }
+    }
+    auto fd = baulk::archive::File::NewFile(*out, file.time, opts.overwrite_mode, ec);
+    if (!fd) {
+      return opts.ignore_error;
+    }
+    auto sfd = std::make_shared<baulk::archive::File>(std::move(*fd));
+    w = [sfd, &progress, &mu, &canceled](const void *data, size_t len) -> bool {
+      if (canceled) {
+        return false;
+      }
+      if (progress) {
+        std::scoped_lock lock(mu);
+        if (!progress(len)) {
+          // canceled
+          return false;
+        }
+      }
+      bela::error_code writeEc;
+      return sfd->WriteFull(data, len, writeEc);
+    };
+    return true;
+  }
+};
+} // namespace cab
+
+namespace msi {
+using Filter = std::function<bool(const File &file, const std::wstring &relative_name)>;
+using OnProgress = std::function<bool(size_t bytes)>;
+// NativeExtractor streams files out of the embedded cabinets, each worker decodes whole cabinet folders
+class NativeExtractor {
+public:
+  NativeExtractor(const ExtractorOptions &opts_) noexcept : opts(opts_) {}
+  NativeExtractor(const NativeExtractor &) = delete;
+  NativeExtractor &operator=(const NativeExtractor &) = delete;
+  auto UncompressedSize() const { return reader.UncompressedSize(); }
+  bool OpenReader(bela::io::FD &fd, const fs::path &dest, int64_t size, bela::error_code &ec) {
+    std::error_code e;
+    if (destination = fs::absolute(dest, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+      return false;
+    }
+    return reader.OpenReader(fd.NativeFD(), size, ec);
+  }
+  bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    struct task {
+      const cab::Reader *cabinet;
+      size_t folder;
+    };
+    std::vector<task> tasks;
+    for (const auto &c : reader.Cabinets()) {
+      for (size_t i = 0; i < c->Folders().size(); i++) {
+        tasks.emplace_back(task{c.get(), i});
+      }
+    }
+    std::atomic_size_t next{0};
+    std::atomic_bool canceled{false};
+    std::mutex mu; // guards filter, progress and firstEc
+    bela::error_code firstEc;
+    auto opener = [&](const cab::File &file, cab::Writer &w, bela::error_code &oec) -> bool {
+      return open_entry(file, filter, progress, mu, canceled, w, oec);
+    };
+    auto worker = [&]() {
+      for (;;) {
+        auto index = next++;
+        if (index >= tasks.size() || canceled) {
+          return;
+        }
+        bela::error_code fec;
+        if (tasks[index].cabinet->DecompressFolder(tasks[index].folder, opener, fec)) {
+          continue;
+        }
+        if (fec.code != bela::ErrCanceled && opts.ignore_error) {
+          continue;
+        }
+        std::scoped_lock lock(mu);
+        if (!firstEc) {
+          firstEc = std::move(fec);
+        }
+        canceled = true;
+      }
+    };
+    auto concurrency =
+        (std::min)(tasks.size(), static_cast<size_t>((std::max)(std::thread::hardware_concurrency(), 1U)));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < concurrency; i++) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : workers) {
+      t.join();
+    }
+    if (firstEc) {
+      ec = std::move(firstEc);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  ExtractorOptions opts;
+  Reader reader;
+  fs::path destination;
+  bool open_entry(const cab::File &cf, const Filter &filter, const OnProgress &progress, std::mutex &mu,
+                  std::atomic_bool &canceled, cab::Writer &w, bela::error_code &ec) {
+    if (canceled) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+      return false;
+    }
+    // cabinet entries are named after the File table key
+    auto file = reader.Lookup(cf.name);
+    if (file == nullptr) {
+      return true;
+    }
+    std::wstring encoded_path;
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file->name, true, encoded_path);
+    if (!out) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file->name));
+      return opts.ignore_error;
+    }
+    if (filter) {
+      std::scoped_lock lock(mu);
+      if (!filter(*file, encoded_path)) {
+        ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+        return false;
+      }
+    }
+    auto fd = baulk::archive::File::NewFile(*out, cf.time, opts.overwrite_mode, ec);
+    if (!fd) {
+      return opts.ignore_error;
+    }
+    auto sfd = std::make_shared<baulk::archive::File>(std::move(*fd));
+    w = [sfd, &progress, &mu, &canceled](const void *data, size_t len) -> bool {
+      if (canceled) {
+        return false;
+      }
+      if (progress) {
+        std::scoped_lock lock(mu);
+        if (!progress(len)) {
+          // canceled
+          return false;
+        }
+      }
+      bela::error_code writeEc;
+      return sfd->WriteFull(data, len, writeEc);
+    };
+    return true;
+  }
+};
+} // namespace msi
 } // namespace baulk::archive
 
 #endif
\ No newline at end of file
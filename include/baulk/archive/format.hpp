@@ -4,6 +4,10 @@
 #include <cstdint>
 
 namespace baulk::archive {
+constexpr long ErrExtractGeneral = 800000;
+constexpr long ErrAnotherWay = 800001;
+constexpr long ErrNoOverlayArchive = 800002;
+
 enum class file_format_t : uint32_t {
   none,
   /// archive
@@ -27,6 +31,7 @@ enum class file_format_t : uint32_t {
   xar,
   wim,
   nsis,
+  inno, // Inno Setup installer, setup-0 follows the loader exe
   z,
   brotli,
   exe, // Currently only supports PE self-extracting files (ELF/Mach-O) not currently supported
@@ -0,0 +1,82 @@
+// baulk inno setup headers
+#ifndef BAULK_ARCHIVE_INNO_HPP
+#define BAULK_ARCHIVE_INNO_HPP
+#include <bela/base.hpp>
+#include <bela/time.hpp>
+#if defined(_WIN32)
+#include <bela/io.hpp>
+#endif
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace baulk::archive::inno {
+// https://github.com/jrsoftware/issrc/blob/main/Projects/Src/Shared.Struct.pas
+// Inno Setup 6 installers: setup-0 (version id, header and entries block, file locations block) follows the
+// loader exe, setup-1 (the compressed chunks of file data) follows setup-0
+enum method_t : int {
+  INNO_STORED = 0, // stored chunk
+  INNO_ZLIB,       // zlib stream
+  INNO_BZIP2,      // bzip2 stream
+  INNO_LZMA1,      // 5 bytes properties + raw lzma
+  INNO_LZMA2,      // 1 byte dictionary size + raw lzma2
+};
+
+struct File {
+  std::string name;    /* UTF-8 path relative to {app} */
+  size_t location{0};  /* file location entry: chunk, offset, size and checksum */
+  int64_t size{0};     /* uncompressed size */
+  bela::Time time;     /* last modified date */
+};
+
+using Writer = std::function<bool(const void *data, size_t len)>;
+// ReaderAt reads the setup data, pos is relative to the start of setup-0
+using ReaderAt = std::function<bool(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec)>;
+class Decoder;
+struct location;
+class Reader {
+public:
+  Reader();
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader();
+#if defined(_WIN32)
+  bool OpenReader(std::wstring_view file, bela::error_code &ec);
+  bool OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec);
+#endif
+  bool OpenReader(ReaderAt &&readerAt_, int64_t size_, bela::error_code &ec);
+  // Files under {app} sorted by data position, chunks decompress in a single pass when extracted in order
+  const auto &Files() const { return files; }
+  // Version is the setup-0 id, e.g. "Inno Setup Setup Data (6.2.2) (u)"
+  std::string_view Version() const { return version; }
+  int64_t CompressedSize() const { return compressed_size; }
+  // Decompress writes the file and checks it against the checksum of its location entry
+  bool Decompress(const File &file, const Writer &w, bela::error_code &ec);
+
+private:
+#if defined(_WIN32)
+  bela::io::FD fd;
+#endif
+  ReaderAt readerAt;
+  int64_t size{bela::SizeUnInitialized};
+  int64_t baseOffset{0};
+  int64_t setup1Offset{0}; // file data (setup-1) start, relative to setup-0
+  int64_t compressed_size{0};
+  std::string version;
+  std::vector<location> locations;
+  std::vector<File> files;
+  std::unique_ptr<Decoder> decoder; // decoder of the current chunk
+  int64_t chunkOffset{-1};          // current chunk, relative to setup-1
+  uint64_t chunkPosition{0};        // decoded bytes of the current chunk
+  bool Initialize(bela::error_code &ec);
+  bool readAt(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const;
+  bool readBlock(int64_t &position, std::vector<uint8_t> &out, bela::error_code &ec) const;
+  bool parseEntries(const std::vector<uint8_t> &block, size_t &locationCount, bela::error_code &ec);
+  bool parseLocations(const std::vector<uint8_t> &block, size_t locationCount, bela::error_code &ec);
+  bool chunkSeek(const location &loc, bela::error_code &ec);
+};
+
+} // namespace baulk::archive::inno
+
+#endif
@@ -6,9 +6,79 @@
 #include <functional>
 #include <filesystem>
 #include <baulk/fs.hpp>
+#include <baulk/archive/cab.hpp>
 #include <bela/terminal.hpp>
+#include <bela/phmap.hpp>
+#include <memory>
 
 namespace baulk::archive::msi {
+// Native reader: OLE compound file + File/Component/Directory/Media tables, files are streamed out of the
+// embedded cabinets. Packages with external cabinets or uncompressed files need an administrative install.
+struct File {
+  std::string key;  /* File table primary key, the file name inside the cabinet */
+  std::string name; /* UTF-8 path relative to TARGETDIR in the administrative install layout */
+  int64_t size{0};
+  int32_t sequence{0};
+};
+
+class Storage;
+class Reader {
+public:
+  Reader();
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader();
+  bool OpenReader(std::wstring_view file, bela::error_code &ec);
+  bool OpenReader(HANDLE nfd, int64_t size_, bela::error_code &ec);
+  const auto &Files() const { return files; }
+  const auto &Cabinets() const { return cabinets; }
+  int64_t UncompressedSize() const { return uncompressed_size; }
+  // Lookup file by File table key
+  const File *Lookup(std::string_view key) const;
+
+private:
+  bela::io::FD fd;
+  int64_t size{bela::SizeUnInitialized};
+  int64_t uncompressed_size{0};
+  std::unique_ptr<Storage> storage;
+  std::vector<File> files;
+  bela::flat_hash_map<std::string, size_t> keys;
+  std::vector<std::unique_ptr<cab::Reader>> cabinets;
+  bool Initialize(bela::error_code &ec);
+};
+
+// MakeFlattened removes the administrative install wrappers (Program Files, PFiles ...)
+inline bool MakeFlattened(const std::filesystem::path &destination, bela::error_code &ec) {
+  std::error_code e;
+  // Drop msi package
+  constexpr std::wstring_view extension = L".msi";
+  for (const auto &entry : std::filesystem::directory_iterator{destination, e}) {
+    if (bela::EqualsIgnoreCase(entry.path().extension().native(), extension)) {
+      std::filesystem::remove_all(entry.path(), e);
+    }
+  }
+
+  auto overflow = [&](const std::filesystem::path &child) {
+    for (const auto &entry : std::filesystem::directory_iterator{child, e}) {
+      auto newPath = destination / entry.path().filename();
+      bela::FPrintF(stderr, L"move %v to %v\n", entry.path(), newPath);
+      std::filesystem::rename(entry.path(), newPath, e);
+    }
+  };
+  // remove some child folder
+  constexpr std::wstring_view childLists[] = {L"Program Files", L"ProgramFiles64", L"PFiles", L"Files"};
+  for (const auto c : childLists) {
+    auto child = destination / c;
+    if (!std::filesystem::exists(child, e)) {
+      continue;
+    }
+    overflow(child);
+    bela::FPrintF(stderr, L"remove %v\n", child);
+    std::filesystem::remove_all(child, e);
+  }
+  return baulk::fs::MakeFlattened(destination, ec);
+}
+
 enum MessageLevel { MessageFatal = 0, MessageError = 1, MessageWarn = 2 };
 
 class Dispatcher {
@@ -77,36 +147,7 @@ public:
     }
     return true;
   }
-  bool MakeFlattened(bela::error_code &ec) {
-    std::error_code e;
-    // Drop msi package
-    constexpr std::wstring_view extension = L".msi";
-    for (const auto &entry : std::filesystem::directory_iterator{destination, e}) {
-      if (bela::EqualsIgnoreCase(entry.path().extension().native(), extension)) {
-        std::filesystem::remove_all(entry.path(), e);
-      }
-    }
-
-    auto overflow = [&](const std::filesystem::path &child) {
-      for (const auto &entry : std::filesystem::directory_iterator{child, e}) {
-        auto newPath = destination / entry.path().filename();
-        bela::FPrintF(stderr, L"move %v to %v\n", entry.path(), newPath);
-        std::filesystem::rename(entry.path(), newPath, e);
-      }
-    };
-    // remove some child folder
-    constexpr std::wstring_view childLists[] = {L"Program Files", L"ProgramFiles64", L"PFiles", L"Files"};
-    for (const auto c : childLists) {
-      auto child = destination / c;
-      if (!std::filesystem::exists(child, e)) {
-        continue;
-      }
-      overflow(child);
-      bela::FPrintF(stderr, L"remove %v\n", child);
-      std::filesystem::remove_all(child, e);
-    }
-    return baulk::fs::MakeFlattened(destination, ec);
-  }
+  bool MakeFlattened(bela::error_code &ec) { return msi::MakeFlattened(destination, ec); }
 
 private:
   static INT WINAPI extract_callback(LPVOID ctx, UINT iMessageType, LPCWSTR szMessage) {
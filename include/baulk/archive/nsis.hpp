@@ -0,0 +1,68 @@
+// baulk nsis headers
+#ifndef BAULK_ARCHIVE_NSIS_HPP
+#define BAULK_ARCHIVE_NSIS_HPP
+#include <bela/base.hpp>
+#include <bela/io.hpp>
+#include <bela/time.hpp>
+#include <functional>
+#include <memory>
+
+namespace baulk::archive::nsis {
+// https://nsis.sourceforge.io/Docs/AppendixG.html
+// https://github.com/kichik/nsis/blob/master/Source/exehead/fileform.h
+enum method_t : int {
+  NSIS_COPY = 0, // stored
+  NSIS_DEFLATE,  // raw deflate
+  NSIS_BZIP2,    // nsis private bzip2 variant: no magic, no CRCs
+  NSIS_LZMA,     // raw lzma (optional x86 bcj filter)
+};
+
+struct File {
+  std::string name;    /* UTF-8 path relative to $INSTDIR */
+  int64_t position{0}; /* data offset relative to data block */
+  bela::Time time;     /* last modified date */
+};
+
+using Writer = std::function<bool(const void *data, size_t len)>;
+class Decoder;
+class Reader {
+public:
+  Reader();
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader();
+  bool OpenReader(std::wstring_view file, bela::error_code &ec);
+  bool OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec);
+  // Files sorted by data position, solid archives decompress in a single pass when extracted in order
+  const auto &Files() const { return files; }
+  method_t Method() const { return method; }
+  bool IsSolid() const { return solid; }
+  bool IsUnicode() const { return unicode; }
+  int64_t CompressedSize() const { return compressed_size; }
+  bool Decompress(const File &file, const Writer &w, bela::error_code &ec);
+
+private:
+  bela::io::FD fd;
+  int64_t size{bela::SizeUnInitialized};
+  int64_t baseOffset{0};
+  int64_t dataOffset{0};   // compressed data start (after firstheader)
+  int64_t dataLength{0};   // compressed data length
+  int64_t blockOffset{0};  // non-solid: file data block start
+  int64_t headerLength{0}; // uncompressed header length
+  int64_t compressed_size{0};
+  method_t method{NSIS_COPY};
+  bool solid{false};
+  bool unicode{false};
+  std::vector<File> files;
+  std::unique_ptr<Decoder> decoder; // solid stream decoder
+  int64_t solidPosition{0};         // solid stream position relative to data block
+  bool Initialize(bela::error_code &ec);
+  bool detectMethod(bela::error_code &ec);
+  bool readHeader(std::vector<uint8_t> &header, bela::error_code &ec);
+  bool parseHeader(const std::vector<uint8_t> &header, bela::error_code &ec);
+  bool solidSeek(int64_t position, bela::error_code &ec);
+};
+
+} // namespace baulk::archive::nsis
+
+#endif
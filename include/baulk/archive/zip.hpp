@@ -99,6 +99,7 @@ private:
     r.compressed_size = 0;
     comment = std::move(r.comment);
     files = std::move(r.files);
+    codePage = r.codePage;
   }
 
 public:
@@ -115,6 +116,8 @@ public:
   const auto &Files() const { return files; }
   int64_t CompressedSize() const { return compressed_size; }
   int64_t UncompressedSize() const { return uncompressed_size; }
+  // CodePage of the file names without the UTF-8 flag, detected once when the archive is opened
+  uint32_t CodePage() const { return codePage; }
   bool Decompress(const File &file, const Writer &w, bela::error_code &ec) const;
   std::string ResolveLinkName(const File &file, bela::error_code &ec) const {
     if (!file.linkname.empty()) {
@@ -141,7 +144,9 @@ private:
   int64_t compressed_size{0};
   std::string comment;
   std::vector<File> files;
+  uint32_t codePage{CP_ACP};
   bool Initialize(bela::error_code &ec);
+  void detectCodePage();
   bool readDirectoryEnd(directoryEnd &d, bela::error_code &ec);
   bool readDirectory64End(int64_t offset, directoryEnd &d, bela::error_code &ec);
   int64_t findDirectory64End(int64_t directoryEndOffset, bela::error_code &ec);
@@ -2,12 +2,56 @@
 #ifndef BAULK_CDN_HPP
 #define BAULK_CDN_HPP
 #include <string_view>
+#include <optional>
+#include <bela/ascii.hpp>
+#include <bela/str_cat.hpp>
+#include <baulk/net/types.hpp>
 
 namespace baulk {
 // https://baulk.io/cdn/hash/filename?url=u
 constexpr std::wstring_view BaulkMirrorURL = L"X-Baulk-Mirror-URL";
 constexpr std::wstring_view BaulkChecksumKey = L"X-Baulk-Mirror-Hash";
-struct cdn {};
+constexpr std::wstring_view BaulkCdnPrefix = L"/cdn/";
+// cdn: a hash addressed archive on a 'baulk serve' mirror, /cdn/<hash>/<filename>
+struct cdn {
+  std::wstring hash;
+  std::wstring filename;
+  // URL of the archive on mirror, the filename is percent encoded
+  std::wstring URL(std::wstring_view mirror) const {
+    while (!mirror.empty() && mirror.back() == '/') {
+      mirror.remove_suffix(1);
+    }
+    return bela::StringCat(mirror, BaulkCdnPrefix, hash, L"/", net::url_path_encode(filename));
+  }
+  // Parse a decoded request path, names that would leave the cache folder are rejected
+  static std::optional<cdn> Parse(std::wstring_view path) {
+    if (!path.starts_with(BaulkCdnPrefix)) {
+      return std::nullopt;
+    }
+    path.remove_prefix(BaulkCdnPrefix.size());
+    auto pos = path.find('/');
+    if (pos == 0 || pos == std::wstring_view::npos) {
+      return std::nullopt;
+    }
+    auto hash = path.substr(0, pos);
+    auto filename = path.substr(pos + 1);
+    for (auto c : hash) {
+      if (!bela::ascii_isalnum(c) && c != ':') {
+        return std::nullopt;
+      }
+    }
+    if (filename.empty() || filename == L"." || filename == L".." ||
+        filename.find_first_of(L"/\\:*?\"<>|") != std::wstring_view::npos) {
+      return std::nullopt;
+    }
+    for (auto c : filename) {
+      if (c < 0x20) {
+        return std::nullopt;
+      }
+    }
+    return std::make_optional(cdn{.hash = std::wstring(hash), .filename = std::wstring(filename)});
+  }
+};
 } // namespace baulk
 
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,12 @@
 #define BAULK_HASH_HPP
 #include <bela/base.hpp>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace baulk::hash {
 enum class hash_t {
@@ -15,10 +21,63 @@ enum class hash_t {
   SHA3_256, //
   SHA3_384, //
   SHA3_512, //
-  BLAKE3
+  BLAKE3,   //
+  SM3
 };
+
+// MultiHasher feeds one stream into several digests, every digest runs on its own consumer thread
+class MultiHasher {
+public:
+  MultiHasher() = default;
+  MultiHasher(const MultiHasher &) = delete;
+  MultiHasher &operator=(const MultiHasher &) = delete;
+  ~MultiHasher();
+  bool Initialize(std::span<const hash_t> methods, bela::error_code &ec);
+  // Update returns once the previous buffer is consumed, data must stay valid until the next Update or Finalize
+  void Update(const void *data, size_t len);
+  // Finalize returns the digests in the order of methods
+  std::vector<std::wstring> Finalize();
+
+private:
+  struct digest;
+  std::vector<std::unique_ptr<digest>> digests;
+  std::vector<std::thread> consumers;
+  std::mutex mu;
+  std::condition_variable cv;
+  const uint8_t *pending{nullptr};
+  size_t pendingLen{0};
+  uint64_t generation{0};
+  size_t busy{0};
+  bool exiting{false};
+  void wait();
+  void consume(size_t index);
+};
+
+// parseHashValue splits 'SHA256:xxx' into method and digest, a value without prefix is SHA256
+bool parseHashValue(std::wstring_view hash_value, hash_t &m, std::wstring_view &value, bela::error_code &ec);
 bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value, bela::error_code &ec);
+// HashEqual checks every hash value, such as SHA256:xxx and BLAKE3:xxx, in one read of the file
+bool HashEqual(const std::filesystem::path &file, std::span<const std::wstring_view> hash_values,
+               bela::error_code &ec);
+// HashEqualCached is HashEqual backed by an index of digests keyed by path and file identity (volume, file ID, size,
+// write and change time). An unchanged file is hashed at most once per method, matching and mismatching values are
+// both answered from the index after that; any write makes it verify from scratch
+bool HashEqualCached(const std::filesystem::path &file, std::wstring_view hash_value,
+                     const std::filesystem::path &index, bela::error_code &ec);
 std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec);
+// MultiFileHash reads the file once for all methods
+std::optional<std::vector<std::wstring>> MultiFileHash(const std::filesystem::path &file,
+                                                       std::span<const hash_t> methods, bela::error_code &ec);
+struct file_hash_options {
+  uint32_t jobs{0}; // worker threads, 0: number of processors
+  bool mmap{false}; // map files into memory instead of reading them
+};
+using file_hash_receiver =
+    std::function<void(const std::filesystem::path &file, const std::optional<std::wstring> &hv,
+                       const bela::error_code &ec)>;
+// FileHashes hashes files on a pool of workers, results are received in input order
+void FileHashes(const std::vector<std::filesystem::path> &files, hash_t method, const file_hash_options &opts,
+                const file_hash_receiver &receiver);
 struct file_hash_sums {
   std::wstring sha256sum;
   std::wstring blake3sum;
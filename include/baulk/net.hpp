@@ -6,7 +6,11 @@
 #include <baulk/net/tcp.hpp>
 
 namespace baulk::net {
-std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale);
+// BestUrl picks a mirror, from the latency table when its records are fresh, otherwise by racing all mirrors
+std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale,
+                          const std::filesystem::path &table = {});
+// RecordThroughput remembers how fast a download from the mirror of url was
+void RecordThroughput(const std::filesystem::path &table, std::wstring_view url, int64_t bytes, double seconds);
 }
 
 #endif
@@ -2,9 +2,13 @@
 #define BAULK_NET_CLIENT_HPP
 #include "types.hpp"
 #include <filesystem>
+#include <functional>
 #include <bela/terminal.hpp>
 
 namespace baulk::net {
+namespace net_internal {
+struct segment_context;
+}
 class Response : private minimal_response {
 public:
   Response(minimal_response &&mr, std::vector<char> &&b, size_t sz) {
@@ -27,14 +31,36 @@ private:
   size_t size_{0};
 };
 
+// download_progress receives the bytes written so far and the expected total, 0 while unknown
+using download_progress = std::function<void(int64_t current, int64_t total)>;
+
 struct download_options {
   std::wstring hash_value;
   std::filesystem::path cwd;
   std::filesystem::path destination;
   bool force_overwrite{false};
+  // parallel range requests for large resumable downloads, 1 keeps a single stream
+  uint32_t connections{4};
+  // reports to the caller instead of drawing a progress bar, called from the downloading threads
+  download_progress progress;
+  // headers of this download only, they replace client headers of the same name
+  headers_t headers;
   bool OverwriteExists() const { return force_overwrite || !destination.empty(); }
 };
 
+// body_reader receives the body as it arrives, decoded when compressed. Returning false stops the transfer, the rest
+// of the body is never read
+using body_reader = std::function<bool(std::string_view chunk)>;
+
+// transfer_limits: connections and bandwidth shared by every request of the process, 0 is unlimited
+struct transfer_limits {
+  uint32_t connections{16};
+  uint32_t host_connections{6};
+  int64_t rate{0}; // bytes per second of archive downloads, metadata requests are not paced
+};
+// SetTransferLimits replaces the limits, requests already connected keep their connections
+void SetTransferLimits(const transfer_limits &limits);
+
 class HttpClient {
 public:
   HttpClient() = default;
@@ -49,7 +75,16 @@ public:
     return *this;
   }
   std::optional<Response> WinRest(std::wstring_view method, std::wstring_view url, std::wstring_view content_type,
-                                  std::wstring_view body, bela::error_code &ec);
+                                  std::wstring_view body, bela::error_code &ec) {
+    return WinRest(method, url, content_type, body, headers_t{}, ec);
+  }
+  // WinRest with headers of this request only, they replace client headers of the same name
+  std::optional<Response> WinRest(std::wstring_view method, std::wstring_view url, std::wstring_view content_type,
+                                  std::wstring_view body, const headers_t &headers, bela::error_code &ec);
+  // WinStream GET hands a 2xx body to reader and returns a Response without content, other responses are received
+  // completely like WinRest
+  std::optional<Response> WinStream(std::wstring_view url, const headers_t &headers, const body_reader &reader,
+                                    bela::error_code &ec);
   std::optional<Response> Get(std::wstring_view url, bela::error_code &ec) {
     return WinRest(L"GET", url, L"", L"", ec);
   }
@@ -101,6 +136,10 @@ public:
   }
 
 private:
+  std::optional<Response> RestRequest(std::wstring_view method, std::wstring_view url, std::wstring_view content_type,
+                                      std::wstring_view body, const headers_t &headers, const body_reader &reader,
+                                      bela::error_code &ec);
+  bool RecvSegment(net_internal::segment_context &sc, size_t index);
   headers_t hkv;
   std::wstring userAgent{L"Wget/7.0 (Baulk)"};
   std::wstring proxyURL;
@@ -117,6 +156,17 @@ inline std::optional<Response> RestGet(std::wstring_view url, bela::error_code &
   return HttpClient::DefaultClient().WinRest(L"GET", url, L"", L"", ec);
 }
 
+// HTTP rest api with request headers, eg: conditional requests
+inline std::optional<Response> RestGet(std::wstring_view url, const headers_t &headers, bela::error_code &ec) {
+  return HttpClient::DefaultClient().WinRest(L"GET", url, L"", L"", headers, ec);
+}
+
+// HTTP rest api streaming the response body, eg: read the newest entries of a feed and stop
+inline std::optional<Response> RestStream(std::wstring_view url, const headers_t &headers, const body_reader &reader,
+                                          bela::error_code &ec) {
+  return HttpClient::DefaultClient().WinStream(url, headers, reader, ec);
+}
+
 // WinGet download file
 inline std::optional<std::filesystem::path> WinGet(std::wstring_view url, const download_options &opts,
                                                    bela::error_code &ec) {
@@ -2,7 +2,9 @@
 #ifndef BAULK_TCP_HPP
 #define BAULK_TCP_HPP
 #include <bela/base.hpp>
+#include <atomic>
 #include <chrono>
+#include <vector>
 
 namespace baulk::net {
 using BAULKSOCK = UINT_PTR;
@@ -36,6 +38,15 @@ private:
 // timeout milliseconds
 std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout,
                                 bela::error_code &ec); // second
+// DialTimeout gives up soon after canceled is set, the socket of a canceled dial is closed
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, const std::atomic_bool &canceled,
+                                bela::error_code &ec);
+// Reachable dials the host and port of url, it only tells whether something accepts connections there
+bool Reachable(std::wstring_view url, int timeout, bela::error_code &ec);
+// ResolveAhead starts resolving the hosts of urls in the background, DialTimeout and Reachable take the cached
+// addresses. WinGet and RestGet cannot: WinHTTP resolves names itself and takes no addresses, they only gain from the
+// answers the lookups leave in the system DNS cache
+void ResolveAhead(const std::vector<std::wstring> &urls);
 } // namespace baulk::net
 
 #endif
\ No newline at end of file
@@ -5,8 +5,10 @@
 #include <bela/match.hpp>
 #include <bela/ascii.hpp>
 #include <bela/phmap.hpp>
-#include <bela/path.hpp>
+#include <bela/codecvt.hpp>
+#include <bela/str_cat.hpp>
 #include <memory>
+#include <vector>
 
 namespace baulk::net {
 
@@ -28,7 +30,7 @@ struct StringCaseInsensitiveHash {
     constexpr size_t kFNVPrime = 16777619U;
 #endif
     size_t val = kFNVOffsetBasis;
-    std::string_view sv = {reinterpret_cast<const char *>(wsv.data()), wsv.size() * 2};
+    std::string_view sv = {reinterpret_cast<const char *>(wsv.data()), wsv.size() * sizeof(wchar_t)};
     for (auto c : sv) {
       val ^= static_cast<size_t>(bela::ascii_tolower(c));
       val *= kFNVPrime;
@@ -61,6 +63,32 @@ constexpr int hexval_table[] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1  // f0~ff
 };
 
+// url_path_last: last element of a URL path resolved like bela::SplitPath, '.' is skipped and '..' drops the element
+// before it. Empty when '..' climbs above the root
+inline std::wstring_view url_path_last(std::wstring_view urlpath) {
+  std::vector<std::wstring_view> pv;
+  size_t first = 0;
+  while (first < urlpath.size()) {
+    const auto second = urlpath.find_first_of(L"/\\", first);
+    if (first != second) {
+      auto s = urlpath.substr(first, second - first);
+      if (s == L"..") {
+        if (pv.empty()) {
+          return {};
+        }
+        pv.pop_back();
+      } else if (s != L".") {
+        pv.emplace_back(s);
+      }
+    }
+    if (second == std::wstring_view::npos) {
+      break;
+    }
+    first = second + 1;
+  }
+  return pv.empty() ? std::wstring_view{} : pv.back();
+}
+
 constexpr int decode_byte_couple(uint8_t a, uint8_t b) {
   auto a1 = hexval_table[a];
   auto b1 = hexval_table[b];
@@ -127,25 +155,25 @@ struct minimal_response {
 };
 
 std::string url_decode(std::wstring_view url);
+std::wstring url_path_encode(std::wstring_view segment);
 
 inline std::wstring url_path_name(std::wstring_view urlpath) {
-  std::vector<std::wstring_view> pv = bela::SplitPath(urlpath);
-  if (pv.empty()) {
+  auto name = net_internal::url_path_last(urlpath);
+  if (name.empty()) {
     return L"index.html";
   }
-  return std::wstring(pv.back());
+  return std::wstring(name);
 }
 
 inline std::wstring decoded_url_path_name(std::wstring_view urlpath) {
-  std::vector<std::wstring_view> pv = bela::SplitPath(urlpath);
-  if (pv.empty()) {
+  auto name = net_internal::url_path_last(urlpath);
+  if (name.empty()) {
     return L"index.html";
   }
-  auto name = pv.back();
   if (name.find(L'%') == std::wstring_view::npos) {
     return std::wstring(name);
   }
-  return bela::encode_into<char, wchar_t>(url_decode(pv.back()));
+  return bela::encode_into<char, wchar_t>(url_decode(name));
 }
 
 } // namespace baulk::net
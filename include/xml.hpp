@@ -1,6 +1,9 @@
 #ifndef BAULK_XML_HPP
 #define BAULK_XML_HPP
+#include <algorithm>
 #include <optional>
+#include <string>
+#include <vector>
 #include <bela/base.hpp>
 #define PUGIXML_HEADER_ONLY 1
 #include "../vendor/pugixml/pugixml.hpp"
@@ -15,6 +18,161 @@ inline std::optional<document> parse_string(const std::string_view buffer, bela:
   }
   return std::make_optional(std::move(doc));
 }
+
+// text_scanner: incremental search for the text of the first element on an absolute path, eg: feed/entry/id.
+// Scanned bytes are dropped as chunks arrive, the caller can stop reading once Feed returns true
+class text_scanner {
+public:
+  text_scanner(std::initializer_list<std::string_view> path_) : path(path_.begin(), path_.end()) {}
+  text_scanner(const text_scanner &) = delete;
+  text_scanner &operator=(const text_scanner &) = delete;
+  // Feed scans the next chunk of the document and returns true once the element is closed
+  bool Feed(std::string_view chunk) {
+    if (found) {
+      return true;
+    }
+    buffer.append(chunk);
+    scan();
+    buffer.erase(0, pos);
+    pos = 0;
+    return found;
+  }
+  bool Found() const { return found; }
+  // Text of the element, the predefined entities and CDATA sections are decoded
+  std::string_view Text() const { return text; }
+
+private:
+  std::vector<std::string> path;
+  std::string buffer;
+  std::string text;
+  size_t pos{0};
+  size_t depth{0};
+  size_t matched{0}; // leading path elements open at the current depth
+  bool found{false};
+  bool capturing() const { return !path.empty() && matched == path.size(); }
+  void append_text(std::string_view s) {
+    while (!s.empty()) {
+      auto amp = s.find('&');
+      text.append(s.substr(0, amp));
+      if (amp == std::string_view::npos) {
+        return;
+      }
+      s.remove_prefix(amp);
+      auto semi = s.find(';');
+      auto entity = s.substr(0, semi + 1);
+      constexpr std::pair<std::string_view, char> entities[] = {
+          {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}};
+      auto decoded = false;
+      for (const auto &[k, c] : entities) {
+        if (entity == k) {
+          text.push_back(c);
+          decoded = true;
+          break;
+        }
+      }
+      if (!decoded) {
+        text.append(entity);
+      }
+      s.remove_prefix(entity.size());
+    }
+  }
+  // close_element handles the end of an element at the current depth
+  void close_element() {
+    if (capturing() && depth == path.size()) {
+      found = true;
+    }
+    if (depth > 0) {
+      depth--;
+    }
+    matched = (std::min)(matched, depth);
+  }
+  size_t tag_end(size_t lt) const {
+    char quote = 0;
+    for (auto i = lt + 1; i < buffer.size(); i++) {
+      auto c = buffer[i];
+      if (quote != 0) {
+        quote = (c == quote) ? 0 : quote;
+        continue;
+      }
+      if (c == '"' || c == '\'') {
+        quote = c;
+        continue;
+      }
+      if (c == '>') {
+        return i;
+      }
+    }
+    return std::string::npos;
+  }
+  void scan() {
+    constexpr std::string_view comment = "<!--";
+    constexpr std::string_view cdata = "<![CDATA[";
+    std::string_view sv{buffer};
+    while (!found) {
+      auto lt = sv.find('<', pos);
+      if (lt == std::string_view::npos) {
+        if (!capturing()) {
+          pos = sv.size();
+          return;
+        }
+        // an entity cut by the chunk boundary waits for the next chunk
+        auto rest = sv.substr(pos);
+        auto amp = rest.rfind('&');
+        if (amp != std::string_view::npos && rest.find(';', amp) == std::string_view::npos) {
+          rest = rest.substr(0, amp);
+        }
+        append_text(rest);
+        pos += rest.size();
+        return;
+      }
+      if (capturing()) {
+        append_text(sv.substr(pos, lt - pos));
+      }
+      pos = lt;
+      auto tail = sv.substr(lt);
+      if (tail.starts_with(comment)) {
+        auto end = sv.find("-->", lt + comment.size());
+        if (end == std::string_view::npos) {
+          return;
+        }
+        pos = end + 3;
+        continue;
+      }
+      if (tail.starts_with(cdata)) {
+        auto end = sv.find("]]>", lt + cdata.size());
+        if (end == std::string_view::npos) {
+          return;
+        }
+        if (capturing()) {
+          text.append(sv.substr(lt + cdata.size(), end - lt - cdata.size()));
+        }
+        pos = end + 3;
+        continue;
+      }
+      auto gt = tag_end(lt);
+      if (gt == std::string_view::npos) {
+        return;
+      }
+      auto tag = sv.substr(lt + 1, gt - lt - 1);
+      pos = gt + 1;
+      if (tag.starts_with('?') || tag.starts_with('!')) {
+        continue;
+      }
+      if (tag.starts_with('/')) {
+        close_element();
+        continue;
+      }
+      auto name = tag.substr(0, tag.find_first_of(" \t\r\n/"));
+      if (matched == depth && depth < path.size() && name == path[depth]) {
+        matched++;
+      }
+      depth++;
+      if (tag.ends_with('/')) {
+        close_element();
+      }
+    }
+  }
+};
 } // namespace baulk::xml
 
 #endif
\ No newline at end of file
@@ -0,0 +1,412 @@
+///
+#include <bela/str_cat.hpp>
+#include <bela/buffer.hpp>
+#include <bela/codecvt.hpp>
+#include <algorithm>
+#include <deque>
+#include "cabinternal.hpp"
+
+namespace baulk::archive::cab {
+constexpr uint16_t maxFolders = 0xFFFC;
+// CB_MAX_FILENAME, a CFFILE entry is at most its header and a name of this size with the terminator
+constexpr size_t maxFileName = 256;
+
+#if defined(_WIN32)
+bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  auto fd_ = bela::io::NewFile(file, ec);
+  if (!fd_) {
+    return false;
+  }
+  fd = std::move(*fd_);
+  file_format_t afmt{file_format_t::none};
+  if (!CheckFormat(fd, afmt, baseOffset, ec)) {
+    return false;
+  }
+  if (afmt != file_format_t::cab) {
+    ec = bela::make_error_code(ErrNotCabFile, L"cab: not a cabinet file");
+    return false;
+  }
+  return Initialize(ec);
+}
+
+bool Reader::OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  fd.Assgin(nfd, false);
+  size = size_;
+  baseOffset = offset_;
+  return Initialize(ec);
+}
+#endif
+
+bool Reader::OpenReader(ReaderAt &&readerAt_, int64_t size_, bela::error_code &ec) {
+#if defined(_WIN32)
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+#endif
+  if (readerAt) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  readerAt = std::move(readerAt_);
+  size = size_;
+  baseOffset = 0;
+  return Initialize(ec);
+}
+
+bool Reader::readAt(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const {
+  if (readerAt) {
+    return readerAt(buffer, pos, ec);
+  }
+#if defined(_WIN32)
+  return fd.ReadAt(buffer, baseOffset + pos, ec);
+#else
+  ec = bela::make_error_code(L"cab: no reader");
+  return false;
+#endif
+}
+
+inline bool readCString(bela::bytes_view bv, size_t &pos, std::string &s) {
+  auto sv = bv.make_cstring_view(pos, bv.size() - pos);
+  if (pos + sv.size() >= bv.size()) {
+    return false;
+  }
+  s.assign(sv);
+  pos += sv.size() + 1;
+  return true;
+}
+
+bool Reader::Initialize(bela::error_code &ec) {
+#if defined(_WIN32)
+  if (size == bela::SizeUnInitialized) {
+    if (size = fd.Size(ec); size == bela::SizeUnInitialized) {
+      return false;
+    }
+  }
+#endif
+  cfheader hdr;
+  if (!readAt({reinterpret_cast<uint8_t *>(&hdr), sizeof(hdr)}, 0, ec)) {
+    return false;
+  }
+  if (memcmp(hdr.signature, "MSCF", 4) != 0) {
+    ec = bela::make_error_code(ErrNotCabFile, L"cab: invalid cabinet signature");
+    return false;
+  }
+  auto flags = bela::fromle(hdr.flags);
+  if ((flags & (cfhdrPREV_CABINET | cfhdrNEXT_CABINET)) != 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"cab: multi-cabinet sets are not supported");
+    return false;
+  }
+  auto cabinetSize = static_cast<int64_t>(bela::fromle(hdr.cbCabinet));
+  if (cabinetSize > size - baseOffset) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"cab: cabinet size ", cabinetSize, L" beyond the end of file");
+    return false;
+  }
+  auto nfolders = bela::fromle(hdr.cFolders);
+  auto nfiles = bela::fromle(hdr.cFiles);
+  auto coffFiles = static_cast<int64_t>(bela::fromle(hdr.coffFiles));
+  if (nfolders > maxFolders || coffFiles >= cabinetSize) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"cab: invalid cabinet header");
+    return false;
+  }
+  auto position = static_cast<int64_t>(sizeof(cfheader));
+  size_t folderReserved = 0;
+  if ((flags & cfhdrRESERVE_PRESENT) != 0) {
+    uint8_t reserved[4];
+    if (!readAt(reserved, position, ec)) {
+      return false;
+    }
+    folderReserved = reserved[2];
+    dataReserved = reserved[3];
+    position += sizeof(reserved) + bela::cast_fromle<uint16_t>(reserved);
+  }
+  // CFFOLDER entries
+  auto folderEntrySize = sizeof(cffolder) + folderReserved;
+  bela::Buffer buffer(folderEntrySize * nfolders);
+  if (!readAt(buffer.make_span(folderEntrySize * nfolders), position, ec)) {
+    return false;
+  }
+  buffer.size() = folderEntrySize * nfolders;
+  folders.resize(nfolders);
+  auto fbv = buffer.as_bytes_view();
+  for (size_t i = 0; i < nfolders; i++) {
+    auto cf = fbv.unchecked_cast<cffolder>(i * folderEntrySize);
+    auto &folder = folders[i];
+    folder.offset = bela::fromle(cf->coffCabStart);
+    folder.blocks = bela::fromle(cf->cCFData);
+    folder.compression = bela::fromle(cf->typeCompress);
+    if (auto method = folder.Method(); method != CAB_NONE && method != CAB_MSZIP && method != CAB_LZX) {
+      ec = bela::make_error_code(ErrAnotherWay, L"cab: unsupported compression method ", static_cast<int>(method));
+      return false;
+    }
+    if (folder.blocks != 0 && folder.offset >= cabinetSize) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"cab: folder ", i, L" data beyond the end of cabinet");
+      return false;
+    }
+  }
+  // CFFILE entries, names are NUL terminated. The table ends before the first CFDATA block, the read stops there
+  // instead of pulling the compressed data in with it
+  auto filesEnd = cabinetSize;
+  for (const auto &folder : folders) {
+    if (folder.blocks != 0) {
+      filesEnd = (std::min)(filesEnd, folder.offset);
+    }
+  }
+  if (coffFiles > filesEnd) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"cab: file table overlaps the folder data");
+    return false;
+  }
+  auto filesSize = (std::min)(static_cast<size_t>(filesEnd - coffFiles), nfiles * (sizeof(cffile) + maxFileName + 1));
+  buffer.grow(filesSize);
+  if (!readAt(buffer.make_span(filesSize), coffFiles, ec)) {
+    return false;
+  }
+  buffer.size() = filesSize;
+  auto bv = buffer.as_bytes_view();
+  files.reserve(nfiles);
+  folderFiles.resize(nfolders);
+  size_t pos = 0;
+  for (size_t i = 0; i < nfiles; i++) {
+    if (pos + sizeof(cffile) > bv.size()) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"cab: file table runs into the folder data");
+      return false;
+    }
+    auto cf = bv.unchecked_cast<cffile>(pos);
+    pos += sizeof(cffile);
+    File file;
+    if (!readCString(bv, pos, file.name)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"cab: file table runs into the folder data");
+      return false;
+    }
+    file.size = bela::fromle(cf->cbFile);
+    file.offset = bela::fromle(cf->uoffFolderStart);
+    file.folder = bela::fromle(cf->iFolder);
+    file.attributes = bela::fromle(cf->attribs);
+    file.time = bela::FromDosDateTime(bela::fromle(cf->date), bela::fromle(cf->time));
+    std::replace(file.name.begin(), file.name.end(), '\\', '/');
+    if (file.folder >= ifoldCONTINUED_FROM_PREV) {
+      ec = bela::make_error_code(ErrAnotherWay, L"cab: file '", bela::encode_into<char, wchar_t>(file.name),
+                                 L"' spans cabinets");
+      return false;
+    }
+    if (file.folder >= nfolders) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"cab: file '", bela::encode_into<char, wchar_t>(file.name),
+                                 L"' invalid folder index ", file.folder);
+      return false;
+    }
+    auto &folder = folders[file.folder];
+    folder.size = (std::max)(folder.size, file.offset + file.size);
+    uncompressed_size += file.size;
+    folderFiles[file.folder].emplace_back(files.size());
+    files.emplace_back(std::move(file));
+  }
+  for (auto &ff : folderFiles) {
+    std::stable_sort(ff.begin(), ff.end(), [&](size_t a, size_t b) { return files[a].offset < files[b].offset; });
+  }
+  compressed_size = cabinetSize;
+  return true;
+}
+
+bool Reader::readBlock(int64_t &position, std::vector<uint8_t> &payload, uint16_t &uncompressed,
+                       bela::error_code &ec) const {
+  std::scoped_lock lock(readMutex);
+  cfdata d;
+  if (!readAt({reinterpret_cast<uint8_t *>(&d), sizeof(d)}, position, ec)) {
+    return false;
+  }
+  auto cbData = bela::fromle(d.cbData);
+  uncompressed = bela::fromle(d.cbUncomp);
+  if (cbData > maxBlockCompressed || uncompressed > maxBlockUncompressed) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"cab: invalid data block size");
+    return false;
+  }
+  if (uncompressed == 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"cab: data block continues in the next cabinet");
+    return false;
+  }
+  position += sizeof(cfdata) + dataReserved;
+  payload.resize(cbData);
+  if (!readAt(payload, position, ec)) {
+    return false;
+  }
+  position += cbData;
+  return true;
+}
+
+// folderSink dispatches the decompressed folder stream to the files it contains
+class folderSink {
+public:
+  folderSink(const std::vector<File> &files_, const std::vector<size_t> &indexes_, const Opener &opener_)
+      : files(files_), indexes(indexes_), opener(opener_) {}
+  bool Done() const { return next == indexes.size() && active.empty(); }
+  bool Write(const uint8_t *data, size_t len, bela::error_code &ec) {
+    auto chunkBegin = position;
+    auto chunkEnd = position + static_cast<int64_t>(len);
+    while (next < indexes.size() && files[indexes[next]].offset < chunkEnd) {
+      if (!open(files[indexes[next++]], ec)) {
+        return false;
+      }
+    }
+    for (auto &a : active) {
+      auto begin = (std::max)(a.file->offset, chunkBegin);
+      auto end = (std::min)(a.file->offset + a.file->size, chunkEnd);
+      if (begin < end && a.w && !a.w(data + (begin - chunkBegin), static_cast<size_t>(end - begin))) {
+        ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+        return false;
+      }
+    }
+    std::erase_if(active, [&](const activeFile &a) { return a.file->offset + a.file->size <= chunkEnd; });
+    position = chunkEnd;
+    return true;
+  }
+  // empty files at the end of the folder
+  bool Finish(bela::error_code &ec) {
+    while (next < indexes.size()) {
+      const auto &file = files[indexes[next++]];
+      if (file.size != 0 || file.offset > position) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"cab: folder data truncated at ", position);
+        return false;
+      }
+      if (!open(file, ec)) {
+        return false;
+      }
+    }
+    if (!active.empty()) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"cab: folder data truncated at ", position);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  struct activeFile {
+    const File *file;
+    Writer w;
+  };
+  const std::vector<File> &files;
+  const std::vector<size_t> &indexes;
+  const Opener &opener;
+  std::vector<activeFile> active;
+  size_t next{0};
+  int64_t position{0};
+  bool open(const File &file, bela::error_code &ec) {
+    Writer w;
+    if (!opener(file, w, ec)) {
+      return false;
+    }
+    if (file.size != 0) {
+      active.emplace_back(activeFile{.file = &file, .w = std::move(w)});
+    }
+    return true;
+  }
+};
+
+bool Reader::DecompressFolder(size_t index, const Opener &opener, bela::error_code &ec) const {
+  if (index >= folders.size()) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"cab: folder index ", index, L" out of range");
+    return false;
+  }
+  const auto &folder = folders[index];
+  folderSink sink(files, folderFiles[index], opener);
+  if (sink.Done()) {
+    return true;
+  }
+  auto position = folder.offset;
+  uint16_t block = 0;
+  std::vector<uint8_t> payload;
+  uint16_t uncompressed = 0;
+  switch (folder.Method()) {
+  case CAB_NONE:
+    for (; block < folder.blocks && !sink.Done(); block++) {
+      if (!readBlock(position, payload, uncompressed, ec)) {
+        return false;
+      }
+      if (payload.size() != uncompressed) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"cab: stored block size mismatch");
+        return false;
+      }
+      if (!sink.Write(payload.data(), payload.size(), ec)) {
+        return false;
+      }
+    }
+    break;
+  case CAB_MSZIP: {
+    mszipDecoder decoder;
+    if (!decoder.Initialize(ec)) {
+      return false;
+    }
+    std::vector<uint8_t> out(maxBlockUncompressed);
+    for (; block < folder.blocks && !sink.Done(); block++) {
+      if (!readBlock(position, payload, uncompressed, ec)) {
+        return false;
+      }
+      if (!decoder.Decode({payload.data(), payload.size()}, out.data(), uncompressed, ec)) {
+        return false;
+      }
+      if (!sink.Write(out.data(), uncompressed, ec)) {
+        return false;
+      }
+    }
+  } break;
+  case CAB_LZX: {
+    // frame sizes come from the block headers, the decoder may pull blocks ahead of the current frame
+    std::deque<std::vector<uint8_t>> queued;
+    std::vector<uint16_t> frameSizes;
+    frameSizes.reserve(folder.blocks);
+    auto pull = [&](std::vector<uint8_t> &next, bela::error_code &pec) -> bool {
+      if (frameSizes.size() >= folder.blocks) {
+        next.clear();
+        return true;
+      }
+      if (!readBlock(position, next, uncompressed, pec)) {
+        return false;
+      }
+      frameSizes.emplace_back(uncompressed);
+      return true;
+    };
+    lzxDecoder decoder;
+    if (!decoder.Initialize(
+            folder.WindowBits(),
+            [&](std::vector<uint8_t> &next, bela::error_code &sec) -> bool {
+              if (!queued.empty()) {
+                next = std::move(queued.front());
+                queued.pop_front();
+                return true;
+              }
+              return pull(next, sec);
+            },
+            ec)) {
+      return false;
+    }
+    for (; block < folder.blocks && !sink.Done(); block++) {
+      while (frameSizes.size() <= block) {
+        if (!pull(payload, ec)) {
+          return false;
+        }
+        queued.emplace_back(std::move(payload));
+      }
+      bela::bytes_view out;
+      if (!decoder.Decode(frameSizes[block], out, ec)) {
+        return false;
+      }
+      if (!sink.Write(out.data(), out.size(), ec)) {
+        return false;
+      }
+    }
+  } break;
+  default:
+    ec = bela::make_error_code(ErrAnotherWay, L"cab: unsupported compression method ", folder.compression & 0x000F);
+    return false;
+  }
+  return sink.Finish(ec);
+}
+
+} // namespace baulk::archive::cab
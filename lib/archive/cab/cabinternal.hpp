@@ -0,0 +1,62 @@
+//
+#ifndef BAULK_ARCHIVE_CAB_INTERNAL_HPP
+#define BAULK_ARCHIVE_CAB_INTERNAL_HPP
+#include <baulk/archive/cab.hpp>
+#if defined(_WIN32)
+#include <baulk/archive.hpp>
+#endif
+#include <bela/endian.hpp>
+#include "decoder.hpp"
+
+namespace baulk::archive::cab {
+constexpr long ErrNotCabFile = 755330;
+
+// CFHEADER flags
+constexpr uint16_t cfhdrPREV_CABINET = 0x0001;
+constexpr uint16_t cfhdrNEXT_CABINET = 0x0002;
+constexpr uint16_t cfhdrRESERVE_PRESENT = 0x0004;
+// CFFILE iFolder continuation values, files spanning cabinets
+constexpr uint16_t ifoldCONTINUED_FROM_PREV = 0xFFFD;
+
+#pragma pack(push, 1)
+struct cfheader {
+  uint8_t signature[4]; // MSCF
+  uint32_t reserved1;
+  uint32_t cbCabinet;
+  uint32_t reserved2;
+  uint32_t coffFiles;
+  uint32_t reserved3;
+  uint8_t versionMinor;
+  uint8_t versionMajor;
+  uint16_t cFolders;
+  uint16_t cFiles;
+  uint16_t flags;
+  uint16_t setID;
+  uint16_t iCabinet;
+};
+
+struct cffolder {
+  uint32_t coffCabStart;
+  uint16_t cCFData;
+  uint16_t typeCompress;
+};
+
+struct cffile {
+  uint32_t cbFile;
+  uint32_t uoffFolderStart;
+  uint16_t iFolder;
+  uint16_t date;
+  uint16_t time;
+  uint16_t attribs;
+};
+
+struct cfdata {
+  uint32_t csum;
+  uint16_t cbData;
+  uint16_t cbUncomp;
+};
+#pragma pack(pop)
+
+} // namespace baulk::archive::cab
+
+#endif
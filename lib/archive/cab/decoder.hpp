@@ -0,0 +1,127 @@
+// MSZIP and LZX block decoders of the cabinet reader. They depend on the portable parts of bela and zlib only, so
+// they and their tests also build outside Windows
+#ifndef BAULK_ARCHIVE_CAB_DECODER_HPP
+#define BAULK_ARCHIVE_CAB_DECODER_HPP
+#include <bela/base.hpp>
+#include <bela/bytes_view.hpp>
+#include <baulk/archive/format.hpp>
+#include <functional>
+#include <vector>
+#include "zlib.h"
+
+namespace baulk::archive::cab {
+constexpr size_t maxBlockUncompressed = 32768;
+// MSZIP blocks may grow by a few bytes, LZX blocks by up to 6144 bytes
+constexpr size_t maxBlockCompressed = maxBlockUncompressed + 6144;
+
+// Source supplies the next CFDATA payload of the folder, empty payload at the end of folder
+using Source = std::function<bool(std::vector<uint8_t> &payload, bela::error_code &ec)>;
+
+// MSZIP: every block is a complete raw deflate stream prefixed with 'CK', history is kept across blocks
+class mszipDecoder {
+public:
+  mszipDecoder() = default;
+  mszipDecoder(const mszipDecoder &) = delete;
+  mszipDecoder &operator=(const mszipDecoder &) = delete;
+  ~mszipDecoder();
+  bool Initialize(bela::error_code &ec);
+  bool Decode(bela::bytes_view in, uint8_t *out, size_t outlen, bela::error_code &ec);
+
+private:
+  z_stream zs{};
+  bool initialized{false};
+  uint8_t history[maxBlockUncompressed];
+  size_t historySize{0};
+};
+
+// LZX: bit stream continues across CFDATA blocks, each block decodes to one frame (<= 32K)
+// https://docs.microsoft.com/en-us/openspecs/exchange_server_protocols/ms-patch/
+class lzxDecoder {
+public:
+  static constexpr size_t pretreeSymbols = 20;
+  static constexpr size_t alignedSymbols = 8;
+  static constexpr size_t lengthSymbols = 249 + 1;
+  static constexpr size_t maintreeSymbols = 256 + 50 * 8;
+  static constexpr size_t lensSafety = 64;
+  struct huffTable {
+    std::vector<uint16_t> table;
+    std::vector<uint8_t> lens;
+    uint32_t nsyms{0};
+    uint32_t nbits{0};
+    bool empty{false};
+  };
+
+  lzxDecoder() = default;
+  lzxDecoder(const lzxDecoder &) = delete;
+  lzxDecoder &operator=(const lzxDecoder &) = delete;
+  bool Initialize(int windowBits, Source &&source_, bela::error_code &ec);
+  // Decode next frame, out is valid until the next call
+  bool Decode(size_t frameSize, bela::bytes_view &out, bela::error_code &ec);
+
+private:
+  Source source;
+  // input
+  std::vector<uint8_t> payload;
+  const uint8_t *ip{nullptr};
+  const uint8_t *iend{nullptr};
+  uint8_t pending[8];
+  size_t pendingPos{0};
+  size_t pendingSize{0};
+  size_t overrun{0};
+  bela::error_code sourceEc;
+  uint64_t bitbuf{0};
+  uint32_t bitsLeft{0};
+  // window
+  std::vector<uint8_t> window;
+  std::vector<uint8_t> e8buf;
+  uint32_t windowSize{0};
+  uint32_t windowPosn{0};
+  uint32_t framePosn{0};
+  uint64_t produced{0};
+  uint32_t frames{0};
+  uint32_t posnSlots{0};
+  // state
+  uint32_t R0{1};
+  uint32_t R1{1};
+  uint32_t R2{1};
+  uint32_t blockType{0};
+  uint32_t blockLength{0};
+  uint32_t blockRemaining{0};
+  int32_t intelFilesize{0};
+  int32_t intelCurpos{0};
+  bool intelStarted{false};
+  bool headerRead{false};
+  huffTable pretree;
+  huffTable maintree;
+  huffTable lengthtree;
+  huffTable alignedtree;
+
+  uint8_t readByte();
+  bool readBytes(uint8_t *dest, size_t len);
+  void ensure(uint32_t n);
+  uint32_t peek(uint32_t n) const { return static_cast<uint32_t>(bitbuf >> (64 - n)); }
+  void remove(uint32_t n) {
+    bitbuf <<= n;
+    bitsLeft -= n;
+  }
+  uint32_t readBits(uint32_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    ensure(n);
+    auto v = peek(n);
+    remove(n);
+    return v;
+  }
+  bool readSymbol(const huffTable &t, uint32_t &sym, bela::error_code &ec);
+  bool readLens(huffTable &t, uint32_t first, uint32_t last, bela::error_code &ec);
+  bool readBlockHeader(bela::error_code &ec);
+  bool decodeRun(uint32_t frameEnd, bela::error_code &ec);
+  void translateE8(uint8_t *data, size_t len);
+};
+
+bool makeDecodeTable(lzxDecoder::huffTable &t);
+
+} // namespace baulk::archive::cab
+
+#endif
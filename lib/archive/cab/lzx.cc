@@ -0,0 +1,547 @@
+//
+#include <algorithm>
+#include <cstring>
+#include "decoder.hpp"
+
+namespace baulk::archive::cab {
+constexpr uint32_t minMatch = 2;
+constexpr uint32_t numChars = 256;
+constexpr uint32_t blocktypeVerbatim = 1;
+constexpr uint32_t blocktypeAligned = 2;
+constexpr uint32_t blocktypeUncompressed = 3;
+constexpr uint32_t numPrimaryLengths = 7;
+constexpr uint32_t numSecondaryLengths = 249;
+constexpr uint32_t pretreeTableBits = 6;
+constexpr uint32_t maintreeTableBits = 12;
+constexpr uint32_t lengthTableBits = 12;
+constexpr uint32_t alignedTableBits = 7;
+constexpr uint32_t huffMaxBits = 16;
+constexpr size_t maxOverrun = 16;
+
+struct positionTables {
+  uint8_t extraBits[51];
+  uint32_t positionBase[51];
+  constexpr positionTables() : extraBits{}, positionBase{} {
+    for (uint32_t i = 0, j = 0; i < 50; i += 2) {
+      extraBits[i] = static_cast<uint8_t>(j);
+      extraBits[i + 1] = static_cast<uint8_t>(j);
+      if (i != 0 && j < 17) {
+        j++;
+      }
+    }
+    extraBits[50] = 17;
+    for (uint32_t i = 0, j = 0; i < 51; i++) {
+      positionBase[i] = j;
+      j += 1U << extraBits[i];
+    }
+  }
+};
+constexpr positionTables positions;
+
+// canonical huffman decode table, codes longer than nbits continue as a binary tree after the direct entries
+bool makeDecodeTable(lzxDecoder::huffTable &t) {
+  auto &table = t.table;
+  const auto &lens = t.lens;
+  uint32_t pos = 0;
+  uint32_t tableMask = 1U << t.nbits;
+  uint32_t bitMask = tableMask >> 1;
+  for (uint32_t bitNum = 1; bitNum <= t.nbits; bitNum++) {
+    for (uint32_t sym = 0; sym < t.nsyms; sym++) {
+      if (lens[sym] != bitNum) {
+        continue;
+      }
+      auto leaf = pos;
+      if ((pos += bitMask) > tableMask) {
+        return false;
+      }
+      for (auto fill = bitMask; fill-- > 0;) {
+        table[leaf++] = static_cast<uint16_t>(sym);
+      }
+    }
+    bitMask >>= 1;
+  }
+  if (pos == tableMask) {
+    return true;
+  }
+  for (auto sym = pos; sym < tableMask; sym++) {
+    table[sym] = 0xFFFF;
+  }
+  uint32_t nextSymbol = ((tableMask >> 1) < t.nsyms) ? t.nsyms : (tableMask >> 1);
+  pos <<= 16;
+  tableMask <<= 16;
+  bitMask = 1U << 15;
+  for (uint32_t bitNum = t.nbits + 1; bitNum <= huffMaxBits; bitNum++) {
+    for (uint32_t sym = 0; sym < t.nsyms; sym++) {
+      if (lens[sym] != bitNum) {
+        continue;
+      }
+      if (pos >= tableMask) {
+        return false;
+      }
+      auto leaf = pos >> 16;
+      for (uint32_t fill = 0; fill < bitNum - t.nbits; fill++) {
+        if (table[leaf] == 0xFFFF) {
+          if ((nextSymbol << 1) + 1 >= table.size()) {
+            return false;
+          }
+          table[(nextSymbol << 1)] = 0xFFFF;
+          table[(nextSymbol << 1) + 1] = 0xFFFF;
+          table[leaf] = static_cast<uint16_t>(nextSymbol++);
+        }
+        leaf = static_cast<uint32_t>(table[leaf]) << 1;
+        if ((pos >> (15 - fill)) & 1) {
+          leaf++;
+        }
+      }
+      table[leaf] = static_cast<uint16_t>(sym);
+      pos += bitMask;
+    }
+    bitMask >>= 1;
+  }
+  return pos == tableMask;
+}
+
+inline void initializeTable(lzxDecoder::huffTable &t, uint32_t nsyms, uint32_t nbits) {
+  t.nsyms = nsyms;
+  t.nbits = nbits;
+  t.table.assign((1U << nbits) + (static_cast<size_t>(nsyms) << 1), 0);
+  t.lens.assign(nsyms + lzxDecoder::lensSafety, 0);
+  t.empty = false;
+}
+
+inline bool buildTable(lzxDecoder::huffTable &t, bool allowEmpty, bela::error_code &ec) {
+  if (makeDecodeTable(t)) {
+    t.empty = false;
+    return true;
+  }
+  if (allowEmpty) {
+    // an all-zero length tree is valid as long as it is never used
+    for (uint32_t i = 0; i < t.nsyms; i++) {
+      if (t.lens[i] != 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid huffman table");
+        return false;
+      }
+    }
+    t.empty = true;
+    return true;
+  }
+  ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid huffman table");
+  return false;
+}
+
+bool lzxDecoder::Initialize(int windowBits, Source &&source_, bela::error_code &ec) {
+  if (windowBits < 15 || windowBits > 21) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"lzx: unsupported window bits ", windowBits);
+    return false;
+  }
+  source = std::move(source_);
+  windowSize = 1U << windowBits;
+  posnSlots = windowBits == 21 ? 50 : (windowBits == 20 ? 42 : static_cast<uint32_t>(windowBits) << 1);
+  window.assign(windowSize, 0);
+  e8buf.resize(maxBlockUncompressed);
+  initializeTable(pretree, pretreeSymbols, pretreeTableBits);
+  initializeTable(maintree, numChars + (posnSlots << 3), maintreeTableBits);
+  initializeTable(lengthtree, lengthSymbols, lengthTableBits);
+  initializeTable(alignedtree, alignedSymbols, alignedTableBits);
+  return true;
+}
+
+uint8_t lzxDecoder::readByte() {
+  if (pendingPos < pendingSize) {
+    return pending[pendingPos++];
+  }
+  while (ip == iend) {
+    if (sourceEc || !source(payload, sourceEc) || payload.empty()) {
+      // past the end of input: feed zeros, checked after the frame is decoded
+      overrun++;
+      return 0;
+    }
+    ip = payload.data();
+    iend = ip + payload.size();
+  }
+  return *ip++;
+}
+
+bool lzxDecoder::readBytes(uint8_t *dest, size_t len) {
+  while (len > 0 && pendingPos < pendingSize) {
+    *dest++ = pending[pendingPos++];
+    len--;
+  }
+  while (len > 0) {
+    if (ip == iend) {
+      if (sourceEc || !source(payload, sourceEc) || payload.empty()) {
+        overrun += len;
+        return false;
+      }
+      ip = payload.data();
+      iend = ip + payload.size();
+      continue;
+    }
+    auto n = (std::min)(len, static_cast<size_t>(iend - ip));
+    memcpy(dest, ip, n);
+    ip += n;
+    dest += n;
+    len -= n;
+  }
+  return true;
+}
+
+// 16-bit little endian words, most significant bit first
+void lzxDecoder::ensure(uint32_t n) {
+  while (bitsLeft < n) {
+    uint32_t b0 = 0;
+    uint32_t b1 = 0;
+    if (pendingPos == pendingSize && iend - ip >= 2) {
+      b0 = ip[0];
+      b1 = ip[1];
+      ip += 2;
+    } else {
+      b0 = readByte();
+      b1 = readByte();
+    }
+    bitbuf |= static_cast<uint64_t>((b1 << 8) | b0) << (48 - bitsLeft);
+    bitsLeft += 16;
+  }
+}
+
+bool lzxDecoder::readSymbol(const huffTable &t, uint32_t &sym, bela::error_code &ec) {
+  if (t.empty) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"lzx: huffman table is empty");
+    return false;
+  }
+  ensure(huffMaxBits);
+  sym = t.table[peek(t.nbits)];
+  if (sym >= t.nsyms) {
+    auto i = static_cast<uint64_t>(1) << (64 - t.nbits);
+    do {
+      if ((i >>= 1) == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid huffman code");
+        return false;
+      }
+      auto index = (static_cast<size_t>(sym) << 1) | ((bitbuf & i) != 0 ? 1 : 0);
+      if (index >= t.table.size()) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid huffman code");
+        return false;
+      }
+      sym = t.table[index];
+    } while (sym >= t.nsyms);
+  }
+  remove(t.lens[sym]);
+  return true;
+}
+
+// code lengths are delta coded against the previous block through the pretree
+bool lzxDecoder::readLens(huffTable &t, uint32_t first, uint32_t last, bela::error_code &ec) {
+  for (uint32_t x = 0; x < pretreeSymbols; x++) {
+    pretree.lens[x] = static_cast<uint8_t>(readBits(4));
+  }
+  if (!buildTable(pretree, false, ec)) {
+    return false;
+  }
+  auto &lens = t.lens;
+  auto limit = static_cast<uint32_t>(lens.size());
+  auto fill = [&](uint32_t &x, uint32_t count, uint8_t value) {
+    for (; count > 0 && x < limit; count--) {
+      lens[x++] = value;
+    }
+  };
+  for (uint32_t x = first; x < last;) {
+    uint32_t z = 0;
+    if (!readSymbol(pretree, z, ec)) {
+      return false;
+    }
+    switch (z) {
+    case 17:
+      fill(x, readBits(4) + 4, 0);
+      break;
+    case 18:
+      fill(x, readBits(5) + 20, 0);
+      break;
+    case 19: {
+      auto y = readBits(1) + 4;
+      if (!readSymbol(pretree, z, ec)) {
+        return false;
+      }
+      auto v = static_cast<int>(lens[x]) - static_cast<int>(z);
+      if (v < 0) {
+        v += 17;
+      }
+      fill(x, y, static_cast<uint8_t>(v));
+    } break;
+    default: {
+      auto v = static_cast<int>(lens[x]) - static_cast<int>(z);
+      if (v < 0) {
+        v += 17;
+      }
+      lens[x++] = static_cast<uint8_t>(v);
+    } break;
+    }
+  }
+  return true;
+}
+
+bool lzxDecoder::readBlockHeader(bela::error_code &ec) {
+  // uncompressed blocks of odd length are padded to 16 bits
+  if (blockType == blocktypeUncompressed && (blockLength & 1) != 0) {
+    readByte();
+  }
+  blockType = readBits(3);
+  auto hi = readBits(16);
+  auto lo = readBits(8);
+  blockLength = (hi << 8) | lo;
+  blockRemaining = blockLength;
+  switch (blockType) {
+  case blocktypeAligned:
+    for (uint32_t i = 0; i < alignedSymbols; i++) {
+      alignedtree.lens[i] = static_cast<uint8_t>(readBits(3));
+    }
+    if (!buildTable(alignedtree, false, ec)) {
+      return false;
+    }
+    [[fallthrough]];
+  case blocktypeVerbatim:
+    if (!readLens(maintree, 0, numChars, ec)) {
+      return false;
+    }
+    if (!readLens(maintree, numChars, maintree.nsyms, ec)) {
+      return false;
+    }
+    if (!buildTable(maintree, false, ec)) {
+      return false;
+    }
+    if (maintree.lens[0xE8] != 0) {
+      intelStarted = true;
+    }
+    if (!readLens(lengthtree, 0, numSecondaryLengths, ec)) {
+      return false;
+    }
+    return buildTable(lengthtree, true, ec);
+  case blocktypeUncompressed: {
+    intelStarted = true;
+    // align to 16 bits (1..16 bits of padding), give whole words back to the byte stream
+    ensure(16);
+    auto pad = bitsLeft & 15;
+    remove(pad == 0 ? 16 : pad);
+    pendingPos = 0;
+    pendingSize = 0;
+    while (bitsLeft >= 16) {
+      auto word = peek(16);
+      remove(16);
+      pending[pendingSize++] = static_cast<uint8_t>(word & 0xFF);
+      pending[pendingSize++] = static_cast<uint8_t>(word >> 8);
+    }
+    bitbuf = 0;
+    bitsLeft = 0;
+    uint8_t rbuf[12];
+    if (!readBytes(rbuf, sizeof(rbuf))) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"lzx: unexpected end of input");
+      return false;
+    }
+    R0 = bela::cast_fromle<uint32_t>(rbuf);
+    R1 = bela::cast_fromle<uint32_t>(rbuf + 4);
+    R2 = bela::cast_fromle<uint32_t>(rbuf + 8);
+    // repeated offsets are only used by later matches, reject the ones no match could take
+    for (auto r : {R0, R1, R2}) {
+      if (r == 0 || r > windowSize) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid repeated offset ", r);
+        return false;
+      }
+    }
+    return true;
+  }
+  default:
+    break;
+  }
+  ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid block type ", blockType);
+  return false;
+}
+
+// decode verbatim or aligned symbols until frameEnd or the end of the block, the last match may run past both
+bool lzxDecoder::decodeRun(uint32_t frameEnd, bela::error_code &ec) {
+  auto runEnd = windowPosn + (std::min)(blockRemaining, frameEnd - windowPosn);
+  auto runStart = windowPosn;
+  auto *w = window.data();
+  while (windowPosn < runEnd) {
+    uint32_t mainElement = 0;
+    if (!readSymbol(maintree, mainElement, ec)) {
+      return false;
+    }
+    if (mainElement < numChars) {
+      w[windowPosn++] = static_cast<uint8_t>(mainElement);
+      continue;
+    }
+    mainElement -= numChars;
+    auto matchLength = mainElement & numPrimaryLengths;
+    if (matchLength == numPrimaryLengths) {
+      uint32_t footer = 0;
+      if (!readSymbol(lengthtree, footer, ec)) {
+        return false;
+      }
+      matchLength += footer;
+    }
+    matchLength += minMatch;
+    auto matchOffset = mainElement >> 3;
+    if (matchOffset > 2) {
+      auto extra = static_cast<uint32_t>(positions.extraBits[matchOffset]);
+      matchOffset = positions.positionBase[matchOffset] - 2;
+      if (blockType == blocktypeAligned && extra >= 3) {
+        matchOffset += readBits(extra - 3) << 3;
+        uint32_t alignedBits = 0;
+        if (!readSymbol(alignedtree, alignedBits, ec)) {
+          return false;
+        }
+        matchOffset += alignedBits;
+      } else {
+        matchOffset += readBits(extra);
+      }
+      R2 = R1;
+      R1 = R0;
+      R0 = matchOffset;
+    } else if (matchOffset == 0) {
+      matchOffset = R0;
+    } else if (matchOffset == 1) {
+      matchOffset = R1;
+      R1 = R0;
+      R0 = matchOffset;
+    } else {
+      matchOffset = R2;
+      R2 = R0;
+      R0 = matchOffset;
+    }
+    if (windowPosn + matchLength > windowSize) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"lzx: match ran over window wrap");
+      return false;
+    }
+    auto position = produced + (windowPosn - framePosn);
+    if (matchOffset == 0 || matchOffset > position || matchOffset > windowSize) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"lzx: match offset beyond start of stream");
+      return false;
+    }
+    auto dest = w + windowPosn;
+    auto i = matchLength;
+    if (matchOffset > windowPosn) {
+      // copy from the end of the window
+      auto j = matchOffset - windowPosn;
+      auto src = w + windowSize - j;
+      if (j < i) {
+        i -= j;
+        while (j-- > 0) {
+          *dest++ = *src++;
+        }
+        src = w;
+      }
+      while (i-- > 0) {
+        *dest++ = *src++;
+      }
+    } else {
+      auto src = dest - matchOffset;
+      while (i-- > 0) {
+        *dest++ = *src++;
+      }
+    }
+    windowPosn += matchLength;
+  }
+  auto decoded = windowPosn - runStart;
+  if (decoded > blockRemaining) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"lzx: match overrun past end of block");
+    return false;
+  }
+  blockRemaining -= decoded;
+  return true;
+}
+
+// undo the x86 call instruction (E8) translation
+void lzxDecoder::translateE8(uint8_t *data, size_t len) {
+  auto curpos = intelCurpos;
+  auto end = data + len - 10;
+  while (data < end) {
+    if (*data++ != 0xE8) {
+      curpos++;
+      continue;
+    }
+    auto absOffset = static_cast<int32_t>(bela::cast_fromle<uint32_t>(data));
+    if (absOffset >= -curpos && absOffset < intelFilesize) {
+      auto relOffset = absOffset >= 0 ? absOffset - curpos : absOffset + intelFilesize;
+      auto u = static_cast<uint32_t>(relOffset);
+      data[0] = static_cast<uint8_t>(u);
+      data[1] = static_cast<uint8_t>(u >> 8);
+      data[2] = static_cast<uint8_t>(u >> 16);
+      data[3] = static_cast<uint8_t>(u >> 24);
+    }
+    data += 4;
+    curpos += 5;
+  }
+}
+
+bool lzxDecoder::Decode(size_t frameSize, bela::bytes_view &out, bela::error_code &ec) {
+  if (frameSize == 0 || frameSize > maxBlockUncompressed || framePosn + frameSize > windowSize) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"lzx: invalid frame size ", frameSize);
+    return false;
+  }
+  if (!headerRead) {
+    uint32_t hi = 0;
+    uint32_t lo = 0;
+    if (readBits(1) != 0) {
+      hi = readBits(16);
+      lo = readBits(16);
+    }
+    intelFilesize = static_cast<int32_t>((hi << 16) | lo);
+    headerRead = true;
+  }
+  auto frameEnd = framePosn + static_cast<uint32_t>(frameSize);
+  while (windowPosn < frameEnd) {
+    if (blockRemaining == 0) {
+      if (!readBlockHeader(ec)) {
+        return false;
+      }
+      continue;
+    }
+    if (blockType == blocktypeUncompressed) {
+      auto n = (std::min)(blockRemaining, frameEnd - windowPosn);
+      if (!readBytes(window.data() + windowPosn, n)) {
+        break;
+      }
+      windowPosn += n;
+      blockRemaining -= n;
+      continue;
+    }
+    if (!decodeRun(frameEnd, ec)) {
+      return false;
+    }
+  }
+  if (sourceEc) {
+    ec = std::move(sourceEc);
+    return false;
+  }
+  if (overrun > maxOverrun || windowPosn != frameEnd) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"lzx: decode beyond output frame limits");
+    return false;
+  }
+  // frames start on a 16-bit boundary
+  if (bitsLeft > 0) {
+    ensure(16);
+  }
+  remove(bitsLeft & 15);
+
+  auto frame = window.data() + framePosn;
+  if (intelStarted && intelFilesize != 0 && frames < 32768 && frameSize > 10) {
+    memcpy(e8buf.data(), frame, frameSize);
+    translateE8(e8buf.data(), frameSize);
+    out = bela::bytes_view(e8buf.data(), frameSize);
+  } else {
+    out = bela::bytes_view(frame, frameSize);
+  }
+  if (intelFilesize != 0) {
+    intelCurpos += static_cast<int32_t>(frameSize);
+  }
+  frames++;
+  produced += frameSize;
+  framePosn = frameEnd;
+  if (framePosn == windowSize) {
+    framePosn = 0;
+    windowPosn = 0;
+  }
+  return true;
+}
+
+} // namespace baulk::archive::cab
@@ -0,0 +1,59 @@
+//
+#include <bela/codecvt.hpp>
+#include <algorithm>
+#include <cstring>
+#include "decoder.hpp"
+
+namespace baulk::archive::cab {
+
+mszipDecoder::~mszipDecoder() {
+  if (initialized) {
+    inflateEnd(&zs);
+  }
+}
+
+// the inflate state is allocated by zlib itself, the decoder does not depend on the mimalloc build of baulk
+bool mszipDecoder::Initialize(bela::error_code &ec) {
+  if (auto zerr = inflateInit2(&zs, -MAX_WBITS); zerr != Z_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+    return false;
+  }
+  initialized = true;
+  return true;
+}
+
+bool mszipDecoder::Decode(bela::bytes_view in, uint8_t *out, size_t outlen, bela::error_code &ec) {
+  if (!in.starts_with("CK")) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"mszip: invalid block signature");
+    return false;
+  }
+  // each block is a new deflate stream whose window is the previous block
+  if (auto zerr = inflateReset(&zs); zerr != Z_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+    return false;
+  }
+  if (historySize != 0) {
+    if (auto zerr = inflateSetDictionary(&zs, history, static_cast<uInt>(historySize)); zerr != Z_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+      return false;
+    }
+  }
+  zs.next_in = const_cast<uint8_t *>(in.data()) + 2;
+  zs.avail_in = static_cast<uInt>(in.size() - 2);
+  zs.next_out = out;
+  zs.avail_out = static_cast<uInt>(outlen);
+  auto ret = ::inflate(&zs, Z_FINISH);
+  if (ret != Z_STREAM_END || zs.avail_out != 0) {
+    if (ret == Z_STREAM_END || ret == Z_BUF_ERROR || ret == Z_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"mszip: block size mismatch");
+      return false;
+    }
+    ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(ret)));
+    return false;
+  }
+  historySize = (std::min)(outlen, sizeof(history));
+  memcpy(history, out + outlen - historySize, historySize);
+  return true;
+}
+
+} // namespace baulk::archive::cab
@@ -3,7 +3,10 @@
 #include <bela/str_split_narrow.hpp>
 #include <baulk/archive.hpp>
 #include <compact_enc_det/compact_enc_det.h>
+#include <algorithm>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 
 namespace baulk::archive {
 // https://codereview.chromium.org/2081653007/
@@ -47,7 +50,8 @@ uint32_t codePageSearch(Encoding e) {
       {CZECH_CP852, 852},        //
       {ISO_8859_13, 28603},      // ISO 8859-13 Estonian
       {ISO_2022_KR, 50225},      // ISO 2022 Korean
-      {ISO_2022_CN, 50227}       // ISO 2022 Simplified Chinese; Chinese Simplified (ISO 2022)
+      {ISO_2022_CN, 50227},      // ISO 2022 Simplified Chinese; Chinese Simplified (ISO 2022)
+      {UTF8, CP_UTF8}            // UTF-8 names without the language encoding flag
   };
   for (const auto c : codePages) {
     if (c.e == e) {
@@ -57,7 +61,65 @@ uint32_t codePageSearch(Encoding e) {
   return CP_ACP;
 }
 
-inline std::wstring encode_from_codepage(std::string_view name, int codePage = CP_ACP) {
+// single byte code pages decode through a 256 entry table, built once per code page
+struct singleByteTable {
+  uint32_t codePage{0};
+  wchar_t table[256];
+};
+
+const singleByteTable *lookupSingleByteTable(uint32_t codePage) {
+  static std::mutex mu;
+  static std::vector<std::unique_ptr<singleByteTable>> tables;
+  static std::vector<uint32_t> multiByteCodePages;
+  std::scoped_lock lock(mu);
+  for (const auto &t : tables) {
+    if (t->codePage == codePage) {
+      return t.get();
+    }
+  }
+  if (std::find(multiByteCodePages.begin(), multiByteCodePages.end(), codePage) != multiByteCodePages.end()) {
+    return nullptr;
+  }
+  CPINFO info;
+  if (GetCPInfo(codePage, &info) != TRUE || info.MaxCharSize != 1) {
+    multiByteCodePages.emplace_back(codePage);
+    return nullptr;
+  }
+  auto t = std::make_unique<singleByteTable>();
+  t->codePage = codePage;
+  for (int i = 0; i < 256; i++) {
+    auto ch = static_cast<char>(i);
+    if (MultiByteToWideChar(codePage, 0, &ch, 1, &t->table[i], 1) != 1) {
+      t->table[i] = 0xFFFD;
+    }
+  }
+  return tables.emplace_back(std::move(t)).get();
+}
+
+constexpr bool isStatefulCodePage(uint32_t codePage) {
+  // ISO 2022 and HZ switch charsets with ASCII escape sequences
+  return codePage == 50225 || codePage == 50227 || codePage == 52936;
+}
+
+inline bool isAscii(std::string_view name) {
+  return std::all_of(name.begin(), name.end(), [](char c) { return static_cast<uint8_t>(c) < 0x80; });
+}
+
+inline std::wstring encode_from_codepage(std::string_view name, uint32_t codePage = CP_ACP) {
+  if (!isStatefulCodePage(codePage) && isAscii(name)) {
+    return std::wstring(name.begin(), name.end());
+  }
+  if (codePage == CP_UTF8) {
+    return bela::encode_into<char, wchar_t>(name);
+  }
+  if (auto t = lookupSingleByteTable(codePage); t != nullptr) {
+    std::wstring output;
+    output.resize(name.size());
+    for (size_t i = 0; i < name.size(); i++) {
+      output[i] = t->table[static_cast<uint8_t>(name[i])];
+    }
+    return output;
+  }
   auto sz = MultiByteToWideChar(codePage, 0, name.data(), (int)name.size(), nullptr, 0);
   std::wstring output;
   output.resize(sz);
@@ -65,22 +127,40 @@ inline std::wstring encode_from_codepage(std::string_view name, int codePage = C
   return output;
 }
 
-inline std::wstring encode_into_native(std::string_view filename, bool always_utf8) {
-  if (always_utf8) {
-    return bela::encode_into<char, wchar_t>(filename);
-  }
+uint32_t DetectCodePage(std::string_view sample) {
   bool is_reliable = false;
   int bytes_consumed = 0;
-  auto e = CompactEncDet::DetectEncoding(filename.data(), static_cast<int>(filename.size()), nullptr, nullptr, nullptr,
+  auto e = CompactEncDet::DetectEncoding(sample.data(), static_cast<int>(sample.size()), nullptr, nullptr, nullptr,
                                          UNKNOWN_ENCODING, UNKNOWN_LANGUAGE, CompactEncDet::WEB_CORPUS, false,
                                          &bytes_consumed, &is_reliable);
-  return encode_from_codepage(filename, codePageSearch(e));
+  return codePageSearch(e);
+}
+
+inline std::wstring encode_into_native(std::string_view filename, bool always_utf8) {
+  if (always_utf8) {
+    return bela::encode_into<char, wchar_t>(filename);
+  }
+  if (isAscii(filename)) {
+    return std::wstring(filename.begin(), filename.end());
+  }
+  return encode_from_codepage(filename, DetectCodePage(filename));
+}
+
+inline std::wstring encode_into_native(std::string_view filename, bool always_utf8, uint32_t codePage) {
+  if (always_utf8) {
+    return bela::encode_into<char, wchar_t>(filename);
+  }
+  return encode_from_codepage(filename, codePage);
 }
 
 std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8) {
   return encode_into_native(filename, always_utf8);
 }
 
+std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8, uint32_t codePage) {
+  return encode_into_native(filename, always_utf8, codePage);
+}
+
 constexpr bool IsDangerousPath(std::wstring_view p) {
   constexpr std::wstring_view dangerousPaths[] = {L":$i30:$bitmap", L"$mft"};
   for (const auto d : dangerousPaths) {
@@ -91,8 +171,7 @@ constexpr bool IsDangerousPath(std::wstring_view p) {
   return false;
 }
 
-std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string_view child_path, bool always_utf8) {
-  auto fileName = encode_into_native(child_path, always_utf8);
+inline std::optional<std::wstring> join_sanitize_path(std::wstring_view root, std::wstring_view fileName) {
   auto path = bela::PathCat(root, fileName);
   if (IsDangerousPath(path)) {
     return std::nullopt; // Windows BUG
@@ -109,6 +188,15 @@ std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string
   return std::make_optional(std::move(path));
 }
 
+std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string_view child_path, bool always_utf8) {
+  return join_sanitize_path(root, encode_into_native(child_path, always_utf8));
+}
+
+std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string_view child_path, bool always_utf8,
+                                             uint32_t codePage) {
+  return join_sanitize_path(root, encode_into_native(child_path, always_utf8, codePage));
+}
+
 inline bool is_harmful_path(std::string_view child_path) {
   const std::string_view dot = ".";
   const std::string_view dotdot = "..";
@@ -141,4 +229,14 @@ std::optional<std::filesystem::path> JoinSanitizeFsPath(const std::filesystem::p
   return std::make_optional(root / encoded_path);
 }
 
+std::optional<std::filesystem::path> JoinSanitizeFsPath(const std::filesystem::path &root, std::string_view child_path,
+                                                        bool always_utf8, uint32_t codePage,
+                                                        std::wstring &encoded_path) {
+  if (is_harmful_path(child_path)) {
+    return std::nullopt;
+  }
+  encoded_path = encode_into_native(child_path, always_utf8, codePage);
+  return std::make_optional(root / encoded_path);
+}
+
 } // namespace baulk::archive
\ No newline at end of file
@@ -3,36 +3,10 @@
 #include <bela/pe.hpp>
 #include <baulk/archive.hpp>
 #include "tar/tarinternal.hpp"
+#include "msi/msiinternal.hpp"
 
 namespace baulk::archive {
 
-struct oleheader_t {
-  uint32_t id[2]; // D0CF11E0 A1B11AE1
-  uint32_t clid[4];
-  uint16_t verminor; // 0x3e
-  uint16_t verdll;   // 0x03
-  uint16_t byteorder;
-  uint16_t lsectorB;
-  uint16_t lssectorB;
-
-  uint16_t reserved1;
-  uint32_t reserved2;
-  uint32_t reserved3;
-
-  uint32_t cfat; // count full sectors
-  uint32_t dirstart;
-
-  uint32_t reserved4;
-
-  uint32_t sectorcutoff; // min size of a standard stream ; if less than this
-                         // then it uses short-streams
-  uint32_t sfatstart;    // first short-sector or EOC
-  uint32_t csfat;        // count short sectors
-  uint32_t difstart;     // first sector master sector table or EOC
-  uint32_t cdif;         // total count
-  uint32_t MSAT[109];    // First 109 MSAT
-};
-
 const wchar_t *FormatToMIME(file_format_t t) {
   struct name_table {
     file_format_t t;
@@ -95,6 +69,9 @@ constexpr const uint8_t lzMagic[] = {0x4C, 0x5A, 0x49, 0x50};
 constexpr const uint8_t nsisSignature[] = {0xEF, 0xBE, 0xAD, 0xDE, 'N', 'u', 'l', 'l',
                                            's',  'o',  'f',  't',  'I', 'n', 's', 't'};
 
+// Inno Setup setup-0 header: "Inno Setup Setup Data (6.2.0) (u)"
+constexpr const uint8_t innoSignature[] = {'I', 'n', 'n', 'o', ' ', 'S', 'e', 't', 'u', 'p', ' '};
+
 constexpr bool is_zip_magic(const uint8_t *buf, size_t size) {
   return (size > 3 && buf[0] == 0x50 && buf[1] == 0x4B && (buf[2] == 0x3 || buf[2] == 0x5 || buf[2] == 0x7) &&
           (buf[3] == 0x4 || buf[3] == 0x6 || buf[3] == 0x8));
@@ -167,6 +144,9 @@ file_format_t analyze_format_internal(bela::bytes_view bv) {
   if (bv.match_with(4, nsisSignature, std::size(nsisSignature))) {
     return file_format_t::nsis;
   }
+  if (bv.starts_bytes_with(innoSignature)) {
+    return file_format_t::inno;
+  }
   if (bv.size() >= 512) {
     if (auto uh = bv.unchecked_cast<tar::ustar_header>(); getFormat(*uh) != tar::FormatUnknown) {
       return file_format_t::tar;
@@ -190,15 +170,15 @@ bool CheckFormat(bela::io::FD &fd, file_format_t &afmt, int64_t &offset, bela::e
       afmt != file_format_t::exe) {
     return true;
   }
-  bela::pe::File pefile;
-  if (!pefile.NewFile(fd.NativeFD(), bela::SizeUnInitialized, ec)) {
+  bela::pe::ProbeHeader ph;
+  if (!bela::pe::Probe(fd.NativeFD(), bela::SizeUnInitialized, ph, ec)) {
     return false;
   }
-  if (pefile.OverlayLength() < magic_size) {
+  if (ph.OverlayLength() < static_cast<int64_t>(magic_size)) {
     // EXE
     return true;
   }
-  offset = pefile.OverlayOffset();
+  offset = ph.OverlayOffset;
   if (!fd.ReadAt(magicBytes, offset, outlen, ec)) {
     return false;
   }
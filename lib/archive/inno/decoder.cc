@@ -0,0 +1,299 @@
+//
+#include <bela/codecvt.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "innointernal.hpp"
+
+namespace baulk::archive::inno {
+constexpr size_t decoderinsize = 256 * 1024;
+constexpr size_t decoderoutsize = 256 * 1024;
+constexpr size_t lzma1PropsSize = 5;
+
+// https://github.com/jrsoftware/issrc/blob/main/Projects/Src/Compression.Base.pas TransformCallInstructions
+// Inno Setup 5.2.0+: the compiler reads files in 64 KiB blocks and, when a CALL or JMP with a 32-bit relative
+// address fits in the block, makes the address absolute and flips the high byte when bit 23 is set
+void revertCallInstructions(uint8_t *p, size_t size, uint32_t offset) {
+  if (size < 5) {
+    return;
+  }
+  size -= 4;
+  for (size_t i = 0; i < size;) {
+    if (p[i] != 0xE8 && p[i] != 0xE9) {
+      i++;
+      continue;
+    }
+    i++;
+    if (p[i + 3] == 0x00 || p[i + 3] == 0xFF) {
+      auto addr = (offset + static_cast<uint32_t>(i) + 4) & 0xFFFFFF;
+      auto rel = (static_cast<uint32_t>(p[i]) | static_cast<uint32_t>(p[i + 1]) << 8 |
+                  static_cast<uint32_t>(p[i + 2]) << 16) -
+                 addr;
+      if ((rel & 0x800000) != 0) {
+        p[i + 3] = static_cast<uint8_t>(~p[i + 3]);
+      }
+      p[i] = static_cast<uint8_t>(rel);
+      p[i + 1] = static_cast<uint8_t>(rel >> 8);
+      p[i + 2] = static_cast<uint8_t>(rel >> 16);
+    }
+    i += 4;
+  }
+}
+
+Decoder::~Decoder() { release(); }
+
+void Decoder::release() {
+  if (zs != nullptr) {
+    inflateEnd(zs);
+    delete zs;
+    zs = nullptr;
+  }
+  if (bzs != nullptr) {
+    BZ2_bzDecompressEnd(bzs);
+    delete bzs;
+    bzs = nullptr;
+  }
+  if (xzs != nullptr) {
+    lzma_end(xzs);
+    delete xzs;
+    xzs = nullptr;
+  }
+}
+
+// detectMethod: the compression of the setup header applies to every compressed chunk, the first bytes of the
+// chunk tell it just as well: zlib and bzip2 have their stream headers, LZMA1 starts with lc/lp/pb (93 for the
+// defaults), LZMA2 with a dictionary size code <= 40 followed by a chunk that resets the dictionary
+inline method_t detectMethod(const uint8_t *p, size_t size) {
+  if (size >= 3 && p[0] == 'B' && p[1] == 'Z' && p[2] == 'h') {
+    return INNO_BZIP2;
+  }
+  if (size >= 2 && (p[0] & 0x0F) == 8 && ((static_cast<uint32_t>(p[0]) << 8) | p[1]) % 31 == 0) {
+    return INNO_ZLIB;
+  }
+  if (size >= 2 && p[0] <= 40 && (p[1] == 0x01 || p[1] >= 0xE0)) {
+    return INNO_LZMA2;
+  }
+  return INNO_LZMA1;
+}
+
+bool Decoder::Initialize(int64_t offset, int64_t length, bool compressed, bela::error_code &ec) {
+  release();
+  uint8_t magic[sizeof(chunkMagic)];
+  if (!readerAt(magic, offset, ec)) {
+    return false;
+  }
+  if (memcmp(magic, chunkMagic, sizeof(chunkMagic)) != 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"inno: bad chunk signature at ", offset);
+    return false;
+  }
+  position = offset + static_cast<int64_t>(sizeof(chunkMagic));
+  remaining = length;
+  eof = false;
+  in.resize(decoderinsize);
+  out.resize(decoderoutsize);
+  inPos = 0;
+  inSize = 0;
+  outPos = 0;
+  outSize = 0;
+  method = INNO_STORED;
+  if (!compressed) {
+    return true;
+  }
+  if (!fill(ec)) {
+    return false;
+  }
+  method = detectMethod(in.data(), inSize);
+  switch (method) {
+  case INNO_ZLIB:
+    zs = new z_stream{};
+    if (auto zerr = inflateInit(zs); zerr != Z_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+      return false;
+    }
+    return true;
+  case INNO_BZIP2:
+    bzs = new bz_stream{};
+    if (auto bzerr = BZ2_bzDecompressInit(bzs, 0, 0); bzerr != BZ_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: BZ2_bzDecompressInit error ", bzerr);
+      return false;
+    }
+    return true;
+  default:
+    break;
+  }
+  return initializeLZMA(ec);
+}
+
+bool Decoder::fill(bela::error_code &ec) {
+  if (inPos < inSize) {
+    return true;
+  }
+  inPos = 0;
+  inSize = 0;
+  if (remaining <= 0) {
+    return true;
+  }
+  auto minsize = static_cast<size_t>((std::min)(static_cast<int64_t>(in.size()), remaining));
+  if (!readerAt({in.data(), minsize}, position, ec)) {
+    return false;
+  }
+  position += static_cast<int64_t>(minsize);
+  remaining -= static_cast<int64_t>(minsize);
+  inSize = minsize;
+  return true;
+}
+
+// Inno LZMA1 chunks: 5 bytes properties (lc/lp/pb, dictionary size) + raw LZMA. LZMA2 chunks: 1 byte dictionary
+// size + raw LZMA2
+bool Decoder::initializeLZMA(bela::error_code &ec) {
+  auto propsSize = method == INNO_LZMA1 ? lzma1PropsSize : 1;
+  if (inSize - inPos < propsSize) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: lzma properties truncated");
+    return false;
+  }
+  lzma_filter filters[2];
+  filters[0] = {.id = method == INNO_LZMA1 ? LZMA_FILTER_LZMA1 : LZMA_FILTER_LZMA2, .options = nullptr};
+  filters[1] = {.id = LZMA_VLI_UNKNOWN, .options = nullptr};
+  if (auto ret = lzma_properties_decode(&filters[0], nullptr, in.data() + inPos, propsSize); ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: invalid lzma properties ", static_cast<int>(ret));
+    return false;
+  }
+  inPos += propsSize;
+  xzs = new lzma_stream;
+  *xzs = LZMA_STREAM_INIT;
+  auto ret = lzma_raw_decoder(xzs, filters);
+  free(filters[0].options);
+  if (ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: lzma_raw_decoder error ", static_cast<int>(ret));
+    return false;
+  }
+  return true;
+}
+
+bool Decoder::decompress(bela::error_code &ec) {
+  outPos = 0;
+  outSize = 0;
+  while (outSize == 0 && !eof) {
+    if (!fill(ec)) {
+      return false;
+    }
+    auto avail = inSize - inPos;
+    switch (method) {
+    case INNO_STORED: {
+      if (avail == 0) {
+        eof = true;
+        break;
+      }
+      auto n = (std::min)(avail, out.size());
+      memcpy(out.data(), in.data() + inPos, n);
+      inPos += n;
+      outSize = n;
+    } break;
+    case INNO_ZLIB: {
+      zs->next_in = in.data() + inPos;
+      zs->avail_in = static_cast<uInt>(avail);
+      zs->next_out = out.data();
+      zs->avail_out = static_cast<uInt>(out.size());
+      auto ret = ::inflate(zs, Z_NO_FLUSH);
+      inPos += avail - zs->avail_in;
+      outSize = out.size() - zs->avail_out;
+      if (ret == Z_STREAM_END || (ret == Z_BUF_ERROR && avail == 0)) {
+        eof = true;
+        break;
+      }
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(ret)));
+        return false;
+      }
+    } break;
+    case INNO_BZIP2: {
+      bzs->next_in = reinterpret_cast<char *>(in.data() + inPos);
+      bzs->avail_in = static_cast<unsigned int>(avail);
+      bzs->next_out = reinterpret_cast<char *>(out.data());
+      bzs->avail_out = static_cast<unsigned int>(out.size());
+      auto ret = BZ2_bzDecompress(bzs);
+      inPos += avail - bzs->avail_in;
+      outSize = out.size() - bzs->avail_out;
+      if (ret == BZ_STREAM_END || (ret == BZ_OK && avail == 0 && outSize == 0)) {
+        eof = true;
+        break;
+      }
+      if (ret != BZ_OK) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"inno: bzip2 decompress error ", ret);
+        return false;
+      }
+    } break;
+    default: {
+      xzs->next_in = in.data() + inPos;
+      xzs->avail_in = avail;
+      xzs->next_out = out.data();
+      xzs->avail_out = out.size();
+      auto ret = lzma_code(xzs, avail == 0 ? LZMA_FINISH : LZMA_RUN);
+      inPos += avail - xzs->avail_in;
+      outSize = out.size() - xzs->avail_out;
+      // streams without end marker: all data decoded once the input is gone
+      if (ret == LZMA_STREAM_END || (ret == LZMA_BUF_ERROR && avail == 0) || (avail == 0 && outSize == 0)) {
+        eof = true;
+        break;
+      }
+      if (ret != LZMA_OK) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"inno: lzma decompress error ", static_cast<int>(ret));
+        return false;
+      }
+    } break;
+    }
+  }
+  return true;
+}
+
+ssize_t Decoder::Read(void *buffer, size_t len, bela::error_code &ec) {
+  if (outPos == outSize) {
+    if (!decompress(ec)) {
+      return -1;
+    }
+    if (outSize == 0) {
+      return 0;
+    }
+  }
+  auto minsize = (std::min)(len, outSize - outPos);
+  memcpy(buffer, out.data() + outPos, minsize);
+  outPos += minsize;
+  return static_cast<ssize_t>(minsize);
+}
+
+bool Decoder::ReadFull(void *buffer, size_t len, bela::error_code &ec) {
+  auto p = reinterpret_cast<uint8_t *>(buffer);
+  size_t rbytes = 0;
+  while (rbytes < len) {
+    auto n = Read(p + rbytes, len - rbytes, ec);
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: unexpected end of chunk");
+      return false;
+    }
+    rbytes += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool Decoder::Discard(uint64_t len, bela::error_code &ec) {
+  while (len > 0) {
+    if (outPos == outSize) {
+      if (!decompress(ec)) {
+        return false;
+      }
+      if (outSize == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"inno: unexpected end of chunk");
+        return false;
+      }
+    }
+    auto minsize = static_cast<size_t>((std::min)(len, static_cast<uint64_t>(outSize - outPos)));
+    outPos += minsize;
+    len -= minsize;
+  }
+  return true;
+}
+
+} // namespace baulk::archive::inno
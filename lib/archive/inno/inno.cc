@@ -0,0 +1,631 @@
+///
+#include <bela/str_cat.hpp>
+#include <bela/codecvt.hpp>
+#include <bela/hash.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include "innointernal.hpp"
+
+namespace baulk::archive::inno {
+constexpr std::string_view setupIdPrefix = "Inno Setup Setup Data (";
+constexpr std::u16string_view appPrefix = u"{app}\\";
+// TSetupHeader: 30 unicode strings up to 6.2 and more in later versions, 4 ansi strings, then the entry counts
+constexpr uint32_t minHeaderStrings = 28;
+constexpr uint32_t maxHeaderStrings = 40;
+constexpr uint32_t headerAnsiStrings = 4;
+// the fixed part after the counts (versions, colors, wizard settings, options) changes with nearly every release,
+// the reader looks for the offset at which the entry lists parse
+constexpr size_t maxHeaderTail = 512;
+constexpr size_t callInstructionBlock = 64 * 1024;
+
+// header entry counts, the entry lists follow the header in this order
+enum entry_t : size_t {
+  entryLanguage = 0,
+  entryCustomMessage,
+  entryPermission,
+  entryType,
+  entryComponent,
+  entryTask,
+  entryDirectory,
+  entryFile,
+  entryFileLocation,
+  entryIcon,
+  entryIni,
+  entryRegistry,
+  entryInstallDelete,
+  entryUninstallDelete,
+  entryRun,
+  entryUninstallRun,
+  entryCount,
+};
+
+// entry layout: unicode strings, ansi strings, then fixed size fields
+struct entryLayout {
+  uint32_t strings;
+  uint32_t ansiStrings;
+  size_t fixed;
+};
+// Inno Setup 5.5 - 6.4
+constexpr entryLayout languageLayout{.strings = 6, .ansiStrings = 4, .fixed = 21};
+constexpr entryLayout customMessageLayout{.strings = 2, .ansiStrings = 0, .fixed = 4};
+constexpr entryLayout permissionLayout{.strings = 0, .ansiStrings = 1, .fixed = 0};
+constexpr entryLayout typeLayout{.strings = 4, .ansiStrings = 0, .fixed = 30};
+constexpr entryLayout componentLayout{.strings = 5, .ansiStrings = 0, .fixed = 42};
+constexpr entryLayout taskLayout{.strings = 6, .ansiStrings = 0, .fixed = 26};
+constexpr entryLayout directoryLayout{.strings = 7, .ansiStrings = 0, .fixed = 27};
+// TSetupFileEntry: SourceFilename, DestName, ... then MinVersion/OnlyBelowVersion, LocationEntry, Attribs,
+// ExternalSize, PermissionsEntry, Options and FileType
+constexpr uint32_t fileStrings = 10;
+constexpr size_t fileVersionsSize = 20;
+constexpr size_t fileOptionsSize = 4 + 8 + 2 + 4;
+// TSetupFileLocationEntry without the checksum and the flags
+constexpr size_t locationFixedSize = 4 + 4 + 4 + 8 + 8 + 8 + 8 + 4 + 4;
+
+// cursor walks the setup-0 records: strings are a 32-bit byte length followed by the data
+class cursor {
+public:
+  cursor(bela::bytes_view bv_, size_t pos_ = 0) : bv(bv_), pos(pos_) {}
+  size_t Position() const { return pos; }
+  bool Skip(size_t n) {
+    if (n > bv.size() - pos) {
+      return false;
+    }
+    pos += n;
+    return true;
+  }
+  template <typename T> bool Read(T &v) {
+    if (sizeof(T) > bv.size() - pos) {
+      return false;
+    }
+    v = bv.cast_fromle<T>(pos);
+    pos += sizeof(T);
+    return true;
+  }
+  // String reads one string, unicode strings are UTF-16LE and must have an even length
+  bool String(bela::bytes_view &s, bool unicode) {
+    uint32_t len = 0;
+    if (!Read(len) || len > bv.size() - pos || (unicode && len % 2 != 0)) {
+      return false;
+    }
+    s = bv.subview(pos, len);
+    pos += len;
+    return true;
+  }
+  bool SkipStrings(uint32_t n, bool unicode) {
+    bela::bytes_view s;
+    for (uint32_t i = 0; i < n; i++) {
+      if (!String(s, unicode)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool SkipEntry(const entryLayout &layout) {
+    return SkipStrings(layout.strings, true) && SkipStrings(layout.ansiStrings, false) && Skip(layout.fixed);
+  }
+
+private:
+  bela::bytes_view bv;
+  size_t pos{0};
+};
+
+inline std::u16string decodeString(bela::bytes_view s) {
+  std::u16string us;
+  us.resize(s.size() / 2);
+  for (size_t i = 0; i < us.size(); i++) {
+    us[i] = static_cast<char16_t>(s.cast_fromle<uint16_t>(i * 2));
+  }
+  return us;
+}
+
+// appPath: the name relative to {app}, empty for files installed elsewhere or with constants left in the name
+inline std::string appPath(bela::bytes_view destName) {
+  auto us = decodeString(destName);
+  if (us.size() <= appPrefix.size()) {
+    return "";
+  }
+  for (size_t i = 0; i < appPrefix.size(); i++) {
+    auto c = us[i] >= u'A' && us[i] <= u'Z' ? static_cast<char16_t>(us[i] + (u'a' - u'A')) : us[i];
+    if (c != appPrefix[i]) {
+      return "";
+    }
+  }
+  std::u16string name;
+  for (size_t i = appPrefix.size(); i < us.size(); i++) {
+    auto c = us[i];
+    if (c == u'{') {
+      if (i + 1 < us.size() && us[i + 1] == u'{') {
+        name.push_back(c);
+        i++;
+        continue;
+      }
+      return "";
+    }
+    name.push_back(c == u'\\' ? u'/' : c);
+  }
+  return bela::encode_into<char16_t, char>(name);
+}
+
+// isLanguageName: TSetupLanguageEntry.Name is the [Languages] Name, e.g. "english"
+inline bool isLanguageName(bela::bytes_view s) {
+  if (s.size() == 0 || s.size() > 128) {
+    return false;
+  }
+  for (size_t i = 0; i < s.size(); i += 2) {
+    auto c = s.cast_fromle<uint16_t>(i);
+    if (c < 0x20 || c >= 0x7F) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#if defined(_WIN32)
+bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  auto fd_ = bela::io::NewFile(file, ec);
+  if (!fd_) {
+    return false;
+  }
+  fd = std::move(*fd_);
+  file_format_t afmt{file_format_t::none};
+  if (!CheckFormat(fd, afmt, baseOffset, ec)) {
+    return false;
+  }
+  if (afmt != file_format_t::inno) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: not an Inno Setup installer");
+    return false;
+  }
+  return Initialize(ec);
+}
+
+bool Reader::OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  fd.Assgin(nfd, false);
+  size = size_;
+  baseOffset = offset_;
+  return Initialize(ec);
+}
+#endif
+
+Reader::Reader() = default;
+Reader::~Reader() = default;
+
+bool Reader::OpenReader(ReaderAt &&readerAt_, int64_t size_, bela::error_code &ec) {
+#if defined(_WIN32)
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+#endif
+  if (readerAt) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  readerAt = std::move(readerAt_);
+  size = size_;
+  baseOffset = 0;
+  return Initialize(ec);
+}
+
+bool Reader::readAt(std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const {
+  if (readerAt) {
+    return readerAt(buffer, pos, ec);
+  }
+#if defined(_WIN32)
+  return fd.ReadAt(buffer, baseOffset + pos, ec);
+#else
+  ec = bela::make_error_code(L"inno: no reader");
+  return false;
+#endif
+}
+
+// readBlock reads one setup-0 block at position and advances position past it
+bool Reader::readBlock(int64_t &position, std::vector<uint8_t> &out, bela::error_code &ec) const {
+  uint8_t hdr[blockHeaderSize];
+  if (size - position < static_cast<int64_t>(blockHeaderSize)) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: setup data truncated");
+    return false;
+  }
+  if (!readAt(hdr, position, ec)) {
+    return false;
+  }
+  if (crc32(0, hdr + 4, 5) != bela::cast_fromle<uint32_t>(hdr)) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: block header crc mismatch");
+    return false;
+  }
+  auto storedSize = bela::cast_fromle<uint32_t>(hdr + 4);
+  auto compressed = hdr[8] != 0;
+  position += blockHeaderSize;
+  if (size - position < static_cast<int64_t>(storedSize)) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: setup data truncated");
+    return false;
+  }
+  std::vector<uint8_t> stored(storedSize);
+  if (!readAt(stored, position, ec)) {
+    return false;
+  }
+  position += storedSize;
+  std::vector<uint8_t> payload;
+  payload.reserve(storedSize);
+  for (size_t pos = 0; pos < stored.size();) {
+    auto n = (std::min)(stored.size() - pos, blockChunkSize + 4);
+    if (n <= 4) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: bad block chunk size");
+      return false;
+    }
+    if (crc32(0, stored.data() + pos + 4, static_cast<uInt>(n - 4)) !=
+        bela::cast_fromle<uint32_t>(stored.data() + pos)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: block chunk crc mismatch");
+      return false;
+    }
+    payload.insert(payload.end(), stored.begin() + pos + 4, stored.begin() + pos + n);
+    pos += n;
+  }
+  if (!compressed) {
+    out = std::move(payload);
+    return true;
+  }
+  // compressed blocks are LZMA1 since 4.1.6: 5 bytes properties + raw lzma
+  if (payload.size() < 5) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: compressed block truncated");
+    return false;
+  }
+  lzma_filter filters[2];
+  filters[0] = {.id = LZMA_FILTER_LZMA1, .options = nullptr};
+  filters[1] = {.id = LZMA_VLI_UNKNOWN, .options = nullptr};
+  if (auto ret = lzma_properties_decode(&filters[0], nullptr, payload.data(), 5); ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrAnotherWay, L"inno: block is not lzma compressed");
+    return false;
+  }
+  lzma_stream xzs = LZMA_STREAM_INIT;
+  auto ret = lzma_raw_decoder(&xzs, filters);
+  free(filters[0].options);
+  if (ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: lzma_raw_decoder error ", static_cast<int>(ret));
+    return false;
+  }
+  out.clear();
+  xzs.next_in = payload.data() + 5;
+  xzs.avail_in = payload.size() - 5;
+  uint8_t buffer[64 * 1024];
+  for (;;) {
+    xzs.next_out = buffer;
+    xzs.avail_out = sizeof(buffer);
+    ret = lzma_code(&xzs, LZMA_FINISH);
+    out.insert(out.end(), buffer, buffer + (sizeof(buffer) - xzs.avail_out));
+    if (ret == LZMA_STREAM_END || (ret == LZMA_BUF_ERROR && xzs.avail_in == 0)) {
+      break;
+    }
+    if (ret != LZMA_OK) {
+      lzma_end(&xzs);
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: lzma decompress error ", static_cast<int>(ret));
+      return false;
+    }
+    if (xzs.avail_in == 0 && xzs.avail_out != 0) {
+      break;
+    }
+  }
+  lzma_end(&xzs);
+  return true;
+}
+
+// parseFileEntries walks the entry lists from the end of the header at pos, succeeds only when every list up to
+// the file entries holds together
+static bool parseFileEntries(bela::bytes_view bv, size_t pos, const uint32_t (&counts)[entryCount],
+                             std::vector<std::pair<std::string, size_t>> &entries) {
+  cursor c(bv, pos);
+  bela::bytes_view s;
+  for (uint32_t i = 0; i < counts[entryLanguage]; i++) {
+    if (!c.String(s, true) || !isLanguageName(s) || !c.SkipStrings(languageLayout.strings - 1, true) ||
+        !c.SkipStrings(languageLayout.ansiStrings, false) || !c.Skip(languageLayout.fixed)) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < counts[entryCustomMessage]; i++) {
+    int32_t language = 0;
+    if (!c.SkipStrings(customMessageLayout.strings, true) || !c.Read(language) || language < -1 ||
+        language >= static_cast<int32_t>(counts[entryLanguage])) {
+      return false;
+    }
+  }
+  constexpr std::pair<entry_t, const entryLayout *> lists[] = {
+      {entryPermission, &permissionLayout}, {entryType, &typeLayout},           {entryComponent, &componentLayout},
+      {entryTask, &taskLayout},             {entryDirectory, &directoryLayout},
+  };
+  for (const auto &[entry, layout] : lists) {
+    for (uint32_t i = 0; i < counts[entry]; i++) {
+      if (!c.SkipEntry(*layout)) {
+        return false;
+      }
+    }
+  }
+  entries.clear();
+  for (uint32_t i = 0; i < counts[entryFile]; i++) {
+    bela::bytes_view destName;
+    int32_t locationEntry = 0;
+    uint8_t fileType = 0;
+    if (!c.SkipStrings(1, true) || !c.String(destName, true) || !c.SkipStrings(fileStrings - 2, true) ||
+        !c.Skip(fileVersionsSize) || !c.Read(locationEntry) || !c.Skip(fileOptionsSize) || !c.Read(fileType)) {
+      return false;
+    }
+    // ftUserFile or ftUninstExe, -1 for files without data ({tmp} dlls, external files)
+    if (fileType > 1 || locationEntry < -1 || locationEntry >= static_cast<int32_t>(counts[entryFileLocation])) {
+      return false;
+    }
+    if (locationEntry < 0 || fileType != 0) {
+      continue;
+    }
+    if (auto name = appPath(destName); !name.empty()) {
+      entries.emplace_back(std::move(name), static_cast<size_t>(locationEntry));
+    }
+  }
+  return true;
+}
+
+bool Reader::parseEntries(const std::vector<uint8_t> &block, size_t &locationCount, bela::error_code &ec) {
+  bela::bytes_view bv(block.data(), block.size());
+  std::vector<std::pair<std::string, size_t>> entries;
+  for (auto strings = minHeaderStrings; strings <= maxHeaderStrings; strings++) {
+    cursor c(bv);
+    if (!c.SkipStrings(strings, true)) {
+      break;
+    }
+    if (!c.SkipStrings(headerAnsiStrings, false)) {
+      continue;
+    }
+    uint32_t counts[entryCount];
+    bool sane = true;
+    for (auto &n : counts) {
+      // every entry takes at least 4 bytes
+      if (!c.Read(n) || n > block.size() / 4) {
+        sane = false;
+        break;
+      }
+    }
+    if (!sane || counts[entryLanguage] == 0) {
+      continue;
+    }
+    for (size_t tail = 0; tail <= maxHeaderTail; tail++) {
+      if (!parseFileEntries(bv, c.Position() + tail, counts, entries)) {
+        continue;
+      }
+      locationCount = counts[entryFileLocation];
+      // a later entry for the same path replaces the earlier one, as the installer overwrites it
+      std::unordered_map<std::string, size_t> indexes;
+      files.clear();
+      files.reserve(entries.size());
+      for (auto &[name, location] : entries) {
+        auto key = name;
+        std::transform(key.begin(), key.end(), key.begin(),
+                       [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; });
+        if (auto it = indexes.find(key); it != indexes.end()) {
+          files[it->second] = File{.name = std::move(name), .location = location, .size = 0, .time = {}};
+          continue;
+        }
+        indexes.emplace(std::move(key), files.size());
+        files.emplace_back(File{.name = std::move(name), .location = location, .size = 0, .time = {}});
+      }
+      return true;
+    }
+  }
+  ec = bela::make_error_code(ErrAnotherWay, L"inno: unsupported setup header layout");
+  return false;
+}
+
+bool Reader::parseLocations(const std::vector<uint8_t> &block, size_t locationCount, bela::error_code &ec) {
+  locations.clear();
+  if (locationCount == 0) {
+    return true;
+  }
+  // the checksum is SHA-1 up to 6.3 and SHA-256 since 6.4, the flags a 1 to 4 bytes Pascal set
+  auto entrySize = block.size() / locationCount;
+  size_t checksumSize = 0;
+  if (entrySize > locationFixedSize + sha1::digestSize && entrySize <= locationFixedSize + sha1::digestSize + 4) {
+    checksumSize = sha1::digestSize;
+  } else if (entrySize > locationFixedSize + 32 && entrySize <= locationFixedSize + 32 + 4) {
+    checksumSize = 32;
+  }
+  if (checksumSize == 0 || block.size() % locationCount != 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"inno: unsupported file location entry size ", entrySize);
+    return false;
+  }
+  auto flagsSize = entrySize - locationFixedSize - checksumSize;
+  bela::bytes_view bv(block.data(), block.size());
+  locations.resize(locationCount);
+  for (size_t i = 0; i < locationCount; i++) {
+    auto p = i * entrySize;
+    auto &loc = locations[i];
+    loc.firstSlice = bv.cast_fromle<uint32_t>(p);
+    loc.lastSlice = bv.cast_fromle<uint32_t>(p + 4);
+    loc.chunkOffset = bv.cast_fromle<uint32_t>(p + 8);
+    loc.chunkSuboffset = bv.cast_fromle<uint64_t>(p + 12);
+    loc.originalSize = bv.cast_fromle<uint64_t>(p + 20);
+    loc.chunkSize = bv.cast_fromle<uint64_t>(p + 28);
+    memcpy(loc.checksum, block.data() + p + 36, checksumSize);
+    loc.checksumSize = checksumSize;
+    p += 36 + checksumSize;
+    loc.timestamp = bv.cast_fromle<uint64_t>(p);
+    p += 16; // FILETIME, FileVersionMS, FileVersionLS
+    loc.flags = 0;
+    for (size_t j = 0; j < flagsSize; j++) {
+      loc.flags |= static_cast<uint32_t>(block[p + j]) << (j * 8);
+    }
+  }
+  return true;
+}
+
+bool Reader::Initialize(bela::error_code &ec) {
+#if defined(_WIN32)
+  if (size == bela::SizeUnInitialized) {
+    if (size = fd.Size(ec); size == bela::SizeUnInitialized) {
+      return false;
+    }
+  }
+#endif
+  if (size < static_cast<int64_t>(setupIdSize + blockHeaderSize)) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: setup data truncated");
+    return false;
+  }
+  uint8_t id[setupIdSize];
+  if (!readAt(id, 0, ec)) {
+    return false;
+  }
+  version.assign(bela::bytes_view(id, sizeof(id)).make_cstring_view(0, sizeof(id)));
+  if (!version.starts_with(setupIdPrefix)) {
+    ec = bela::make_error_code(ErrNotInnoFile, L"inno: invalid setup id");
+    return false;
+  }
+  // "(5.5.0) (u)": the Unicode builds of 5.5 and later, the only ones of Inno Setup 6
+  uint32_t major = 0;
+  uint32_t minor = 0;
+  auto vp = version.substr(setupIdPrefix.size());
+  size_t i = 0;
+  for (; i < vp.size() && vp[i] >= '0' && vp[i] <= '9'; i++) {
+    major = major * 10 + static_cast<uint32_t>(vp[i] - '0');
+  }
+  if (i < vp.size() && vp[i] == '.') {
+    for (i++; i < vp.size() && vp[i] >= '0' && vp[i] <= '9'; i++) {
+      minor = minor * 10 + static_cast<uint32_t>(vp[i] - '0');
+    }
+  }
+  auto unicode = version.find("(u)") != std::string::npos || version.find("(U)") != std::string::npos;
+  if (!unicode || major < 5 || (major == 5 && minor < 5)) {
+    ec = bela::make_error_code(ErrAnotherWay, L"inno: unsupported setup data version ",
+                               bela::encode_into<char, wchar_t>(version));
+    return false;
+  }
+  int64_t position = setupIdSize;
+  std::vector<uint8_t> block;
+  if (!readBlock(position, block, ec)) {
+    return false;
+  }
+  size_t locationCount = 0;
+  if (!parseEntries(block, locationCount, ec)) {
+    return false;
+  }
+  if (!readBlock(position, block, ec)) {
+    return false;
+  }
+  if (!parseLocations(block, locationCount, ec)) {
+    return false;
+  }
+  // setup-1 follows setup-0 in the same file, spanned installers keep it in setup-1.bin slices
+  setup1Offset = position;
+  compressed_size = size - setup1Offset;
+  for (auto &file : files) {
+    const auto &loc = locations[file.location];
+    if (loc.firstSlice != 0 || loc.lastSlice != 0) {
+      ec = bela::make_error_code(ErrAnotherWay, L"inno: disk spanning is not supported");
+      return false;
+    }
+    if ((loc.flags & locChunkEncrypted) != 0) {
+      ec = bela::make_error_code(ErrAnotherWay, L"inno: encrypted files are not supported");
+      return false;
+    }
+    if (loc.chunkOffset + static_cast<int64_t>(sizeof(chunkMagic)) > compressed_size ||
+        loc.chunkSize > static_cast<uint64_t>(compressed_size - loc.chunkOffset)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: chunk of ", bela::encode_into<char, wchar_t>(file.name),
+                                 L" out of range");
+      return false;
+    }
+    file.size = static_cast<int64_t>(loc.originalSize);
+    file.time = bela::FromWindowsPreciseTime(loc.timestamp);
+  }
+  if (!files.empty()) {
+    // setup-1 must start with a chunk, anything else means the layout guess above was wrong
+    uint8_t magic[sizeof(chunkMagic)];
+    if (!readAt(magic, setup1Offset + locations[files.front().location].chunkOffset, ec)) {
+      return false;
+    }
+    if (memcmp(magic, chunkMagic, sizeof(chunkMagic)) != 0) {
+      ec = bela::make_error_code(ErrAnotherWay, L"inno: setup-1 not found after setup-0");
+      return false;
+    }
+  }
+  std::stable_sort(files.begin(), files.end(), [&](const File &a, const File &b) {
+    const auto &la = locations[a.location];
+    const auto &lb = locations[b.location];
+    return la.chunkOffset < lb.chunkOffset || (la.chunkOffset == lb.chunkOffset && la.chunkSuboffset < lb.chunkSuboffset);
+  });
+  decoder = std::make_unique<Decoder>([this](std::span<uint8_t> buffer, int64_t pos, bela::error_code &rec) {
+    return readAt(buffer, setup1Offset + pos, rec);
+  });
+  return true;
+}
+
+// chunkSeek positions the decoder at the file data, files of one chunk are read forward without restarting it
+bool Reader::chunkSeek(const location &loc, bela::error_code &ec) {
+  if (chunkOffset != loc.chunkOffset || chunkPosition > loc.chunkSuboffset) {
+    chunkOffset = -1;
+    if (!decoder->Initialize(loc.chunkOffset, static_cast<int64_t>(loc.chunkSize),
+                             (loc.flags & locChunkCompressed) != 0, ec)) {
+      return false;
+    }
+    chunkOffset = loc.chunkOffset;
+    chunkPosition = 0;
+  }
+  if (!decoder->Discard(loc.chunkSuboffset - chunkPosition, ec)) {
+    chunkOffset = -1;
+    return false;
+  }
+  chunkPosition = loc.chunkSuboffset;
+  return true;
+}
+
+bool Reader::Decompress(const File &file, const Writer &w, bela::error_code &ec) {
+  if (file.location >= locations.size()) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: file location ", file.location, L" out of range");
+    return false;
+  }
+  const auto &loc = locations[file.location];
+  if (!chunkSeek(loc, ec)) {
+    return false;
+  }
+  sha1 h1;
+  bela::hash::sha256::Hasher h256;
+  h256.Initialize();
+  std::vector<uint8_t> buffer(callInstructionBlock);
+  uint64_t offset = 0;
+  while (offset < loc.originalSize) {
+    auto n = static_cast<size_t>((std::min)(loc.originalSize - offset, static_cast<uint64_t>(buffer.size())));
+    if (!decoder->ReadFull(buffer.data(), n, ec)) {
+      chunkOffset = -1;
+      return false;
+    }
+    chunkPosition += n;
+    if ((loc.flags & locCallInstructionOptimized) != 0) {
+      revertCallInstructions(buffer.data(), n, static_cast<uint32_t>(offset));
+    }
+    if (loc.checksumSize == sha1::digestSize) {
+      h1.Update(buffer.data(), n);
+    } else {
+      h256.Update(buffer.data(), n);
+    }
+    if (!w(buffer.data(), n)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"inno: write ", bela::encode_into<char, wchar_t>(file.name),
+                                 L" error");
+      return false;
+    }
+    offset += n;
+  }
+  uint8_t digest[32];
+  if (loc.checksumSize == sha1::digestSize) {
+    h1.Finalize(digest);
+  } else {
+    h256.Finalize(digest, sizeof(digest));
+  }
+  if (memcmp(digest, loc.checksum, loc.checksumSize) != 0) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"inno: checksum mismatch: ", bela::encode_into<char, wchar_t>(file.name));
+    return false;
+  }
+  return true;
+}
+
+} // namespace baulk::archive::inno
@@ -0,0 +1,103 @@
+//
+#ifndef BAULK_ARCHIVE_INNO_INTERNAL_HPP
+#define BAULK_ARCHIVE_INNO_INTERNAL_HPP
+#include <baulk/archive/inno.hpp>
+#include <baulk/archive/format.hpp>
+#include <bela/endian.hpp>
+#include <bela/bytes_view.hpp>
+#include "zlib.h"
+#include "bzlib.h"
+#ifndef LZMA_API_STATIC
+#define LZMA_API_STATIC 1
+#endif
+#include <lzma.h>
+
+namespace baulk::archive::inno {
+using bela::ssize_t;
+constexpr long ErrNotInnoFile = 755330;
+
+// setup-0 starts with a 64-byte id, "Inno Setup Setup Data (6.2.2) (u)"
+constexpr size_t setupIdSize = 64;
+// setup-0 blocks: crc32 of the next 5 bytes, stored size, compressed flag, then the stored data in 4096-byte
+// chunks that each start with their own crc32
+constexpr size_t blockHeaderSize = 9;
+constexpr size_t blockChunkSize = 4096;
+// every setup-1 chunk starts with 'zlb' 0x1A whatever its compression
+constexpr uint8_t chunkMagic[] = {'z', 'l', 'b', 0x1A};
+
+// TSetupFileLocationEntry flags
+constexpr uint32_t locTimeStampInUTC = 1U << 2;
+constexpr uint32_t locCallInstructionOptimized = 1U << 4;
+constexpr uint32_t locChunkEncrypted = 1U << 6;
+constexpr uint32_t locChunkCompressed = 1U << 7;
+
+// TSetupFileLocationEntry: the fields the reader uses
+struct location {
+  uint32_t firstSlice{0};
+  uint32_t lastSlice{0};
+  int64_t chunkOffset{0};     // chunk start, relative to setup-1
+  uint64_t chunkSuboffset{0}; // file start in the decompressed chunk
+  uint64_t originalSize{0};
+  uint64_t chunkSize{0}; // compressed chunk size, without the chunk magic
+  uint8_t checksum[32];
+  size_t checksumSize{0}; // 20: SHA-1 before 6.4, 32: SHA-256
+  uint64_t timestamp{0};  // FILETIME
+  uint32_t flags{0};
+};
+
+// sha1: the file checksums of Inno Setup 5.3.9 up to 6.3
+class sha1 {
+public:
+  static constexpr size_t digestSize = 20;
+  sha1();
+  void Update(const void *data, size_t len);
+  void Finalize(uint8_t digest[digestSize]);
+
+private:
+  uint32_t state[5];
+  uint64_t length{0};
+  uint8_t block[64];
+  size_t blockSize{0};
+  void transform(const uint8_t *p);
+};
+
+// revertCallInstructions undoes the x86 CALL/JMP address transform of one 64 KiB block of a file
+void revertCallInstructions(uint8_t *p, size_t size, uint32_t offset);
+
+// Decoder decompresses one setup-1 chunk located at [offset, offset+length) of the setup data
+class Decoder {
+public:
+  Decoder(ReaderAt &&readerAt_) : readerAt(std::move(readerAt_)) {}
+  Decoder(const Decoder &) = delete;
+  Decoder &operator=(const Decoder &) = delete;
+  ~Decoder();
+  bool Initialize(int64_t offset, int64_t length, bool compressed, bela::error_code &ec);
+  method_t Method() const { return method; }
+  ssize_t Read(void *buffer, size_t len, bela::error_code &ec);
+  bool ReadFull(void *buffer, size_t len, bela::error_code &ec);
+  bool Discard(uint64_t len, bela::error_code &ec);
+
+private:
+  bool fill(bela::error_code &ec);
+  bool decompress(bela::error_code &ec);
+  bool initializeLZMA(bela::error_code &ec);
+  void release();
+  ReaderAt readerAt;
+  method_t method{INNO_STORED};
+  int64_t position{0};
+  int64_t remaining{0};
+  z_stream *zs{nullptr};
+  bz_stream *bzs{nullptr};
+  lzma_stream *xzs{nullptr};
+  std::vector<uint8_t> in;
+  size_t inPos{0};
+  size_t inSize{0};
+  std::vector<uint8_t> out;
+  size_t outPos{0};
+  size_t outSize{0};
+  bool eof{false};
+};
+
+} // namespace baulk::archive::inno
+
+#endif
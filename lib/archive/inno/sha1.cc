@@ -0,0 +1,99 @@
+// SHA-1 (FIPS 180-4) for the file checksums of Inno Setup 5.3.9 up to 6.3, only used to verify extracted files
+#include <algorithm>
+#include <cstring>
+#include "innointernal.hpp"
+
+namespace baulk::archive::inno {
+inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+sha1::sha1() {
+  state[0] = 0x67452301;
+  state[1] = 0xEFCDAB89;
+  state[2] = 0x98BADCFE;
+  state[3] = 0x10325476;
+  state[4] = 0xC3D2E1F0;
+}
+
+void sha1::transform(const uint8_t *p) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = static_cast<uint32_t>(p[i * 4]) << 24 | static_cast<uint32_t>(p[i * 4 + 1]) << 16 |
+           static_cast<uint32_t>(p[i * 4 + 2]) << 8 | p[i * 4 + 3];
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  auto a = state[0];
+  auto b = state[1];
+  auto c = state[2];
+  auto d = state[3];
+  auto e = state[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f = 0;
+    uint32_t k = 0;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    auto t = rotl(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotl(b, 30);
+    b = a;
+    a = t;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+void sha1::Update(const void *data, size_t len) {
+  auto p = reinterpret_cast<const uint8_t *>(data);
+  length += len;
+  if (blockSize != 0) {
+    auto n = (std::min)(len, sizeof(block) - blockSize);
+    memcpy(block + blockSize, p, n);
+    blockSize += n;
+    p += n;
+    len -= n;
+    if (blockSize < sizeof(block)) {
+      return;
+    }
+    transform(block);
+    blockSize = 0;
+  }
+  for (; len >= sizeof(block); p += sizeof(block), len -= sizeof(block)) {
+    transform(p);
+  }
+  memcpy(block, p, len);
+  blockSize = len;
+}
+
+void sha1::Finalize(uint8_t digest[digestSize]) {
+  auto bits = length * 8;
+  uint8_t pad[72] = {0x80};
+  auto padSize = (blockSize < 56 ? 56 : 120) - blockSize;
+  for (int i = 0; i < 8; i++) {
+    pad[padSize + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+  }
+  Update(pad, padSize + 8);
+  for (int i = 0; i < 5; i++) {
+    digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+    digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+    digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+    digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+  }
+}
+
+} // namespace baulk::archive::inno
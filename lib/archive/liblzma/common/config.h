@@ -115,7 +115,10 @@
 /* Define to 1 if the system has the type `_Bool'. */
 #define HAVE__BOOL 1
 
-#ifdef _M_IX86
+#if !defined(_WIN32)
+/* Define to 1 when using POSIX threads (pthreads). */
+#define MYTHREAD_POSIX 1
+#elif defined(_M_IX86)
 /* Define to 1 when using Windows 95 (and thus XP) compatible threads. This
    avoids use of features that were added in Windows Vista.
    This is used for 32-bit x86 builds for compatibility reasons since it
@@ -0,0 +1,487 @@
+//
+#include <bela/str_cat.hpp>
+#include <algorithm>
+#include "msiinternal.hpp"
+
+namespace baulk::archive::msi {
+constexpr size_t maxDirectoryDepth = 256;
+
+inline bool isAscii(std::string_view s) {
+  return std::all_of(s.begin(), s.end(), [](char c) { return static_cast<uint8_t>(c) < 0x80; });
+}
+
+inline std::string decodeString(std::string_view s, uint32_t codePage) {
+  if (codePage == CP_UTF8 || isAscii(s)) {
+    return std::string(s);
+  }
+  auto cp = codePage == 0 ? CP_ACP : codePage;
+  auto sz = MultiByteToWideChar(cp, 0, s.data(), static_cast<int>(s.size()), nullptr, 0);
+  std::wstring w;
+  w.resize(sz);
+  MultiByteToWideChar(cp, 0, s.data(), static_cast<int>(s.size()), w.data(), sz);
+  return bela::encode_into<wchar_t, char>(w);
+}
+
+// https://docs.microsoft.com/en-us/windows/win32/msi/column-definition-format
+struct column {
+  std::string name;
+  uint16_t type{0};
+  size_t width{0};
+  size_t offset{0}; // start of the column, tables are stored column by column
+};
+
+class table {
+public:
+  bool Load(const Storage &storage, std::string_view name, std::vector<column> &&columns_, bela::error_code &ec) {
+    columns = std::move(columns_);
+    size_t rowSize = 0;
+    for (const auto &c : columns) {
+      rowSize += c.width;
+    }
+    auto s = storage.Find(bela::encode_into<char, wchar_t>(bela::StringCat("!", name)));
+    if (s == nullptr || rowSize == 0) {
+      // empty tables have no stream
+      return true;
+    }
+    if (!storage.ReadAll(*s, data, ec)) {
+      return false;
+    }
+    rows = data.size() / rowSize;
+    size_t offset = 0;
+    for (auto &c : columns) {
+      c.offset = offset;
+      offset += c.width * rows;
+    }
+    return true;
+  }
+  size_t Rows() const { return rows; }
+  int Index(std::string_view name) const {
+    for (size_t i = 0; i < columns.size(); i++) {
+      if (columns[i].name == name) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+  uint32_t Raw(size_t row, int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= columns.size()) {
+      return 0;
+    }
+    const auto &c = columns[index];
+    auto p = data.data() + c.offset + row * c.width;
+    switch (c.width) {
+    case 2:
+      return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+    case 3:
+      return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16);
+    case 4:
+      return bela::cast_fromle<uint32_t>(p);
+    default:
+      break;
+    }
+    return 0;
+  }
+  // Integer returns 0 for null values
+  int64_t Integer(size_t row, int index) const {
+    auto raw = Raw(row, index);
+    if (raw == 0) {
+      return 0;
+    }
+    if (columns[index].width == 2) {
+      return static_cast<int64_t>(raw) - 0x8000;
+    }
+    return static_cast<int64_t>(raw) - 0x80000000LL;
+  }
+
+private:
+  std::vector<column> columns;
+  std::vector<uint8_t> data;
+  size_t rows{0};
+};
+
+// database resolves the string pool and the table schema (_Columns)
+class database {
+public:
+  database(const Storage &storage_) : storage(storage_) {}
+  bool Initialize(bela::error_code &ec);
+  bool Open(std::string_view name, table &t, bela::error_code &ec) const;
+  std::string_view String(uint32_t id) const {
+    if (id >= strings.size()) {
+      return "";
+    }
+    return strings[id];
+  }
+
+private:
+  const Storage &storage;
+  std::vector<std::string> strings;
+  bela::flat_hash_map<std::string, std::vector<column>> schema;
+  size_t refSize{2};
+  bool loadStrings(bela::error_code &ec);
+  size_t width(uint16_t type) const {
+    if ((type & ~MSITYPE_NULLABLE) == (MSITYPE_STRING | MSITYPE_VALID)) {
+      return 2; // binary, index of the stream
+    }
+    if ((type & MSITYPE_STRING) != 0) {
+      return refSize;
+    }
+    return (type & 0xFF) <= 2 ? 2 : 4;
+  }
+};
+
+bool database::loadStrings(bela::error_code &ec) {
+  auto ps = storage.Find(L"!_StringPool");
+  auto ds = storage.Find(L"!_StringData");
+  if (ps == nullptr || ds == nullptr) {
+    ec = bela::make_error_code(ErrNotMsiFile, L"msi: string pool not found");
+    return false;
+  }
+  std::vector<uint8_t> poolBytes;
+  std::vector<uint8_t> stringData;
+  if (!storage.ReadAll(*ps, poolBytes, ec) || !storage.ReadAll(*ds, stringData, ec)) {
+    return false;
+  }
+  std::vector<uint16_t> pool(poolBytes.size() / 2);
+  for (size_t i = 0; i < pool.size(); i++) {
+    pool[i] = bela::cast_fromle<uint16_t>(poolBytes.data() + i * 2);
+  }
+  strings.emplace_back(); // string id 0 is null
+  if (pool.size() < 2) {
+    return true;
+  }
+  // header: codepage, bit 15 of the high word selects 3 bytes string references
+  uint32_t codePage = pool[0] | ((pool[1] & ~0x8000U) << 16);
+  refSize = (pool[1] & 0x8000) != 0 ? 3 : 2;
+  size_t offset = 0;
+  for (size_t i = 2; i + 1 < pool.size(); i += 2) {
+    size_t len = pool[i];
+    auto refs = pool[i + 1];
+    if (len == 0 && refs == 0) {
+      strings.emplace_back();
+      continue;
+    }
+    if (len == 0) {
+      // strings longer than 64K: the real length follows in the next entry
+      if (i + 3 >= pool.size()) {
+        break;
+      }
+      len = (static_cast<size_t>(pool[i + 3]) << 16) | pool[i + 2];
+      i += 2;
+    }
+    if (offset + len > stringData.size()) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: string pool data truncated");
+      return false;
+    }
+    strings.emplace_back(
+        decodeString({reinterpret_cast<const char *>(stringData.data()) + offset, len}, codePage));
+    offset += len;
+  }
+  return true;
+}
+
+bool database::Initialize(bela::error_code &ec) {
+  if (!loadStrings(ec)) {
+    return false;
+  }
+  // _Columns: Table (s64 key), Number (i2 key), Name (s64), Type (i2)
+  auto stringType = static_cast<uint16_t>(MSITYPE_VALID | MSITYPE_STRING | 64);
+  std::vector<column> columnsColumns{
+      {"Table", stringType, refSize}, {"Number", 0x0502, 2}, {"Name", stringType, refSize}, {"Type", 0x0502, 2}};
+  table columns;
+  if (!columns.Load(storage, "_Columns", std::move(columnsColumns), ec)) {
+    return false;
+  }
+  struct definition {
+    std::string table;
+    int64_t number;
+    column c;
+  };
+  std::vector<definition> definitions;
+  definitions.reserve(columns.Rows());
+  for (size_t row = 0; row < columns.Rows(); row++) {
+    auto type = static_cast<uint16_t>(columns.Integer(row, 3));
+    if ((type & MSITYPE_TEMPORARY) != 0) {
+      continue;
+    }
+    definitions.emplace_back(definition{std::string(String(columns.Raw(row, 0))), columns.Integer(row, 1),
+                                        column{std::string(String(columns.Raw(row, 2))), type, width(type)}});
+  }
+  std::sort(definitions.begin(), definitions.end(), [](const definition &a, const definition &b) {
+    return a.table == b.table ? a.number < b.number : a.table < b.table;
+  });
+  for (auto &d : definitions) {
+    schema[d.table].emplace_back(std::move(d.c));
+  }
+  return true;
+}
+
+bool database::Open(std::string_view name, table &t, bela::error_code &ec) const {
+  auto it = schema.find(name);
+  if (it == schema.end()) {
+    ec = bela::make_error_code(ErrAnotherWay, L"msi: table '", bela::encode_into<char, wchar_t>(name),
+                               L"' not found");
+    return false;
+  }
+  auto columns = it->second;
+  return t.Load(storage, name, std::move(columns), ec);
+}
+
+// DefaultDir is [target:]source, each part [short|]long
+inline std::string_view sourceName(std::string_view defaultDir) {
+  if (auto pos = defaultDir.find(':'); pos != std::string_view::npos) {
+    defaultDir.remove_prefix(pos + 1);
+  }
+  if (auto pos = defaultDir.find('|'); pos != std::string_view::npos) {
+    defaultDir.remove_prefix(pos + 1);
+  }
+  return defaultDir;
+}
+
+inline std::string_view longName(std::string_view fileName) {
+  if (auto pos = fileName.find('|'); pos != std::string_view::npos) {
+    fileName.remove_prefix(pos + 1);
+  }
+  return fileName;
+}
+
+class directories {
+public:
+  bool Load(const database &db, bela::error_code &ec) {
+    table t;
+    if (!db.Open("Directory", t, ec)) {
+      return false;
+    }
+    auto iKey = t.Index("Directory");
+    auto iParent = t.Index("Directory_Parent");
+    auto iDefault = t.Index("DefaultDir");
+    if (iKey < 0 || iParent < 0 || iDefault < 0) {
+      ec = bela::make_error_code(ErrAnotherWay, L"msi: invalid Directory table");
+      return false;
+    }
+    for (size_t row = 0; row < t.Rows(); row++) {
+      entries.emplace(db.String(t.Raw(row, iKey)),
+                      entry{std::string(db.String(t.Raw(row, iParent))),
+                            std::string(sourceName(db.String(t.Raw(row, iDefault))))});
+    }
+    return true;
+  }
+  // Resolve returns the source path relative to the root (TARGETDIR)
+  bool Resolve(const std::string &key, std::string &path, bela::error_code &ec) {
+    std::vector<const std::string *> chain;
+    const std::string *current = &key;
+    for (;;) {
+      if (auto it = resolved.find(*current); it != resolved.end()) {
+        path = it->second;
+        break;
+      }
+      auto it = entries.find(*current);
+      if (it == entries.end()) {
+        ec = bela::make_error_code(ErrAnotherWay, L"msi: directory '", bela::encode_into<char, wchar_t>(*current),
+                                   L"' not found");
+        return false;
+      }
+      if (it->second.parent.empty() || it->second.parent == *current) {
+        path.clear(); // root
+        resolved.emplace(*current, path);
+        break;
+      }
+      if (chain.size() > maxDirectoryDepth) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"msi: directory tree too deep");
+        return false;
+      }
+      chain.emplace_back(current);
+      current = &it->second.parent;
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      const auto &name = entries[**it].name;
+      if (!name.empty() && name != ".") {
+        path = path.empty() ? name : bela::StringCat(path, "/", name);
+      }
+      resolved.emplace(**it, path);
+    }
+    return true;
+  }
+
+private:
+  struct entry {
+    std::string parent;
+    std::string name;
+  };
+  bela::flat_hash_map<std::string, entry> entries;
+  bela::flat_hash_map<std::string, std::string> resolved;
+};
+
+Reader::Reader() = default;
+Reader::~Reader() = default;
+
+bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  auto fd_ = bela::io::NewFile(file, ec);
+  if (!fd_) {
+    return false;
+  }
+  fd = std::move(*fd_);
+  file_format_t afmt{file_format_t::none};
+  int64_t offset = 0;
+  if (!CheckFormat(fd, afmt, offset, ec)) {
+    return false;
+  }
+  if (afmt != file_format_t::msi) {
+    ec = bela::make_error_code(ErrNotMsiFile, L"msi: not a windows installer package");
+    return false;
+  }
+  return Initialize(ec);
+}
+
+bool Reader::OpenReader(HANDLE nfd, int64_t size_, bela::error_code &ec) {
+  if (fd) {
+    ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
+    return false;
+  }
+  fd.Assgin(nfd, false);
+  size = size_;
+  return Initialize(ec);
+}
+
+const File *Reader::Lookup(std::string_view key) const {
+  if (auto it = keys.find(key); it != keys.end()) {
+    return &files[it->second];
+  }
+  return nullptr;
+}
+
+bool Reader::Initialize(bela::error_code &ec) {
+  if (size == bela::SizeUnInitialized) {
+    if (size = fd.Size(ec); size == bela::SizeUnInitialized) {
+      return false;
+    }
+  }
+  storage = std::make_unique<Storage>(fd, size);
+  if (!storage->Initialize(ec)) {
+    return false;
+  }
+  database db(*storage);
+  if (!db.Initialize(ec)) {
+    return false;
+  }
+  directories dirs;
+  if (!dirs.Load(db, ec)) {
+    return false;
+  }
+  table components;
+  if (!db.Open("Component", components, ec)) {
+    return false;
+  }
+  auto iComponent = components.Index("Component");
+  auto iDirectory = components.Index("Directory_");
+  if (iComponent < 0 || iDirectory < 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"msi: invalid Component table");
+    return false;
+  }
+  bela::flat_hash_map<std::string, std::string> componentDirs;
+  for (size_t row = 0; row < components.Rows(); row++) {
+    componentDirs.emplace(db.String(components.Raw(row, iComponent)), db.String(components.Raw(row, iDirectory)));
+  }
+  // media: files with Sequence <= LastSequence belong to the cabinet
+  struct media {
+    int64_t lastSequence;
+    std::string cabinet;
+  };
+  std::vector<media> medias;
+  table mediaTable;
+  if (!db.Open("Media", mediaTable, ec)) {
+    return false;
+  }
+  auto iLastSequence = mediaTable.Index("LastSequence");
+  auto iCabinet = mediaTable.Index("Cabinet");
+  if (iLastSequence < 0 || iCabinet < 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"msi: invalid Media table");
+    return false;
+  }
+  for (size_t row = 0; row < mediaTable.Rows(); row++) {
+    medias.emplace_back(
+        media{mediaTable.Integer(row, iLastSequence), std::string(db.String(mediaTable.Raw(row, iCabinet)))});
+  }
+  std::sort(medias.begin(), medias.end(),
+            [](const media &a, const media &b) { return a.lastSequence < b.lastSequence; });
+  table fileTable;
+  if (!db.Open("File", fileTable, ec)) {
+    return false;
+  }
+  auto iFile = fileTable.Index("File");
+  auto iFileComponent = fileTable.Index("Component_");
+  auto iFileName = fileTable.Index("FileName");
+  auto iFileSize = fileTable.Index("FileSize");
+  auto iSequence = fileTable.Index("Sequence");
+  if (iFile < 0 || iFileComponent < 0 || iFileName < 0 || iFileSize < 0 || iSequence < 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"msi: invalid File table");
+    return false;
+  }
+  std::vector<std::string> usedCabinets;
+  files.reserve(fileTable.Rows());
+  for (size_t row = 0; row < fileTable.Rows(); row++) {
+    File file;
+    file.key = db.String(fileTable.Raw(row, iFile));
+    file.size = fileTable.Integer(row, iFileSize);
+    file.sequence = static_cast<int32_t>(fileTable.Integer(row, iSequence));
+    auto mit = std::lower_bound(medias.begin(), medias.end(), file.sequence,
+                                [](const media &m, int64_t sequence) { return m.lastSequence < sequence; });
+    if (mit == medias.end() || !mit->cabinet.starts_with('#')) {
+      // external cabinets and uncompressed files live next to the package
+      ec = bela::make_error_code(ErrAnotherWay, L"msi: file '", bela::encode_into<char, wchar_t>(file.key),
+                                 L"' not stored in an embedded cabinet");
+      return false;
+    }
+    if (std::find(usedCabinets.begin(), usedCabinets.end(), mit->cabinet) == usedCabinets.end()) {
+      usedCabinets.emplace_back(mit->cabinet);
+    }
+    auto cit = componentDirs.find(db.String(fileTable.Raw(row, iFileComponent)));
+    if (cit == componentDirs.end()) {
+      ec = bela::make_error_code(ErrAnotherWay, L"msi: component of '", bela::encode_into<char, wchar_t>(file.key),
+                                 L"' not found");
+      return false;
+    }
+    std::string dir;
+    if (!dirs.Resolve(cit->second, dir, ec)) {
+      return false;
+    }
+    auto name = longName(db.String(fileTable.Raw(row, iFileName)));
+    file.name = dir.empty() ? std::string(name) : bela::StringCat(dir, "/", name);
+    uncompressed_size += file.size;
+    keys.emplace(file.key, files.size());
+    files.emplace_back(std::move(file));
+  }
+  bela::flat_hash_map<std::string, bool> stored;
+  for (const auto &c : usedCabinets) {
+    auto stream = storage->Find(bela::encode_into<char, wchar_t>(std::string_view(c).substr(1)));
+    if (stream == nullptr) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: cabinet stream '", bela::encode_into<char, wchar_t>(c),
+                                 L"' not found");
+      return false;
+    }
+    auto cr = std::make_unique<cab::Reader>();
+    auto readerAt = [st = storage.get(), stream](std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) {
+      return st->ReadAt(*stream, buffer, pos, ec);
+    };
+    if (!cr->OpenReader(std::move(readerAt), stream->size, ec)) {
+      return false;
+    }
+    for (const auto &f : cr->Files()) {
+      stored.emplace(f.name, true);
+    }
+    cabinets.emplace_back(std::move(cr));
+  }
+  for (const auto &file : files) {
+    if (!stored.contains(file.key)) {
+      ec = bela::make_error_code(ErrAnotherWay, L"msi: file '", bela::encode_into<char, wchar_t>(file.key),
+                                 L"' not found in embedded cabinets");
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace baulk::archive::msi
@@ -0,0 +1,114 @@
+//
+#ifndef BAULK_ARCHIVE_MSI_INTERNAL_HPP
+#define BAULK_ARCHIVE_MSI_INTERNAL_HPP
+#include <baulk/archive/msi.hpp>
+#include <baulk/archive.hpp>
+#include <bela/endian.hpp>
+#include <mutex>
+
+namespace baulk::archive {
+// https://docs.microsoft.com/en-us/openspecs/windows_protocols/ms-cfb/
+#pragma pack(push, 1)
+struct oleheader_t {
+  uint32_t id[2]; // D0CF11E0 A1B11AE1
+  uint32_t clid[4];
+  uint16_t verminor; // 0x3e
+  uint16_t verdll;   // 0x03
+  uint16_t byteorder;
+  uint16_t lsectorB;
+  uint16_t lssectorB;
+
+  uint16_t reserved1;
+  uint32_t reserved2;
+  uint32_t reserved3;
+
+  uint32_t cfat; // count full sectors
+  uint32_t dirstart;
+
+  uint32_t reserved4;
+
+  uint32_t sectorcutoff; // min size of a standard stream ; if less than this
+                         // then it uses short-streams
+  uint32_t sfatstart;    // first short-sector or EOC
+  uint32_t csfat;        // count short sectors
+  uint32_t difstart;     // first sector master sector table or EOC
+  uint32_t cdif;         // total count
+  uint32_t MSAT[109];    // First 109 MSAT
+};
+
+struct oleentry_t {
+  uint16_t name[32]; // UTF-16 name
+  uint16_t namelen;  // bytes, including the terminating NUL
+  uint8_t type;
+  uint8_t color;
+  uint32_t left;
+  uint32_t right;
+  uint32_t child;
+  uint8_t clsid[16];
+  uint32_t state;
+  uint64_t ctime;
+  uint64_t mtime;
+  uint32_t start;
+  uint64_t size; // version 3 files only use the low 32 bits
+};
+#pragma pack(pop)
+static_assert(sizeof(oleheader_t) == 512);
+static_assert(sizeof(oleentry_t) == 128);
+} // namespace baulk::archive
+
+namespace baulk::archive::msi {
+constexpr long ErrNotMsiFile = 755340;
+constexpr uint32_t FREESECT = 0xFFFFFFFF;
+constexpr uint32_t ENDOFCHAIN = 0xFFFFFFFE;
+constexpr uint32_t NOSTREAM = 0xFFFFFFFF;
+constexpr uint8_t STGTY_STORAGE = 1;
+constexpr uint8_t STGTY_STREAM = 2;
+constexpr uint8_t STGTY_ROOT = 5;
+
+struct Stream {
+  std::wstring name; // decoded msi stream name, tables start with '!'
+  int64_t size{0};
+  bool mini{false};
+  std::vector<uint32_t> sectors;
+};
+
+// Storage reads the streams of the root storage of an OLE compound file
+class Storage {
+public:
+  Storage(const bela::io::FD &fd_, int64_t size_) : fd(fd_), size(size_) {}
+  Storage(const Storage &) = delete;
+  Storage &operator=(const Storage &) = delete;
+  bool Initialize(bela::error_code &ec);
+  const Stream *Find(std::wstring_view name) const;
+  // ReadAt is safe to call concurrently
+  bool ReadAt(const Stream &s, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const;
+  bool ReadAll(const Stream &s, std::vector<uint8_t> &buffer, bela::error_code &ec) const;
+
+private:
+  const bela::io::FD &fd;
+  mutable std::mutex readMutex; // bela::io::FD::ReadAt seeks
+  int64_t size{0};
+  uint32_t sectorShift{9};
+  uint32_t miniShift{6};
+  uint32_t cutoff{4096};
+  std::vector<uint32_t> fat;
+  std::vector<uint32_t> minifat;
+  Stream ministream; // root entry, container of the mini sectors
+  std::vector<Stream> streams;
+  bool readSector(uint32_t sector, std::span<uint8_t> buffer, bela::error_code &ec) const;
+  bool chain(const std::vector<uint32_t> &table, uint32_t start, std::vector<uint32_t> &sectors,
+             bela::error_code &ec) const;
+  bool readStreamAt(const Stream &s, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const;
+};
+
+// https://docs.microsoft.com/en-us/windows/win32/msi/column-definition-format
+constexpr uint16_t MSITYPE_VALID = 0x0100;
+constexpr uint16_t MSITYPE_STRING = 0x0800;
+constexpr uint16_t MSITYPE_NULLABLE = 0x1000;
+constexpr uint16_t MSITYPE_TEMPORARY = 0x4000;
+
+std::wstring DecodeStreamName(std::wstring_view name);
+
+} // namespace baulk::archive::msi
+
+#endif
@@ -0,0 +1,266 @@
+//
+#include "msiinternal.hpp"
+
+namespace baulk::archive::msi {
+constexpr size_t difatHeaderEntries = 109;
+constexpr size_t maxDirectoryDepth = 4096;
+
+inline wchar_t mime2utf(int x) {
+  if (x < 10) {
+    return static_cast<wchar_t>(x + '0');
+  }
+  if (x < 36) {
+    return static_cast<wchar_t>(x - 10 + 'A');
+  }
+  if (x < 62) {
+    return static_cast<wchar_t>(x - 36 + 'a');
+  }
+  return x == 62 ? L'.' : L'_';
+}
+
+// msi packs stream names two characters per code unit in 0x3800..0x4840, tables are prefixed with 0x4840
+std::wstring DecodeStreamName(std::wstring_view name) {
+  std::wstring s;
+  s.reserve(name.size() * 2);
+  for (auto ch : name) {
+    if (ch == 0x4840) {
+      s.push_back(L'!');
+      continue;
+    }
+    if (ch >= 0x3800 && ch < 0x4800) {
+      ch -= 0x3800;
+      s.push_back(mime2utf(ch & 0x3F));
+      s.push_back(mime2utf((ch >> 6) & 0x3F));
+      continue;
+    }
+    if (ch >= 0x4800 && ch < 0x4840) {
+      s.push_back(mime2utf(ch - 0x4800));
+      continue;
+    }
+    s.push_back(ch);
+  }
+  return s;
+}
+
+bool Storage::readSector(uint32_t sector, std::span<uint8_t> buffer, bela::error_code &ec) const {
+  auto offset = (static_cast<int64_t>(sector) + 1) << sectorShift;
+  if (offset + static_cast<int64_t>(buffer.size()) > size) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: sector ", sector, L" beyond the end of file");
+    return false;
+  }
+  return fd.ReadAt(buffer, offset, ec);
+}
+
+bool Storage::chain(const std::vector<uint32_t> &table, uint32_t start, std::vector<uint32_t> &sectors,
+                    bela::error_code &ec) const {
+  sectors.clear();
+  for (auto s = start; s != ENDOFCHAIN && s != FREESECT; s = table[s]) {
+    if (s >= table.size() || sectors.size() >= table.size()) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: invalid sector chain");
+      return false;
+    }
+    sectors.emplace_back(s);
+  }
+  return true;
+}
+
+bool Storage::Initialize(bela::error_code &ec) {
+  oleheader_t hdr;
+  if (!fd.ReadAt(hdr, 0, ec)) {
+    return false;
+  }
+  if (bela::fromle(hdr.id[0]) != 0xE011CFD0 || bela::fromle(hdr.id[1]) != 0xE11AB1A1) {
+    ec = bela::make_error_code(ErrNotMsiFile, L"msi: invalid compound file signature");
+    return false;
+  }
+  sectorShift = bela::fromle(hdr.lsectorB);
+  miniShift = bela::fromle(hdr.lssectorB);
+  cutoff = bela::fromle(hdr.sectorcutoff);
+  if ((sectorShift != 9 && sectorShift != 12) || miniShift != 6) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: unsupported sector size");
+    return false;
+  }
+  auto sectorSize = static_cast<size_t>(1) << sectorShift;
+  auto entriesPerSector = sectorSize / sizeof(uint32_t);
+  auto cfat = static_cast<size_t>(bela::fromle(hdr.cfat));
+  if (static_cast<int64_t>(cfat) > (size >> sectorShift)) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: invalid fat sectors ", cfat);
+    return false;
+  }
+  // DIFAT: 109 entries in the header, then a chain of DIFAT sectors
+  std::vector<uint32_t> fatSectors;
+  fatSectors.reserve(cfat);
+  for (size_t i = 0; i < difatHeaderEntries && fatSectors.size() < cfat; i++) {
+    fatSectors.emplace_back(bela::fromle(hdr.MSAT[i]));
+  }
+  std::vector<uint32_t> sector(entriesPerSector);
+  auto dif = bela::fromle(hdr.difstart);
+  for (size_t i = 0; fatSectors.size() < cfat && dif != ENDOFCHAIN && dif != FREESECT; i++) {
+    if (i >= cfat) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: invalid difat chain");
+      return false;
+    }
+    if (!readSector(dif, {reinterpret_cast<uint8_t *>(sector.data()), sectorSize}, ec)) {
+      return false;
+    }
+    for (size_t j = 0; j + 1 < entriesPerSector && fatSectors.size() < cfat; j++) {
+      fatSectors.emplace_back(bela::fromle(sector[j]));
+    }
+    dif = bela::fromle(sector[entriesPerSector - 1]);
+  }
+  if (fatSectors.size() != cfat) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: fat sectors truncated");
+    return false;
+  }
+  fat.resize(cfat * entriesPerSector);
+  for (size_t i = 0; i < cfat; i++) {
+    if (!readSector(fatSectors[i], {reinterpret_cast<uint8_t *>(fat.data() + i * entriesPerSector), sectorSize},
+                    ec)) {
+      return false;
+    }
+  }
+  for (auto &e : fat) {
+    e = bela::fromle(e);
+  }
+  // mini fat
+  std::vector<uint32_t> sectors;
+  if (!chain(fat, bela::fromle(hdr.sfatstart), sectors, ec)) {
+    return false;
+  }
+  minifat.resize(sectors.size() * entriesPerSector);
+  for (size_t i = 0; i < sectors.size(); i++) {
+    if (!readSector(sectors[i], {reinterpret_cast<uint8_t *>(minifat.data() + i * entriesPerSector), sectorSize},
+                    ec)) {
+      return false;
+    }
+  }
+  for (auto &e : minifat) {
+    e = bela::fromle(e);
+  }
+  // directory
+  if (!chain(fat, bela::fromle(hdr.dirstart), sectors, ec)) {
+    return false;
+  }
+  if (sectors.empty()) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: empty directory");
+    return false;
+  }
+  std::vector<oleentry_t> entries(sectors.size() * sectorSize / sizeof(oleentry_t));
+  auto entriesPerDirSector = sectorSize / sizeof(oleentry_t);
+  for (size_t i = 0; i < sectors.size(); i++) {
+    if (!readSector(sectors[i], {reinterpret_cast<uint8_t *>(entries.data() + i * entriesPerDirSector), sectorSize},
+                    ec)) {
+      return false;
+    }
+  }
+  auto entrySize = [&](const oleentry_t &e) -> int64_t {
+    auto sz = bela::fromle(e.size);
+    // version 3 (512 bytes sectors) may leave garbage in the high part
+    return static_cast<int64_t>(sectorShift == 9 ? (sz & 0xFFFFFFFF) : sz);
+  };
+  const auto &root = entries[0];
+  if (root.type != STGTY_ROOT) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: invalid root entry");
+    return false;
+  }
+  ministream.size = entrySize(root);
+  if (!chain(fat, bela::fromle(root.start), ministream.sectors, ec)) {
+    return false;
+  }
+  // streams of the root storage, the siblings form a red-black tree
+  std::vector<uint32_t> stack{bela::fromle(root.child)};
+  std::vector<bool> visited(entries.size(), false);
+  while (!stack.empty()) {
+    auto id = stack.back();
+    stack.pop_back();
+    if (id == NOSTREAM) {
+      continue;
+    }
+    if (id >= entries.size() || visited[id] || stack.size() > maxDirectoryDepth) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: invalid directory tree");
+      return false;
+    }
+    visited[id] = true;
+    const auto &e = entries[id];
+    stack.emplace_back(bela::fromle(e.left));
+    stack.emplace_back(bela::fromle(e.right));
+    if (e.type != STGTY_STREAM) {
+      continue;
+    }
+    Stream s;
+    auto namelen = (std::min)(static_cast<size_t>(bela::fromle(e.namelen) / 2), std::size(e.name));
+    std::wstring rawName;
+    for (size_t i = 0; i < namelen && e.name[i] != 0; i++) {
+      rawName.push_back(static_cast<wchar_t>(bela::fromle(e.name[i])));
+    }
+    s.name = DecodeStreamName(rawName);
+    s.size = entrySize(e);
+    s.mini = s.size < static_cast<int64_t>(cutoff);
+    if (s.size != 0 && !chain(s.mini ? minifat : fat, bela::fromle(e.start), s.sectors, ec)) {
+      return false;
+    }
+    streams.emplace_back(std::move(s));
+  }
+  return true;
+}
+
+const Stream *Storage::Find(std::wstring_view name) const {
+  for (const auto &s : streams) {
+    if (s.name == name) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+bool Storage::readStreamAt(const Stream &s, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const {
+  if (pos < 0 || pos + static_cast<int64_t>(buffer.size()) > s.size) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"msi: read beyond the end of stream");
+    return false;
+  }
+  auto shift = s.mini ? miniShift : sectorShift;
+  auto unit = static_cast<int64_t>(1) << shift;
+  size_t done = 0;
+  while (done < buffer.size()) {
+    auto idx = static_cast<size_t>(pos >> shift);
+    if (idx >= s.sectors.size()) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"msi: stream sector chain truncated");
+      return false;
+    }
+    auto within = pos & (unit - 1);
+    auto first = s.sectors[idx];
+    auto remaining = static_cast<int64_t>(buffer.size() - done);
+    auto n = (std::min)(unit - within, remaining);
+    // merge physically contiguous sectors into one read
+    for (auto next = idx + 1; n < remaining && next < s.sectors.size() && s.sectors[next] == first + (next - idx);
+         next++) {
+      n += (std::min)(unit, remaining - n);
+    }
+    auto part = buffer.subspan(done, static_cast<size_t>(n));
+    if (s.mini) {
+      if (!readStreamAt(ministream, part, (static_cast<int64_t>(first) << miniShift) + within, ec)) {
+        return false;
+      }
+    } else {
+      auto offset = ((static_cast<int64_t>(first) + 1) << sectorShift) + within;
+      if (!fd.ReadAt(part, offset, ec)) {
+        return false;
+      }
+    }
+    done += static_cast<size_t>(n);
+    pos += n;
+  }
+  return true;
+}
+
+bool Storage::ReadAt(const Stream &s, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) const {
+  std::scoped_lock lock(readMutex);
+  return readStreamAt(s, buffer, pos, ec);
+}
+
+bool Storage::ReadAll(const Stream &s, std::vector<uint8_t> &buffer, bela::error_code &ec) const {
+  buffer.resize(static_cast<size_t>(s.size));
+  return ReadAt(s, buffer, 0, ec);
+}
+
+} // namespace baulk::archive::msi
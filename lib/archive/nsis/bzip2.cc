@@ -0,0 +1,356 @@
+// NSIS bzip2: https://github.com/kichik/nsis/blob/master/Source/bzip2/decompress.c
+// The installer stream is plain bzip2 with its framing removed: no 'BZh' stream header, every block starts with
+// the byte 0x31 instead of the 48-bit block magic, there is neither a block nor a stream CRC, the randomised bit is
+// gone and the stream ends with the byte 0x17. The block size is always 900k
+#include "nsisinternal.hpp"
+
+namespace baulk::archive::nsis {
+constexpr uint32_t bzBlockSignature = 0x31;
+constexpr uint32_t bzEndSignature = 0x17;
+constexpr size_t bzMaxBlockSize = 900000;
+constexpr uint32_t bzRunA = 0;
+constexpr uint32_t bzRunB = 1;
+constexpr uint32_t bzGroupSize = 50;
+constexpr uint32_t bzMaxSelectors = 18002;
+constexpr uint32_t bzMaxRunLength = 2 * 1024 * 1024;
+
+bool bzip2Decoder::Initialize(Source &&source_, bela::error_code &ec) {
+  source = std::move(source_);
+  chunk = {};
+  chunkPos = 0;
+  bitbuf = 0;
+  bitcount = 0;
+  tt.resize(bzMaxBlockSize);
+  selectors.resize(bzMaxSelectors);
+  blockSize = 0;
+  blockUsed = 0;
+  last = -1;
+  runLength = 0;
+  repeat = 0;
+  eof = false;
+  return true;
+}
+
+bool bzip2Decoder::getBits(uint32_t n, uint32_t &v, bela::error_code &ec) {
+  while (bitcount < n) {
+    if (chunkPos == chunk.size()) {
+      if (!source(chunk, ec)) {
+        return false;
+      }
+      chunkPos = 0;
+      if (chunk.size() == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"nsis: bzip2 stream truncated");
+        return false;
+      }
+    }
+    bitbuf = (bitbuf << 8) | chunk.data()[chunkPos++];
+    bitcount += 8;
+  }
+  bitcount -= n;
+  v = static_cast<uint32_t>(bitbuf >> bitcount) & ((1U << n) - 1);
+  return true;
+}
+
+// makeTable builds the canonical decode tables of one coding group, the same way as hbCreateDecodeTables
+void bzip2Decoder::makeTable(huffGroup &g, const uint8_t *lens, uint32_t alphaSize) {
+  g.minLen = maxCodeLen;
+  g.maxLen = 0;
+  for (uint32_t i = 0; i < alphaSize; i++) {
+    g.minLen = (std::min)(g.minLen, static_cast<uint32_t>(lens[i]));
+    g.maxLen = (std::max)(g.maxLen, static_cast<uint32_t>(lens[i]));
+  }
+  uint32_t pp = 0;
+  for (auto i = g.minLen; i <= g.maxLen; i++) {
+    for (uint32_t j = 0; j < alphaSize; j++) {
+      if (lens[j] == i) {
+        g.perm[pp++] = static_cast<uint16_t>(j);
+      }
+    }
+  }
+  int32_t counts[maxCodeLen + 2] = {0};
+  for (uint32_t i = 0; i < alphaSize; i++) {
+    counts[lens[i] + 1]++;
+  }
+  for (uint32_t i = 1; i < std::size(counts); i++) {
+    counts[i] += counts[i - 1];
+  }
+  int32_t vec = 0;
+  for (uint32_t i = 0; i <= maxCodeLen; i++) {
+    g.limit[i] = -1;
+    g.base[i] = counts[i];
+  }
+  for (auto i = g.minLen; i <= g.maxLen; i++) {
+    vec += counts[i + 1] - counts[i];
+    g.limit[i] = vec - 1;
+    vec <<= 1;
+  }
+  for (auto i = g.minLen + 1; i <= g.maxLen; i++) {
+    g.base[i] = ((g.limit[i - 1] + 1) << 1) - counts[i];
+  }
+}
+
+bool bzip2Decoder::decodeSymbol(const huffGroup &g, uint32_t alphaSize, uint32_t &sym, bela::error_code &ec) {
+  auto n = g.minLen;
+  uint32_t code = 0;
+  if (!getBits(n, code, ec)) {
+    return false;
+  }
+  for (;;) {
+    if (static_cast<int32_t>(code) <= g.limit[n]) {
+      break;
+    }
+    uint32_t bit = 0;
+    if (++n > g.maxLen || !getBits(1, bit, ec)) {
+      if (!ec) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"nsis: bzip2 invalid huffman code");
+      }
+      return false;
+    }
+    code = (code << 1) | bit;
+  }
+  auto index = static_cast<int32_t>(code) - g.base[n];
+  if (index < 0 || static_cast<uint32_t>(index) >= alphaSize) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: bzip2 invalid huffman code");
+    return false;
+  }
+  sym = g.perm[index];
+  return true;
+}
+
+// readBlock decodes the next block into tt and prepares the inverse BWT, sets eof at the end of stream marker
+bool bzip2Decoder::readBlock(bela::error_code &ec) {
+  auto corrupt = [&](std::wstring_view what) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: bzip2 ", what);
+    return false;
+  };
+  uint32_t v = 0;
+  if (!getBits(8, v, ec)) {
+    return false;
+  }
+  if (v == bzEndSignature) {
+    eof = true;
+    return true;
+  }
+  if (v != bzBlockSignature) {
+    return corrupt(L"bad block signature");
+  }
+  uint32_t origPtr = 0;
+  if (!getBits(24, origPtr, ec)) {
+    return false;
+  }
+  // symbol map: 16 ranges of 16 bytes
+  uint8_t seqToUnseq[256];
+  uint32_t nInUse = 0;
+  uint32_t inUse16 = 0;
+  if (!getBits(16, inUse16, ec)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < 16; i++) {
+    if ((inUse16 & (0x8000 >> i)) == 0) {
+      continue;
+    }
+    uint32_t inUse = 0;
+    if (!getBits(16, inUse, ec)) {
+      return false;
+    }
+    for (uint32_t j = 0; j < 16; j++) {
+      if ((inUse & (0x8000 >> j)) != 0) {
+        seqToUnseq[nInUse++] = static_cast<uint8_t>(i * 16 + j);
+      }
+    }
+  }
+  if (nInUse == 0) {
+    return corrupt(L"empty symbol map");
+  }
+  auto alphaSize = nInUse + 2;
+  uint32_t nGroups = 0;
+  uint32_t nSelectors = 0;
+  if (!getBits(3, nGroups, ec) || !getBits(15, nSelectors, ec)) {
+    return false;
+  }
+  if (nGroups < 2 || nGroups > maxGroups || nSelectors < 1) {
+    return corrupt(L"bad coding groups");
+  }
+  // selectors are MTF coded unary numbers, the ones past bzMaxSelectors are read and dropped like libbzip2 does
+  uint8_t pos[maxGroups];
+  for (uint32_t i = 0; i < nGroups; i++) {
+    pos[i] = static_cast<uint8_t>(i);
+  }
+  for (uint32_t i = 0; i < nSelectors; i++) {
+    uint32_t j = 0;
+    for (;;) {
+      uint32_t bit = 0;
+      if (!getBits(1, bit, ec)) {
+        return false;
+      }
+      if (bit == 0) {
+        break;
+      }
+      if (++j >= nGroups) {
+        return corrupt(L"bad selector");
+      }
+    }
+    auto tmp = pos[j];
+    for (; j > 0; j--) {
+      pos[j] = pos[j - 1];
+    }
+    pos[0] = tmp;
+    if (i < bzMaxSelectors) {
+      selectors[i] = tmp;
+    }
+  }
+  nSelectors = (std::min)(nSelectors, bzMaxSelectors);
+  // code lengths are delta coded from a 5-bit start
+  for (uint32_t t = 0; t < nGroups; t++) {
+    uint8_t lens[maxAlphaSize];
+    uint32_t curr = 0;
+    if (!getBits(5, curr, ec)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < alphaSize; i++) {
+      for (;;) {
+        if (curr < 1 || curr > maxCodeLen) {
+          return corrupt(L"bad code length");
+        }
+        uint32_t bit = 0;
+        if (!getBits(1, bit, ec)) {
+          return false;
+        }
+        if (bit == 0) {
+          break;
+        }
+        if (!getBits(1, bit, ec)) {
+          return false;
+        }
+        curr = bit == 0 ? curr + 1 : curr - 1;
+      }
+      lens[i] = static_cast<uint8_t>(curr);
+    }
+    makeTable(groups[t], lens, alphaSize);
+  }
+  // MTF and RUNA/RUNB zero runs
+  uint8_t mtf[256];
+  for (uint32_t i = 0; i < 256; i++) {
+    mtf[i] = static_cast<uint8_t>(i);
+  }
+  uint32_t unzftab[256] = {0};
+  auto eob = nInUse + 1;
+  uint32_t groupNo = 0;
+  uint32_t groupPos = 0;
+  const huffGroup *g = nullptr;
+  auto nextSymbol = [&](uint32_t &sym) {
+    if (groupPos == 0) {
+      if (groupNo >= nSelectors) {
+        return corrupt(L"selectors exhausted");
+      }
+      g = &groups[selectors[groupNo++]];
+      groupPos = bzGroupSize;
+    }
+    groupPos--;
+    return decodeSymbol(*g, alphaSize, sym, ec);
+  };
+  uint32_t nblock = 0;
+  uint32_t sym = 0;
+  if (!nextSymbol(sym)) {
+    return false;
+  }
+  while (sym != eob) {
+    if (sym == bzRunA || sym == bzRunB) {
+      uint32_t es = 0;
+      uint32_t n = 1;
+      do {
+        if (n >= bzMaxRunLength) {
+          return corrupt(L"run too long");
+        }
+        es += sym == bzRunA ? n : 2 * n;
+        n <<= 1;
+        if (!nextSymbol(sym)) {
+          return false;
+        }
+      } while (sym == bzRunA || sym == bzRunB);
+      auto uc = seqToUnseq[mtf[0]];
+      if (es > bzMaxBlockSize - nblock) {
+        return corrupt(L"block overflow");
+      }
+      unzftab[uc] += es;
+      std::fill_n(tt.data() + nblock, es, static_cast<uint32_t>(uc));
+      nblock += es;
+      continue;
+    }
+    if (nblock >= bzMaxBlockSize) {
+      return corrupt(L"block overflow");
+    }
+    auto nn = sym - 1;
+    auto tmp = mtf[nn];
+    memmove(mtf + 1, mtf, nn);
+    mtf[0] = tmp;
+    auto uc = seqToUnseq[tmp];
+    unzftab[uc]++;
+    tt[nblock++] = uc;
+    if (!nextSymbol(sym)) {
+      return false;
+    }
+  }
+  if (origPtr >= nblock) {
+    return corrupt(L"bad origin pointer");
+  }
+  // inverse BWT: the high 24 bits of tt link every byte to its successor
+  uint32_t cftab[256];
+  for (uint32_t i = 0, sum = 0; i < 256; i++) {
+    cftab[i] = sum;
+    sum += unzftab[i];
+  }
+  for (uint32_t i = 0; i < nblock; i++) {
+    auto uc = tt[i] & 0xFF;
+    tt[cftab[uc]++] |= i << 8;
+  }
+  tpos = tt[origPtr] >> 8;
+  blockSize = nblock;
+  blockUsed = 0;
+  last = -1;
+  runLength = 0;
+  repeat = 0;
+  return true;
+}
+
+// Read undoes the initial run-length coding: four equal bytes are followed by a count of further repeats
+ssize_t bzip2Decoder::Read(uint8_t *out, size_t len, bela::error_code &ec) {
+  size_t n = 0;
+  while (n < len) {
+    if (repeat > 0) {
+      auto k = (std::min)(static_cast<size_t>(repeat), len - n);
+      memset(out + n, last, k);
+      n += k;
+      repeat -= static_cast<uint32_t>(k);
+      continue;
+    }
+    if (blockUsed == blockSize) {
+      if (eof || n > 0) {
+        break;
+      }
+      if (!readBlock(ec)) {
+        return -1;
+      }
+      continue;
+    }
+    auto entry = tt[tpos];
+    auto c = static_cast<int>(entry & 0xFF);
+    tpos = entry >> 8;
+    blockUsed++;
+    if (runLength == 4) {
+      repeat = static_cast<uint32_t>(c);
+      runLength = 0;
+      continue;
+    }
+    if (c == last) {
+      runLength++;
+    } else {
+      last = c;
+      runLength = 1;
+    }
+    out[n++] = static_cast<uint8_t>(c);
+  }
+  return static_cast<ssize_t>(n);
+}
+
+} // namespace baulk::archive::nsis
@@ -0,0 +1,317 @@
+//
+#include "nsisinternal.hpp"
+
+namespace baulk::archive::nsis {
+constexpr size_t decoderinsize = 256 * 1024;
+constexpr size_t decoderoutsize = 256 * 1024;
+constexpr size_t lzmaPropsSize = 5;
+
+// LZMA allocator
+static lzma_allocator allocator{                                  // allocater
+                                .alloc = baulk::mem::allocate_xz, //
+                                .free = baulk::mem::deallocate_simple,
+                                .opaque = nullptr};
+
+Decoder::~Decoder() { release(); }
+
+void Decoder::release() {
+  if (zs != nullptr) {
+    inflateEnd(zs);
+    baulk::mem::deallocate(zs);
+    zs = nullptr;
+  }
+  if (xzs != nullptr) {
+    lzma_end(xzs);
+    baulk::mem::deallocate(xzs);
+    xzs = nullptr;
+  }
+  bzs.reset();
+}
+
+bool Decoder::Initialize(int64_t offset, int64_t length, bela::error_code &ec) {
+  release();
+  position = offset;
+  remaining = length;
+  eof = false;
+  in.grow(decoderinsize);
+  out.grow(decoderoutsize);
+  in.pos() = 0;
+  in.size() = 0;
+  out.pos() = 0;
+  out.size() = 0;
+  switch (method) {
+  case NSIS_COPY:
+    return true;
+  case NSIS_DEFLATE:
+    zs = baulk::mem::allocate<z_stream>();
+    memset(zs, 0, sizeof(z_stream));
+    zs->zalloc = baulk::mem::allocate_zlib;
+    zs->zfree = baulk::mem::deallocate_simple;
+    // nsis stores raw deflate streams without zlib header
+    if (auto zerr = inflateInit2(zs, -MAX_WBITS); zerr != Z_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+      return false;
+    }
+    return true;
+  case NSIS_LZMA:
+    return initializeLZMA(ec);
+  case NSIS_BZIP2:
+    bzs = std::make_unique<bzip2Decoder>();
+    return bzs->Initialize(
+        [this](bela::bytes_view &chunk, bela::error_code &ec) {
+          // hand out what is left of the input buffer, then refill it
+          if (!fill(ec)) {
+            return false;
+          }
+          chunk = bela::bytes_view(in.data() + in.pos(), in.size() - in.pos());
+          in.pos() = in.size();
+          return true;
+        },
+        ec);
+  default:
+    break;
+  }
+  ec = bela::make_error_code(ErrAnotherWay, L"nsis: unsupported compression method ", static_cast<int>(method));
+  return false;
+}
+
+bool Decoder::fill(bela::error_code &ec) {
+  if (in.pos() < in.size()) {
+    return true;
+  }
+  in.pos() = 0;
+  in.size() = 0;
+  if (remaining <= 0) {
+    return true;
+  }
+  auto minsize = (std::min)(static_cast<int64_t>(in.capacity()), remaining);
+  int64_t outlen = 0;
+  if (!fd.ReadAt({in.data(), static_cast<size_t>(minsize)}, position, outlen, ec)) {
+    return false;
+  }
+  if (outlen == 0) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: unexpected end of file");
+    return false;
+  }
+  position += outlen;
+  remaining -= outlen;
+  in.size() = static_cast<size_t>(outlen);
+  return true;
+}
+
+// NSIS LZMA streams: [filter flag] + 5 bytes properties + raw LZMA data. The optional filter flag selects x86 BCJ
+bool Decoder::initializeLZMA(bela::error_code &ec) {
+  uint8_t props[lzmaPropsSize + 1];
+  size_t propsSize = 0;
+  while (propsSize < sizeof(props)) {
+    if (!fill(ec)) {
+      return false;
+    }
+    if (in.pos() == in.size()) {
+      break;
+    }
+    auto n = (std::min)(sizeof(props) - propsSize, in.size() - in.pos());
+    memcpy(props + propsSize, in.data() + in.pos(), n);
+    propsSize += n;
+    in.pos() += n;
+  }
+  if (propsSize != sizeof(props)) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: lzma properties truncated");
+    return false;
+  }
+  auto useFilter = false;
+  size_t propsOffset = 0;
+  if (props[0] <= 1 && props[1] == 0x5D) {
+    useFilter = props[0] == 1;
+    propsOffset = 1;
+  } else {
+    // no filter flag, give the last byte back to the input buffer
+    in.pos() -= 1;
+  }
+  lzma_filter filters[3];
+  size_t fi = 0;
+  if (useFilter) {
+    filters[fi++] = {.id = LZMA_FILTER_X86, .options = nullptr};
+  }
+  filters[fi] = {.id = LZMA_FILTER_LZMA1, .options = nullptr};
+  if (auto ret = lzma_properties_decode(&filters[fi], &allocator, props + propsOffset, lzmaPropsSize);
+      ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: invalid lzma properties ", static_cast<int>(ret));
+    return false;
+  }
+  fi++;
+  filters[fi] = {.id = LZMA_VLI_UNKNOWN, .options = nullptr};
+  xzs = baulk::mem::allocate<lzma_stream>();
+  memset(xzs, 0, sizeof(lzma_stream));
+  xzs->allocator = &allocator;
+  auto ret = lzma_raw_decoder(xzs, filters);
+  for (size_t i = 0; i < fi; i++) {
+    if (filters[i].options != nullptr) {
+      allocator.free(allocator.opaque, filters[i].options);
+    }
+  }
+  if (ret != LZMA_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"nsis: lzma_raw_decoder error ", static_cast<int>(ret));
+    return false;
+  }
+  return true;
+}
+
+bool Decoder::decompress(bela::error_code &ec) {
+  out.pos() = 0;
+  out.size() = 0;
+  while (out.size() == 0 && !eof) {
+    if (!fill(ec)) {
+      return false;
+    }
+    auto avail = in.size() - in.pos();
+    if (method == NSIS_COPY) {
+      if (avail == 0) {
+        eof = true;
+        break;
+      }
+      auto n = (std::min)(avail, out.capacity());
+      memcpy(out.data(), in.data() + in.pos(), n);
+      in.pos() += n;
+      out.size() = n;
+      break;
+    }
+    if (method == NSIS_DEFLATE) {
+      zs->next_in = in.data() + in.pos();
+      zs->avail_in = static_cast<uInt>(avail);
+      zs->next_out = out.data();
+      zs->avail_out = static_cast<uInt>(out.capacity());
+      auto ret = ::inflate(zs, Z_NO_FLUSH);
+      in.pos() += avail - zs->avail_in;
+      out.size() = out.capacity() - zs->avail_out;
+      switch (ret) {
+      case Z_STREAM_END:
+        eof = true;
+        break;
+      case Z_BUF_ERROR:
+        if (avail == 0) {
+          // input exhausted without stream end, nsis solid deflate may be unterminated
+          eof = true;
+        }
+        break;
+      case Z_NEED_DICT:
+        ret = Z_DATA_ERROR;
+        [[fallthrough]];
+      case Z_DATA_ERROR:
+        [[fallthrough]];
+      case Z_MEM_ERROR:
+        ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(ret)));
+        return false;
+      default:
+        break;
+      }
+      continue;
+    }
+    if (method == NSIS_BZIP2) {
+      auto n = bzs->Read(out.data(), out.capacity(), ec);
+      if (n < 0) {
+        return false;
+      }
+      out.size() = static_cast<size_t>(n);
+      eof = n == 0;
+      break;
+    }
+    xzs->next_in = in.data() + in.pos();
+    xzs->avail_in = avail;
+    xzs->next_out = out.data();
+    xzs->avail_out = out.capacity();
+    auto ret = lzma_code(xzs, avail == 0 ? LZMA_FINISH : LZMA_RUN);
+    in.pos() += avail - xzs->avail_in;
+    out.size() = out.capacity() - xzs->avail_out;
+    if (ret == LZMA_STREAM_END) {
+      eof = true;
+      break;
+    }
+    if (ret == LZMA_BUF_ERROR && avail == 0) {
+      // streams without end marker: all data decoded
+      eof = true;
+      break;
+    }
+    if (ret != LZMA_OK) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"nsis: lzma decompress error ", static_cast<int>(ret));
+      return false;
+    }
+  }
+  return true;
+}
+
+ssize_t Decoder::Read(void *buffer, size_t len, bela::error_code &ec) {
+  if (out.pos() == out.size()) {
+    if (!decompress(ec)) {
+      return -1;
+    }
+    if (out.size() == 0) {
+      return 0;
+    }
+  }
+  auto minsize = (std::min)(len, out.size() - out.pos());
+  memcpy(buffer, out.data() + out.pos(), minsize);
+  out.pos() += minsize;
+  return static_cast<ssize_t>(minsize);
+}
+
+bool Decoder::ReadFull(void *buffer, size_t len, bela::error_code &ec) {
+  auto p = reinterpret_cast<uint8_t *>(buffer);
+  size_t rbytes = 0;
+  while (rbytes < len) {
+    auto n = Read(p + rbytes, len - rbytes, ec);
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"nsis: unexpected end of stream");
+      return false;
+    }
+    rbytes += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool Decoder::Discard(int64_t len, bela::error_code &ec) {
+  while (len > 0) {
+    if (out.pos() == out.size()) {
+      if (!decompress(ec)) {
+        return false;
+      }
+      if (out.size() == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"nsis: unexpected end of stream");
+        return false;
+      }
+    }
+    auto minsize = (std::min)(static_cast<size_t>(len), out.size() - out.pos());
+    out.pos() += minsize;
+    len -= minsize;
+  }
+  return true;
+}
+
+// Avoid multiple memory copies
+bool Decoder::WriteTo(const Writer &w, int64_t len, bela::error_code &ec) {
+  while (len > 0) {
+    if (out.pos() == out.size()) {
+      if (!decompress(ec)) {
+        return false;
+      }
+      if (out.size() == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"nsis: unexpected end of stream");
+        return false;
+      }
+    }
+    auto minsize = (std::min)(static_cast<size_t>(len), out.size() - out.pos());
+    auto p = out.data() + out.pos();
+    out.pos() += minsize;
+    len -= minsize;
+    if (!w(p, minsize)) {
+      ec = bela::make_error_code(ErrCanceled, L"canceled");
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace baulk::archive::nsis
@@ -0,0 +1,439 @@
+///
+#include <bela/str_cat.hpp>
+#include <bela/codecvt.hpp>
+#include <algorithm>
+#include "nsisinternal.hpp"
+
+namespace baulk::archive::nsis {
+// https://github.com/kichik/nsis/blob/master/Source/exehead/util.c GetNSISString
+// NSIS 3 uses 1..4 as special codes for both ANSI and Unicode, NSIS 2 ANSI uses 252..255
+struct special_codes {
+  uint16_t lang;
+  uint16_t shell;
+  uint16_t var;
+  uint16_t skip;
+};
+constexpr special_codes nsis3codes{.lang = 1, .shell = 2, .var = 3, .skip = 4};
+constexpr special_codes nsis2codes{.lang = 255, .shell = 254, .var = 253, .skip = 252};
+
+constexpr std::wstring_view varNames[] = {
+    L"CMDLINE",  L"INSTDIR", L"OUTDIR",     L"EXEDIR", L"LANGUAGE", L"TEMP",
+    L"PLUGINSDIR", L"EXEPATH", L"EXEFILE", L"HWNDPARENT", L"_CLICK",   L"_OUTDIR",
+};
+constexpr std::wstring_view instdirPrefix = L"$INSTDIR";
+
+inline std::wstring varName(int index) {
+  if (index < 10) {
+    return bela::StringCat(L"$", index);
+  }
+  if (index < 20) {
+    return bela::StringCat(L"$R", index - 10);
+  }
+  if (auto i = static_cast<size_t>(index - 20); i < std::size(varNames)) {
+    return bela::StringCat(L"$", varNames[i]);
+  }
+  return bela::StringCat(L"$VAR", index);
+}
+
+class stringTable {
+public:
+  stringTable(bela::bytes_view sv_, bool unicode_) : sv(sv_), unicode(unicode_) {
+    codes = unicode ? nsis3codes : detectANSICodes();
+  }
+  // resolve string, $OUTDIR and $_OUTDIR expand to outdir
+  std::wstring resolve(int32_t offset, std::wstring_view outdir) const {
+    std::wstring s;
+    if (offset < 0) {
+      return s;
+    }
+    auto pos = static_cast<size_t>(offset) * (unicode ? 2 : 1);
+    for (;;) {
+      auto c = next(pos);
+      if (c == 0) {
+        break;
+      }
+      if (c == codes.skip) {
+        if (auto ch = next(pos); ch != 0) {
+          s.push_back(ch);
+        }
+        continue;
+      }
+      if (c == codes.var || c == codes.shell || c == codes.lang) {
+        auto n = decodeShort(pos);
+        if (c == codes.shell) {
+          s.append(L"$SHELL");
+          continue;
+        }
+        if (c == codes.lang) {
+          s.append(L"$LANG");
+          continue;
+        }
+        if (n == VAR_OUTDIR || n == VAR_OUTDIR_) {
+          s.append(outdir);
+          continue;
+        }
+        s.append(varName(n));
+        continue;
+      }
+      s.push_back(c);
+    }
+    return s;
+  }
+
+private:
+  bela::bytes_view sv;
+  bool unicode{false};
+  special_codes codes;
+  wchar_t next(size_t &pos) const {
+    if (unicode) {
+      auto c = sv.cast_fromle<uint16_t>(pos);
+      pos += 2;
+      return static_cast<wchar_t>(c);
+    }
+    auto c = sv[pos];
+    pos++;
+    return c == UINT8_MAX && pos > sv.size() ? 0 : static_cast<wchar_t>(c);
+  }
+  int decodeShort(size_t &pos) const {
+    uint8_t lo = 0;
+    uint8_t hi = 0;
+    if (unicode) {
+      auto c = sv.cast_fromle<uint16_t>(pos);
+      pos += 2;
+      lo = static_cast<uint8_t>(c & 0xFF);
+      hi = static_cast<uint8_t>(c >> 8);
+    } else {
+      lo = sv[pos];
+      hi = sv[pos + 1];
+      pos += 2;
+    }
+    return (lo & 0x7F) | ((hi & 0x7F) << 7);
+  }
+  // special code followed by an encoded short (both bytes have the high bit set)
+  special_codes detectANSICodes() const {
+    size_t v2 = 0;
+    size_t v3 = 0;
+    for (size_t i = 0; i + 2 < sv.size(); i++) {
+      if ((sv[i + 1] & 0x80) == 0 || (sv[i + 2] & 0x80) == 0) {
+        continue;
+      }
+      if (sv[i] == nsis3codes.var) {
+        v3++;
+      } else if (sv[i] == nsis2codes.var) {
+        v2++;
+      }
+    }
+    return v2 > v3 ? nsis2codes : nsis3codes;
+  }
+};
+
+inline bool isLZMA(bela::bytes_view sig) { return sig[0] == 0x5D || (sig[0] <= 1 && sig[1] == 0x5D); }
+inline bool isBzip2(bela::bytes_view sig) { return sig[0] == 0x31 && sig[1] < 14; }
+inline method_t detectBlockMethod(bela::bytes_view sig) {
+  if (isLZMA(sig)) {
+    return NSIS_LZMA;
+  }
+  if (isBzip2(sig)) {
+    return NSIS_BZIP2;
+  }
+  return NSIS_DEFLATE;
+}
+
+Reader::Reader() = default;
+Reader::~Reader() = default;
+
+bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
+  auto fd_ = bela::io::NewFile(file, ec);
+  if (!fd_) {
+    return false;
+  }
+  file_format_t afmt{file_format_t::none};
+  if (!CheckFormat(*fd_, afmt, baseOffset, ec)) {
+    return false;
+  }
+  if (afmt != file_format_t::nsis) {
+    ec = bela::make_error_code(ErrNotNsisFile, L"nsis: not a nsis installer");
+    return false;
+  }
+  fd = std::move(*fd_);
+  return Initialize(ec);
+}
+
+bool Reader::OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec) {
+  fd.Assgin(nfd, false);
+  size = size_;
+  baseOffset = offset_;
+  return Initialize(ec);
+}
+
+bool Reader::Initialize(bela::error_code &ec) {
+  if (size == bela::SizeUnInitialized) {
+    if (size = fd.Size(ec); size == bela::SizeUnInitialized) {
+      return false;
+    }
+  }
+  firstheader fh;
+  if (!fd.ReadAt(fh, baseOffset, ec)) {
+    return false;
+  }
+  if (bela::fromle(fh.siginfo) != FH_SIG || memcmp(fh.nsinst, "NullsoftInst", sizeof(fh.nsinst)) != 0) {
+    ec = bela::make_error_code(ErrNotNsisFile, L"nsis: invalid firstheader");
+    return false;
+  }
+  if ((bela::fromle(fh.flags) & FH_FLAGS_UNINSTALL) != 0) {
+    ec = bela::make_error_code(ErrAnotherWay, L"nsis: uninstaller not supported");
+    return false;
+  }
+  headerLength = bela::fromle(fh.length_of_header);
+  dataOffset = baseOffset + static_cast<int64_t>(sizeof(firstheader));
+  // length_of_all_following_data includes firstheader and the optional crc
+  dataLength = (std::min)(static_cast<int64_t>(bela::fromle(fh.length_of_all_following_data)), size - baseOffset) -
+               static_cast<int64_t>(sizeof(firstheader));
+  if (dataLength <= 0 || headerLength <= 0) {
+    ec = bela::make_error_code(ErrNotNsisFile, L"nsis: invalid data length");
+    return false;
+  }
+  compressed_size = dataLength;
+  if (!detectMethod(ec)) {
+    return false;
+  }
+  std::vector<uint8_t> header;
+  if (!readHeader(header, ec)) {
+    return false;
+  }
+  return parseHeader(header, ec);
+}
+
+// https://github.com/mcmilk/7-Zip/blob/master/CPP/7zip/Archive/Nsis/NsisIn.cpp
+bool Reader::detectMethod(bela::error_code &ec) {
+  uint8_t sig[16] = {0};
+  int64_t outlen = 0;
+  if (!fd.ReadAt(sig, dataOffset, outlen, ec)) {
+    return false;
+  }
+  bela::bytes_view sv(sig, static_cast<size_t>(outlen));
+  if (auto v = sv.cast_fromle<uint32_t>(0); v == static_cast<uint32_t>(headerLength)) {
+    solid = false;
+    method = NSIS_COPY;
+  } else if (isLZMA(sv)) {
+    solid = true;
+    method = NSIS_LZMA;
+  } else if (sv[3] == 0x80) {
+    solid = false;
+    method = detectBlockMethod(sv.subview(4));
+  } else if (isBzip2(sv)) {
+    solid = true;
+    method = NSIS_BZIP2;
+  } else {
+    solid = true;
+    method = NSIS_DEFLATE;
+  }
+  return true;
+}
+
+bool Reader::readHeader(std::vector<uint8_t> &header, bela::error_code &ec) {
+  header.resize(static_cast<size_t>(headerLength));
+  if (solid) {
+    decoder = std::make_unique<Decoder>(fd, method);
+    if (!decoder->Initialize(dataOffset, dataLength, ec)) {
+      return false;
+    }
+    uint32_t hsize = 0;
+    if (!decoder->ReadFull(&hsize, sizeof(hsize), ec)) {
+      return false;
+    }
+    if (bela::fromle(hsize) != static_cast<uint32_t>(headerLength)) {
+      ec = bela::make_error_code(ErrNotNsisFile, L"nsis: header length mismatch");
+      return false;
+    }
+    if (!decoder->ReadFull(header.data(), header.size(), ec)) {
+      return false;
+    }
+    solidPosition = 0;
+    return true;
+  }
+  uint32_t v = 0;
+  if (!fd.ReadAt(v, dataOffset, ec)) {
+    return false;
+  }
+  v = bela::fromle(v);
+  auto blockSize = static_cast<int64_t>(v & ~compressedFlag);
+  blockOffset = dataOffset + 4 + blockSize;
+  if ((v & compressedFlag) == 0) {
+    return fd.ReadAt({header.data(), header.size()}, dataOffset + 4, ec);
+  }
+  uint8_t sig[8] = {0};
+  int64_t outlen = 0;
+  if (!fd.ReadAt(sig, dataOffset + 4, outlen, ec)) {
+    return false;
+  }
+  Decoder d(fd, detectBlockMethod(bela::bytes_view(sig, static_cast<size_t>(outlen))));
+  if (!d.Initialize(dataOffset + 4, blockSize, ec)) {
+    return false;
+  }
+  return d.ReadFull(header.data(), header.size(), ec);
+}
+
+bool Reader::parseHeader(const std::vector<uint8_t> &header, bela::error_code &ec) {
+  bela::bytes_view hv(header.data(), header.size());
+  if (hv.size() < headerBlocksOffset + sizeof(block_header) * BLOCKS_NUM) {
+    ec = bela::make_error_code(ErrNotNsisFile, L"nsis: header too small");
+    return false;
+  }
+  auto blockAt = [&](size_t i) -> block_header {
+    block_header b;
+    memcpy(&b, hv.data() + headerBlocksOffset + sizeof(block_header) * i, sizeof(b));
+    return block_header{.offset = bela::fromle(b.offset), .num = bela::fromle(b.num)};
+  };
+  auto entries = blockAt(NB_ENTRIES);
+  auto strings = blockAt(NB_STRINGS);
+  auto langtables = blockAt(NB_LANGTABLES);
+  if (entries.offset + static_cast<uint64_t>(entries.num) * sizeof(entry) > hv.size() || strings.offset > hv.size() ||
+      langtables.offset < strings.offset) {
+    ec = bela::make_error_code(ErrNotNsisFile, L"nsis: invalid header blocks");
+    return false;
+  }
+  auto sv = hv.subview(strings.offset, (std::min)(static_cast<size_t>(langtables.offset), hv.size()) - strings.offset);
+  // the string table starts with an empty string, Unicode installers use UTF-16LE
+  unicode = sv.size() >= 2 && sv[0] == 0 && sv[1] == 0;
+  stringTable st(sv, unicode);
+  auto codepage = CP_ACP;
+  auto encodeName = [&](std::wstring_view name) {
+    std::wstring wname(name);
+    if (!unicode) {
+      // ANSI installers: each char holds one byte in the system code page
+      std::string raw;
+      raw.reserve(name.size());
+      for (auto c : name) {
+        raw.push_back(static_cast<char>(c));
+      }
+      auto sz = MultiByteToWideChar(codepage, 0, raw.data(), static_cast<int>(raw.size()), nullptr, 0);
+      wname.resize(sz);
+      MultiByteToWideChar(codepage, 0, raw.data(), static_cast<int>(raw.size()), wname.data(), sz);
+    }
+    std::replace(wname.begin(), wname.end(), L'\\', L'/');
+    return bela::encode_into<wchar_t, char>(wname);
+  };
+  std::wstring outdir(instdirPrefix);
+  for (uint32_t i = 0; i < entries.num; i++) {
+    entry e;
+    memcpy(&e, hv.data() + entries.offset + i * sizeof(entry), sizeof(e));
+    auto which = bela::fromle(e.which);
+    if (which == EW_CREATEDIR) {
+      if (bela::fromle(e.offsets[1]) != 0) {
+        outdir = st.resolve(bela::fromle(e.offsets[0]), outdir);
+      }
+      continue;
+    }
+    if (which != EW_EXTRACTFILE) {
+      continue;
+    }
+    auto name = st.resolve(bela::fromle(e.offsets[1]), outdir);
+    if (!name.starts_with(L'$') && !(name.size() > 1 && name[1] == L':')) {
+      name = bela::StringCat(outdir, L"\\", name);
+    }
+    if (name.starts_with(instdirPrefix)) {
+      name.erase(0, instdirPrefix.size());
+      auto pos = name.find_first_not_of(L"\\/");
+      name.erase(0, pos == std::wstring::npos ? name.size() : pos);
+    }
+    if (name.empty()) {
+      continue;
+    }
+    File file;
+    file.name = encodeName(name);
+    file.position = static_cast<uint32_t>(bela::fromle(e.offsets[2]));
+    auto lo = static_cast<uint32_t>(bela::fromle(e.offsets[3]));
+    auto hi = static_cast<uint32_t>(bela::fromle(e.offsets[4]));
+    if ((lo == 0 && hi == 0) || (lo == UINT32_MAX && hi == UINT32_MAX)) {
+      file.time = bela::Now();
+    } else {
+      file.time = bela::FromWindowsPreciseTime(static_cast<uint64_t>(hi) << 32 | lo);
+    }
+    files.emplace_back(std::move(file));
+  }
+  if (files.empty()) {
+    ec = bela::make_error_code(ErrAnotherWay, L"nsis: no files found in install script");
+    return false;
+  }
+  std::stable_sort(files.begin(), files.end(), [](const File &a, const File &b) { return a.position < b.position; });
+  return true;
+}
+
+bool Reader::solidSeek(int64_t position, bela::error_code &ec) {
+  if (position < solidPosition) {
+    // rewind: restart the solid stream and skip the header
+    if (!decoder->Initialize(dataOffset, dataLength, ec)) {
+      return false;
+    }
+    if (!decoder->Discard(4 + headerLength, ec)) {
+      return false;
+    }
+    solidPosition = 0;
+  }
+  if (!decoder->Discard(position - solidPosition, ec)) {
+    return false;
+  }
+  solidPosition = position;
+  return true;
+}
+
+bool Reader::Decompress(const File &file, const Writer &w, bela::error_code &ec) {
+  if (solid) {
+    if (!solidSeek(file.position, ec)) {
+      return false;
+    }
+    uint32_t v = 0;
+    if (!decoder->ReadFull(&v, sizeof(v), ec)) {
+      return false;
+    }
+    auto itemSize = static_cast<int64_t>(bela::fromle(v) & ~compressedFlag);
+    solidPosition += 4;
+    if (!decoder->WriteTo(w, itemSize, ec)) {
+      return false;
+    }
+    solidPosition += itemSize;
+    return true;
+  }
+  auto itemOffset = blockOffset + file.position;
+  uint32_t v = 0;
+  if (!fd.ReadAt(v, itemOffset, ec)) {
+    return false;
+  }
+  v = bela::fromle(v);
+  auto itemSize = static_cast<int64_t>(v & ~compressedFlag);
+  auto itemMethod = NSIS_COPY;
+  if ((v & compressedFlag) != 0) {
+    uint8_t sig[8] = {0};
+    int64_t outlen = 0;
+    if (!fd.ReadAt(sig, itemOffset + 4, outlen, ec)) {
+      return false;
+    }
+    itemMethod = detectBlockMethod(bela::bytes_view(sig, static_cast<size_t>(outlen)));
+  }
+  Decoder d(fd, itemMethod);
+  if (!d.Initialize(itemOffset + 4, itemSize, ec)) {
+    return false;
+  }
+  if (itemMethod == NSIS_COPY) {
+    return d.WriteTo(w, itemSize, ec);
+  }
+  // compressed blocks do not record uncompressed size: decode to the end of the block
+  uint8_t buffer[64 * 1024];
+  for (;;) {
+    auto n = d.Read(buffer, sizeof(buffer), ec);
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    if (!w(buffer, static_cast<size_t>(n))) {
+      ec = bela::make_error_code(ErrCanceled, L"canceled");
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace baulk::archive::nsis
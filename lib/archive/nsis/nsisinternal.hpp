@@ -0,0 +1,140 @@
+//
+#ifndef BAULK_ARCHIVE_NSIS_INTERNAL_HPP
+#define BAULK_ARCHIVE_NSIS_INTERNAL_HPP
+#include <baulk/archive/nsis.hpp>
+#include <baulk/allocate.hpp>
+#include <baulk/archive.hpp>
+#include <bela/endian.hpp>
+#include <bela/bytes_view.hpp>
+#include "zlib.h"
+#ifndef LZMA_API_STATIC
+#define LZMA_API_STATIC 1
+#endif
+#include <lzma.h>
+
+namespace baulk::archive::nsis {
+using baulk::mem::Buffer;
+using bela::ssize_t;
+constexpr long ErrNotNsisFile = 755320;
+
+// https://github.com/kichik/nsis/blob/master/Source/exehead/fileform.h
+constexpr uint32_t FH_FLAGS_MASK = 15;
+constexpr uint32_t FH_FLAGS_UNINSTALL = 1;
+constexpr uint32_t FH_FLAGS_SILENT = 2;
+constexpr uint32_t FH_FLAGS_NO_CRC = 4;
+constexpr uint32_t FH_FLAGS_FORCE_CRC = 8;
+constexpr uint32_t FH_SIG = 0xDEADBEEF;
+constexpr uint32_t compressedFlag = 0x80000000;
+
+#pragma pack(push, 1)
+struct firstheader {
+  uint32_t flags;
+  uint32_t siginfo;
+  uint8_t nsinst[12]; // NullsoftInst
+  uint32_t length_of_header;
+  uint32_t length_of_all_following_data;
+};
+
+struct block_header {
+  uint32_t offset;
+  uint32_t num;
+};
+
+struct entry {
+  uint32_t which;
+  int32_t offsets[6];
+};
+#pragma pack(pop)
+
+constexpr size_t BLOCKS_NUM = 8;
+constexpr size_t NB_ENTRIES = 2;
+constexpr size_t NB_STRINGS = 3;
+constexpr size_t NB_LANGTABLES = 4;
+constexpr size_t headerBlocksOffset = 4;
+
+// exec opcodes
+constexpr uint32_t EW_CREATEDIR = 11;
+constexpr uint32_t EW_EXTRACTFILE = 20;
+
+// nsis variables https://github.com/kichik/nsis/blob/master/Source/exehead/state.h
+constexpr int VAR_INSTDIR = 21;
+constexpr int VAR_OUTDIR = 22;
+constexpr int VAR_OUTDIR_ = 31; // $_OUTDIR
+
+// bzip2Decoder decodes the NSIS flavour of bzip2, which libbzip2 cannot read (see bzip2.cc)
+class bzip2Decoder {
+public:
+  static constexpr uint32_t maxGroups = 6;
+  static constexpr uint32_t maxAlphaSize = 258;
+  static constexpr uint32_t maxCodeLen = 20;
+  // Source supplies the next chunk of compressed input, an empty chunk at the end of input
+  using Source = std::function<bool(bela::bytes_view &chunk, bela::error_code &ec)>;
+  bzip2Decoder() = default;
+  bzip2Decoder(const bzip2Decoder &) = delete;
+  bzip2Decoder &operator=(const bzip2Decoder &) = delete;
+  bool Initialize(Source &&source_, bela::error_code &ec);
+  // Read returns the number of bytes decoded, 0 after the end of stream marker
+  ssize_t Read(uint8_t *out, size_t len, bela::error_code &ec);
+
+private:
+  struct huffGroup {
+    int32_t limit[maxCodeLen + 1];
+    int32_t base[maxCodeLen + 1];
+    uint16_t perm[maxAlphaSize];
+    uint32_t minLen{0};
+    uint32_t maxLen{0};
+  };
+  Source source;
+  bela::bytes_view chunk;
+  size_t chunkPos{0};
+  uint64_t bitbuf{0};
+  uint32_t bitcount{0};
+  huffGroup groups[maxGroups];
+  std::vector<uint8_t> selectors;
+  std::vector<uint32_t> tt; // block bytes in the low 8 bits, inverse BWT links in the high 24 bits
+  uint32_t tpos{0};
+  uint32_t blockSize{0};
+  uint32_t blockUsed{0};
+  int last{-1};
+  uint32_t runLength{0};
+  uint32_t repeat{0};
+  bool eof{false};
+  bool getBits(uint32_t n, uint32_t &v, bela::error_code &ec);
+  void makeTable(huffGroup &g, const uint8_t *lens, uint32_t alphaSize);
+  bool decodeSymbol(const huffGroup &g, uint32_t alphaSize, uint32_t &sym, bela::error_code &ec);
+  bool readBlock(bela::error_code &ec);
+};
+
+// Decoder decompresses a stream located at [offset, offset+length) of the file
+class Decoder {
+public:
+  Decoder(const bela::io::FD &fd_, method_t method_) : fd(fd_), method(method_) {}
+  Decoder(const Decoder &) = delete;
+  Decoder &operator=(const Decoder &) = delete;
+  ~Decoder();
+  bool Initialize(int64_t offset, int64_t length, bela::error_code &ec);
+  ssize_t Read(void *buffer, size_t len, bela::error_code &ec);
+  bool ReadFull(void *buffer, size_t len, bela::error_code &ec);
+  bool Discard(int64_t len, bela::error_code &ec);
+  bool WriteTo(const Writer &w, int64_t len, bela::error_code &ec);
+
+private:
+  bool fill(bela::error_code &ec);
+  bool decompress(bela::error_code &ec);
+  bool initializeLZMA(bela::error_code &ec);
+  void release();
+  const bela::io::FD &fd;
+  method_t method;
+  int64_t position{0};
+  int64_t remaining{0};
+  z_stream *zs{nullptr};
+  lzma_stream *xzs{nullptr};
+  std::unique_ptr<bzip2Decoder> bzs;
+  Buffer in;
+  Buffer out;
+  bool eof{false};
+};
+
+} // namespace baulk::archive::nsis
+
+#endif
@@ -3,6 +3,7 @@
 #include <bela/endian.hpp>
 #include <bela/bufio.hpp>
 #include <bitset>
+#include <algorithm>
 #include <bela/terminal.hpp>
 #include "zipinternal.hpp"
 
@@ -404,9 +405,29 @@ bool Reader::Initialize(bela::error_code &ec) {
     compressed_size += file.compressed_size;
     files.emplace_back(std::move(file));
   }
+  detectCodePage();
   return true;
 }
 
+// a single short name carries little signal, detect the encoding once over a sample of all legacy names
+void Reader::detectCodePage() {
+  constexpr size_t maxSampleSize = 64 * 1024;
+  std::string sample;
+  for (const auto &file : files) {
+    if (file.IsFileNameUTF8() ||
+        std::all_of(file.name.begin(), file.name.end(), [](char c) { return static_cast<uint8_t>(c) < 0x80; })) {
+      continue;
+    }
+    if (sample.size() + file.name.size() + 1 > maxSampleSize) {
+      break;
+    }
+    sample.append(file.name).push_back('\n');
+  }
+  if (!sample.empty()) {
+    codePage = DetectCodePage(sample);
+  }
+}
+
 bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
   if (fd) {
     ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
@@ -5,30 +5,124 @@
 #include <bela/hash.hpp>
 #include <bela/ascii.hpp>
 #include <baulk/hash.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <variant>
 
 namespace baulk::hash {
 
-template <typename Hasher> struct Sumizer {
-  Hasher hasher;
-  bool filechecksum(const std::filesystem::path &file, std::wstring &hv, bela::error_code &ec) {
-    HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (FileHandle == INVALID_HANDLE_VALUE) {
+constexpr size_t readBufferSize = 1024 * 1024;
+// BLAKE3 splits each update into subtrees, a power of two keeps them full
+constexpr size_t treeBufferSize = 32 * 1024 * 1024;
+constexpr int64_t treeMinSize = 64 * 1024 * 1024;
+constexpr size_t mapViewSize = 64 * 1024 * 1024;
+
+struct source_options {
+  bool mmap{false};
+  bool tree{false}; // allow BLAKE3 multi-threaded tree hashing of large files
+};
+
+// page aligned read buffer
+class AlignedBuffer {
+public:
+  AlignedBuffer(size_t size_) : size(size_) {
+    data = reinterpret_cast<uint8_t *>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+  }
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+  ~AlignedBuffer() {
+    if (data != nullptr) {
+      VirtualFree(data, 0, MEM_RELEASE);
+    }
+  }
+  uint8_t *data{nullptr};
+  size_t size{0};
+};
+
+template <typename Fn> bool readFile(HANDLE FileHandle, size_t bufferSize, Fn fn, bela::error_code &ec) {
+  AlignedBuffer buffer(bufferSize);
+  if (buffer.data == nullptr) {
+    ec = bela::make_system_error_code(L"VirtualAlloc(): ");
+    return false;
+  }
+  for (;;) {
+    DWORD dwread = 0;
+    if (ReadFile(FileHandle, buffer.data, static_cast<DWORD>(buffer.size), &dwread, nullptr) != TRUE) {
       ec = bela::make_system_error_code();
       return false;
     }
-    auto closer = bela::finally([&] { CloseHandle(FileHandle); });
-    uint8_t bytes[32678];
-    for (;;) {
-      DWORD dwread = 0;
-      if (ReadFile(FileHandle, bytes, sizeof(bytes), &dwread, nullptr) != TRUE) {
-        ec = bela::make_system_error_code();
-        return false;
-      }
-      hasher.Update(bytes, static_cast<size_t>(dwread));
-      if (dwread < sizeof(bytes)) {
-        break;
+    if (dwread == 0) {
+      break;
+    }
+    fn(buffer.data, static_cast<size_t>(dwread));
+  }
+  return true;
+}
+
+template <typename Fn> bool mapFile(HANDLE FileHandle, int64_t size, Fn fn, bela::error_code &ec) {
+  if (size == 0) {
+    return true;
+  }
+  auto FileMap = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (FileMap == nullptr) {
+    ec = bela::make_system_error_code(L"CreateFileMappingW(): ");
+    return false;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileMap); });
+  for (int64_t offset = 0; offset < size;) {
+    auto len = static_cast<size_t>((std::min)(static_cast<int64_t>(mapViewSize), size - offset));
+    auto view = MapViewOfFile(FileMap, FILE_MAP_READ, static_cast<DWORD>(offset >> 32),
+                              static_cast<DWORD>(offset & 0xFFFFFFFF), len);
+    if (view == nullptr) {
+      ec = bela::make_system_error_code(L"MapViewOfFile(): ");
+      return false;
+    }
+    fn(reinterpret_cast<const uint8_t *>(view), len);
+    UnmapViewOfFile(view);
+    offset += static_cast<int64_t>(len);
+  }
+  return true;
+}
+
+// hashFile feeds the whole file to fn(data, len, tree), tree is set when the file is large enough to be split
+template <typename Fn>
+bool hashFile(const std::filesystem::path &file, const source_options &so, Fn fn, bela::error_code &ec) {
+  HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    ec = bela::make_system_error_code();
+    return false;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
+  LARGE_INTEGER li;
+  if (GetFileSizeEx(FileHandle, &li) != TRUE) {
+    ec = bela::make_system_error_code(L"GetFileSizeEx(): ");
+    return false;
+  }
+  auto tree = so.tree && li.QuadPart >= treeMinSize;
+  auto update = [&](const uint8_t *data, size_t len) { fn(data, len, tree); };
+  if (so.mmap) {
+    return mapFile(FileHandle, li.QuadPart, update, ec);
+  }
+  return readFile(FileHandle, tree ? treeBufferSize : readBufferSize, update, ec);
+}
+
+template <typename Hasher> struct Sumizer {
+  Hasher hasher;
+  source_options so;
+  bool filechecksum(const std::filesystem::path &file, std::wstring &hv, bela::error_code &ec) {
+    auto update = [&](const uint8_t *data, size_t len, bool tree) {
+      if constexpr (std::is_same_v<Hasher, bela::hash::blake3::Hasher>) {
+        if (tree) {
+          hasher.UpdateParallel(data, len);
+          return;
+        }
       }
+      hasher.Update(data, len);
+    };
+    if (!hashFile(file, so, update, ec)) {
+      return false;
     }
     hv = hasher.Finalize();
     return true;
@@ -42,52 +136,58 @@ template <typename Hasher> struct Sumizer {
   }
 };
 
-std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec) {
+std::optional<std::wstring> fileHash(const std::filesystem::path &file, hash_t method, const source_options &so,
+                                     bela::error_code &ec) {
   switch (method) {
   case hash_t::SHA224: {
-    Sumizer<bela::hash::sha256::Hasher> sumizer;
+    Sumizer<bela::hash::sha256::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize(bela::hash::sha256::HashBits::SHA224);
     return sumizer(file, ec);
   }
   case hash_t::SHA256: {
-    Sumizer<bela::hash::sha256::Hasher> sumizer;
+    Sumizer<bela::hash::sha256::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize();
     return sumizer(file, ec);
   }
   case hash_t::SHA384: {
-    Sumizer<bela::hash::sha512::Hasher> sumizer;
+    Sumizer<bela::hash::sha512::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize(bela::hash::sha512::HashBits::SHA384);
     return sumizer(file, ec);
   }
   case hash_t::SHA512: {
-    Sumizer<bela::hash::sha512::Hasher> sumizer;
+    Sumizer<bela::hash::sha512::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize();
     return sumizer(file, ec);
   }
   case hash_t::SHA3_224: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
+    Sumizer<bela::hash::sha3::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3224);
     return sumizer(file, ec);
   }
   case hash_t::SHA3_256:
     [[fallthrough]];
   case hash_t::SHA3: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
+    Sumizer<bela::hash::sha3::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize();
     return sumizer(file, ec);
   }
   case hash_t::SHA3_384: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
+    Sumizer<bela::hash::sha3::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3384);
     return sumizer(file, ec);
   }
   case hash_t::SHA3_512: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
+    Sumizer<bela::hash::sha3::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3512);
     return sumizer(file, ec);
   }
   case hash_t::BLAKE3: {
-    Sumizer<bela::hash::blake3::Hasher> sumizer;
+    Sumizer<bela::hash::blake3::Hasher> sumizer{.so = so};
+    sumizer.hasher.Initialize();
+    return sumizer(file, ec);
+  }
+  case hash_t::SM3: {
+    Sumizer<bela::hash::sm3::Hasher> sumizer{.so = so};
     sumizer.hasher.Initialize();
     return sumizer(file, ec);
   }
@@ -98,6 +198,310 @@ std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t m
   return std::nullopt;
 }
 
+std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec) {
+  return fileHash(file, method, source_options{.tree = true}, ec);
+}
+
+struct hash_result {
+  std::optional<std::wstring> hv;
+  bela::error_code ec;
+  bool done{false};
+};
+
+std::optional<bela::hash::sha3::HashBits> sha3Bits(hash_t method) {
+  switch (method) {
+  case hash_t::SHA3_224:
+    return bela::hash::sha3::HashBits::SHA3224;
+  case hash_t::SHA3_256:
+    [[fallthrough]];
+  case hash_t::SHA3:
+    return bela::hash::sha3::HashBits::SHA3256;
+  case hash_t::SHA3_384:
+    return bela::hash::sha3::HashBits::SHA3384;
+  case hash_t::SHA3_512:
+    return bela::hash::sha3::HashBits::SHA3512;
+  default:
+    break;
+  }
+  return std::nullopt;
+}
+
+constexpr size_t sha3Lanes = 4;
+
+// sha3Batch reads up to four files in lockstep, full buffers of the lanes share the interleaved Keccak permutation
+void sha3Batch(std::span<const std::filesystem::path> files, bela::hash::sha3::HashBits hb,
+               std::span<hash_result> results) {
+  bela::hash::sha3::Hasher4 hasher;
+  hasher.Initialize(hb);
+  AlignedBuffer buffer(readBufferSize * sha3Lanes);
+  if (buffer.data == nullptr) {
+    for (auto &r : results) {
+      r.ec = bela::make_system_error_code(L"VirtualAlloc(): ");
+    }
+    return;
+  }
+  HANDLE handles[sha3Lanes] = {INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE};
+  auto closeLane = [&](size_t i) {
+    CloseHandle(handles[i]);
+    handles[i] = INVALID_HANDLE_VALUE;
+  };
+  size_t opened = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    handles[i] = CreateFileW(files[i].c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handles[i] == INVALID_HANDLE_VALUE) {
+      results[i].ec = bela::make_system_error_code();
+      continue;
+    }
+    opened++;
+  }
+  while (opened != 0) {
+    const void *input[sha3Lanes] = {nullptr, nullptr, nullptr, nullptr};
+    bool full = false;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (handles[i] == INVALID_HANDLE_VALUE) {
+        continue;
+      }
+      auto data = buffer.data + i * readBufferSize;
+      DWORD dwread = 0;
+      if (ReadFile(handles[i], data, static_cast<DWORD>(readBufferSize), &dwread, nullptr) != TRUE) {
+        results[i].ec = bela::make_system_error_code();
+        closeLane(i);
+        opened--;
+        continue;
+      }
+      if (dwread == 0) {
+        results[i].hv = hasher.lanes[i].Finalize();
+        closeLane(i);
+        opened--;
+        continue;
+      }
+      if (dwread == readBufferSize) {
+        input[i] = data;
+        full = true;
+        continue;
+      }
+      // a short read is the tail of the file
+      hasher.lanes[i].Update(data, dwread);
+    }
+    if (full) {
+      hasher.Update(input, readBufferSize);
+    }
+  }
+}
+
+void FileHashes(const std::vector<std::filesystem::path> &files, hash_t method, const file_hash_options &opts,
+                const file_hash_receiver &receiver) {
+  std::vector<hash_result> results(files.size());
+  std::atomic_size_t next{0};
+  std::mutex mu;
+  size_t emitted = 0;
+  // a single file keeps every processor busy with BLAKE3 subtrees instead
+  source_options so{.mmap = opts.mmap, .tree = files.size() == 1};
+  auto jobs = static_cast<size_t>(opts.jobs != 0 ? opts.jobs : (std::max)(std::thread::hardware_concurrency(), 1U));
+  // once every thread is busy, SHA-3 files go four at a time through the interleaved permutation
+  auto hb = sha3Bits(method);
+  size_t batch = (hb && !opts.mmap && files.size() > jobs) ? sha3Lanes : 1;
+  auto worker = [&]() {
+    for (;;) {
+      auto i = next.fetch_add(batch);
+      if (i >= files.size()) {
+        return;
+      }
+      auto n = (std::min)(batch, files.size() - i);
+      if (batch == 1) {
+        auto &r = results[i];
+        r.hv = fileHash(files[i], method, so, r.ec);
+      } else {
+        sha3Batch(std::span(files).subspan(i, n), *hb, std::span(results).subspan(i, n));
+      }
+      std::scoped_lock lock(mu);
+      for (size_t k = i; k < i + n; k++) {
+        results[k].done = true;
+      }
+      for (; emitted < results.size() && results[emitted].done; emitted++) {
+        auto &e = results[emitted];
+        receiver(files[emitted], e.hv, e.ec);
+        e.hv.reset();
+      }
+    }
+  };
+  auto n = (std::min)(jobs, (files.size() + batch - 1) / batch);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < n; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+struct MultiHasher::digest {
+  std::variant<bela::hash::sha256::Hasher, bela::hash::sha512::Hasher, bela::hash::sha3::Hasher,
+               bela::hash::blake3::Hasher, bela::hash::sm3::Hasher>
+      hasher;
+  bool Initialize(hash_t method, bela::error_code &ec) {
+    switch (method) {
+    case hash_t::SHA224:
+      hasher.emplace<bela::hash::sha256::Hasher>().Initialize(bela::hash::sha256::HashBits::SHA224);
+      return true;
+    case hash_t::SHA256:
+      hasher.emplace<bela::hash::sha256::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA384:
+      hasher.emplace<bela::hash::sha512::Hasher>().Initialize(bela::hash::sha512::HashBits::SHA384);
+      return true;
+    case hash_t::SHA512:
+      hasher.emplace<bela::hash::sha512::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA3_224:
+      hasher.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3224);
+      return true;
+    case hash_t::SHA3_256:
+      [[fallthrough]];
+    case hash_t::SHA3:
+      hasher.emplace<bela::hash::sha3::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA3_384:
+      hasher.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3384);
+      return true;
+    case hash_t::SHA3_512:
+      hasher.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3512);
+      return true;
+    case hash_t::BLAKE3:
+      hasher.emplace<bela::hash::blake3::Hasher>().Initialize();
+      return true;
+    case hash_t::SM3:
+      hasher.emplace<bela::hash::sm3::Hasher>().Initialize();
+      return true;
+    default:
+      break;
+    }
+    ec = bela::make_error_code(bela::ErrGeneral, L"unkown hash method: ", static_cast<int>(method));
+    return false;
+  }
+  void Update(const uint8_t *data, size_t len) {
+    std::visit([&](auto &h) { h.Update(data, len); }, hasher);
+  }
+  std::wstring Finalize() {
+    return std::visit([](auto &h) { return h.Finalize(); }, hasher);
+  }
+};
+
+MultiHasher::~MultiHasher() {
+  wait();
+  {
+    std::scoped_lock lock(mu);
+    exiting = true;
+  }
+  cv.notify_all();
+  for (auto &t : consumers) {
+    t.join();
+  }
+}
+
+bool MultiHasher::Initialize(std::span<const hash_t> methods, bela::error_code &ec) {
+  for (auto m : methods) {
+    auto d = std::make_unique<digest>();
+    if (!d->Initialize(m, ec)) {
+      return false;
+    }
+    digests.emplace_back(std::move(d));
+  }
+  for (size_t i = 0; i < digests.size(); i++) {
+    consumers.emplace_back([this, i] { consume(i); });
+  }
+  return true;
+}
+
+void MultiHasher::consume(size_t index) {
+  uint64_t seen = 0;
+  for (;;) {
+    const uint8_t *data = nullptr;
+    size_t len = 0;
+    {
+      std::unique_lock lock(mu);
+      cv.wait(lock, [&] { return exiting || generation != seen; });
+      if (exiting) {
+        return;
+      }
+      seen = generation;
+      data = pending;
+      len = pendingLen;
+    }
+    digests[index]->Update(data, len);
+    {
+      std::scoped_lock lock(mu);
+      busy--;
+    }
+    cv.notify_all();
+  }
+}
+
+void MultiHasher::wait() {
+  std::unique_lock lock(mu);
+  cv.wait(lock, [&] { return busy == 0; });
+}
+
+void MultiHasher::Update(const void *data, size_t len) {
+  if (len == 0 || digests.empty()) {
+    return;
+  }
+  wait();
+  {
+    std::scoped_lock lock(mu);
+    pending = reinterpret_cast<const uint8_t *>(data);
+    pendingLen = len;
+    busy = digests.size();
+    generation++;
+  }
+  cv.notify_all();
+}
+
+std::vector<std::wstring> MultiHasher::Finalize() {
+  wait();
+  std::vector<std::wstring> hvs;
+  hvs.reserve(digests.size());
+  for (auto &d : digests) {
+    hvs.emplace_back(d->Finalize());
+  }
+  return hvs;
+}
+
+std::optional<std::vector<std::wstring>> MultiFileHash(const std::filesystem::path &file,
+                                                       std::span<const hash_t> methods, bela::error_code &ec) {
+  // reading the next buffer overlaps hashing the previous one, the buffers must outlive the hasher
+  AlignedBuffer buffers[2] = {AlignedBuffer(readBufferSize), AlignedBuffer(readBufferSize)};
+  if (buffers[0].data == nullptr || buffers[1].data == nullptr) {
+    ec = bela::make_system_error_code(L"VirtualAlloc(): ");
+    return std::nullopt;
+  }
+  MultiHasher hasher;
+  if (!hasher.Initialize(methods, ec)) {
+    return std::nullopt;
+  }
+  HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    ec = bela::make_system_error_code();
+    return std::nullopt;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
+  for (size_t i = 0;; i ^= 1) {
+    DWORD dwread = 0;
+    if (ReadFile(FileHandle, buffers[i].data, static_cast<DWORD>(buffers[i].size), &dwread, nullptr) != TRUE) {
+      ec = bela::make_system_error_code();
+      return std::nullopt;
+    }
+    if (dwread == 0) {
+      break;
+    }
+    hasher.Update(buffers[i].data, static_cast<size_t>(dwread));
+  }
+  return std::make_optional(hasher.Finalize());
+}
+
 struct HashPrefix {
   const std::wstring_view prefix;
   hash_t method;
@@ -113,10 +517,11 @@ constexpr HashPrefix hnmaps[] = {
     {L"SHA3-384", hash_t::SHA3_384}, // SHA3-384
     {L"SHA3-512", hash_t::SHA3_512}, // SHA3-512
     {L"SHA3", hash_t::SHA3},         // SHA3 alias for SHA3-256
+    {L"SM3", hash_t::SM3},           // SM3
 };
-bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value, bela::error_code &ec) {
-  std::wstring_view value = hash_value;
-  auto m = hash_t::SHA256;
+bool parseHashValue(std::wstring_view hash_value, hash_t &m, std::wstring_view &value, bela::error_code &ec) {
+  value = hash_value;
+  m = hash_t::SHA256;
   if (auto pos = hash_value.find(':'); pos != std::wstring_view::npos) {
     value = hash_value.substr(pos + 1);
     auto prefix = bela::AsciiStrToUpper(hash_value.substr(0, pos));
@@ -134,43 +539,52 @@ bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value,
       return false;
     }
   }
-  auto ha = FileHash(file, m, ec);
-  if (!ha) {
-    return false;
+  return true;
+}
+
+bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value, bela::error_code &ec) {
+  return HashEqual(file, std::span<const std::wstring_view>(&hash_value, 1), ec);
+}
+
+bool HashEqual(const std::filesystem::path &file, std::span<const std::wstring_view> hash_values,
+               bela::error_code &ec) {
+  std::vector<hash_t> methods(hash_values.size());
+  std::vector<std::wstring_view> values(hash_values.size());
+  for (size_t i = 0; i < hash_values.size(); i++) {
+    if (!parseHashValue(hash_values[i], methods[i], values[i], ec)) {
+      return false;
+    }
   }
-  if (!bela::EndsWithIgnoreCase(*ha, value)) {
-    ec = bela::make_error_code(bela::ErrGeneral, L"checksum mismatch expected ", value, L" actual ", *ha);
-    return false;
+  std::vector<std::wstring> hvs;
+  if (methods.size() == 1) {
+    auto ha = FileHash(file, methods.front(), ec);
+    if (!ha) {
+      return false;
+    }
+    hvs.emplace_back(std::move(*ha));
+  } else {
+    auto ha = MultiFileHash(file, methods, ec);
+    if (!ha) {
+      return false;
+    }
+    hvs = std::move(*ha);
+  }
+  for (size_t i = 0; i < hvs.size(); i++) {
+    if (!bela::EndsWithIgnoreCase(hvs[i], values[i])) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"checksum mismatch expected ", values[i], L" actual ", hvs[i]);
+      return false;
+    }
   }
   return true;
 }
 
 std::optional<file_hash_sums> HashSums(const std::filesystem::path &file, bela::error_code &ec) {
-  HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-  if (FileHandle == INVALID_HANDLE_VALUE) {
-    ec = bela::make_system_error_code();
+  constexpr hash_t methods[] = {hash_t::SHA256, hash_t::BLAKE3};
+  auto hvs = MultiFileHash(file, methods, ec);
+  if (!hvs) {
     return std::nullopt;
   }
-  bela::hash::sha256::Hasher s;
-  bela::hash::blake3::Hasher b;
-  s.Initialize();
-  b.Initialize();
-  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
-  uint8_t bytes[32678];
-  for (;;) {
-    DWORD dwread = 0;
-    if (ReadFile(FileHandle, bytes, sizeof(bytes), &dwread, nullptr) != TRUE) {
-      ec = bela::make_system_error_code();
-      return std::nullopt;
-    }
-    s.Update(bytes, static_cast<size_t>(dwread));
-    b.Update(bytes, static_cast<size_t>(dwread));
-    if (dwread < sizeof(bytes)) {
-      break;
-    }
-  }
-  return std::make_optional(file_hash_sums{.sha256sum = s.Finalize(), .blake3sum = b.Finalize()});
+  return std::make_optional(file_hash_sums{.sha256sum = std::move((*hvs)[0]), .blake3sum = std::move((*hvs)[1])});
 }
 
 } // namespace baulk::hash
@@ -0,0 +1,160 @@
+// Index of verified file digests, lets a cached archive skip rehashing while it is unchanged
+#include <bela/base.hpp>
+#include <bela/ascii.hpp>
+#include <bela/io.hpp>
+#include <bela/match.hpp>
+#include <bela/str_cat.hpp>
+#include <baulk/hash.hpp>
+#include <json.hpp>
+
+namespace baulk::hash {
+
+// a write to the file updates LastWriteTime and ChangeTime, replacing it changes the file ID
+struct file_identity {
+  uint64_t volume{0};
+  std::string id;
+  int64_t size{0};
+  int64_t mtime{0};
+  int64_t ctime{0};
+  bool operator==(const file_identity &) const = default;
+};
+
+// timestamps this close to now may still be updated by a write the same tick, such files are not recorded
+constexpr int64_t racyInterval = 2 * 10'000'000; // 2s in FILETIME units
+
+static std::optional<file_identity> fileIdentity(const std::filesystem::path &file) {
+  auto FileHandle =
+      CreateFileW(file.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    return std::nullopt;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
+  FILE_ID_INFO idInfo;
+  FILE_BASIC_INFO basicInfo;
+  FILE_STANDARD_INFO standardInfo;
+  if (GetFileInformationByHandleEx(FileHandle, FileIdInfo, &idInfo, sizeof(idInfo)) != TRUE ||
+      GetFileInformationByHandleEx(FileHandle, FileBasicInfo, &basicInfo, sizeof(basicInfo)) != TRUE ||
+      GetFileInformationByHandleEx(FileHandle, FileStandardInfo, &standardInfo, sizeof(standardInfo)) != TRUE) {
+    return std::nullopt;
+  }
+  file_identity fi;
+  fi.volume = idInfo.VolumeSerialNumber;
+  constexpr char hex[] = "0123456789abcdef";
+  for (auto b : idInfo.FileId.Identifier) {
+    fi.id.push_back(hex[b >> 4]);
+    fi.id.push_back(hex[b & 0xF]);
+  }
+  fi.size = standardInfo.EndOfFile.QuadPart;
+  fi.mtime = basicInfo.LastWriteTime.QuadPart;
+  fi.ctime = basicInfo.ChangeTime.QuadPart;
+  return std::make_optional(std::move(fi));
+}
+
+static int64_t fileTimeNow() {
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  ULARGE_INTEGER ul;
+  ul.LowPart = ft.dwLowDateTime;
+  ul.HighPart = ft.dwHighDateTime;
+  return static_cast<int64_t>(ul.QuadPart);
+}
+
+static nlohmann::json emptyIndex() { return nlohmann::json{{"files", nlohmann::json::object()}}; }
+
+static nlohmann::json loadIndex(const std::filesystem::path &index) {
+  FILE *fd = nullptr;
+  if (_wfopen_s(&fd, index.c_str(), L"rb") != 0) {
+    return emptyIndex();
+  }
+  auto closer = bela::finally([&] { fclose(fd); });
+  try {
+    auto j = nlohmann::json::parse(fd, nullptr, true, true);
+    if (j.is_object() && j.contains("files") && j["files"].is_object()) {
+      return j;
+    }
+  } catch (const std::exception &) {
+    // a corrupt index only costs a rehash
+  }
+  return emptyIndex();
+}
+
+static bool identityMatched(const nlohmann::json &entry, const file_identity &fi) {
+  return entry.value("volume", uint64_t{0}) == fi.volume && entry.value("id", std::string()) == fi.id &&
+         entry.value("size", int64_t{-1}) == fi.size && entry.value("mtime", int64_t{0}) == fi.mtime &&
+         entry.value("ctime", int64_t{0}) == fi.ctime;
+}
+
+static bool saveIndex(nlohmann::json &j, const std::filesystem::path &index, bela::error_code &ec) {
+  auto &files = j["files"];
+  // drop entries of files that were removed, the downloads folder is cleaned independently
+  for (auto it = files.begin(); it != files.end();) {
+    std::error_code e;
+    if (!std::filesystem::exists(bela::encode_into<char, wchar_t>(it.key()), e)) {
+      it = files.erase(it);
+      continue;
+    }
+    ++it;
+  }
+  return bela::io::WriteTextAtomic(j.dump(4), index.native(), ec);
+}
+
+bool HashEqualCached(const std::filesystem::path &file, std::wstring_view hash_value,
+                     const std::filesystem::path &index, bela::error_code &ec) {
+  hash_t method;
+  std::wstring_view value;
+  if (!parseHashValue(hash_value, method, value, ec)) {
+    return false;
+  }
+  auto before = fileIdentity(file);
+  if (!before) {
+    return HashEqual(file, hash_value, ec);
+  }
+  auto compare = [&](std::wstring_view actual) {
+    if (!bela::EndsWithIgnoreCase(actual, value)) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"checksum mismatch expected ", value, L" actual ", actual);
+      return false;
+    }
+    return true;
+  };
+  std::error_code e;
+  auto absPath = std::filesystem::absolute(file, e).lexically_normal();
+  auto key = bela::encode_into<wchar_t, char>(absPath.native());
+  auto methodKey = std::to_string(static_cast<int>(method));
+  std::optional<std::wstring> actual;
+  try {
+    auto j = loadIndex(index);
+    auto &files = j["files"];
+    if (auto it = files.find(key); it != files.end() && identityMatched(*it, *before)) {
+      if (auto digests = it->find("digests"); digests != it->end() && digests->is_object()) {
+        if (auto d = digests->find(methodKey); d != digests->end() && d->is_string()) {
+          return compare(bela::encode_into<char, wchar_t>(d->get<std::string_view>()));
+        }
+      }
+    }
+    if (actual = FileHash(file, method, ec); !actual) {
+      return false;
+    }
+    // the file must not have changed while it was hashed, and must be old enough that a later write moves its times
+    auto after = fileIdentity(file);
+    if (after && *after == *before && fileTimeNow() - after->mtime >= racyInterval) {
+      auto &entry = files[key];
+      if (!entry.is_object() || !identityMatched(entry, *after) || !entry.contains("digests")) {
+        entry = nlohmann::json{{"volume", after->volume}, {"id", after->id},
+                               {"size", after->size},     {"mtime", after->mtime},
+                               {"ctime", after->ctime},   {"digests", nlohmann::json::object()}};
+      }
+      entry["digests"][methodKey] = bela::encode_into<wchar_t, char>(bela::AsciiStrToLower(*actual));
+      bela::error_code ec2;
+      saveIndex(j, index, ec2);
+    }
+  } catch (const std::exception &) {
+    // the index is bookkeeping only, its failures never decide the verification
+    if (!actual) {
+      return HashEqual(file, hash_value, ec);
+    }
+  }
+  return compare(*actual);
+}
+
+} // namespace baulk::hash
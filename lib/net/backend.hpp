@@ -0,0 +1,150 @@
+// backend: what HttpClient needs from the platform. Requests on pooled connections, the part file a download is
+// written to and the progress display. WinHTTP, Win32 files and the console progress bar on Windows
+// (backend_windows.cc), POSIX sockets with OpenSSL, POSIX files and a progress line elsewhere (backend_posix.cc)
+#ifndef BAULK_NET_BACKEND_HPP
+#define BAULK_NET_BACKEND_HPP
+#include <bela/numbers.hpp>
+#include <bela/str_split.hpp>
+#include <bela/strip.hpp>
+#include <baulk/net/client.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <utility>
+
+namespace baulk::net::net_internal {
+struct url {
+  std::wstring host;
+  std::wstring filename;
+  std::wstring uri; // path and query
+  int nPort{80};
+  bool secure{true};
+};
+
+// crack_url splits an http or https URL
+std::optional<url> crack_url(std::wstring_view us, bela::error_code &ec);
+
+// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Content-Disposition
+// https://www.rfc-editor.org/rfc/rfc6266#section-5
+inline std::optional<std::wstring> extract_filename(const headers_t &hkv) {
+  auto it = hkv.find(L"Content-Disposition");
+  if (it == hkv.end()) {
+    return std::nullopt;
+  }
+  std::vector<std::wstring_view> pvv = bela::StrSplit(it->second, bela::ByChar(';'), bela::SkipEmpty());
+  constexpr std::wstring_view fns = L"filename=";
+  constexpr std::wstring_view fnsu = L"filename*=";
+  for (auto e : pvv) {
+    auto s = bela::StripAsciiWhitespace(e);
+    if (bela::ConsumePrefix(&s, fns)) {
+      bela::ConsumePrefix(&s, L"\"");
+      bela::ConsumeSuffix(&s, L"\"");
+      return std::make_optional<>(url_path_name(s));
+    }
+    if (bela::ConsumePrefix(&s, fnsu)) {
+      bela::ConsumePrefix(&s, L"\"");
+      bela::ConsumeSuffix(&s, L"\"");
+      return std::make_optional<>(decoded_url_path_name(s));
+    }
+  }
+  return std::nullopt;
+}
+
+// content_length
+inline int64_t content_length(const headers_t &hkv) {
+  if (auto it = hkv.find(L"Content-Length"); it != hkv.end()) {
+    if (int64_t len = 0; bela::SimpleAtoi(bela::StripAsciiWhitespace(it->second), &len)) {
+      return len;
+    }
+  }
+  return -1;
+}
+
+inline bool enable_part_download(const headers_t &hkv) {
+  if (auto it = hkv.find(L"Accept-Ranges"); it != hkv.end()) {
+    return bela::EqualsIgnoreCase(bela::StripAsciiWhitespace(it->second), L"bytes");
+  }
+  return false;
+}
+
+// request_options: a range [position, end) is requested when either is set, end 0 leaves the range open
+struct request_options {
+  const headers_t &headers;
+  const std::vector<std::wstring> &cookies;
+  int64_t position{0};
+  int64_t end{0};
+  std::wstring_view body;
+  std::wstring_view content_type;
+};
+
+// request: one exchange on a connection of the backend
+class request {
+public:
+  virtual ~request() = default;
+  // Send writes the request and reads the response head, redirects are followed
+  virtual std::optional<minimal_response> Send(const request_options &opts, bela::error_code &ec) = 0;
+  // Read receives up to len bytes of the body, received is 0 once the body ended
+  virtual bool Read(char *buffer, size_t len, size_t &received, bela::error_code &ec) = 0;
+  // Location: where the last redirect led, nothing when the request was not redirected
+  virtual std::optional<url> Location() const = 0;
+};
+
+// progress: display of one download, Update is called from the writing threads
+class progress {
+public:
+  virtual ~progress() = default;
+  virtual void Update(int64_t current) = 0;
+  virtual void MarkFault() = 0;
+  virtual void MarkCompleted() = 0;
+  // Finish stops the display, called once
+  virtual void Finish() = 0;
+};
+
+// part_file: the file a download is written to. It is deleted when closed unless Keep or Rename was called
+class part_file {
+public:
+  part_file() = default;
+  part_file(part_file &&other) noexcept
+      : fd(std::exchange(other.fd, invalid_fd)), path(std::move(other.path)), keep(other.keep) {}
+  part_file(const part_file &) = delete;
+  part_file &operator=(const part_file &) = delete;
+  ~part_file() { Close(); }
+  bool Open(const std::filesystem::path &p, bela::error_code &ec);
+  bool Valid() const { return fd != invalid_fd; }
+  int64_t Size(bela::error_code &ec) const;
+  // ReadAt and WriteAt pass the offset with the call, segment writers and the hash catch-up share the file without
+  // going through its file pointer
+  bool ReadAt(void *buffer, size_t len, int64_t pos, bela::error_code &ec) const;
+  bool WriteAt(const void *data, size_t len, int64_t pos, bela::error_code &ec);
+  // Write appends at the file pointer
+  bool Write(const void *data, size_t len, bela::error_code &ec);
+  // Truncate sets the size and moves the file pointer there
+  bool Truncate(int64_t size, bela::error_code &ec);
+  void Keep() { keep = true; }
+  // Rename replaces target with the file and closes it
+  bool Rename(const std::filesystem::path &target, bela::error_code &ec);
+  void Close();
+
+private:
+  static constexpr intptr_t invalid_fd = -1; // INVALID_HANDLE_VALUE on Windows
+  intptr_t fd{invalid_fd};
+  std::filesystem::path path;
+  bool keep{false};
+};
+
+class backend {
+public:
+  virtual ~backend() = default;
+  // Open returns a request on a pooled connection to u. Segments of one download ask for no multiplexing so each
+  // range gets a connection of its own
+  virtual std::unique_ptr<request> Open(HttpClient &client, const url &u, std::wstring_view method,
+                                        bool multiplexing, bela::error_code &ec) = 0;
+  // MakeProgress: nothing is drawn when draw is false, the caller reports progress itself
+  virtual std::unique_ptr<progress> MakeProgress(const std::filesystem::path &file, int64_t total, bool draw) = 0;
+};
+
+backend &default_backend();
+
+} // namespace baulk::net::net_internal
+
+#endif
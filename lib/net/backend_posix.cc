@@ -0,0 +1,998 @@
+// POSIX backend of HttpClient: HTTP/1.1 on sockets, OpenSSL for https, POSIX part files and a progress line.
+// Idle keep-alive connections are pooled per host, port and proxy the way WinHTTP keeps them per session
+#include <bela/codecvt.hpp>
+#include <bela/match.hpp>
+#include <bela/str_cat.hpp>
+#include <bela/terminal.hpp>
+#include "backend.hpp"
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+
+namespace baulk::net::net_internal {
+constexpr int connect_timeout = 30 * 1000; // milliseconds
+constexpr int io_timeout = 60;             // seconds without progress on an established connection
+constexpr int max_redirects = 10;
+constexpr size_t max_idle_connections = 8;
+constexpr size_t max_header_size = 1024 * 1024;
+
+inline bela::error_code make_errno_code(std::wstring_view prefix, int eno) {
+  return bela::make_error_code(eno, prefix, bela::encode_into<char, wchar_t>(strerror(eno)));
+}
+
+// make_tls_error_code drains the OpenSSL error queue into one message
+inline bela::error_code make_tls_error_code(std::wstring_view prefix) {
+  std::wstring message;
+  char buffer[256];
+  while (auto e = ERR_get_error()) {
+    ERR_error_string_n(e, buffer, sizeof(buffer));
+    if (!message.empty()) {
+      message.append(L"; ");
+    }
+    message.append(bela::encode_into<char, wchar_t>(buffer));
+  }
+  if (message.empty()) {
+    message = L"connection closed";
+  }
+  return bela::make_error_code(bela::ErrGeneral, prefix, message);
+}
+
+std::optional<url> crack_url(std::wstring_view us, bela::error_code &ec) {
+  auto bad_url = [&](std::wstring_view reason) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"invalid URL '", us, L"': ", reason);
+    return std::nullopt;
+  };
+  url u;
+  auto rest = us;
+  if (bela::StartsWithIgnoreCase(rest, L"https://")) {
+    rest.remove_prefix(8);
+    u.secure = true;
+    u.nPort = 443;
+  } else if (bela::StartsWithIgnoreCase(rest, L"http://")) {
+    rest.remove_prefix(7);
+    u.secure = false;
+    u.nPort = 80;
+  } else {
+    return bad_url(L"unsupported scheme");
+  }
+  auto authority = rest.substr(0, rest.find_first_of(L"/?#"));
+  auto tail = rest.substr(authority.size());
+  if (auto at = authority.rfind(L'@'); at != std::wstring_view::npos) {
+    authority.remove_prefix(at + 1);
+  }
+  auto host = authority;
+  std::wstring_view port;
+  if (authority.starts_with(L'[')) {
+    auto close = authority.find(L']');
+    if (close == std::wstring_view::npos) {
+      return bad_url(L"unterminated IPv6 address");
+    }
+    host = authority.substr(1, close - 1);
+    if (auto after = authority.substr(close + 1); !after.empty()) {
+      if (after.front() != L':') {
+        return bad_url(L"junk after IPv6 address");
+      }
+      port = after.substr(1);
+    }
+  } else if (auto colon = authority.rfind(L':'); colon != std::wstring_view::npos) {
+    host = authority.substr(0, colon);
+    port = authority.substr(colon + 1);
+  }
+  if (host.empty()) {
+    return bad_url(L"missing host");
+  }
+  if (!port.empty()) {
+    if (int p = 0; bela::SimpleAtoi(port, &p) && p > 0 && p <= 65535) {
+      u.nPort = p;
+    } else {
+      return bad_url(L"invalid port");
+    }
+  }
+  // the fragment stays with the client
+  tail = tail.substr(0, tail.find(L'#'));
+  u.host = host;
+  u.uri = tail.starts_with(L'/') ? std::wstring(tail) : bela::StringCat(L"/", tail);
+  u.filename = decoded_url_path_name(tail.substr(0, tail.find(L'?')));
+  return std::make_optional(std::move(u));
+}
+
+// tls_contexts: one verifying context and one for insecure mode, shared by every connection
+class tls_contexts {
+public:
+  tls_contexts() {
+    for (int i = 0; i < 2; i++) {
+      auto ctx = SSL_CTX_new(TLS_client_method());
+      if (ctx == nullptr) {
+        continue;
+      }
+      SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+      // bodies read until close end without close_notify on many servers, framing errors are caught by length
+      SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+      SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
+      if (i == 0) {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+        SSL_CTX_set_default_verify_paths(ctx);
+      } else {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+      }
+      contexts[i] = ctx;
+    }
+  }
+  tls_contexts(const tls_contexts &) = delete;
+  tls_contexts &operator=(const tls_contexts &) = delete;
+  ~tls_contexts() {
+    for (auto ctx : contexts) {
+      SSL_CTX_free(ctx);
+    }
+  }
+  SSL_CTX *get(bool insecure) const { return contexts[insecure ? 1 : 0]; }
+
+private:
+  SSL_CTX *contexts[2]{nullptr, nullptr};
+};
+
+// connection: a socket with an optional TLS session and a read buffer for the response head
+class connection {
+public:
+  connection(int fd_) : fd(fd_) {}
+  connection(const connection &) = delete;
+  connection &operator=(const connection &) = delete;
+  ~connection() {
+    if (ssl != nullptr) {
+      SSL_free(ssl);
+    }
+    close(fd);
+  }
+  bool StartTLS(SSL_CTX *ctx, const std::string &host, bool insecure, bela::error_code &ec) {
+    if (ctx == nullptr || (ssl = SSL_new(ctx)) == nullptr) {
+      ec = make_tls_error_code(L"TLS: ");
+      return false;
+    }
+    SSL_set_fd(ssl, fd);
+    in6_addr addr;
+    auto literal = inet_pton(AF_INET, host.data(), &addr) == 1 || inet_pton(AF_INET6, host.data(), &addr) == 1;
+    if (!literal) {
+      SSL_set_tlsext_host_name(ssl, host.data());
+    }
+    if (!insecure) {
+      if (literal) {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), host.data());
+      } else {
+        SSL_set1_host(ssl, host.data());
+      }
+    }
+    if (SSL_connect(ssl) != 1) {
+      if (auto result = SSL_get_verify_result(ssl); result != X509_V_OK) {
+        ERR_clear_error();
+        ec = bela::make_error_code(bela::ErrGeneral, L"TLS: certificate verify failed: ",
+                                   bela::encode_into<char, wchar_t>(X509_verify_cert_error_string(result)));
+        return false;
+      }
+      ec = make_tls_error_code(L"TLS handshake: ");
+      return false;
+    }
+    return true;
+  }
+  SSL *TLS() const { return ssl; }
+  bool WriteAll(std::string_view data, bela::error_code &ec) {
+    while (!data.empty()) {
+      ssize_t n = 0;
+      if (ssl != nullptr) {
+        n = SSL_write(ssl, data.data(), static_cast<int>((std::min)(data.size(), static_cast<size_t>(1 << 30))));
+        if (n <= 0) {
+          ec = make_tls_error_code(L"send: ");
+          return false;
+        }
+      } else if (n = send(fd, data.data(), data.size(), MSG_NOSIGNAL); n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ec = make_errno_code(L"send: ", errno);
+        return false;
+      }
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+  }
+  // ReadSome returns what is buffered or what one receive brings, 0 when the peer closed the connection
+  ssize_t ReadSome(char *out, size_t len, bela::error_code &ec) {
+    if (pos < buffer.size()) {
+      auto n = (std::min)(len, buffer.size() - pos);
+      memcpy(out, buffer.data() + pos, n);
+      pos += n;
+      return static_cast<ssize_t>(n);
+    }
+    return recv_some(out, len, ec);
+  }
+  // ReadLine reads a line of the response head without its CRLF
+  bool ReadLine(std::string &line, bela::error_code &ec) {
+    for (;;) {
+      if (auto end = buffer.find('\n', pos); end != std::string::npos) {
+        line.assign(buffer, pos, end - pos);
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+        pos = end + 1;
+        return true;
+      }
+      if (buffer.size() - pos > max_header_size) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"response header line too long");
+        return false;
+      }
+      buffer.erase(0, pos);
+      pos = 0;
+      char chunk[16 * 1024];
+      auto n = recv_some(chunk, sizeof(chunk), ec);
+      if (n < 0) {
+        return false;
+      }
+      if (n == 0) {
+        ec = bela::make_error_code(bela::ErrEnded, L"connection closed before the response ended");
+        return false;
+      }
+      buffer.append(chunk, static_cast<size_t>(n));
+    }
+  }
+  // Idle: nothing arrived on an idle connection, a readable socket means the server closed it
+  bool Idle() const {
+    if (pos < buffer.size() || (ssl != nullptr && SSL_pending(ssl) > 0)) {
+      return false;
+    }
+    pollfd p{.fd = fd, .events = POLLIN, .revents = 0};
+    return poll(&p, 1, 0) == 0;
+  }
+  // Received: whether any byte of a response arrived, a reused connection that fails before is retried
+  bool Received() const { return received; }
+
+private:
+  int fd{-1};
+  SSL *ssl{nullptr};
+  std::string buffer;
+  size_t pos{0};
+  bool received{false};
+  ssize_t recv_some(char *out, size_t len, bela::error_code &ec) {
+    len = (std::min)(len, static_cast<size_t>(1 << 30));
+    for (;;) {
+      ssize_t n = 0;
+      if (ssl != nullptr) {
+        n = SSL_read(ssl, out, static_cast<int>(len));
+        if (n <= 0) {
+          switch (SSL_get_error(ssl, static_cast<int>(n))) {
+          case SSL_ERROR_ZERO_RETURN:
+            return 0;
+          case SSL_ERROR_SYSCALL:
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+              ec = bela::make_error_code(bela::ErrGeneral, L"recv: timed out");
+              return -1;
+            }
+            if (ERR_peek_error() == 0) {
+              return 0;
+            }
+            [[fallthrough]];
+          default:
+            ec = make_tls_error_code(L"recv: ");
+            return -1;
+          }
+        }
+      } else if (n = recv(fd, out, len, 0); n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ec = make_errno_code(L"recv: ", errno == EAGAIN || errno == EWOULDBLOCK ? ETIMEDOUT : errno);
+        return -1;
+      }
+      received = received || n > 0;
+      return n;
+    }
+  }
+};
+
+// connection_pool: idle keep-alive connections, the most recent last
+class connection_pool {
+public:
+  std::unique_ptr<connection> Take(const std::string &key) {
+    std::scoped_lock lock(mu);
+    for (auto i = idle.size(); i > 0; i--) {
+      auto &e = idle[i - 1];
+      if (e.key != key) {
+        continue;
+      }
+      auto conn = std::move(e.conn);
+      idle.erase(idle.begin() + static_cast<std::ptrdiff_t>(i - 1));
+      if (conn->Idle()) {
+        return conn;
+      }
+    }
+    return nullptr;
+  }
+  void Put(const std::string &key, std::unique_ptr<connection> &&conn) {
+    std::scoped_lock lock(mu);
+    if (idle.size() >= max_idle_connections) {
+      idle.erase(idle.begin());
+    }
+    idle.emplace_back(idle_entry{.key = key, .conn = std::move(conn)});
+  }
+
+private:
+  struct idle_entry {
+    std::string key;
+    std::unique_ptr<connection> conn;
+  };
+  std::mutex mu;
+  std::vector<idle_entry> idle;
+};
+
+inline std::wstring format_address(const sockaddr *sa) {
+  char text[INET6_ADDRSTRLEN] = {0};
+  if (sa->sa_family == AF_INET) {
+    inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(sa)->sin_addr, text, sizeof(text));
+  } else if (sa->sa_family == AF_INET6) {
+    inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 *>(sa)->sin6_addr, text, sizeof(text));
+  }
+  return bela::encode_into<char, wchar_t>(text);
+}
+
+// connect_with_timeout connects a blocking socket, giving up after timeout milliseconds
+inline bool connect_with_timeout(int fd, const sockaddr *sa, socklen_t len, int timeout, bela::error_code &ec) {
+  auto flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  if (connect(fd, sa, len) != 0) {
+    if (errno != EINPROGRESS) {
+      ec = make_errno_code(L"connect: ", errno);
+      return false;
+    }
+    pollfd p{.fd = fd, .events = POLLOUT, .revents = 0};
+    int rc = 0;
+    while ((rc = poll(&p, 1, timeout)) < 0 && errno == EINTR) {
+    }
+    if (rc == 0) {
+      ec = make_errno_code(L"connect: ", ETIMEDOUT);
+      return false;
+    }
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    if (rc < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0 || err != 0) {
+      ec = make_errno_code(L"connect: ", err != 0 ? err : errno);
+      return false;
+    }
+  }
+  fcntl(fd, F_SETFL, flags);
+  return true;
+}
+
+// dial resolves host and connects to the first address that answers
+inline std::unique_ptr<connection> dial(HttpClient &client, const std::wstring &host, int port, bela::error_code &ec) {
+  auto node = bela::encode_into<wchar_t, char>(host);
+  auto service = std::to_string(port);
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = nullptr;
+  if (auto rc = getaddrinfo(node.data(), service.data(), &hints, &result); rc != 0) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"resolve ", host, L": ", bela::encode_into<char, wchar_t>(gai_strerror(rc)));
+    return nullptr;
+  }
+  auto closer = bela::finally([&] { freeaddrinfo(result); });
+  for (auto ai = result; ai != nullptr; ai = ai->ai_next) {
+    auto fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0) {
+      ec = make_errno_code(L"socket: ", errno);
+      continue;
+    }
+    if (!connect_with_timeout(fd, ai->ai_addr, ai->ai_addrlen, connect_timeout, ec)) {
+      close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval tv{.tv_sec = io_timeout, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    client.DbgPrint(L"Connecting to %s (%s) %s|:%d connected.", host, host, format_address(ai->ai_addr), port);
+    return std::make_unique<connection>(fd);
+  }
+  return nullptr;
+}
+
+inline std::wstring host_port(const url &u) {
+  auto ipv6 = u.host.find(L':') != std::wstring::npos;
+  return ipv6 ? bela::StringCat(L"[", u.host, L"]:", u.nPort) : bela::StringCat(u.host, L":", u.nPort);
+}
+
+// host_header leaves out the default port of the scheme
+inline std::wstring host_header(const url &u) {
+  if (u.nPort == (u.secure ? 443 : 80)) {
+    return u.host.find(L':') != std::wstring::npos ? bela::StringCat(L"[", u.host, L"]") : u.host;
+  }
+  return host_port(u);
+}
+
+// resolve_location turns a Location header into the next URL, relative references resolve against base
+inline std::optional<url> resolve_location(const url &base, std::wstring_view location, bela::error_code &ec) {
+  if (bela::StartsWithIgnoreCase(location, L"http://") || bela::StartsWithIgnoreCase(location, L"https://")) {
+    return crack_url(location, ec);
+  }
+  auto scheme = base.secure ? std::wstring_view{L"https:"} : std::wstring_view{L"http:"};
+  if (location.starts_with(L"//")) {
+    return crack_url(bela::StringCat(scheme, location), ec);
+  }
+  auto origin = bela::StringCat(scheme, L"//", host_port(base));
+  if (location.starts_with(L'/')) {
+    return crack_url(bela::StringCat(origin, location), ec);
+  }
+  std::wstring_view dir = base.uri;
+  dir = dir.substr(0, dir.find(L'?'));
+  dir = dir.substr(0, dir.rfind(L'/') + 1);
+  return crack_url(bela::StringCat(origin, dir, location), ec);
+}
+
+// body framing of a response
+enum class body_mode { none, length, chunked, close };
+
+class posix_backend;
+
+class posix_request final : public request {
+public:
+  posix_request(posix_backend &backend_, HttpClient &client_, const url &u, std::wstring_view method_)
+      : backend(backend_), client(client_), target(u), method(method_) {}
+  std::optional<minimal_response> Send(const request_options &opts, bela::error_code &ec) override;
+  bool Read(char *buffer, size_t len, size_t &received, bela::error_code &ec) override;
+  std::optional<url> Location() const override { return location; }
+
+private:
+  posix_backend &backend;
+  HttpClient &client;
+  url target;
+  std::wstring method;
+  std::optional<url> location;
+  std::unique_ptr<connection> conn;
+  std::string key; // pool key of conn
+  body_mode mode{body_mode::none};
+  int64_t remaining{0}; // of the body or of the current chunk
+  bool chunk_seen{false};
+  bool keep_alive{false};
+  std::optional<minimal_response> exchange(const request_options &opts, bela::error_code &ec);
+  std::optional<minimal_response> read_head(bela::error_code &ec);
+  std::string make_head(const request_options &opts, size_t body_size, bool proxied) const;
+  bool next_chunk(bela::error_code &ec);
+  void finish();
+  bool discard_body();
+};
+
+class line_progress final : public progress {
+public:
+  line_progress(const std::filesystem::path &file, int64_t total_, bool draw)
+      : name(file.filename().wstring()), total(total_), active(draw && bela::terminal::IsTerminal(stderr)) {}
+  void Update(int64_t current_) override {
+    current = current_;
+    if (!active) {
+      return;
+    }
+    std::scoped_lock lock(mu);
+    auto now = std::chrono::steady_clock::now();
+    if (drawn && now - last < std::chrono::milliseconds(200)) {
+      return;
+    }
+    last = now;
+    drawn = true;
+    draw();
+  }
+  void MarkFault() override { state = 31; }
+  void MarkCompleted() override { state = 32; }
+  void Finish() override {
+    std::scoped_lock lock(mu);
+    if (!drawn) {
+      return;
+    }
+    draw();
+    bela::FPrintF(stderr, L"\n");
+    drawn = false;
+  }
+
+private:
+  std::wstring name;
+  int64_t total{0};
+  bool active{false};
+  std::mutex mu;
+  std::chrono::steady_clock::time_point last;
+  bool drawn{false};
+  std::atomic_int64_t current{0};
+  std::atomic_uint32_t state{33};
+  void draw() {
+    constexpr double MiB = 1024.0 * 1024.0;
+    auto value = current.load();
+    if (total > 0) {
+      bela::FPrintF(stderr, L"\x1b[2K\r\x1b[%dm%s %d%% %.1f/%.1f MiB\x1b[0m", state.load(), name, value * 100 / total,
+                    static_cast<double>(value) / MiB, static_cast<double>(total) / MiB);
+      return;
+    }
+    bela::FPrintF(stderr, L"\x1b[2K\r\x1b[%dm%s %.1f MiB\x1b[0m", state.load(), name, static_cast<double>(value) / MiB);
+  }
+};
+
+class posix_backend final : public backend {
+public:
+  posix_backend() {
+    // a peer that closes while a request is written must surface as an error, not end the process
+    signal(SIGPIPE, SIG_IGN);
+  }
+  std::unique_ptr<request> Open(HttpClient &client, const url &u, std::wstring_view method, bool multiplexing,
+                                bela::error_code &ec) override {
+    // HTTP/1.1 runs one request per connection, segments get connections of their own either way
+    (void)multiplexing;
+    (void)ec;
+    return std::make_unique<posix_request>(*this, client, u, method);
+  }
+  std::unique_ptr<progress> MakeProgress(const std::filesystem::path &file, int64_t total, bool draw) override {
+    return std::make_unique<line_progress>(file, total, draw);
+  }
+  // Connect returns an idle pooled connection or a new one, through the proxy of client unless target bypasses it
+  std::unique_ptr<connection> Connect(HttpClient &client, const url &target, std::string &key, bool &proxied,
+                                      bool &reused, bela::error_code &ec);
+  void Release(const std::string &key, std::unique_ptr<connection> &&conn) { pool.Put(key, std::move(conn)); }
+
+private:
+  connection_pool pool;
+  tls_contexts tls;
+  std::optional<url> proxy_url(HttpClient &client, const url &target, bela::error_code &ec) const {
+    auto proxy = client.ProxyURL();
+    if (proxy.empty() || client.IsNoProxy(target.host)) {
+      return std::nullopt;
+    }
+    if (proxy.find(L"://") == std::wstring_view::npos) {
+      return crack_url(bela::StringCat(L"http://", proxy), ec);
+    }
+    return crack_url(proxy, ec);
+  }
+  bool tunnel(HttpClient &client, connection &conn, const url &target, bela::error_code &ec);
+};
+
+// tunnel asks an HTTP proxy for a CONNECT tunnel to target, TLS starts on top of it
+bool posix_backend::tunnel(HttpClient &client, connection &conn, const url &target, bela::error_code &ec) {
+  auto authority = host_port(target);
+  auto head = bela::StringCat(L"CONNECT ", authority, L" HTTP/1.1\r\nHost: ", authority, L"\r\nUser-Agent: ",
+                              client.UserAgent(), L"\r\n\r\n");
+  if (!conn.WriteAll(bela::encode_into<wchar_t, char>(head), ec)) {
+    return false;
+  }
+  std::string line;
+  if (!conn.ReadLine(line, ec)) {
+    return false;
+  }
+  auto status = line.size() > 12 ? line.substr(9, 3) : std::string();
+  for (std::string h; conn.ReadLine(h, ec) && !h.empty();) {
+  }
+  if (status.empty() || status[0] != '2') {
+    ec = bela::make_error_code(bela::ErrGeneral, L"proxy CONNECT: ", bela::encode_into<char, wchar_t>(line));
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<connection> posix_backend::Connect(HttpClient &client, const url &target, std::string &key,
+                                                   bool &proxied, bool &reused, bela::error_code &ec) {
+  auto proxy = proxy_url(client, target, ec);
+  if (!proxy && ec) {
+    return nullptr;
+  }
+  if (proxy && proxy->secure) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"HTTPS proxies are not supported: ", client.ProxyURL());
+    return nullptr;
+  }
+  proxied = proxy.has_value();
+  key = bela::encode_into<wchar_t, char>(bela::StringCat(target.secure ? L"https://" : L"http://", host_port(target),
+                                                         client.IsInsecureMode() ? L" insecure" : L"",
+                                                         proxied ? bela::StringCat(L" via ", host_port(*proxy)) : L""));
+  if (auto conn = pool.Take(key); conn) {
+    reused = true;
+    client.DbgPrint(L"Re-using existing connection to %s", host_port(target));
+    return conn;
+  }
+  reused = false;
+  auto conn = proxied ? dial(client, proxy->host, proxy->nPort, ec) : dial(client, target.host, target.nPort, ec);
+  if (!conn) {
+    return nullptr;
+  }
+  if (!target.secure) {
+    return conn;
+  }
+  if (proxied && !tunnel(client, *conn, target, ec)) {
+    return nullptr;
+  }
+  if (!conn->StartTLS(tls.get(client.IsInsecureMode()), bela::encode_into<wchar_t, char>(target.host),
+                      client.IsInsecureMode(), ec)) {
+    return nullptr;
+  }
+  client.DbgPrint(L"SSL connection using %s / %s", bela::encode_into<char, wchar_t>(SSL_get_version(conn->TLS())),
+                  bela::encode_into<char, wchar_t>(SSL_get_cipher_name(conn->TLS())));
+  return conn;
+}
+
+std::string posix_request::make_head(const request_options &opts, size_t body_size, bool proxied) const {
+  std::wstring head;
+  // an HTTP proxy takes the absolute URL, a tunnel and the server itself the path
+  if (proxied && !target.secure) {
+    bela::StrAppend(&head, method, L" http://", host_port(target), target.uri, L" HTTP/1.1\r\n");
+  } else {
+    bela::StrAppend(&head, method, L" ", target.uri, L" HTTP/1.1\r\n");
+  }
+  bela::StrAppend(&head, L"Host: ", host_header(target), L"\r\n");
+  if (opts.headers.find(L"User-Agent") == opts.headers.end()) {
+    bela::StrAppend(&head, L"User-Agent: ", client.UserAgent(), L"\r\n");
+  }
+  for (const auto &[k, v] : opts.headers) {
+    if (!bela::EqualsIgnoreCase(k, L"Host") && !bela::EqualsIgnoreCase(k, L"Content-Length")) {
+      bela::StrAppend(&head, k, L": ", v, L"\r\n");
+    }
+  }
+  // part download
+  if (opts.position > 0 || opts.end > 0) {
+    bela::StrAppend(&head, L"Range: bytes=", opts.position, L"-");
+    if (opts.end > opts.position) {
+      bela::StrAppend(&head, opts.end - 1);
+    }
+    head.append(L"\r\n");
+  }
+  if (!opts.cookies.empty()) {
+    head.append(L"Cookie: ");
+    for (size_t i = 0; i < opts.cookies.size(); i++) {
+      bela::StrAppend(&head, i == 0 ? L"" : L"; ", opts.cookies[i]);
+    }
+    head.append(L"\r\n");
+  }
+  if (client.IsNoCache()) {
+    head.append(L"Cache-Control: no-cache\r\nPragma: no-cache\r\n");
+  }
+  if (body_size != 0) {
+    bela::StrAppend(&head, L"Content-Type: ", opts.content_type.empty() ? L"text/plain" : opts.content_type,
+                    L"\r\nContent-Length: ", body_size, L"\r\n");
+  } else if (method == L"POST" || method == L"PUT" || method == L"PATCH") {
+    head.append(L"Content-Length: 0\r\n");
+  }
+  head.append(L"\r\n");
+  return bela::encode_into<wchar_t, char>(head);
+}
+
+std::optional<minimal_response> posix_request::read_head(bela::error_code &ec) {
+  std::string line;
+  for (;;) {
+    if (!conn->ReadLine(line, ec)) {
+      return std::nullopt;
+    }
+    // HTTP/1.1 200 OK
+    std::string_view sv(line);
+    if (!sv.starts_with("HTTP/1.") || sv.size() < 12 || sv[8] != ' ') {
+      ec = bela::make_error_code(bela::ErrGeneral, L"malformed status line: ", bela::encode_into<char, wchar_t>(sv));
+      return std::nullopt;
+    }
+    unsigned long status_code = 0;
+    if (!bela::SimpleAtoi(sv.substr(9, 3), &status_code)) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"malformed status line: ", bela::encode_into<char, wchar_t>(sv));
+      return std::nullopt;
+    }
+    auto http10 = sv[7] == '0';
+    minimal_response mr{.status_code = status_code,
+                        .version = protocol_version::HTTP11,
+                        .status_text = bela::encode_into<char, wchar_t>(
+                            bela::StripAsciiWhitespace(sv.size() > 12 ? sv.substr(13) : std::string_view{}))};
+    size_t head_size = line.size();
+    for (;;) {
+      if (!conn->ReadLine(line, ec)) {
+        return std::nullopt;
+      }
+      if (line.empty()) {
+        break;
+      }
+      if (head_size += line.size(); head_size > max_header_size) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"response header too large");
+        return std::nullopt;
+      }
+      if (auto colon = line.find(':'); colon != std::string::npos) {
+        std::string_view lv(line);
+        mr.headers.emplace(bela::encode_into<char, wchar_t>(bela::StripAsciiWhitespace(lv.substr(0, colon))),
+                           bela::encode_into<char, wchar_t>(bela::StripAsciiWhitespace(lv.substr(colon + 1))));
+      }
+    }
+    // interim responses come before the final one
+    if (status_code >= 100 && status_code < 200 && status_code != 101) {
+      continue;
+    }
+    keep_alive = !http10;
+    if (auto it = mr.headers.find(L"Connection"); it != mr.headers.end()) {
+      if (bela::StrContains(bela::AsciiStrToLower(it->second), L"close")) {
+        keep_alive = false;
+      } else if (bela::StrContains(bela::AsciiStrToLower(it->second), L"keep-alive")) {
+        keep_alive = true;
+      }
+    }
+    mode = body_mode::close;
+    if (method == L"HEAD" || status_code == 204 || status_code == 304 || status_code < 200) {
+      mode = body_mode::none;
+    } else if (auto it = mr.headers.find(L"Transfer-Encoding"); it != mr.headers.end() &&
+                                                                bela::StrContains(bela::AsciiStrToLower(it->second),
+                                                                                  L"chunked")) {
+      mode = body_mode::chunked;
+      remaining = 0;
+      chunk_seen = false;
+    } else if (auto len = content_length(mr.headers); len >= 0) {
+      mode = body_mode::length;
+      remaining = len;
+    }
+    if (mode == body_mode::close) {
+      keep_alive = false;
+    }
+    if (mode == body_mode::none || (mode == body_mode::length && remaining == 0)) {
+      finish();
+    }
+    return std::make_optional(std::move(mr));
+  }
+}
+
+// exchange sends the request on a pooled or new connection. A pooled connection the server closed meanwhile fails
+// before any response byte, the request is sent once more on a new connection then
+std::optional<minimal_response> posix_request::exchange(const request_options &opts, bela::error_code &ec) {
+  auto body = bela::encode_into<wchar_t, char>(opts.body);
+  for (;;) {
+    bool proxied = false;
+    bool reused = false;
+    if (conn = backend.Connect(client, target, key, proxied, reused, ec); !conn) {
+      return std::nullopt;
+    }
+    auto head = make_head(opts, body.size(), proxied);
+    if (conn->WriteAll(head, ec) && conn->WriteAll(body, ec)) {
+      if (auto mr = read_head(ec); mr || !reused || conn->Received()) {
+        return mr;
+      }
+    } else if (!reused) {
+      return std::nullopt;
+    }
+    client.DbgPrint(L"connection to %s was closed, retrying on a new one", host_port(target));
+    ec.clear();
+  }
+}
+
+// discard_body reads what is left of a short body so its connection can be pooled, large bodies close instead
+bool posix_request::discard_body() {
+  char buffer[16 * 1024];
+  for (int i = 0; i < 4 && conn; i++) {
+    size_t received = 0;
+    bela::error_code ec;
+    if (!Read(buffer, sizeof(buffer), received, ec) || received == 0) {
+      break;
+    }
+  }
+  conn.reset();
+  return true;
+}
+
+std::optional<minimal_response> posix_request::Send(const request_options &opts, bela::error_code &ec) {
+  auto redirected = opts;
+  for (int hops = 0;; hops++) {
+    auto mr = exchange(redirected, ec);
+    if (!mr) {
+      return std::nullopt;
+    }
+    auto status = mr->status_code;
+    auto it = mr->headers.find(L"Location");
+    if ((status != 301 && status != 302 && status != 303 && status != 307 && status != 308) || it == mr->headers.end()) {
+      return mr;
+    }
+    if (hops >= max_redirects) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"stopped after ", max_redirects, L" redirects");
+      return std::nullopt;
+    }
+    auto next = resolve_location(target, it->second, ec);
+    if (!next) {
+      return std::nullopt;
+    }
+    client.DbgPrint(L"Location: %v [following]", it->second);
+    discard_body();
+    // 303 and a redirected POST go on with GET, like browsers and WinHTTP
+    if (status == 303 || ((status == 301 || status == 302) && method == L"POST")) {
+      method = L"GET";
+      redirected.body = {};
+      redirected.content_type = {};
+    }
+    target = *next;
+    location = std::move(next);
+  }
+}
+
+bool posix_request::next_chunk(bela::error_code &ec) {
+  std::string line;
+  // the CRLF after the data of the previous chunk
+  if (chunk_seen && !conn->ReadLine(line, ec)) {
+    return false;
+  }
+  chunk_seen = true;
+  if (!conn->ReadLine(line, ec)) {
+    return false;
+  }
+  auto sv = bela::StripAsciiWhitespace(std::string_view(line).substr(0, line.find(';')));
+  uint64_t size = 0;
+  if (!bela::SimpleHexAtoi(sv, &size) || size > static_cast<uint64_t>(INT64_MAX)) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"malformed chunk size: ", bela::encode_into<char, wchar_t>(line));
+    return false;
+  }
+  if (size == 0) {
+    // trailers end with an empty line
+    do {
+      if (!conn->ReadLine(line, ec)) {
+        return false;
+      }
+    } while (!line.empty());
+    finish();
+    return true;
+  }
+  remaining = static_cast<int64_t>(size);
+  return true;
+}
+
+// finish ends the body, the connection goes back to the pool when the server keeps it open
+void posix_request::finish() {
+  mode = body_mode::none;
+  if (conn && keep_alive) {
+    backend.Release(key, std::move(conn));
+  }
+  conn.reset();
+}
+
+bool posix_request::Read(char *buffer, size_t len, size_t &received, bela::error_code &ec) {
+  received = 0;
+  if (mode == body_mode::chunked && remaining == 0 && !next_chunk(ec)) {
+    return false;
+  }
+  if (mode == body_mode::none || !conn || len == 0) {
+    return true;
+  }
+  if (mode != body_mode::close) {
+    len = static_cast<size_t>((std::min)(static_cast<int64_t>(len), remaining));
+  }
+  auto n = conn->ReadSome(buffer, len, ec);
+  if (n < 0) {
+    return false;
+  }
+  if (n == 0) {
+    if (mode != body_mode::close) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"connection has been disconnected");
+      return false;
+    }
+    finish();
+    return true;
+  }
+  received = static_cast<size_t>(n);
+  if (mode == body_mode::close) {
+    return true;
+  }
+  if (remaining -= n; remaining == 0 && mode == body_mode::length) {
+    finish();
+  }
+  return true;
+}
+
+backend &default_backend() {
+  static posix_backend b;
+  return b;
+}
+
+bool part_file::Open(const std::filesystem::path &p, bela::error_code &ec) {
+  auto h = ::open(p.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (h < 0) {
+    ec = make_errno_code(bela::StringCat(L"open ", p.wstring(), L": "), errno);
+    return false;
+  }
+  fd = h;
+  path = p;
+  return true;
+}
+
+int64_t part_file::Size(bela::error_code &ec) const {
+  struct stat st;
+  if (fstat(static_cast<int>(fd), &st) != 0) {
+    ec = make_errno_code(L"fstat: ", errno);
+    return -1;
+  }
+  return static_cast<int64_t>(st.st_size);
+}
+
+bool part_file::ReadAt(void *buffer, size_t len, int64_t pos, bela::error_code &ec) const {
+  auto p = reinterpret_cast<char *>(buffer);
+  for (size_t done = 0; done < len;) {
+    auto n = pread(static_cast<int>(fd), p + done, len - done, static_cast<off_t>(pos) + static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      ec = make_errno_code(L"pread: ", errno);
+      return false;
+    }
+    if (n == 0) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"short read at ", pos);
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool part_file::WriteAt(const void *data, size_t len, int64_t pos, bela::error_code &ec) {
+  auto p = reinterpret_cast<const char *>(data);
+  for (size_t done = 0; done < len;) {
+    auto n = pwrite(static_cast<int>(fd), p + done, len - done, static_cast<off_t>(pos) + static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      ec = make_errno_code(L"pwrite: ", errno);
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool part_file::Write(const void *data, size_t len, bela::error_code &ec) {
+  auto p = reinterpret_cast<const char *>(data);
+  for (size_t done = 0; done < len;) {
+    auto n = write(static_cast<int>(fd), p + done, len - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      ec = make_errno_code(L"write: ", errno);
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool part_file::Truncate(int64_t size, bela::error_code &ec) {
+  if (ftruncate(static_cast<int>(fd), static_cast<off_t>(size)) != 0) {
+    ec = make_errno_code(L"ftruncate: ", errno);
+    return false;
+  }
+  if (lseek(static_cast<int>(fd), static_cast<off_t>(size), SEEK_SET) < 0) {
+    ec = make_errno_code(L"lseek: ", errno);
+    return false;
+  }
+  return true;
+}
+
+bool part_file::Rename(const std::filesystem::path &target, bela::error_code &ec) {
+  if (::rename(path.c_str(), target.c_str()) != 0) {
+    ec = make_errno_code(bela::StringCat(L"rename ", target.wstring(), L": "), errno);
+    return false;
+  }
+  close(static_cast<int>(fd));
+  fd = invalid_fd;
+  return true;
+}
+
+void part_file::Close() {
+  if (fd == invalid_fd) {
+    return;
+  }
+  if (!keep) {
+    unlink(path.c_str());
+  }
+  close(static_cast<int>(fd));
+  fd = invalid_fd;
+}
+
+} // namespace baulk::net::net_internal
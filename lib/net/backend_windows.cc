@@ -0,0 +1,297 @@
+// Windows backend of HttpClient: WinHTTP sessions, Win32 part files and the console progress bar
+#include <bela/io.hpp>
+#include <baulk/allocate.hpp>
+#include <baulk/indicators.hpp>
+#include "backend.hpp"
+#include "native.hpp"
+
+namespace baulk::net::net_internal {
+
+inline std::optional<std::wstring> query_remote_address(HINTERNET hRequest) {
+  WINHTTP_CONNECTION_INFO coninfo;
+  DWORD dwSize = sizeof(WINHTTP_CONNECTION_INFO);
+  if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_CONNECTION_INFO, &coninfo, &dwSize) != TRUE) {
+    return std::nullopt;
+  }
+  wchar_t addrw[256];
+  if (coninfo.RemoteAddress.ss_family == AF_INET) {
+    auto addr = reinterpret_cast<const struct sockaddr_in *>(&coninfo.RemoteAddress);
+    if (InetNtopW(AF_INET, &addr->sin_addr, addrw, sizeof(addrw) * 2) == nullptr) {
+      return std::nullopt;
+    }
+    return std::make_optional<std::wstring>(addrw);
+  }
+  if (coninfo.RemoteAddress.ss_family == AF_INET6) {
+    auto addr = reinterpret_cast<const struct sockaddr_in6 *>(&coninfo.RemoteAddress);
+    if (InetNtopW(AF_INET6, &addr->sin6_addr, addrw, sizeof(addrw) * 2) == nullptr) {
+      return std::nullopt;
+    }
+    return std::make_optional<std::wstring>(addrw);
+  }
+  return std::nullopt;
+}
+
+inline void connect_trace(HINTERNET hRequest) {
+  WINHTTP_SECURITY_INFO_X si;
+  DWORD dwSize = sizeof(si);
+  if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_SECURITY_INFO, &si, &dwSize) != TRUE) {
+    return;
+  }
+  if ((si.ConnectionInfo.dwProtocol & SP_PROT_TLS1_2_CLIENT) != 0) {
+    bela::FPrintF(stderr, L"\x1b[33m* SSL connection using TLSv1.2 / %s\x1b[0m\n", si.CipherInfo.szCipherSuite);
+  }
+  if ((si.ConnectionInfo.dwProtocol & SP_PROT_TLS1_3_CLIENT) != 0) {
+    bela::FPrintF(stderr, L"\x1b[33m* SSL connection using TLSv1.3 / %s\x1b[0m\n", si.CipherInfo.szCipherSuite);
+  }
+}
+
+void WINAPI status_context_callback(HINTERNET hInternet, DWORD_PTR dwContext, DWORD dwInternetStatus,
+                                    LPVOID lpvStatusInformation, DWORD dwStatusInformationLength) {
+  if (dwContext != 0) {
+    reinterpret_cast<native::status_context *>(dwContext)->status_context_callback(
+        hInternet, dwInternetStatus, lpvStatusInformation, dwStatusInformationLength);
+  }
+}
+
+std::optional<url> crack_url(std::wstring_view us, bela::error_code &ec) { return native::crack_url(us, ec); }
+
+class winhttp_request final : public request {
+public:
+  winhttp_request(HttpClient &client_, const url &u_, native::handle &&h_)
+      : client(client_), u(u_), h(std::move(h_)), sc(client_.IsDebugMode()) {}
+  std::optional<minimal_response> Send(const request_options &opts, bela::error_code &ec) override {
+    if (client.IsInsecureMode()) {
+      h.set_insecure_mode();
+    }
+    if (!h.write_headers(opts.headers, opts.cookies, opts.position, opts.end, ec)) {
+      return std::nullopt;
+    }
+    if (!h.write_body(opts.body, opts.content_type, status_context_callback, sc.addressof(), ec)) {
+      return std::nullopt;
+    }
+    if (client.IsDebugMode()) {
+      if (auto addr = query_remote_address(h.addressof()); addr) {
+        bela::FPrintF(stderr, L"\x1b[33mConnecting to %s (%s) %s|:%d connected.\x1b[0m\n", u.host, u.host, *addr,
+                      u.nPort);
+      }
+      connect_trace(h.addressof());
+    }
+    return h.recv_minimal_response(ec);
+  }
+  bool Read(char *buffer, size_t len, size_t &received, bela::error_code &ec) override {
+    DWORD downloaded_size = 0;
+    if (WinHttpReadData(h.addressof(), buffer, static_cast<DWORD>(len), &downloaded_size) != TRUE) {
+      ec = native::make_net_error_code();
+      return false;
+    }
+    received = downloaded_size;
+    return true;
+  }
+  std::optional<url> Location() const override { return sc.crack_location_url(); }
+
+private:
+  HttpClient &client;
+  url u;
+  native::handle h;
+  native::status_context sc;
+};
+
+class bar_progress final : public progress {
+public:
+  bar_progress(const std::filesystem::path &file, int64_t total, bool draw) {
+    if (total > 0) {
+      bar.Maximum(static_cast<uint64_t>(total));
+    }
+    bar.FileName(file.filename().native());
+    if (draw) {
+      bar.Execute();
+    }
+  }
+  void Update(int64_t current) override { bar.Update(static_cast<uint64_t>(current)); }
+  void MarkFault() override { bar.MarkFault(); }
+  void MarkCompleted() override { bar.MarkCompleted(); }
+  void Finish() override { bar.Finish(); }
+
+private:
+  baulk::ProgressBar bar;
+};
+
+class winhttp_backend final : public backend {
+public:
+  std::unique_ptr<request> Open(HttpClient &client, const url &u, std::wstring_view method, bool multiplexing,
+                                bela::error_code &ec) override {
+    auto proxy = client.IsNoProxy(u.host) ? std::wstring_view{} : client.ProxyURL();
+    auto conn = pool.connect(client.UserAgent(), proxy, multiplexing, u.host, u.nPort, ec);
+    if (conn == nullptr) {
+      return nullptr;
+    }
+    DWORD flags = u.secure ? WINHTTP_FLAG_SECURE : 0;
+    if (client.IsNoCache()) {
+      flags |= WINHTTP_FLAG_REFRESH;
+    }
+    auto h = conn->open_request(method, u.uri, flags, ec);
+    if (!h) {
+      return nullptr;
+    }
+    return std::make_unique<winhttp_request>(client, u, std::move(*h));
+  }
+  std::unique_ptr<progress> MakeProgress(const std::filesystem::path &file, int64_t total, bool draw) override {
+    return std::make_unique<bar_progress>(file, total, draw);
+  }
+
+private:
+  // sessions and connections live for the whole process, see native::session_pool
+  native::session_pool pool;
+};
+
+backend &default_backend() {
+  static winhttp_backend b;
+  return b;
+}
+
+inline HANDLE native_handle(intptr_t fd) { return reinterpret_cast<HANDLE>(fd); }
+
+struct _File_disposition_info_ex {
+  DWORD _Flags;
+};
+
+inline bool disposition_file_handle(HANDLE fd) {
+  _File_disposition_info_ex _Info_ex{0x3};
+
+  // FileDispositionInfoEx isn't documented in MSDN at the time of this writing, but is present
+  // in minwinbase.h as of at least 10.0.16299.0
+  constexpr auto _FileDispositionInfoExClass = static_cast<FILE_INFO_BY_HANDLE_CLASS>(21);
+  if (SetFileInformationByHandle(fd, _FileDispositionInfoExClass, &_Info_ex, sizeof(_Info_ex))) {
+    return true;
+  }
+  auto ec = bela::make_system_error_code(L"SetFileInformationByHandle() ");
+
+  switch (ec.code) {
+  case ERROR_INVALID_PARAMETER: // Older Windows versions
+    [[fallthrough]];
+  case ERROR_INVALID_FUNCTION: // Windows 10 1607
+    [[fallthrough]];
+  case ERROR_NOT_SUPPORTED: // POSIX delete not supported by the file system
+    break;                  // try non-POSIX delete below
+  case ERROR_ACCESS_DENIED: // This might be due to the read-only bit, try to clear it and try again
+    [[fallthrough]];
+  default:
+    bela::FPrintF(stderr, L"Disposition: %s\n", ec);
+    return false;
+  }
+
+  FILE_DISPOSITION_INFO _Info{/* .Delete= */ TRUE};
+  if (SetFileInformationByHandle(fd, FileDispositionInfo, &_Info, sizeof(_Info))) {
+    return true;
+  }
+  return false;
+}
+
+bool part_file::Open(const std::filesystem::path &p, bela::error_code &ec) {
+  // https://devblogs.microsoft.com/oldnewthing/20170310-00/?p=95705
+  auto h = ::CreateFileW(p.c_str(), FILE_GENERIC_READ | FILE_GENERIC_WRITE | GENERIC_READ | GENERIC_WRITE | DELETE,
+                         FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                         nullptr);
+  if (h == INVALID_HANDLE_VALUE) {
+    ec = bela::make_system_error_code();
+    return false;
+  }
+  fd = reinterpret_cast<intptr_t>(h);
+  path = p;
+  return true;
+}
+
+int64_t part_file::Size(bela::error_code &ec) const { return bela::io::Size(native_handle(fd), ec); }
+
+bool part_file::ReadAt(void *buffer, size_t len, int64_t pos, bela::error_code &ec) const {
+  OVERLAPPED o{};
+  o.Offset = static_cast<DWORD>(pos);
+  o.OffsetHigh = static_cast<DWORD>(pos >> 32);
+  DWORD dwSize = 0;
+  if (::ReadFile(native_handle(fd), buffer, static_cast<DWORD>(len), &dwSize, &o) != TRUE) {
+    ec = bela::make_system_error_code(L"ReadFile() ");
+    return false;
+  }
+  if (dwSize != len) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"short read at ", pos);
+    return false;
+  }
+  return true;
+}
+
+bool part_file::WriteAt(const void *data, size_t len, int64_t pos, bela::error_code &ec) {
+  auto u8d = reinterpret_cast<const uint8_t *>(data);
+  for (size_t written = 0; written < len;) {
+    auto offset = pos + static_cast<int64_t>(written);
+    OVERLAPPED o{};
+    o.Offset = static_cast<DWORD>(offset);
+    o.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD dwSize = 0;
+    if (::WriteFile(native_handle(fd), u8d + written, static_cast<DWORD>(len - written), &dwSize, &o) != TRUE) {
+      ec = bela::make_system_error_code(L"WriteFile() ");
+      return false;
+    }
+    written += dwSize;
+  }
+  return true;
+}
+
+bool part_file::Write(const void *data, size_t len, bela::error_code &ec) {
+  auto u8d = reinterpret_cast<const uint8_t *>(data);
+  for (size_t written = 0; written < len;) {
+    DWORD dwSize = 0;
+    if (::WriteFile(native_handle(fd), u8d + written, static_cast<DWORD>(len - written), &dwSize, nullptr) != TRUE) {
+      ec = bela::make_system_error_code(L"WriteFile() ");
+      return false;
+    }
+    written += dwSize;
+  }
+  return true;
+}
+
+bool part_file::Truncate(int64_t size, bela::error_code &ec) {
+  if (!bela::io::Seek(native_handle(fd), size, ec)) {
+    return false;
+  }
+  if (SetEndOfFile(native_handle(fd)) != TRUE) {
+    ec = bela::make_system_error_code(L"SetEndOfFile() ");
+    return false;
+  }
+  return true;
+}
+
+bool part_file::Rename(const std::filesystem::path &target, bela::error_code &ec) {
+  const auto &nativePath = target.native();
+  auto roSize = sizeof(FILE_RENAME_INFO) + (nativePath.size() + 1) * sizeof(wchar_t);
+  auto renameOptions = baulk::mem::make_unique_variable<FILE_RENAME_INFO>(roSize);
+  if (!renameOptions) {
+    ec = bela::make_error_code(L"allocate failed");
+    return false;
+  }
+  renameOptions->ReplaceIfExists = TRUE;
+  renameOptions->RootDirectory = nullptr;
+  renameOptions->FileNameLength = static_cast<DWORD>((nativePath.size() + 1) * sizeof(wchar_t));
+  memcpy(renameOptions->FileName, nativePath.data(), nativePath.size() * sizeof(wchar_t));
+  renameOptions->FileName[nativePath.size()] = 0;
+  if (SetFileInformationByHandle(native_handle(fd), FileRenameInfo, renameOptions.get(), static_cast<DWORD>(roSize)) !=
+      TRUE) {
+    ec = bela::make_system_error_code(L"SetFileInformationByHandle");
+    return false;
+  }
+  CloseHandle(native_handle(fd));
+  fd = invalid_fd;
+  return true;
+}
+
+void part_file::Close() {
+  if (fd == invalid_fd) {
+    return;
+  }
+  if (!keep) {
+    disposition_file_handle(native_handle(fd));
+  }
+  CloseHandle(native_handle(fd));
+  fd = invalid_fd;
+}
+
+} // namespace baulk::net::net_internal
@@ -1,49 +1,32 @@
 //
-#include <bela/env.hpp>
 #include <baulk/net/client.hpp>
-#include <baulk/indicators.hpp>
-#include "native.hpp"
+#include "backend.hpp"
 #include "file.hpp"
+#include "decoder.hpp"
+#include "ring.hpp"
+#include "scheduler.hpp"
+#include <mutex>
+#include <thread>
+#if defined(_WIN32)
+#include <bela/env.hpp>
+#else
+#include <cerrno>
+#include <cstdlib>
+#endif
 
 namespace baulk::net {
-
-inline std::optional<std::wstring> query_remote_address(HINTERNET hRequest) {
-  WINHTTP_CONNECTION_INFO coninfo;
-  DWORD dwSize = sizeof(WINHTTP_CONNECTION_INFO);
-  if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_CONNECTION_INFO, &coninfo, &dwSize) != TRUE) {
-    return std::nullopt;
-  }
-  wchar_t addrw[256];
-  if (coninfo.RemoteAddress.ss_family == AF_INET) {
-    auto addr = reinterpret_cast<const struct sockaddr_in *>(&coninfo.RemoteAddress);
-    if (InetNtopW(AF_INET, &addr->sin_addr, addrw, sizeof(addrw) * 2) == nullptr) {
-      return std::nullopt;
-    }
-    return std::make_optional<std::wstring>(addrw);
-  }
-  if (coninfo.RemoteAddress.ss_family == AF_INET6) {
-    auto addr = reinterpret_cast<const struct sockaddr_in6 *>(&coninfo.RemoteAddress);
-    if (InetNtopW(AF_INET6, &addr->sin6_addr, addrw, sizeof(addrw) * 2) == nullptr) {
-      return std::nullopt;
-    }
-    return std::make_optional<std::wstring>(addrw);
-  }
-  return std::nullopt;
-}
-
-void connect_trace(HINTERNET hRequest) {
-  WINHTTP_SECURITY_INFO_X si;
-  DWORD dwSize = sizeof(si);
-  if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_SECURITY_INFO, &si, &dwSize) != TRUE) {
-    return;
-  }
-  if ((si.ConnectionInfo.dwProtocol & SP_PROT_TLS1_2_CLIENT) != 0) {
-    bela::FPrintF(stderr, L"\x1b[33m* SSL connection using TLSv1.2 / %s\x1b[0m\n", si.CipherInfo.szCipherSuite);
-  }
-  if ((si.ConnectionInfo.dwProtocol & SP_PROT_TLS1_3_CLIENT) != 0) {
-    bela::FPrintF(stderr, L"\x1b[33m* SSL connection using TLSv1.3 / %s\x1b[0m\n", si.CipherInfo.szCipherSuite);
-  }
+#if defined(_WIN32)
+constexpr long file_exists_error = ERROR_FILE_EXISTS;
+inline std::wstring get_env(std::wstring_view key) { return bela::GetEnv(key); }
+#else
+constexpr long file_exists_error = EEXIST;
+inline std::wstring get_env(std::wstring_view key) {
+  if (auto value = getenv(bela::encode_into<wchar_t, char>(key).data()); value != nullptr) {
+    return bela::encode_into<char, wchar_t>(value);
+  }
+  return L"";
 }
+#endif
 
 void response_trace(minimal_response &resp) {
   int color = 31;
@@ -67,7 +50,6 @@ void response_trace(minimal_response &resp) {
   }
 }
 
-using baulk::net::native::make_net_error_code;
 bool HttpClient::IsNoProxy(std::wstring_view host) const {
   for (const auto &u : noProxy) {
     if (bela::EqualsIgnoreCase(u, host)) {
@@ -78,66 +60,147 @@ bool HttpClient::IsNoProxy(std::wstring_view host) const {
 }
 
 bool HttpClient::InitializeProxyFromEnv() {
-  if (auto noProxyURL = bela::GetEnv(L"NO_PROXY"); noProxyURL.empty()) {
+  if (auto noProxyURL = get_env(L"NO_PROXY"); !noProxyURL.empty()) {
     noProxy = bela::StrSplit(noProxyURL, bela::ByChar(L','), bela::SkipEmpty());
   }
-  if (proxyURL = bela::GetEnv(L"HTTPS_PROXY"); !proxyURL.empty()) {
+  if (proxyURL = get_env(L"HTTPS_PROXY"); !proxyURL.empty()) {
     return true;
   }
-  if (proxyURL = bela::GetEnv(L"HTTP_PROXY"); !proxyURL.empty()) {
+  if (proxyURL = get_env(L"HTTP_PROXY"); !proxyURL.empty()) {
     return true;
   }
-  if (proxyURL = bela::GetEnv(L"ALL_PROXY"); !proxyURL.empty()) {
+  if (proxyURL = get_env(L"ALL_PROXY"); !proxyURL.empty()) {
     return true;
   }
   return true;
 }
 
-std::optional<Response> HttpClient::WinRest(std::wstring_view method, std::wstring_view url,
-                                            std::wstring_view content_type, std::wstring_view body,
-                                            bela::error_code &ec) {
-  auto u = native::crack_url(url, ec);
-  if (!u) {
-    return std::nullopt;
+namespace net_internal {
+// recv_decoded decodes a compressed body as it arrives, the decoder writes into buffer directly
+int64_t recv_decoded(request &req, content_decoder &decoder, std::vector<char> &buffer, size_t max_body_size,
+                     bela::error_code &ec) {
+  std::vector<char> chunk(64 * 1024);
+  size_t size = 0;
+  size_t received = 0;
+  for (;;) {
+    size_t downloaded_size = 0;
+    if (!req.Read(chunk.data(), chunk.size(), downloaded_size, ec)) {
+      return -1;
+    }
+    if (downloaded_size == 0) {
+      break;
+    }
+    received += downloaded_size;
+    if (!decoder.Decode(chunk.data(), downloaded_size, buffer, size, max_body_size, ec)) {
+      return -1;
+    }
   }
-  auto session = native::make_session(userAgent, ec);
-  if (!session) {
-    return std::nullopt;
+  if (received != 0 && !decoder.Finished()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"compressed response body is truncated");
+    return -1;
   }
-  if (!IsNoProxy(u->host)) {
-    session->set_proxy_url(proxyURL);
+  return static_cast<int64_t>(size);
+}
+
+// recv_stream hands the body to reader as it arrives, a decoder reuses one output buffer for every chunk
+bool recv_stream(request &req, content_decoder *decoder, const body_reader &reader, size_t max_body_size,
+                 bela::error_code &ec) {
+  std::vector<char> chunk(64 * 1024);
+  std::vector<char> decoded;
+  size_t received = 0;
+  for (;;) {
+    size_t downloaded_size = 0;
+    if (!req.Read(chunk.data(), chunk.size(), downloaded_size, ec)) {
+      return false;
+    }
+    if (downloaded_size == 0) {
+      break;
+    }
+    received += downloaded_size;
+    std::string_view data{chunk.data(), downloaded_size};
+    if (decoder != nullptr) {
+      size_t size = 0;
+      if (!decoder->Decode(chunk.data(), downloaded_size, decoded, size, max_body_size, ec)) {
+        return false;
+      }
+      data = std::string_view{decoded.data(), size};
+    }
+    if (!data.empty() && !reader(data)) {
+      return true;
+    }
   }
-  session->protocol_enable();
-  auto conn = session->connect(u->host, u->nPort, ec);
-  if (!conn) {
+  if (decoder != nullptr && received != 0 && !decoder->Finished()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"compressed response body is truncated");
+    return false;
+  }
+  return true;
+}
+
+// recv_completely reads a body without Content-Encoding, len is its Content-Length or -1 when unknown
+int64_t recv_completely(request &req, int64_t len, std::vector<char> &buffer, size_t max_body_size,
+                        bela::error_code &ec) {
+  if (len == 0) {
+    return 0;
+  }
+  auto limit = max_body_size;
+  if (len > 0) {
+    limit = static_cast<size_t>((std::min)(static_cast<uint64_t>(max_body_size), static_cast<uint64_t>(len)));
+  }
+  buffer.resize(len > 0 ? limit : (std::min)(limit, static_cast<size_t>(256 * 1024)));
+  size_t size = 0;
+  while (size < limit) {
+    if (size == buffer.size()) {
+      buffer.resize((std::min)(limit, buffer.size() * 2));
+    }
+    size_t received = 0;
+    if (!req.Read(buffer.data() + size, buffer.size() - size, received, ec)) {
+      return -1;
+    }
+    if (received == 0) {
+      break;
+    }
+    size += received;
+  }
+  return static_cast<int64_t>(size);
+}
+} // namespace net_internal
+
+std::optional<Response> HttpClient::WinRest(std::wstring_view method, std::wstring_view url,
+                                            std::wstring_view content_type, std::wstring_view body,
+                                            const headers_t &headers, bela::error_code &ec) {
+  return RestRequest(method, url, content_type, body, headers, body_reader{}, ec);
+}
+
+std::optional<Response> HttpClient::WinStream(std::wstring_view url, const headers_t &headers,
+                                              const body_reader &reader, bela::error_code &ec) {
+  return RestRequest(L"GET", url, L"", L"", headers, reader, ec);
+}
+
+std::optional<Response> HttpClient::RestRequest(std::wstring_view method, std::wstring_view url,
+                                                std::wstring_view content_type, std::wstring_view body,
+                                                const headers_t &headers, const body_reader &reader,
+                                                bela::error_code &ec) {
+  auto u = net_internal::crack_url(url, ec);
+  if (!u) {
     return std::nullopt;
   }
-  auto flags = u->TlsFlag();
+  auto slot = net_internal::transfer_scheduler::Instance().Acquire(u->host, net_internal::transfer_priority::metadata);
   if (noCache) {
     DbgPrint(L"Indicates that the request should be forwarded to the originating server");
-    flags |= WINHTTP_FLAG_REFRESH;
   }
-  auto req = conn->open_request(method, u->uri, flags, ec);
+  auto req = net_internal::default_backend().Open(*this, *u, method, true, ec);
   if (!req) {
     return std::nullopt;
   }
-  if (insecureMode) {
-    req->set_insecure_mode();
-  }
-  if (!req->write_headers(hkv, cookies, 0, 0, ec)) {
-    return std::nullopt;
-  }
-  if (!req->write_body(body, content_type, ec)) {
-    return std::nullopt;
+  headers_t merged;
+  merged.emplace(L"Accept-Encoding", net_internal::accept_encoding);
+  for (const auto &[k, v] : hkv) {
+    merged[k] = v;
   }
-  if (debugMode) {
-    if (auto addr = query_remote_address(req->addressof()); addr) {
-      bela::FPrintF(stderr, L"\x1b[33mConnecting to %s (%s) %s|:%d connected.\x1b[0m\n", u->host, u->host, *addr,
-                    u->nPort);
-    }
-    connect_trace(req->addressof());
+  for (const auto &[k, v] : headers) {
+    merged[k] = v;
   }
-  auto mr = req->recv_minimal_response(ec);
+  auto mr = req->Send({.headers = merged, .cookies = cookies, .body = body, .content_type = content_type}, ec);
   if (!mr) {
     return std::nullopt;
   }
@@ -146,14 +209,32 @@ std::optional<Response> HttpClient::WinRest(std::wstring_view method, std::wstri
   }
   std::vector<char> buffer;
   int64_t recv_size = -1;
-  auto content_length = native::content_length(mr->headers);
-  if (recv_size = req->recv_completely(content_length, buffer, max_body_size, ec); recv_size < 0) {
+  std::unique_ptr<net_internal::content_decoder> decoder;
+  if (auto it = mr->headers.find(L"Content-Encoding"); it != mr->headers.end()) {
+    if (decoder = net_internal::make_content_decoder(it->second, ec); !decoder && ec) {
+      return std::nullopt;
+    }
+  }
+  if (reader && mr->status_code >= 200 && mr->status_code < 300) {
+    // a reader that stops early leaves the body unread, the connection is closed instead of pooled
+    if (!net_internal::recv_stream(*req, decoder.get(), reader, max_body_size, ec)) {
+      return std::nullopt;
+    }
+    return std::make_optional<Response>(std::move(*mr), std::vector<char>{}, 0);
+  }
+  if (decoder) {
+    recv_size = net_internal::recv_decoded(*req, *decoder, buffer, max_body_size, ec);
+  } else {
+    recv_size = net_internal::recv_completely(*req, net_internal::content_length(mr->headers), buffer, max_body_size,
+                                              ec);
+  }
+  if (recv_size < 0) {
     return std::nullopt;
   }
   return std::make_optional<Response>(std::move(*mr), std::move(buffer), static_cast<size_t>(recv_size));
 }
 
-inline std::filesystem::path make_destination(const download_options &opts, const baulk::net::native::url &u) {
+inline std::filesystem::path make_destination(const download_options &opts, const net_internal::url &u) {
   if (!opts.destination.empty()) {
     return opts.destination;
   }
@@ -173,86 +254,197 @@ inline bool make_destination_decorous(std::filesystem::path &destination, bool f
   auto parent = destination.parent_path();
   auto ext = destination.extension();
   for (int i = 1; i < 100; i++) {
-    if (auto newPath = parent / bela::StringCat(filename.native(), L"-(", i, L")", ext.native());
+    if (auto newPath = parent / bela::StringCat(filename.wstring(), L"-(", i, L")", ext.wstring());
         !std::filesystem::exists(newPath, e)) {
       destination = std::move(newPath);
       return true;
     }
   }
-  ec = bela::make_error_code(ERROR_FILE_EXISTS, L"'", destination, L"' already exists");
+  ec = bela::make_error_code(file_exists_error, L"'", destination.wstring(), L"' already exists");
   return false;
 }
 
-void WINAPI status_context_callback(HINTERNET hInternet, DWORD_PTR dwContext, DWORD dwInternetStatus,
-                                    LPVOID lpvStatusInformation, DWORD dwStatusInformationLength) {
-  if (dwContext != 0) {
-    reinterpret_cast<native::status_context *>(dwContext)->status_context_callback(
-        hInternet, dwInternetStatus, lpvStatusInformation, dwStatusInformationLength);
+namespace net_internal {
+// segments smaller than this are not worth another connection
+constexpr int64_t segment_min_size = 4 * 1024 * 1024;
+
+// shared by the connections of a segmented download, FilePart and the first error are guarded by mu. FilePart
+// releases mu while it hashes
+struct segment_context {
+  url u;
+  FilePart &filePart;
+  const std::function<void(int64_t)> &report;
+  std::mutex mu;
+  std::atomic_bool failed{false};
+  bela::error_code ec;
+  void fail(const bela::error_code &e) {
+    std::lock_guard lock(mu);
+    if (!failed.exchange(true)) {
+      ec = e;
+    }
   }
+};
+
+inline size_t segments_count(int64_t total_size, uint32_t connections) {
+  return static_cast<size_t>((std::min)(static_cast<int64_t>(connections), total_size / segment_min_size));
 }
 
-std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, const download_options &opts,
-                                                        bela::error_code &ec) {
-  auto u = native::crack_url(url, ec);
-  if (!u) {
-    return std::nullopt;
+// first_unfinished_segment: the range a resumed download requests on its first connection
+inline size_t first_unfinished_segment(const FilePart &filePart) {
+  const auto &segments = filePart.Segments();
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (segments[i].Remaining() != 0) {
+      return i;
+    }
   }
-  auto session = native::make_session(userAgent, ec);
-  if (!session) {
-    return std::nullopt;
+  return segments.size();
+}
+
+// fill_slot reads into a ring buffer without asking for the available size first, it hands the buffer over once
+// it is full, the response ended (eof) or batch_interval passed. Returns false on a read error
+bool fill_slot(request &req, char *buffer, size_t limit, size_t &filled, bool &eof, bela::error_code &ec) {
+  auto begin = std::chrono::steady_clock::now();
+  filled = 0;
+  eof = false;
+  while (filled < limit) {
+    size_t downloaded_size = 0;
+    if (!req.Read(buffer + filled, limit - filled, downloaded_size, ec)) {
+      return false;
+    }
+    if (downloaded_size == 0) {
+      eof = true;
+      return true;
+    }
+    filled += downloaded_size;
+    transfer_scheduler::Instance().Throttle(downloaded_size);
+    if (std::chrono::steady_clock::now() - begin >= receive_ring::batch_interval) {
+      break;
+    }
+  }
+  return true;
+}
+
+// recv_segment reads a response into its segment until the segment is full, only this thread advances it.
+// The segment is written from a ring while the next buffer is received
+bool recv_segment(request &req, segment_context &sc, size_t index) {
+  receive_ring ring(
+      [&](const char *data, size_t bytes, bela::error_code &ec) {
+        std::unique_lock lock(sc.mu);
+        if (!sc.filePart.WriteSegment(index, data, bytes, lock, ec)) {
+          return false;
+        }
+        sc.report(sc.filePart.CurrentBytes());
+        return true;
+      },
+      2);
+  // only this thread advances the segment, what is left is counted here while the writer catches up
+  auto remaining = sc.filePart.Segments()[index].Remaining();
+  bela::error_code ec;
+  while (remaining > 0 && !sc.failed) {
+    auto buffer = ring.Acquire();
+    if (buffer == nullptr) {
+      break;
+    }
+    auto limit = static_cast<size_t>((std::min)(remaining, static_cast<int64_t>(receive_ring::slot_size)));
+    size_t filled = 0;
+    bool eof = false;
+    auto ok = fill_slot(req, buffer, limit, filled, eof, ec);
+    // data that arrived before a failure is still written, a resumed download starts after it
+    ring.Commit(filled);
+    remaining -= static_cast<int64_t>(filled);
+    if (!ok) {
+      sc.fail(ec);
+      break;
+    }
+    if (eof && remaining > 0) {
+      sc.fail(bela::make_error_code(bela::ErrGeneral, L"segment ", index, L" connection has been disconnected"));
+      break;
+    }
+  }
+  if (!ring.Finish(ec)) {
+    sc.fail(ec);
+    return false;
+  }
+  return !sc.failed;
+}
+} // namespace net_internal
+
+// RecvSegment fetches the unwritten rest of a segment on a connection of its own
+bool HttpClient::RecvSegment(net_internal::segment_context &sc, size_t index) {
+  bela::error_code ec;
+  auto fail = [&]() {
+    sc.fail(ec);
+    return false;
+  };
+  auto slot = net_internal::transfer_scheduler::Instance().Acquire(sc.u.host, net_internal::transfer_priority::archive);
+  auto req = net_internal::default_backend().Open(*this, sc.u, L"GET", false, ec);
+  if (!req) {
+    return fail();
+  }
+  const auto &seg = sc.filePart.Segments()[index];
+  auto position = seg.start + seg.done;
+  auto mr = req->Send({.headers = hkv, .cookies = cookies, .position = position, .end = seg.end}, ec);
+  if (!mr) {
+    return fail();
   }
-  if (!IsNoProxy(u->host)) {
-    session->set_proxy_url(proxyURL);
+  if (mr->status_code != 206 || net_internal::content_length(mr->headers) != seg.end - position) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"segment ", index, L" bytes ", position, L"-", seg.end - 1,
+                               L" response: ", mr->status_code, L" status: ", mr->status_text);
+    return fail();
   }
-  session->protocol_enable();
-  auto conn = session->connect(u->host, u->nPort, ec);
-  if (!conn) {
+  DbgPrint(L"%s segment %d bytes: %d-%d", sc.u.filename, index, position, seg.end - 1);
+  return net_internal::recv_segment(*req, sc, index);
+}
+
+std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, const download_options &opts,
+                                                        bela::error_code &ec) {
+  auto u = net_internal::crack_url(url, ec);
+  if (!u) {
     return std::nullopt;
   }
-  auto flags = u->TlsFlag();
+  auto slot = net_internal::transfer_scheduler::Instance().Acquire(u->host, net_internal::transfer_priority::archive);
   if (noCache) {
     DbgPrint(L"Indicates that the request should be forwarded to the originating server");
-    flags |= WINHTTP_FLAG_REFRESH;
   }
-  auto req = conn->open_request(L"GET", u->uri, flags, ec);
+  auto req = net_internal::default_backend().Open(*this, *u, L"GET", true, ec);
   if (!req) {
     return std::nullopt;
   }
-  if (insecureMode) {
-    req->set_insecure_mode();
-  }
   auto destination = make_destination(opts, *u);
   auto filePart = net_internal::FilePart::MakeFilePart(destination, opts.hash_value, ec);
   if (!filePart) {
     return std::nullopt;
   }
-  // detect part download
-  if (!req->write_headers(hkv, cookies, filePart->CurrentBytes(), filePart->FileSize(), ec)) {
-    return std::nullopt;
-  }
-  native::status_context sc(debugMode);
-  if (!req->write_body(L"", L"", status_context_callback, sc.addressof(), ec)) {
-    return std::nullopt;
-  }
-  if (debugMode) {
-    if (auto addr = query_remote_address(req->addressof()); addr) {
-      bela::FPrintF(stderr, L"\x1b[33mConnecting to %s (%s) %s|:%d connected.\x1b[0m\n", u->host, u->host, *addr,
-                    u->nPort);
+  // detect part download, a segmented part resumes its first unfinished range on this request
+  auto range_start = filePart->CurrentBytes();
+  auto range_end = filePart->FileSize();
+  auto first_segment = net_internal::first_unfinished_segment(*filePart);
+  if (filePart->Segmented()) {
+    range_start = 0;
+    range_end = 0;
+    if (first_segment < filePart->Segments().size()) {
+      const auto &seg = filePart->Segments()[first_segment];
+      range_start = seg.start + seg.done;
+      range_end = seg.end;
     }
-    connect_trace(req->addressof());
   }
-  auto mr = req->recv_minimal_response(ec);
+  auto merged = hkv;
+  for (const auto &[k, v] : opts.headers) {
+    merged[k] = v;
+  }
+  auto mr = req->Send({.headers = merged, .cookies = cookies, .position = range_start, .end = range_end}, ec);
   if (!mr) {
     return std::nullopt;
   }
   if (debugMode) {
     response_trace(*mr);
   }
-  if (auto nu = sc.crack_location_url(); nu) {
-    destination = opts.cwd / nu->filename;
+  auto location = req->Location();
+  if (location) {
+    destination = opts.cwd / location->filename;
   }
   if (opts.destination.empty()) {
-    if (auto dispositionName = native::extract_filename(mr->headers); dispositionName) {
+    if (auto dispositionName = net_internal::extract_filename(mr->headers); dispositionName) {
       DbgPrint(L"filename from 'Content-Disposition': %v", *dispositionName);
       destination = opts.cwd / *dispositionName;
     }
@@ -262,8 +454,8 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
   }
   filePart->RenameTo(destination);
 
-  int64_t total_size = native::content_length(mr->headers);
-  bool part_support = !opts.hash_value.empty() && native::enable_part_download(mr->headers) && total_size > 0;
+  int64_t total_size = net_internal::content_length(mr->headers);
+  bool part_support = !opts.hash_value.empty() && net_internal::enable_part_download(mr->headers) && total_size > 0;
   DbgPrint(L"%s support part download: %v", u->filename, part_support);
   if (!mr->IsSuccessStatusCode()) {
     ec = bela::make_error_code(bela::ErrGeneral, L"response: ", mr->status_code, L" status: ", mr->status_text);
@@ -273,23 +465,41 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
     if (!filePart->Truncated(ec)) {
       return std::nullopt;
     }
+    first_segment = 0;
     // else:  // part download support
+  } else if (filePart->Segmented()) {
+    if (total_size != range_end - range_start) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"unexpected range response length ", total_size);
+      return std::nullopt;
+    }
+    total_size = filePart->FileSize();
+    DbgPrint(L"%s resume %d segments from bytes: %d", u->filename, filePart->Segments().size(),
+             filePart->CurrentBytes());
   } else {
     total_size += filePart->CurrentBytes();
     DbgPrint(L"%s download from bytes: %d", u->filename, filePart->CurrentBytes());
   }
-  // Pare progress bar
-  baulk::ProgressBar bar;
-  if (total_size > 0) {
-    bar.Maximum(static_cast<uint64_t>(total_size));
+  // split a complete response into ranges, this response fills the first of them
+  if (auto count = net_internal::segments_count(total_size, opts.connections);
+      part_support && mr->status_code != 206 && count > 1) {
+    if (!filePart->Preallocate(total_size, count, ec)) {
+      return std::nullopt;
+    }
+    DbgPrint(L"%s download in %d segments", u->filename, filePart->Segments().size());
   }
-  bar.FileName(destination.filename().native());
-  bar.Execute();
+  // Pare progress bar
+  auto bar = net_internal::default_backend().MakeProgress(destination, total_size, !opts.progress);
   auto finish = bela::finally([&] {
     // finish progressbar
-    bar.Finish();
+    bar->Finish();
   });
   int64_t current_bytes = filePart->CurrentBytes();
+  const std::function<void(int64_t)> report = [&](int64_t current) {
+    bar->Update(current);
+    if (opts.progress) {
+      opts.progress(current, (std::max)(total_size, static_cast<int64_t>(0)));
+    }
+  };
 
   auto save_part_overlay = [&] {
     if (!part_support) {
@@ -299,41 +509,85 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
     filePart->SaveOverlayData(opts.hash_value, total_size, current_bytes, discard_ec);
     DbgPrint(L"%s download broken for bytes: %d-%d", u->filename, current_bytes, total_size);
   };
-  // recv data
-  std::vector<char> buffer;
-  buffer.reserve(64 * 1024);
-  DWORD dwSize = 0;
-  do {
-    DWORD downloaded_size = 0;
-    if (WinHttpQueryDataAvailable(req->addressof(), &dwSize) != TRUE) {
-      ec = bela::make_system_error_code();
+  if (filePart->Segmented()) {
+    net_internal::segment_context ctx{
+        .u = location.value_or(*u), .filePart = *filePart, .report = report};
+    std::vector<std::thread> workers;
+    for (size_t i = first_segment + 1; i < filePart->Segments().size(); i++) {
+      if (filePart->Segments()[i].Remaining() != 0) {
+        workers.emplace_back([&, i] { RecvSegment(ctx, i); });
+      }
+    }
+    net_internal::recv_segment(*req, ctx, first_segment);
+    // the first range is done, drop its connection instead of draining the rest of a complete response
+    req.reset();
+    slot.Release();
+    for (auto &w : workers) {
+      w.join();
+    }
+    current_bytes = filePart->CurrentBytes();
+    if (ctx.failed) {
+      ec = std::move(ctx.ec);
       save_part_overlay();
-      bar.MarkFault();
+      bar->MarkFault();
+      bar->MarkCompleted();
       return std::nullopt;
     }
-    if (buffer.size() < dwSize) {
-      buffer.resize(static_cast<size_t>(dwSize) * 2);
+  } else {
+    // recv data, the file is written and hashed from a ring while the next buffer is received
+    int64_t written_bytes = current_bytes;
+    net_internal::receive_ring ring([&](const char *data, size_t bytes, bela::error_code &wec) {
+      if (!filePart->Write(data, bytes, wec)) {
+        return false;
+      }
+      written_bytes += static_cast<int64_t>(bytes);
+      report(written_bytes);
+      return true;
+    });
+    bool received = true;
+    for (;;) {
+      auto buffer = ring.Acquire();
+      if (buffer == nullptr) {
+        break;
+      }
+      size_t filled = 0;
+      bool eof = false;
+      received = net_internal::fill_slot(*req, buffer, net_internal::receive_ring::slot_size, filled, eof, ec);
+      ring.Commit(filled);
+      if (!received || eof) {
+        break;
+      }
+    }
+    bela::error_code wec;
+    auto written = ring.Finish(wec);
+    current_bytes = written_bytes;
+    if (!written) {
+      ec = std::move(wec);
+      bar->MarkFault();
+      return std::nullopt;
     }
-    if (WinHttpReadData(req->addressof(), (LPVOID)buffer.data(), dwSize, &downloaded_size) != TRUE) {
-      ec = make_net_error_code();
+    if (!received) {
       save_part_overlay();
-      bar.MarkFault();
+      bar->MarkFault();
       return std::nullopt;
     }
-    filePart->WriteFull(buffer.data(), static_cast<size_t>(downloaded_size), ec);
-    current_bytes += dwSize;
-    bar.Update(current_bytes);
-  } while (dwSize > 0);
+  }
 
   if (total_size != 0 && current_bytes < total_size) {
-    bar.MarkFault();
-    bar.MarkCompleted();
+    bar->MarkFault();
+    bar->MarkCompleted();
     ec = bela::make_error_code(bela::ErrGeneral, L"connection has been disconnected");
     save_part_overlay();
     return std::nullopt;
   }
+  // the data was hashed as it arrived, a mismatched file is discarded with the part
+  if (!filePart->Verify(ec)) {
+    bar->MarkFault();
+    bar->MarkCompleted();
+    return std::nullopt;
+  }
   filePart->Solidified(ec);
-  bar.MarkCompleted();
+  bar->MarkCompleted();
   return std::make_optional(std::move(destination));
 }
 } // namespace baulk::net
\ No newline at end of file
@@ -0,0 +1,192 @@
+// Content-Encoding decoders for response bodies
+#include <bela/ascii.hpp>
+#include <bela/match.hpp>
+#include <bela/strip.hpp>
+#include <baulk/allocate.hpp>
+#include "decoder.hpp"
+#define ZSTD_STATIC_LINKING_ONLY 1
+#include <zstd.h>
+#include <brotli/decode.h>
+#include <zlib.h>
+
+namespace baulk::net::net_internal {
+constexpr size_t grow_step = 64 * 1024;
+
+// reserve makes room behind size, doubling the body so the decoded text is never copied more than log(n) times
+inline bool reserve(std::vector<char> &body, size_t size, size_t limit, bela::error_code &ec) {
+  if (body.size() > size) {
+    return true;
+  }
+  if (size >= limit) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"decoded response body exceeds ", limit, L" bytes");
+    return false;
+  }
+  body.resize((std::min)((std::max)(size * 2, size + grow_step), limit));
+  return true;
+}
+
+class zstd_decoder : public content_decoder {
+public:
+  zstd_decoder(ZSTD_DCtx *dctx_) : dctx(dctx_) {}
+  zstd_decoder(const zstd_decoder &) = delete;
+  zstd_decoder &operator=(const zstd_decoder &) = delete;
+  ~zstd_decoder() { ZSTD_freeDCtx(dctx); }
+  bool Decode(const char *input, size_t len, std::vector<char> &body, size_t &size, size_t limit,
+              bela::error_code &ec) override {
+    ZSTD_inBuffer in{input, len, 0};
+    for (;;) {
+      if (!reserve(body, size, limit, ec)) {
+        return false;
+      }
+      ZSTD_outBuffer out{body.data() + size, body.size() - size, 0};
+      auto result = ZSTD_decompressStream(dctx, &out, &in);
+      if (ZSTD_isError(result) != 0) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"ZSTD_decompressStream: ",
+                                   bela::encode_into<char, wchar_t>(ZSTD_getErrorName(result)));
+        return false;
+      }
+      size += out.pos;
+      finished = result == 0;
+      // a full output buffer may leave decoded data inside the context
+      if (in.pos == in.size && out.pos < out.size) {
+        return true;
+      }
+    }
+  }
+
+private:
+  ZSTD_DCtx *dctx{nullptr};
+};
+
+class brotli_decoder : public content_decoder {
+public:
+  brotli_decoder(BrotliDecoderState *state_) : state(state_) {}
+  brotli_decoder(const brotli_decoder &) = delete;
+  brotli_decoder &operator=(const brotli_decoder &) = delete;
+  ~brotli_decoder() { BrotliDecoderDestroyInstance(state); }
+  bool Decode(const char *input, size_t len, std::vector<char> &body, size_t &size, size_t limit,
+              bela::error_code &ec) override {
+    auto next_in = reinterpret_cast<const uint8_t *>(input);
+    auto avail_in = len;
+    for (;;) {
+      if (!reserve(body, size, limit, ec)) {
+        return false;
+      }
+      auto next_out = reinterpret_cast<uint8_t *>(body.data() + size);
+      auto avail_out = body.size() - size;
+      auto result = BrotliDecoderDecompressStream(state, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+      size = body.size() - avail_out;
+      switch (result) {
+      case BROTLI_DECODER_RESULT_ERROR:
+        ec = bela::make_error_code(
+            bela::ErrGeneral, L"BrotliDecoderDecompressStream: ",
+            bela::encode_into<char, wchar_t>(BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state))));
+        return false;
+      case BROTLI_DECODER_RESULT_SUCCESS:
+        finished = true;
+        return true;
+      case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+        return true;
+      default:
+        break;
+      }
+    }
+  }
+
+private:
+  BrotliDecoderState *state{nullptr};
+};
+
+// gzip_decoder: inflate detects the gzip or zlib header by itself
+class gzip_decoder : public content_decoder {
+public:
+  gzip_decoder() = default;
+  gzip_decoder(const gzip_decoder &) = delete;
+  gzip_decoder &operator=(const gzip_decoder &) = delete;
+  ~gzip_decoder() {
+    if (initialized) {
+      inflateEnd(&zs);
+    }
+  }
+  bool Initialize(bela::error_code &ec) {
+    zs.zalloc = baulk::mem::allocate_zlib;
+    zs.zfree = baulk::mem::deallocate_simple;
+    if (auto zerr = inflateInit2(&zs, MAX_WBITS + 32); zerr != Z_OK) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"inflateInit2: ", bela::encode_into<char, wchar_t>(zError(zerr)));
+      return false;
+    }
+    initialized = true;
+    return true;
+  }
+  bool Decode(const char *input, size_t len, std::vector<char> &body, size_t &size, size_t limit,
+              bela::error_code &ec) override {
+    if (finished) {
+      return true;
+    }
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input));
+    zs.avail_in = static_cast<uInt>(len);
+    for (;;) {
+      if (!reserve(body, size, limit, ec)) {
+        return false;
+      }
+      auto avail = static_cast<uInt>((std::min)(body.size() - size, static_cast<size_t>(UINT32_MAX)));
+      zs.next_out = reinterpret_cast<Bytef *>(body.data() + size);
+      zs.avail_out = avail;
+      auto ret = ::inflate(&zs, Z_NO_FLUSH);
+      size += avail - zs.avail_out;
+      if (ret == Z_STREAM_END) {
+        finished = true;
+        return true;
+      }
+      if (ret == Z_BUF_ERROR && zs.avail_in == 0) {
+        return true;
+      }
+      if (ret != Z_OK) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"inflate: ", bela::encode_into<char, wchar_t>(zError(ret)));
+        return false;
+      }
+      if (zs.avail_in == 0 && zs.avail_out != 0) {
+        return true;
+      }
+    }
+  }
+
+private:
+  z_stream zs{};
+  bool initialized{false};
+};
+
+std::unique_ptr<content_decoder> make_content_decoder(std::wstring_view encoding, bela::error_code &ec) {
+  encoding = bela::StripAsciiWhitespace(encoding);
+  if (encoding.empty() || bela::EqualsIgnoreCase(encoding, L"identity")) {
+    return nullptr;
+  }
+  if (bela::EqualsIgnoreCase(encoding, L"zstd")) {
+    auto dctx = ZSTD_createDCtx_advanced(ZSTD_customMem{
+        .customAlloc = baulk::mem::allocate_simple, .customFree = baulk::mem::deallocate_simple, .opaque = nullptr});
+    if (dctx == nullptr) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"ZSTD_createDCtx() out of memory");
+      return nullptr;
+    }
+    return std::make_unique<zstd_decoder>(dctx);
+  }
+  if (bela::EqualsIgnoreCase(encoding, L"br")) {
+    auto state = BrotliDecoderCreateInstance(baulk::mem::allocate_simple, baulk::mem::deallocate_simple, nullptr);
+    if (state == nullptr) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"BrotliDecoderCreateInstance failed");
+      return nullptr;
+    }
+    return std::make_unique<brotli_decoder>(state);
+  }
+  if (bela::EqualsIgnoreCase(encoding, L"gzip") || bela::EqualsIgnoreCase(encoding, L"x-gzip") ||
+      bela::EqualsIgnoreCase(encoding, L"deflate")) {
+    auto d = std::make_unique<gzip_decoder>();
+    if (!d->Initialize(ec)) {
+      return nullptr;
+    }
+    return d;
+  }
+  ec = bela::make_error_code(bela::ErrGeneral, L"unsupported Content-Encoding: ", encoding);
+  return nullptr;
+}
+} // namespace baulk::net::net_internal
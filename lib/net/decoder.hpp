@@ -0,0 +1,30 @@
+///
+#ifndef BAULK_NET_DECODER_HPP
+#define BAULK_NET_DECODER_HPP
+#include <bela/base.hpp>
+#include <memory>
+#include <vector>
+
+namespace baulk::net::net_internal {
+// sent with metadata requests, archives are already compressed and must keep their byte ranges
+constexpr std::wstring_view accept_encoding = L"zstd, br, gzip";
+
+// content_decoder: streaming Content-Encoding decoder, output goes straight into the growing response body
+class content_decoder {
+public:
+  virtual ~content_decoder() = default;
+  // Decode appends what input decodes to at body[size], body grows up to limit bytes
+  virtual bool Decode(const char *input, size_t len, std::vector<char> &body, size_t &size, size_t limit,
+                      bela::error_code &ec) = 0;
+  // Finished reports the end of the compressed stream was seen
+  bool Finished() const { return finished; }
+
+protected:
+  bool finished{false};
+};
+
+// make_content_decoder returns nullptr without error for identity or an empty encoding
+std::unique_ptr<content_decoder> make_content_decoder(std::wstring_view encoding, bela::error_code &ec);
+} // namespace baulk::net::net_internal
+
+#endif
@@ -1,12 +1,14 @@
 //
 #include <bela/base.hpp>
-#include <bela/path.hpp>
 #include <bela/time.hpp>
 #include <bela/ascii.hpp>
-#include <bela/io.hpp>
+#include <bela/hash.hpp>
+#include <bela/match.hpp>
 #include <filesystem>
-#include <baulk/allocate.hpp>
+#include <mutex>
+#include <variant>
 #include <baulk/net/types.hpp>
+#include "backend.hpp"
 
 namespace baulk::net::net_internal {
 enum class hash_t : uint16_t {
@@ -24,8 +26,17 @@ enum class hash_t : uint16_t {
 };
 
 constexpr std::wstring_view part_suffix = L".part";
-constexpr uint8_t part_magic[] = {'P', 'A', 'R', 'T'};
+// part file: data | hasher state (state_size) | segments (segment_count) | part_overlay_data
+// a single stream keeps current_bytes of data, a segmented download keeps total_bytes with unwritten holes
+constexpr uint8_t part_magic[] = {'P', 'A', 'R', '4'};
 #pragma pack(push, 1)
+// part_segment: range [start, end) of a segmented download, done bytes are written from start
+struct part_segment {
+  int64_t start{0};
+  int64_t end{0};
+  int64_t done{0};
+  int64_t Remaining() const { return end - start - done; }
+};
 struct part_overlay_data {
   uint8_t magic[4];
   hash_t method{hash_t::NONE};
@@ -34,6 +45,10 @@ struct part_overlay_data {
   int64_t total_bytes{0};
   int64_t current_bytes{0};
   int64_t laste_time{0};
+  uint32_t state_size{0};
+  uint64_t state_checksum{0}; // state_checksum of the hasher state
+  int64_t hashed_bytes{0};    // data prefix covered by the hasher state
+  uint32_t segment_count{0};
 };
 #pragma pack(pop)
 
@@ -55,6 +70,105 @@ constexpr HashPrefix hnmaps[] = {
     {L"SHA3", hash_t::SHA3, 32},         // SHA3 alias for SHA3-256
 };
 
+// part_hasher hashes the part file while it is written, its state is kept in the overlay to resume hashing
+class part_hasher {
+public:
+  bool Initialize(hash_t method) {
+    switch (method) {
+    case hash_t::SHA224:
+      h.emplace<bela::hash::sha256::Hasher>().Initialize(bela::hash::sha256::HashBits::SHA224);
+      return true;
+    case hash_t::SHA256:
+      h.emplace<bela::hash::sha256::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA384:
+      h.emplace<bela::hash::sha512::Hasher>().Initialize(bela::hash::sha512::HashBits::SHA384);
+      return true;
+    case hash_t::SHA512:
+      h.emplace<bela::hash::sha512::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA3_224:
+      h.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3224);
+      return true;
+    case hash_t::SHA3:
+      [[fallthrough]];
+    case hash_t::SHA3_256:
+      h.emplace<bela::hash::sha3::Hasher>().Initialize();
+      return true;
+    case hash_t::SHA3_384:
+      h.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3384);
+      return true;
+    case hash_t::SHA3_512:
+      h.emplace<bela::hash::sha3::Hasher>().Initialize(bela::hash::sha3::HashBits::SHA3512);
+      return true;
+    case hash_t::BLAKE3:
+      h.emplace<bela::hash::blake3::Hasher>().Initialize();
+      return true;
+    default:
+      break;
+    }
+    h.emplace<std::monostate>();
+    return false;
+  }
+  bool Enabled() const { return !std::holds_alternative<std::monostate>(h); }
+  void Update(const void *data, size_t len) {
+    std::visit(
+        [&](auto &x) {
+          if constexpr (!std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) {
+            x.Update(data, len);
+          }
+        },
+        h);
+  }
+  std::wstring Finalize() {
+    return std::visit(
+        [](auto &x) -> std::wstring {
+          if constexpr (!std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) {
+            return x.Finalize();
+          } else {
+            return L"";
+          }
+        },
+        h);
+  }
+  size_t StateSize() const {
+    return std::visit(
+        [](const auto &x) -> size_t {
+          if constexpr (!std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) {
+            return bela::hash::StateSize<std::decay_t<decltype(x)>>();
+          } else {
+            return 0;
+          }
+        },
+        h);
+  }
+  void ExportState(uint8_t *out) const {
+    std::visit(
+        [&](const auto &x) {
+          if constexpr (!std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) {
+            bela::hash::ExportState(x, out);
+          }
+        },
+        h);
+  }
+  bool ImportState(const uint8_t *state, size_t len) {
+    return std::visit(
+        [&](auto &x) -> bool {
+          if constexpr (!std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) {
+            return bela::hash::ImportState(x, state, len);
+          } else {
+            return false;
+          }
+        },
+        h);
+  }
+
+private:
+  std::variant<std::monostate, bela::hash::sha256::Hasher, bela::hash::sha512::Hasher, bela::hash::sha3::Hasher,
+               bela::hash::blake3::Hasher>
+      h;
+};
+
 inline bool hash_construct(std::wstring_view hash_value, part_overlay_data &overlay_data, bela::error_code &ec) {
   std::wstring_view value = hash_value;
   overlay_data.method = hash_t::SHA256;
@@ -85,81 +199,113 @@ inline bool hash_construct(std::wstring_view hash_value, part_overlay_data &over
   return true;
 }
 
-struct _File_disposition_info_ex {
-  DWORD _Flags;
-};
-
-inline bool disposition_file_handle(HANDLE fd) {
-  _File_disposition_info_ex _Info_ex{0x3};
-
-  // FileDispositionInfoEx isn't documented in MSDN at the time of this writing, but is present
-  // in minwinbase.h as of at least 10.0.16299.0
-  constexpr auto _FileDispositionInfoExClass = static_cast<FILE_INFO_BY_HANDLE_CLASS>(21);
-  if (SetFileInformationByHandle(reinterpret_cast<HANDLE>(fd), _FileDispositionInfoExClass, &_Info_ex,
-                                 sizeof(_Info_ex))) {
-    return true;
-  }
-  auto ec = bela::make_system_error_code(L"SetFileInformationByHandle() ");
-
-  switch (ec.code) {
-  case ERROR_INVALID_PARAMETER: // Older Windows versions
-    [[fallthrough]];
-  case ERROR_INVALID_FUNCTION: // Windows 10 1607
-    [[fallthrough]];
-  case ERROR_NOT_SUPPORTED: // POSIX delete not supported by the file system
-    break;                  // try non-POSIX delete below
-  case ERROR_ACCESS_DENIED: // This might be due to the read-only bit, try to clear it and try again
-    [[fallthrough]];
-  default:
-    bela::FPrintF(stderr, L"Disposition: %s\n", ec);
-    return false;
-  }
-
-  FILE_DISPOSITION_INFO _Info{/* .Delete= */ TRUE};
-  if (SetFileInformationByHandle(reinterpret_cast<HANDLE>(fd), FileDispositionInfo, &_Info, sizeof(_Info))) {
-    return true;
-  }
-  return false;
-}
-
-inline void cleanup_close_file(HANDLE fd) {
-  disposition_file_handle(fd);
-  CloseHandle(fd);
+// state_checksum: the first 8 bytes of the SHA-256 of a hasher state, a damaged state is not imported
+inline uint64_t state_checksum(const uint8_t *state, size_t len) {
+  bela::hash::sha256::Hasher h;
+  h.Initialize();
+  h.Update(state, len);
+  uint8_t digest[bela::hash::sha256::sha256_hash_size];
+  h.Finalize(digest, sizeof(digest));
+  uint64_t sum = 0;
+  memcpy(&sum, digest, sizeof(sum));
+  return sum;
 }
 
-inline bool truncated_file(HANDLE fd, int64_t pos, bela::error_code &ec) {
-  if (!bela::io::Seek(fd, pos, ec)) {
-    return false;
+// resume_hasher imports the hasher state saved after the data. A state that fails its checksum or the limits of the
+// hasher is dropped, the first hashed_bytes are hashed again from zero
+inline bool resume_hasher(const part_file &file, part_hasher &h, hash_t method, int64_t hashed_bytes,
+                          int64_t state_offset, uint32_t state_size, uint64_t checksum, bela::error_code &ec) {
+  std::vector<uint8_t> buffer((std::max)(static_cast<size_t>(state_size), static_cast<size_t>(64 * 1024)));
+  if (state_size != 0) {
+    if (file.ReadAt(buffer.data(), state_size, state_offset, ec) &&
+        state_checksum(buffer.data(), state_size) == checksum && h.ImportState(buffer.data(), state_size)) {
+      return true;
+    }
+    h.Initialize(method);
   }
-  if (SetEndOfFile(fd) != TRUE) {
-    ec = bela::make_system_error_code(L"SetEndOfFile() ");
-    return false;
+  for (int64_t offset = 0; offset < hashed_bytes;) {
+    auto len = static_cast<size_t>((std::min)(static_cast<int64_t>(buffer.size()), hashed_bytes - offset));
+    if (!file.ReadAt(buffer.data(), len, offset, ec)) {
+      return false;
+    }
+    h.Update(buffer.data(), len);
+    offset += static_cast<int64_t>(len);
   }
   return true;
 }
 
+// part_resume: state of an interrupted download read back from the overlay
+struct part_resume {
+  part_hasher hasher;
+  int64_t hashed_bytes{0};
+  std::vector<part_segment> segments;
+};
+
+// segments are aligned so that every range but the last is a whole number of MiB
+constexpr int64_t segment_alignment = 1024 * 1024;
+
 class FilePart {
 public:
-  FilePart(HANDLE fd_, const std::filesystem::path &fsPath_, int64_t total_bytes_, int64_t current_bytes_,
-           int64_t recent_)
-      : fd(fd_), fsPath(fsPath_), total_bytes(total_bytes_), current_bytes(current_bytes_), laste_time(recent_) {}
+  FilePart(part_file &&file_, const std::filesystem::path &fsPath_, int64_t total_bytes_, int64_t current_bytes_,
+           int64_t recent_, hash_t method_ = hash_t::NONE, std::wstring_view hash_value = L"",
+           const part_resume *resumed = nullptr)
+      : file(std::move(file_)), fsPath(fsPath_), total_bytes(total_bytes_), current_bytes(current_bytes_),
+        laste_time(recent_), hashed_bytes(current_bytes_), method(method_) {
+    if (resumed != nullptr) {
+      segments = resumed->segments;
+      hashed_bytes = resumed->hashed_bytes;
+    }
+    if (!hasher.Initialize(method)) {
+      return;
+    }
+    auto pos = hash_value.find(':');
+    expected = pos == std::wstring_view::npos ? hash_value : hash_value.substr(pos + 1);
+    if (resumed != nullptr) {
+      hasher = resumed->hasher;
+    }
+  }
   FilePart(const FilePart &) = delete;
   FilePart &operator=(const FilePart &) = delete;
-  ~FilePart() noexcept { file_discard(); }
+  // the part file is deleted unless SaveOverlayData kept it or Solidified renamed it
+  ~FilePart() noexcept = default;
   void RenameTo(const std::filesystem::path &newPath) { fsPath = newPath; }
   auto FileSize() const { return total_bytes; }
   auto CurrentBytes() const { return current_bytes; }
   auto LasteTime() const { return bela::FromUnixSeconds(laste_time); }
+  // Verifiable: the data is hashed while it is written, Verify needs no extra read
+  bool Verifiable() const { return hasher.Enabled(); }
+  bool Segmented() const { return !segments.empty(); }
+  const auto &Segments() const { return segments; }
   bool Truncated(bela::error_code &ec) {
-    if (!truncated_file(fd, 0, ec)) {
+    if (!file.Truncate(0, ec)) {
       return false;
     }
     current_bytes = 0;
     total_bytes = 0;
+    hashed_bytes = 0;
+    segments.clear();
+    hasher.Initialize(method);
+    return true;
+  }
+  // Preallocate sizes an empty part to total bytes and splits it into at most count ranges
+  bool Preallocate(int64_t total, size_t count, bela::error_code &ec) {
+    if (current_bytes != 0 || total <= 0 || count == 0) {
+      ec = bela::make_error_code(L"FilePart cannot be segmented");
+      return false;
+    }
+    if (!file.Truncate(total, ec)) {
+      return false;
+    }
+    auto chunk = (total / static_cast<int64_t>(count) + segment_alignment - 1) / segment_alignment * segment_alignment;
+    segments.clear();
+    for (int64_t start = 0; start < total; start += chunk) {
+      segments.emplace_back(part_segment{.start = start, .end = (std::min)(start + chunk, total), .done = 0});
+    }
+    total_bytes = total;
     return true;
   }
   bool SaveOverlayData(std::wstring_view hash_value, int64_t total_bytes, int64_t current_bytes, bela::error_code &ec) {
-    if (!discard_file_handle) {
+    if (kept) {
       ec = bela::make_error_code(L"FilePart not a discard file");
       return false;
     }
@@ -167,105 +313,126 @@ public:
       ec = bela::make_error_code(L"Current download not support part download");
       return false;
     }
+    auto data_end = Segmented() ? total_bytes : current_bytes;
     auto now = bela::Now();
     part_overlay_data overlay_data{
-        .magic = {'P', 'A', 'R', 'T'},
+        .magic = {0},
         .method = hash_t::NONE,
         .hashsz = {0},
         .hash = {0},
         .total_bytes = total_bytes,
         .current_bytes = current_bytes,
         .laste_time = bela::ToUnixSeconds(now),
+        .state_size = 0,
+        .state_checksum = 0,
+        .hashed_bytes = hashed_bytes,
+        .segment_count = static_cast<uint32_t>(segments.size()),
     };
+    memcpy(overlay_data.magic, part_magic, sizeof(part_magic));
     if (!hash_construct(hash_value, overlay_data, ec)) {
       return false;
     }
-    if (auto fileSize = bela::io::Size(fd, ec); fileSize != current_bytes) {
+    if (auto fileSize = file.Size(ec); fileSize != data_end) {
       ec = bela::make_error_code(L"FilePart size not equal current_bytes size");
       return false;
     }
-    if (!bela::io::Seek(fd, current_bytes, ec)) {
+    // hasher state | segments | overlay after the data
+    auto offset = data_end;
+    auto append = [&](const void *data, size_t bytes) {
+      if (!file.WriteAt(data, bytes, offset, ec)) {
+        return false;
+      }
+      offset += static_cast<int64_t>(bytes);
+      return true;
+    };
+    if (overlay_data.method == method && hasher.Enabled()) {
+      std::vector<uint8_t> state(hasher.StateSize());
+      hasher.ExportState(state.data());
+      if (!append(state.data(), state.size())) {
+        return false;
+      }
+      overlay_data.state_size = static_cast<uint32_t>(state.size());
+      overlay_data.state_checksum = state_checksum(state.data(), state.size());
+    }
+    if (!segments.empty() && !append(segments.data(), segments.size() * sizeof(part_segment))) {
       return false;
     }
-    if (!WriteFull(overlay_data, ec)) {
+    if (!append(&overlay_data, sizeof(overlay_data))) {
       return false;
     }
-    discard_file_handle = false;
+    file.Keep();
+    kept = true;
     return true;
   }
 
-  template <typename T> bool WriteFull(const T &t, bela::error_code &ec) { return WriteFull(&t, sizeof(t), ec); }
-  bool WriteFull(const void *data, size_t bytes, bela::error_code &ec) {
-    auto len = static_cast<DWORD>(bytes);
-    auto u8d = reinterpret_cast<const uint8_t *>(data);
-    DWORD writtenBytes = 0;
-    do {
-      DWORD dwSize = 0;
-      if (WriteFile(fd, u8d + writtenBytes, len - writtenBytes, &dwSize, nullptr) != TRUE) {
-        ec = bela::make_system_error_code(L"WriteFile() ");
-        return false;
-      }
-      writtenBytes += dwSize;
-    } while (writtenBytes < len);
+  // Write appends downloaded data and feeds it to the hasher
+  bool Write(const void *data, size_t bytes, bela::error_code &ec) {
+    if (!file.Write(data, bytes, ec)) {
+      return false;
+    }
+    hasher.Update(data, bytes);
+    hashed_bytes += static_cast<int64_t>(bytes);
     return true;
   }
-  // solidified
-  bool Solidified(bela::error_code &ec) {
-    if (fd == INVALID_HANDLE_VALUE) {
-      ec = bela::make_error_code(L"FilePart is invalid");
+  // WriteSegment stores data at the end of the written range of a segment, callers hold lock.
+  // The hasher follows the contiguous prefix: data written at the hash cursor is hashed from memory, ranges that
+  // arrived ahead of it are read back once the segments before them are complete. Hashing runs with lock released,
+  // the writer that takes the cursor keeps it until the prefix is caught up, the others only write
+  bool WriteSegment(size_t index, const void *data, size_t bytes, std::unique_lock<std::mutex> &lock,
+                    bela::error_code &ec) {
+    auto &seg = segments[index];
+    auto pos = seg.start + seg.done;
+    if (static_cast<int64_t>(bytes) > seg.Remaining()) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"segment ", index, L" overflow");
+      return false;
+    }
+    if (!file.WriteAt(data, bytes, pos, ec)) {
       return false;
     }
-    const auto &nativePath = fsPath.native();
-    auto roSize = sizeof(FILE_RENAME_INFO) + (nativePath.size() + 1) * sizeof(wchar_t);
-    auto renameOptions = baulk::mem::make_unique_variable<FILE_RENAME_INFO>(roSize);
-    if (!renameOptions) {
-      ec = bela::make_error_code(L"allocate failed");
+    seg.done += static_cast<int64_t>(bytes);
+    current_bytes += static_cast<int64_t>(bytes);
+    if (!hasher.Enabled() || hashing) {
+      return true;
+    }
+    if (pos == hashed_bytes) {
+      hashing = true;
+      lock.unlock();
+      hasher.Update(data, bytes);
+      lock.lock();
+      hashing = false;
+      hashed_bytes += static_cast<int64_t>(bytes);
+    }
+    return hash_contiguous(&lock, ec);
+  }
+  // Verify compares the digest of everything written with the expected hash
+  bool Verify(bela::error_code &ec) {
+    if (!hasher.Enabled()) {
+      return true;
+    }
+    if (Segmented() && (!hash_contiguous(nullptr, ec) || hashed_bytes != total_bytes)) {
+      if (!ec) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"segmented download incomplete at ", hashed_bytes);
+      }
       return false;
     }
-    renameOptions->ReplaceIfExists = TRUE;
-    renameOptions->RootDirectory = nullptr;
-    renameOptions->FileNameLength = static_cast<DWORD>((nativePath.size() + 1) * sizeof(wchar_t));
-    memcpy(renameOptions->FileName, nativePath.data(), nativePath.size() * sizeof(wchar_t));
-    renameOptions->FileName[nativePath.size()] = 0;
-    if (SetFileInformationByHandle(fd, FileRenameInfo, renameOptions.get(), static_cast<DWORD>(roSize)) != TRUE) {
-      ec = bela::make_system_error_code(L"SetFileInformationByHandle");
+    auto hv = hasher.Finalize();
+    if (!bela::EndsWithIgnoreCase(hv, expected)) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"checksum mismatch expected ", expected, L" actual ", hv);
       return false;
     }
-    CloseHandle(fd);
-    fd = INVALID_HANDLE_VALUE;
     return true;
   }
+  // solidified
+  bool Solidified(bela::error_code &ec) {
+    if (!file.Valid()) {
+      ec = bela::make_error_code(L"FilePart is invalid");
+      return false;
+    }
+    return file.Rename(fsPath, ec);
+  }
 
   static std::optional<FilePart> MakeFilePart(const std::filesystem::path &p, std::wstring_view hash_value,
                                               bela::error_code &ec) {
-    std::error_code e;
-    auto fsPath = std::filesystem::absolute(p, e);
-    auto part = bela::StringCat(fsPath.native(), part_suffix);
-    // https://devblogs.microsoft.com/oldnewthing/20170310-00/?p=95705
-    auto fd = ::CreateFileW(part.data(), FILE_GENERIC_READ | FILE_GENERIC_WRITE | GENERIC_READ | GENERIC_WRITE | DELETE,
-                            FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                            nullptr);
-    if (fd == INVALID_HANDLE_VALUE) {
-      ec = bela::make_system_error_code();
-      return std::nullopt;
-    }
-    auto fileSize = bela::io::Size(fd, ec);
-    if (fileSize == -1) {
-      cleanup_close_file(fd);
-      return std::nullopt;
-    }
-    auto local_truncated = [&]() -> bool {
-      if (fileSize == 0) {
-        return true;
-      }
-      return truncated_file(fd, 0, ec);
-    };
-    if (fileSize <= static_cast<int64_t>(sizeof(part_overlay_data)) || hash_value.empty()) {
-      if (!local_truncated()) {
-        return std::nullopt;
-      }
-      return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
-    }
     part_overlay_data overlayInput{
         .magic = {0},
         .method = hash_t::NONE,
@@ -274,12 +441,34 @@ public:
         .total_bytes = 0,
         .current_bytes = 0,
         .laste_time = 0,
+        .state_size = 0,
+        .state_checksum = 0,
+        .hashed_bytes = 0,
+        .segment_count = 0,
     };
-    if (!hash_construct(hash_value, overlayInput, ec)) {
-      if (!local_truncated()) {
+    if (!hash_value.empty() && !hash_construct(hash_value, overlayInput, ec)) {
+      return std::nullopt;
+    }
+    std::error_code e;
+    auto fsPath = std::filesystem::absolute(p, e);
+    auto part = fsPath;
+    part += part_suffix;
+    part_file file;
+    if (!file.Open(part, ec)) {
+      return std::nullopt;
+    }
+    auto fileSize = file.Size(ec);
+    if (fileSize == -1) {
+      return std::nullopt;
+    }
+    auto local_truncated = [&]() -> std::optional<FilePart> {
+      if (fileSize != 0 && !file.Truncate(0, ec)) {
         return std::nullopt;
       }
-      return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
+      return std::make_optional<FilePart>(std::move(file), fsPath, 0, 0, 0, overlayInput.method, hash_value);
+    };
+    if (fileSize <= static_cast<int64_t>(sizeof(part_overlay_data)) || hash_value.empty()) {
+      return local_truncated();
     }
     auto seekTo = fileSize - static_cast<int64_t>(sizeof(part_overlay_data));
     part_overlay_data overlayDisk{
@@ -290,43 +479,119 @@ public:
         .total_bytes = 0,
         .current_bytes = 0,
         .laste_time = 0,
+        .state_size = 0,
+        .state_checksum = 0,
+        .hashed_bytes = 0,
+        .segment_count = 0,
     };
-    size_t outSize = 0;
-    if (!bela::io::ReadAt(fd, &overlayDisk, sizeof(overlayDisk), seekTo, outSize, ec)) {
-      if (!local_truncated()) {
-        return std::nullopt;
-      }
-      return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
+    if (!file.ReadAt(&overlayDisk, sizeof(overlayDisk), seekTo, ec)) {
+      return local_truncated();
     }
+    auto data_end = overlayDisk.segment_count != 0 ? overlayDisk.total_bytes : overlayDisk.current_bytes;
+    auto table_size = static_cast<int64_t>(overlayDisk.segment_count) * static_cast<int64_t>(sizeof(part_segment));
     if (!bytes_equal(overlayDisk.magic, part_magic) || !bytes_equal(overlayInput.hash, overlayDisk.hash) ||
-        overlayDisk.method != overlayInput.method || overlayDisk.hashsz != overlayInput.hashsz) {
-      if (!local_truncated()) {
-        return std::nullopt;
+        overlayDisk.method != overlayInput.method || overlayDisk.hashsz != overlayInput.hashsz ||
+        overlayDisk.hashed_bytes < 0 || overlayDisk.hashed_bytes > overlayDisk.current_bytes ||
+        data_end + static_cast<int64_t>(overlayDisk.state_size) + table_size != seekTo) {
+      return local_truncated();
+    }
+    part_resume resumed{.hashed_bytes = overlayDisk.hashed_bytes};
+    if (overlayDisk.segment_count != 0) {
+      resumed.segments.resize(overlayDisk.segment_count);
+      if (!file.ReadAt(resumed.segments.data(), static_cast<size_t>(table_size),
+                       data_end + static_cast<int64_t>(overlayDisk.state_size), ec) ||
+          !segments_valid(resumed.segments, overlayDisk.total_bytes, overlayDisk.current_bytes)) {
+        return local_truncated();
       }
-      return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
     }
-    if (!truncated_file(fd, seekTo, ec)) {
+    if (resumed.hasher.Initialize(overlayInput.method) &&
+        !resume_hasher(file, resumed.hasher, overlayInput.method, overlayDisk.hashed_bytes, data_end,
+                       overlayDisk.state_size, overlayDisk.state_checksum, ec)) {
+      // the downloaded bytes cannot be hashed again, start over
+      return local_truncated();
+    }
+    if (!file.Truncate(data_end, ec)) {
       return std::nullopt;
     }
     // current_bytes part found
-    return std::make_optional<FilePart>(fd, fsPath, overlayDisk.total_bytes, overlayDisk.current_bytes,
-                                        overlayDisk.laste_time);
+    return std::make_optional<FilePart>(std::move(file), fsPath, overlayDisk.total_bytes, overlayDisk.current_bytes,
+                                        overlayDisk.laste_time, overlayInput.method, hash_value, &resumed);
   }
 
 private:
-  HANDLE fd{INVALID_HANDLE_VALUE};
+  part_file file;
   std::filesystem::path fsPath;
   int64_t total_bytes{0};
   int64_t current_bytes{0};
   int64_t laste_time{0};
-  bool discard_file_handle{true};
-  void file_discard() noexcept {
-    if (fd != INVALID_HANDLE_VALUE) {
-      if (discard_file_handle) {
-        disposition_file_handle(fd);
+  int64_t hashed_bytes{0};
+  bool kept{false}; // the overlay was saved, the part file stays for a resume
+  hash_t method{hash_t::NONE};
+  part_hasher hasher;
+  std::wstring expected;
+  std::vector<part_segment> segments;
+  bool hashing{false}; // a segment writer owns the hasher and hashes without the lock
+  // segments_valid: ranges cover [0, total) in order and their written bytes add up to current
+  static bool segments_valid(const std::vector<part_segment> &segs, int64_t total, int64_t current) {
+    int64_t next = 0;
+    int64_t done = 0;
+    for (const auto &s : segs) {
+      if (s.start != next || s.end <= s.start || s.done < 0 || s.Remaining() < 0) {
+        return false;
       }
-      CloseHandle(fd);
+      next = s.end;
+      done += s.done;
     }
+    return next == total && done == current;
+  }
+  // contiguous_end: end of the written prefix of a segmented download
+  int64_t contiguous_end() const {
+    int64_t end = 0;
+    for (const auto &s : segments) {
+      end = s.start + s.done;
+      if (s.Remaining() != 0) {
+        break;
+      }
+    }
+    return end;
+  }
+  // hash_contiguous moves the hasher over data written ahead of it by later segments. With a lock the written range
+  // is read back and hashed unlocked while this writer owns the cursor; ranges written meanwhile are picked up by the
+  // next pass. Without a lock no segment is being written
+  bool hash_contiguous(std::unique_lock<std::mutex> *lock, bela::error_code &ec) {
+    if (!hasher.Enabled() || hashing) {
+      return true;
+    }
+    std::vector<uint8_t> buffer;
+    for (auto end = contiguous_end(); hashed_bytes < end; end = contiguous_end()) {
+      if (buffer.empty()) {
+        buffer.resize(256 * 1024);
+      }
+      auto offset = hashed_bytes;
+      hashing = true;
+      if (lock != nullptr) {
+        lock->unlock();
+      }
+      auto ok = true;
+      while (offset < end) {
+        auto len = static_cast<size_t>((std::min)(static_cast<int64_t>(buffer.size()), end - offset));
+        if (ok = file.ReadAt(buffer.data(), len, offset, ec); !ok) {
+          break;
+        }
+        hasher.Update(buffer.data(), len);
+        offset += static_cast<int64_t>(len);
+      }
+      if (lock != nullptr) {
+        lock->lock();
+      }
+      hashing = false;
+      // the hasher covers what it read, a failed read leaves the cursor at its start
+      hashed_bytes = offset;
+      if (!ok) {
+        return false;
+      }
+    }
+    return true;
   }
 };
 
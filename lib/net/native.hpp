@@ -3,9 +3,13 @@
 #include <bela/env.hpp>
 #include <bela/strip.hpp>
 #include <baulk/net/types.hpp>
+#include "backend.hpp"
 #include <schannel.h>
 #include <ws2tcpip.h>
 #include <winhttp.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 
 struct WINHTTP_SECURITY_INFO_X {
   SecPkgContext_ConnectionInfo ConnectionInfo;
@@ -37,14 +41,7 @@ inline bela::error_code make_net_error_code(std::wstring_view prefix = L"") {
   return ec;
 }
 
-struct url {
-  std::wstring host;
-  std::wstring filename;
-  std::wstring uri;
-  int nPort{80};
-  int nScheme{INTERNET_SCHEME_HTTPS};
-  inline DWORD TlsFlag() const { return nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0; }
-};
+using url = net_internal::url;
 
 inline std::optional<url> crack_url(std::wstring_view us, bela::error_code &ec) {
   URL_COMPONENTSW uc;
@@ -64,7 +61,7 @@ inline std::optional<url> crack_url(std::wstring_view us, bela::error_code &ec)
           .filename = decoded_url_path_name(urlpath),
           .uri = bela::StringCat(urlpath, std::wstring_view{uc.lpszExtraInfo, uc.dwExtraInfoLength}),
           .nPort = uc.nPort,
-          .nScheme = uc.nScheme});
+          .secure = uc.nScheme == INTERNET_SCHEME_HTTPS});
 }
 
 class status_context {
@@ -104,7 +101,7 @@ public:
       break;
     }
   }
-  std::optional<url> crack_location_url() {
+  std::optional<url> crack_location_url() const {
     if (location.empty()) {
       return std::nullopt;
     }
@@ -143,53 +140,11 @@ private:
   }
 };
 
-// https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Content-Disposition
-// https://www.rfc-editor.org/rfc/rfc6266#section-5
-inline std::optional<std::wstring> extract_filename(const headers_t &hkv) {
-  auto it = hkv.find(L"Content-Disposition");
-  if (it == hkv.end()) {
-    return std::nullopt;
-  }
-  std::vector<std::wstring_view> pvv = bela::StrSplit(it->second, bela::ByChar(';'), bela::SkipEmpty());
-  constexpr std::wstring_view fns = L"filename=";
-  constexpr std::wstring_view fnsu = L"filename*=";
-  for (auto e : pvv) {
-    auto s = bela::StripAsciiWhitespace(e);
-    if (bela::ConsumePrefix(&s, fns)) {
-      bela::ConsumePrefix(&s, L"\"");
-      bela::ConsumeSuffix(&s, L"\"");
-      return std::make_optional<>(url_path_name(s));
-    }
-    if (bela::ConsumePrefix(&s, fnsu)) {
-      bela::ConsumePrefix(&s, L"\"");
-      bela::ConsumeSuffix(&s, L"\"");
-      return std::make_optional<>(decoded_url_path_name(s));
-    }
-  }
-  return std::nullopt;
-}
-
-// content_length
-inline int64_t content_length(const headers_t &hkv) {
-  if (auto it = hkv.find(L"Content-Length"); it != hkv.end()) {
-    if (int64_t len = 0; bela::SimpleAtoi(bela::StripAsciiWhitespace(it->second), &len)) {
-      return len;
-    }
-  }
-  return -1;
-}
-
-inline bool enable_part_download(const headers_t &hkv) {
-  if (auto it = hkv.find(L"Accept-Ranges"); it != hkv.end()) {
-    return bela::EqualsIgnoreCase(bela::StripAsciiWhitespace(it->second), L"bytes");
-  }
-  return false;
-}
-
 class handle {
 public:
   handle() = default;
   handle(HINTERNET h_) : h(h_) {}
+  handle(handle &&other) noexcept : h(std::exchange(other.h, nullptr)) {}
   handle(const handle &) = delete;
   handle &operator=(const handle &) = delete;
   ~handle() {
@@ -205,13 +160,17 @@ public:
     proxy.lpszProxyBypass = nullptr;
     return WinHttpSetOption(h, WINHTTP_OPTION_PROXY, &proxy, sizeof(proxy)) == TRUE;
   }
-  void protocol_enable() {
+  // protocol_enable: without multiplexing, concurrent requests to a host run on connections of their own
+  void protocol_enable(bool multiplexing = true) {
     // ENABLE TLS 1.3
     DWORD secure_protocols(WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_3);
     if (WinHttpSetOption(h, WINHTTP_OPTION_SECURE_PROTOCOLS, &secure_protocols, sizeof(secure_protocols)) != TRUE) {
       secure_protocols = WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2;
       WinHttpSetOption(h, WINHTTP_OPTION_SECURE_PROTOCOLS, &secure_protocols, sizeof(secure_protocols));
     }
+    if (!multiplexing) {
+      return;
+    }
     // ENABLE HTTP2 and HTTP3
     DWORD all_protocols(WINHTTP_PROTOCOL_FLAG_HTTP2 | WINHTTP_PROTOCOL_FLAG_HTTP3);
     if (WinHttpSetOption(h, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &all_protocols, sizeof(all_protocols)) != TRUE) {
@@ -226,17 +185,21 @@ public:
     WinHttpSetOption(h, WINHTTP_OPTION_SECURITY_FLAGS, &dwFlags, sizeof(dwFlags));
   }
 
-  // fill header
-  bool write_headers(const headers_t &hkv, const std::vector<std::wstring> &cookies, int64_t position, int64_t length,
+  // fill header, a range [position, end) is requested when either is set, end 0 leaves the range open
+  bool write_headers(const headers_t &hkv, const std::vector<std::wstring> &cookies, int64_t position, int64_t end,
                      bela::error_code &ec) {
     std::wstring flattened_headers;
     for (const auto &[key, value] : hkv) {
       bela::StrAppend(&flattened_headers, key, L": ", value, L"\r\n");
     }
     // part download
-    if (position > 0) {
+    if (position > 0 || end > 0) {
       // https://developer.mozilla.org/zh-CN/docs/Web/HTTP/Headers/Range
       bela::StrAppend(&flattened_headers, L"Range: bytes=", position, L"-");
+      if (end > position) {
+        bela::StrAppend(&flattened_headers, end - 1);
+      }
+      flattened_headers.append(L"\r\n");
     }
     if (!cookies.empty()) {
       bela::StrAppend(&flattened_headers, L"Cookie: ", bela::StrJoin(cookies, L"; "), L"\r\n");
@@ -341,57 +304,6 @@ public:
                                                .version = version,
                                                .status_text = std::move(status)});
   }
-  //
-  int64_t recv_completely(int64_t len, std::vector<char> &buffer, size_t max_body_size, bela::error_code &ec) {
-    if (len == 0) {
-      return 0;
-    }
-    // content-length
-    if (len > 0) {
-      auto total_size =
-          static_cast<size_t>((std::min)(static_cast<uint64_t>(max_body_size), static_cast<uint64_t>(len)));
-      buffer.resize(total_size);
-      size_t download_size = 0;
-      auto buf = buffer.data();
-      do {
-        DWORD dwSize = 0;
-        if (WinHttpQueryDataAvailable(h, &dwSize) != TRUE) {
-          ec = make_net_error_code();
-          return -1;
-        }
-        auto recv_size = (std::min)(total_size - download_size, static_cast<size_t>(dwSize));
-        if (WinHttpReadData(h, buf + download_size, static_cast<DWORD>(recv_size), &dwSize) != TRUE) {
-          ec = make_net_error_code();
-          return -1;
-        }
-        download_size += static_cast<size_t>(dwSize);
-      } while (total_size > download_size);
-      return download_size;
-    }
-    // chunk receive
-    buffer.resize(256 * 1024); // 256kb buffer
-    size_t download_size = 0;
-    do {
-      DWORD dwSize = 0;
-      if (WinHttpQueryDataAvailable(h, &dwSize) != TRUE) {
-        ec = make_net_error_code();
-        return -1;
-      }
-      if (dwSize == 0) {
-        break;
-      }
-      if (buffer.size() < static_cast<size_t>(dwSize) + download_size) {
-        buffer.resize(download_size + static_cast<size_t>(dwSize));
-      }
-      if (WinHttpReadData(h, buffer.data() + download_size, dwSize, &dwSize) != TRUE) {
-        ec = make_net_error_code();
-        return -1;
-      }
-      download_size += dwSize;
-    } while (download_size < max_body_size);
-    return download_size;
-  }
-
   // a session handle create a connection
   std::optional<handle> connect(std::wstring_view host, int port, bela::error_code &ec) {
     auto hConnect = WinHttpConnect(h, host.data(), port, 0);
@@ -429,6 +341,70 @@ inline std::optional<handle> make_session(std::wstring_view ua, bela::error_code
   return std::make_optional<handle>(hSession);
 }
 
+// session_pool keeps sessions and connection handles for the life of the process. WinHTTP keeps the idle
+// connections of a session alive, so later requests to the same host skip DNS, TCP and TLS setup, and with
+// HTTP/2 concurrent requests share one connection
+class session_pool {
+public:
+  session_pool() = default;
+  session_pool(const session_pool &) = delete;
+  session_pool &operator=(const session_pool &) = delete;
+  // connect returns a connection handle owned by the pool, shared by requests to host:port through the same proxy
+  handle *connect(std::wstring_view ua, std::wstring_view proxy, bool multiplexing, std::wstring_view host, int port,
+                  bela::error_code &ec) {
+    std::scoped_lock lock(mu);
+    auto s = std::find_if(sessions.begin(), sessions.end(), [&](const auto &e) {
+      return e->ua == ua && e->proxy == proxy && e->multiplexing == multiplexing;
+    });
+    if (s == sessions.end()) {
+      auto session = make_session(ua, ec);
+      if (!session) {
+        return nullptr;
+      }
+      if (!proxy.empty()) {
+        auto proxyURL = std::wstring(proxy);
+        session->set_proxy_url(proxyURL);
+      }
+      session->protocol_enable(multiplexing);
+      s = sessions.emplace(sessions.end(), std::make_unique<session_entry>(session_entry{
+                                               .ua = std::wstring(ua),
+                                               .proxy = std::wstring(proxy),
+                                               .multiplexing = multiplexing,
+                                               .session = std::move(*session),
+                                           }));
+    }
+    auto &conns = (*s)->connections;
+    auto c = std::find_if(conns.begin(), conns.end(),
+                          [&](const auto &e) { return e->port == port && bela::EqualsIgnoreCase(e->host, host); });
+    if (c != conns.end()) {
+      return &(*c)->conn;
+    }
+    auto conn = (*s)->session.connect(host, port, ec);
+    if (!conn) {
+      return nullptr;
+    }
+    conns.emplace_back(std::make_unique<connection_entry>(
+        connection_entry{.host = std::wstring(host), .port = port, .conn = std::move(*conn)}));
+    return &conns.back()->conn;
+  }
+
+private:
+  struct connection_entry {
+    std::wstring host;
+    int port{0};
+    handle conn;
+  };
+  struct session_entry {
+    std::wstring ua;
+    std::wstring proxy;
+    bool multiplexing{true};
+    handle session;
+    std::vector<std::unique_ptr<connection_entry>> connections;
+  };
+  std::mutex mu;
+  std::vector<std::unique_ptr<session_entry>> sessions;
+};
+
 } // namespace baulk::net::native
 
 #endif
\ No newline at end of file
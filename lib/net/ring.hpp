@@ -0,0 +1,121 @@
+#ifndef BAULK_NET_RING_HPP
+#define BAULK_NET_RING_HPP
+#include <bela/base.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace baulk::net::net_internal {
+// receive_ring: a fixed ring of large aligned buffers between the receiving thread and a writer thread. The
+// network fills one buffer while the writer hashes and stores the ones before it, so neither waits on the other
+class receive_ring {
+public:
+  static constexpr size_t max_slots = 4;
+  static constexpr size_t slot_size = 1024 * 1024;
+  // a partially filled buffer is handed over after this long, progress of slow links still moves
+  static constexpr auto batch_interval = std::chrono::milliseconds(200);
+  using sink_t = std::function<bool(const char *data, size_t bytes, bela::error_code &ec)>;
+  receive_ring(sink_t &&sink_, size_t count_ = max_slots)
+      : sink(std::move(sink_)), slot_count((std::clamp)(count_, size_t{2}, max_slots)) {
+    for (size_t i = 0; i < slot_count; i++) {
+      slots[i].data = static_cast<char *>(::operator new[](slot_size, slot_alignment));
+    }
+    writer = std::thread([this] { write_loop(); });
+  }
+  receive_ring(const receive_ring &) = delete;
+  receive_ring &operator=(const receive_ring &) = delete;
+  ~receive_ring() {
+    bela::error_code ec;
+    Finish(ec);
+    for (size_t i = 0; i < slot_count; i++) {
+      ::operator delete[](slots[i].data, slot_alignment);
+    }
+  }
+  // Acquire waits for a free buffer of slot_size bytes, nullptr once the writer failed
+  char *Acquire() {
+    std::unique_lock lock(mu);
+    cv.wait(lock, [&] { return failed || queued < slot_count; });
+    if (failed) {
+      return nullptr;
+    }
+    return slots[(head + queued) % slot_count].data;
+  }
+  // Commit queues the buffer returned by Acquire with the bytes filled in it
+  void Commit(size_t bytes) {
+    {
+      std::scoped_lock lock(mu);
+      slots[(head + queued) % slot_count].size = bytes;
+      queued++;
+    }
+    cv.notify_all();
+  }
+  // Finish writes what is queued and stops the writer, returns false with the first write error
+  bool Finish(bela::error_code &ec) {
+    {
+      std::scoped_lock lock(mu);
+      done = true;
+    }
+    cv.notify_all();
+    if (writer.joinable()) {
+      writer.join();
+    }
+    if (failed) {
+      ec = error;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static constexpr std::align_val_t slot_alignment{4096};
+  struct slot {
+    char *data{nullptr};
+    size_t size{0};
+  };
+  slot slots[max_slots];
+  sink_t sink;
+  size_t slot_count{max_slots};
+  std::thread writer;
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t head{0};   // oldest queued buffer, the one being written
+  size_t queued{0}; // buffers queued or being written
+  bool done{false};
+  bool failed{false};
+  bela::error_code error;
+  void write_loop() {
+    for (;;) {
+      slot *s = nullptr;
+      bool skip = false;
+      {
+        std::unique_lock lock(mu);
+        cv.wait(lock, [&] { return queued > 0 || done; });
+        if (queued == 0) {
+          return;
+        }
+        s = &slots[head];
+        skip = failed;
+      }
+      bela::error_code ec;
+      // after a failure the queued data is dropped, the caller only waits for the ring to drain
+      auto ok = skip || s->size == 0 || sink(s->data, s->size, ec);
+      {
+        std::scoped_lock lock(mu);
+        if (!ok && !failed) {
+          failed = true;
+          error = std::move(ec);
+        }
+        head = (head + 1) % slot_count;
+        queued--;
+      }
+      cv.notify_all();
+    }
+  }
+};
+} // namespace baulk::net::net_internal
+
+#endif
@@ -0,0 +1,100 @@
+// Connection limits and bandwidth shared by every request of the process
+#include <bela/ascii.hpp>
+#include <algorithm>
+#include <thread>
+#include "scheduler.hpp"
+
+namespace baulk::net {
+namespace net_internal {
+transfer_scheduler &transfer_scheduler::Instance() {
+  static transfer_scheduler inst;
+  return inst;
+}
+
+void transfer_scheduler::Configure(const transfer_limits &limits_) {
+  {
+    std::scoped_lock lock(mu);
+    limits = limits_;
+  }
+  cv.notify_all();
+  std::scoped_lock lock(rateMutex);
+  rate = (std::max)(limits_.rate, int64_t{0});
+  tokens = static_cast<double>(rate);
+  refilled = std::chrono::steady_clock::now();
+}
+
+bool transfer_scheduler::available(const std::wstring &host) const {
+  if (limits.connections != 0 && total >= limits.connections) {
+    return false;
+  }
+  if (limits.host_connections == 0) {
+    return true;
+  }
+  auto it = active.find(host);
+  return it == active.end() || it->second < limits.host_connections;
+}
+
+// eligible: w can connect now and no waiter that can connect as well is ahead of it
+bool transfer_scheduler::eligible(const waiter &w) const {
+  if (!available(w.host)) {
+    return false;
+  }
+  return std::none_of(waiters.begin(), waiters.end(), [&](const waiter &v) {
+    if (v.ticket == w.ticket || !available(v.host)) {
+      return false;
+    }
+    return v.priority < w.priority || (v.priority == w.priority && v.ticket < w.ticket);
+  });
+}
+
+transfer_slot transfer_scheduler::Acquire(std::wstring_view host, transfer_priority priority) {
+  auto key = bela::AsciiStrToLower(host);
+  {
+    std::unique_lock lock(mu);
+    auto it = waiters.insert(waiters.end(), waiter{.host = key, .priority = priority, .ticket = tickets++});
+    cv.wait(lock, [&] { return eligible(*it); });
+    waiters.erase(it);
+    active[key]++;
+    total++;
+  }
+  // a waiter for another host may still fit
+  cv.notify_all();
+  return transfer_slot(this, std::move(key));
+}
+
+void transfer_scheduler::release(const std::wstring &host) {
+  {
+    std::scoped_lock lock(mu);
+    if (auto it = active.find(host); it != active.end() && --it->second == 0) {
+      active.erase(it);
+    }
+    total--;
+  }
+  cv.notify_all();
+}
+
+void transfer_scheduler::Throttle(size_t bytes) {
+  std::chrono::duration<double> debt{0};
+  {
+    std::scoped_lock lock(rateMutex);
+    if (rate == 0) {
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto capacity = static_cast<double>(rate);
+    tokens = (std::min)(capacity, tokens + std::chrono::duration<double>(now - refilled).count() * capacity);
+    refilled = now;
+    tokens -= static_cast<double>(bytes);
+    if (tokens >= 0) {
+      return;
+    }
+    debt = std::chrono::duration<double>(-tokens / capacity);
+  }
+  std::this_thread::sleep_for(debt);
+}
+} // namespace net_internal
+
+void SetTransferLimits(const transfer_limits &limits) {
+  net_internal::transfer_scheduler::Instance().Configure(limits);
+}
+} // namespace baulk::net
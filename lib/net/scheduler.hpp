@@ -0,0 +1,85 @@
+#ifndef BAULK_NET_SCHEDULER_HPP
+#define BAULK_NET_SCHEDULER_HPP
+#include <baulk/net/client.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <utility>
+#include <mutex>
+
+namespace baulk::net::net_internal {
+// metadata requests (bucket probes, manifests) are granted before archive connections waiting at the same time
+enum class transfer_priority : int { metadata = 0, archive = 1 };
+
+class transfer_scheduler;
+// transfer_slot: a granted connection, given back when the slot is released or destroyed
+class transfer_slot {
+public:
+  transfer_slot() = default;
+  transfer_slot(transfer_scheduler *s, std::wstring &&h) : sched(s), host(std::move(h)) {}
+  transfer_slot(const transfer_slot &) = delete;
+  transfer_slot &operator=(const transfer_slot &) = delete;
+  transfer_slot(transfer_slot &&other) noexcept
+      : sched(std::exchange(other.sched, nullptr)), host(std::move(other.host)) {}
+  transfer_slot &operator=(transfer_slot &&other) noexcept {
+    if (this != &other) {
+      Release();
+      sched = std::exchange(other.sched, nullptr);
+      host = std::move(other.host);
+    }
+    return *this;
+  }
+  ~transfer_slot() { Release(); }
+  void Release();
+
+private:
+  transfer_scheduler *sched{nullptr};
+  std::wstring host;
+};
+
+// transfer_scheduler: process wide connection limits, per host and in total, and a token bucket that paces
+// archive downloads. Waiting requests are granted by priority, then in arrival order
+class transfer_scheduler {
+public:
+  transfer_scheduler() = default;
+  transfer_scheduler(const transfer_scheduler &) = delete;
+  transfer_scheduler &operator=(const transfer_scheduler &) = delete;
+  static transfer_scheduler &Instance();
+  void Configure(const transfer_limits &limits_);
+  // Acquire waits until host and the process have a free connection
+  transfer_slot Acquire(std::wstring_view host, transfer_priority priority);
+  // Throttle charges received bytes to the rate limit and sleeps while the bucket is in debt
+  void Throttle(size_t bytes);
+
+private:
+  friend class transfer_slot;
+  struct waiter {
+    std::wstring host;
+    transfer_priority priority;
+    uint64_t ticket;
+  };
+  std::mutex mu;
+  std::condition_variable cv;
+  transfer_limits limits;
+  bela::flat_hash_map<std::wstring, uint32_t> active; // lower case host -> connections
+  uint32_t total{0};
+  std::list<waiter> waiters;
+  uint64_t tickets{0};
+  // token bucket, one second of burst
+  std::mutex rateMutex;
+  int64_t rate{0};
+  double tokens{0};
+  std::chrono::steady_clock::time_point refilled{std::chrono::steady_clock::now()};
+  bool available(const std::wstring &host) const;
+  bool eligible(const waiter &w) const;
+  void release(const std::wstring &host);
+};
+
+inline void transfer_slot::Release() {
+  if (auto s = std::exchange(sched, nullptr); s != nullptr) {
+    s->release(host);
+  }
+}
+} // namespace baulk::net::net_internal
+
+#endif
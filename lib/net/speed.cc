@@ -1,34 +1,178 @@
 //
+#include <bela/io.hpp>
 #include <baulk/net.hpp>
 #include <baulk/net/tcp.hpp>
 #include "native.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <json.hpp>
 
 namespace baulk::net {
 constexpr auto MaximumTime = (std::numeric_limits<std::uint64_t>::max)();
+// a mirror is probed again once its record is this old, seconds
+constexpr int64_t mirrorRecordLifetime = 24 * 3600;
+constexpr int dialTimeout = 10000;
 
-std::uint64_t UrlResponseTime(std::wstring_view url) {
-  bela::error_code ec;
-  auto u = native::crack_url(url, ec);
-  if (!u) {
-    return MaximumTime;
+inline int64_t unix_now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+inline std::string mirror_key(const native::url &u) {
+  return bela::encode_into<wchar_t, char>(bela::StringCat(bela::AsciiStrToLower(u.host), L":", u.nPort));
+}
+
+// mirror_table: observed connect latency and download throughput of each mirror host
+class mirror_table {
+public:
+  mirror_table(const std::filesystem::path &file_) : file(file_) {
+    if (file.empty()) {
+      return;
+    }
+    FILE *fd = nullptr;
+    if (_wfopen_s(&fd, file.c_str(), L"rb") != 0) {
+      return;
+    }
+    auto closer = bela::finally([&] { fclose(fd); });
+    try {
+      if (auto j = nlohmann::json::parse(fd, nullptr, true, true); j.is_object() && j.contains("hosts")) {
+        hosts = std::move(j["hosts"]);
+      }
+    } catch (const std::exception &) {
+      // a corrupt table only costs a probe
+    }
+    if (!hosts.is_object()) {
+      hosts = nlohmann::json::object();
+    }
   }
+  mirror_table(const mirror_table &) = delete;
+  mirror_table &operator=(const mirror_table &) = delete;
+  // fresh record of a host, nullptr when it has to be probed
+  const nlohmann::json *Fresh(const std::string &key) const {
+    if (auto it = hosts.find(key); it != hosts.end() && it->is_object() &&
+                                   unix_now() - it->value("updated", int64_t{0}) < mirrorRecordLifetime) {
+      return &*it;
+    }
+    return nullptr;
+  }
+  void Latency(const std::string &key, std::uint64_t nanoseconds) {
+    auto &h = entry(key);
+    h["latency"] = nanoseconds;
+    if (nanoseconds == MaximumTime) {
+      // an unreachable mirror must not win on an old download
+      h.erase("throughput");
+    }
+    h["updated"] = unix_now();
+  }
+  void Throughput(const std::string &key, double bytesPerSecond) {
+    auto &h = entry(key);
+    h["throughput"] = bytesPerSecond;
+    h["updated"] = unix_now();
+  }
+  bool Save() {
+    if (file.empty()) {
+      return false;
+    }
+    std::error_code e;
+    std::filesystem::create_directories(file.parent_path(), e);
+    bela::error_code ec;
+    return bela::io::WriteTextAtomic(nlohmann::json{{"hosts", hosts}}.dump(4), file.native(), ec);
+  }
+
+private:
+  std::filesystem::path file;
+  nlohmann::json hosts = nlohmann::json::object();
+  nlohmann::json &entry(const std::string &key) {
+    auto &h = hosts[key];
+    if (!h.is_object()) {
+      h = nlohmann::json::object();
+    }
+    return h;
+  }
+};
+
+// guards load-modify-save of the table, concurrent downloads record their throughput
+static std::mutex tableMutex;
+
+// mirror_race: every candidate dials at once, the first connected one wins. The losing dials are canceled, they
+// close their sockets and RaceMirrors joins them before it returns
+struct mirror_race {
+  std::mutex mu;
+  std::condition_variable cv;
+  std::atomic_bool canceled{false};
+  std::vector<std::uint64_t> elapsed; // MaximumTime: failed or not finished
+  std::vector<bool> finished;
+  size_t pending{0};
+  size_t winner{(std::numeric_limits<size_t>::max)()};
+};
+
+size_t RaceMirrors(const std::vector<native::url> &urls, std::vector<std::uint64_t> &elapsed) {
+  mirror_race race;
+  race.elapsed.assign(urls.size(), MaximumTime);
+  race.finished.assign(urls.size(), false);
+  race.pending = urls.size();
   auto begin = std::chrono::steady_clock::now();
-  if (auto conn = baulk::net::DialTimeout(u->host, u->nPort, 10000, ec); !conn) {
-    return MaximumTime;
+  std::vector<std::thread> dials;
+  dials.reserve(urls.size());
+  for (size_t i = 0; i < urls.size(); i++) {
+    dials.emplace_back([&race, i, &u = urls[i], begin] {
+      bela::error_code ec;
+      auto conn = baulk::net::DialTimeout(u.host, u.nPort, dialTimeout, race.canceled, ec);
+      auto cur = std::chrono::steady_clock::now();
+      {
+        std::lock_guard lock(race.mu);
+        race.finished[i] = true;
+        race.pending--;
+        if (conn && !race.canceled) {
+          race.elapsed[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(cur - begin).count();
+          if (race.winner >= race.elapsed.size()) {
+            race.winner = i;
+          }
+        }
+      }
+      race.cv.notify_all();
+    });
+  }
+  {
+    std::unique_lock lock(race.mu);
+    race.cv.wait(lock, [&] { return race.winner < urls.size() || race.pending == 0; });
+    race.canceled = true;
+    elapsed = race.elapsed;
+    if (race.winner < urls.size()) {
+      // mirrors still dialing are at least as slow as the winner
+      auto decided = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+      for (size_t i = 0; i < urls.size(); i++) {
+        if (!race.finished[i]) {
+          elapsed[i] = decided.count() + 1;
+        }
+      }
+    }
+  }
+  for (auto &t : dials) {
+    t.join();
   }
-  auto cur = std::chrono::steady_clock::now();
-  return std::chrono::duration_cast<std::chrono::nanoseconds>(cur - begin).count();
+  return race.winner;
 }
 
-std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::wstring_view locale) {
+// better: throughput decides when both mirrors were downloaded from, connect latency otherwise
+inline bool better(const nlohmann::json &a, const nlohmann::json &b) {
+  auto ta = a.value("throughput", 0.0);
+  auto tb = b.value("throughput", 0.0);
+  if (ta > 0 && tb > 0) {
+    return ta > tb;
+  }
+  return a.value("latency", MaximumTime) < b.value("latency", MaximumTime);
+}
+
+std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::wstring_view locale,
+                                  const std::filesystem::path &table) {
   if (urls.empty()) {
     return L"";
   }
   if (urls.size() == 1) {
     return urls[0];
   }
-  auto elapsed = MaximumTime;
-  size_t pos = 0;
   auto suffix = bela::StringCat(L"#", locale);
   // The first round to determine whether there is a mirror image of the area
   for (const auto &u : urls) {
@@ -39,22 +183,80 @@ std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::ws
       return url;
     }
   }
-  // Second round of analysis of network connection establishment time
+  std::vector<native::url> cracked;
+  std::vector<size_t> positions;
   for (size_t i = 0; i < urls.size(); i++) {
-    // connect url to get elapsed timeout
-    auto resptime = UrlResponseTime(urls[i]);
-    if (resptime < elapsed) {
-      pos = i;
+    bela::error_code ec;
+    if (auto u = native::crack_url(urls[i], ec); u) {
+      cracked.emplace_back(std::move(*u));
+      positions.emplace_back(i);
+    }
+  }
+  if (cracked.empty()) {
+    return urls[0];
+  }
+  // Second round: every mirror has a fresh record, choose without probing
+  if (auto chosen = [&]() -> std::optional<size_t> {
+        std::lock_guard lock(tableMutex);
+        mirror_table mt(table);
+        const nlohmann::json *best = nullptr;
+        size_t pos = 0;
+        for (size_t i = 0; i < cracked.size(); i++) {
+          auto record = mt.Fresh(mirror_key(cracked[i]));
+          if (record == nullptr) {
+            return std::nullopt;
+          }
+          if (best == nullptr || better(*record, *best)) {
+            best = record;
+            pos = positions[i];
+          }
+        }
+        if (best->value("latency", MaximumTime) == MaximumTime) {
+          return std::nullopt;
+        }
+        return std::make_optional(pos);
+      }();
+      chosen) {
+    return urls[*chosen];
+  }
+  // Third round: race the connection establishment of all mirrors
+  std::vector<std::uint64_t> elapsed;
+  auto winner = RaceMirrors(cracked, elapsed);
+  {
+    std::lock_guard lock(tableMutex);
+    mirror_table mt(table);
+    for (size_t i = 0; i < cracked.size(); i++) {
+      mt.Latency(mirror_key(cracked[i]), elapsed[i]);
     }
+    mt.Save();
   }
-  return urls[pos];
+  if (winner >= cracked.size()) {
+    return urls[positions[0]];
+  }
+  return urls[positions[winner]];
 }
 
-std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale) {
-  auto url = BestUrlInternal(urls, locale);
+std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale,
+                          const std::filesystem::path &table) {
+  auto url = BestUrlInternal(urls, locale, table);
   if (auto pos = url.find('#'); pos != std::wstring_view::npos) {
     return url.substr(0, pos);
   }
   return url;
 }
-} // namespace baulk::net
\ No newline at end of file
+
+void RecordThroughput(const std::filesystem::path &table, std::wstring_view url, int64_t bytes, double seconds) {
+  if (table.empty() || bytes <= 0 || seconds <= 0) {
+    return;
+  }
+  bela::error_code ec;
+  auto u = native::crack_url(url, ec);
+  if (!u) {
+    return;
+  }
+  std::lock_guard lock(tableMutex);
+  mirror_table mt(table);
+  mt.Throughput(mirror_key(*u), static_cast<double>(bytes) / seconds);
+  mt.Save();
+}
+} // namespace baulk::net
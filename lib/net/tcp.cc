@@ -1,11 +1,19 @@
 //
 #include <bela/base.hpp>
 #include <bela/terminal.hpp>
+#include <bela/phmap.hpp>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
 #include <thread>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <windns.h>
 #include <baulk/net/tcp.hpp>
+#include "native.hpp"
 
 namespace baulk::net {
 // WSAConnectByName
@@ -34,6 +42,8 @@ private:
   std::atomic_bool initialized{false};
 };
 
+inline void InitializeWinsock() { static winsock_initializer initializer_; }
+
 inline constexpr bool InProgress(int rv) { return rv == WSAEWOULDBLOCK || rv == WSAEINPROGRESS; }
 
 inline bela::error_code make_wsa_error_code(int code, std::wstring_view prefix = L"") {
@@ -154,13 +164,25 @@ ssize_t Conn::ReadTimeout(char *buf, size_t len, int timeout) {
   return -1;
 }
 
-bool DialTimeoutInternal(BAULKSOCK sock, const ADDRINFOEX4 *hi, int timeout, bela::error_code &ec) {
+// a cancelable dial waits in slices this long, milliseconds
+constexpr int dialSlice = 50;
+
+inline bool canceled_dial(const std::atomic_bool *canceled, bela::error_code &ec) {
+  if (canceled == nullptr || !canceled->load()) {
+    return false;
+  }
+  ec = bela::make_error_code(bela::ErrGeneral, L"dial canceled");
+  return true;
+}
+
+bool DialTimeoutInternal(BAULKSOCK sock, const sockaddr_storage &addr, int addrlen, int timeout,
+                         const std::atomic_bool *canceled, bela::error_code &ec) {
   ULONG flags = 1;
   if (ioctlsocket(sock, FIONBIO, &flags) == SOCKET_ERROR) {
     ec = make_wsa_error_code(WSAGetLastError(), L"ioctlsocket() ");
     return false;
   }
-  if (connect(sock, hi->ai_addr, static_cast<int>(hi->ai_addrlen)) != SOCKET_ERROR) {
+  if (connect(sock, reinterpret_cast<const sockaddr *>(&addr), addrlen) != SOCKET_ERROR) {
     // success
     return true;
   }
@@ -171,48 +193,220 @@ bool DialTimeoutInternal(BAULKSOCK sock, const ADDRINFOEX4 *hi, int timeout, bel
   WSAPOLLFD pfd;
   pfd.fd = sock;
   pfd.events = POLLOUT;
-  auto rc = WSAPoll(&pfd, 1, timeout);
-  if (rc == 0) {
-    // timeout error DialTimeout make it
-    return false;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  int rc = 0;
+  for (;;) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+      // timeout error DialTimeout make it
+      return false;
+    }
+    auto slice = canceled == nullptr ? remaining.count() : (std::min)(remaining.count(), int64_t{dialSlice});
+    if ((rc = WSAPoll(&pfd, 1, static_cast<INT>(slice))) != 0) {
+      break;
+    }
+    if (canceled_dial(canceled, ec)) {
+      return false;
+    }
   }
   if (rc < 0) {
     ec = make_wsa_error_code(WSAGetLastError(), L"connect() ");
     return false;
   }
+  // a refused connection also wakes the poll, it is not a connected socket
+  if ((pfd.revents & (POLLERR | POLLHUP)) != 0) {
+    int err = 0;
+    int len = sizeof(err);
+    getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&err), &len);
+    ec = make_wsa_error_code(err != 0 ? err : WSAECONNREFUSED, L"connect() ");
+    return false;
+  }
   return true;
 }
 
-std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, bela::error_code &ec) {
-  static winsock_initializer initializer_;
-  PADDRINFOEX4 rhints = nullptr;
-  if (!ResolveName(address, port, &rhints, ec)) {
+// resolved_name: the addresses of a host and port, or why they could not be resolved
+struct resolved_name {
+  std::vector<std::pair<sockaddr_storage, int>> addresses;
+  bela::error_code ec;
+};
+
+// TTL of the host's A and AAAA records in the system DNS cache, GetAddrInfoExW does not report it
+std::chrono::seconds cached_ttl(std::wstring_view host) {
+  constexpr auto defaultTTL = std::chrono::seconds(60);
+  auto name = std::wstring(host);
+  DWORD ttl = (std::numeric_limits<DWORD>::max)();
+  for (auto type : {DNS_TYPE_A, DNS_TYPE_AAAA}) {
+    PDNS_RECORD records = nullptr;
+    if (DnsQuery_W(name.data(), type, DNS_QUERY_CACHE_ONLY, nullptr, &records, nullptr) != 0 || records == nullptr) {
+      continue;
+    }
+    for (auto r = records; r != nullptr; r = r->pNext) {
+      if (r->wType == type) {
+        ttl = (std::min)(ttl, r->dwTtl);
+      }
+    }
+    DnsRecordListFree(records, DnsFreeRecordList);
+  }
+  if (ttl == (std::numeric_limits<DWORD>::max)()) {
+    return defaultTTL;
+  }
+  return std::clamp(std::chrono::seconds(ttl), std::chrono::seconds(5), std::chrono::seconds(300));
+}
+
+// resolver_cache: resolutions shared by the whole process, concurrent lookups of a host wait for the first one.
+// Failures are not kept, the next dial asks again. Background lookups are counted, at exit the cache stops new ones
+// and waits for the running ones before it is destroyed, Winsock is released after it
+class resolver_cache {
+public:
+  static resolver_cache &Instance() {
+    static resolver_cache cache;
+    return cache;
+  }
+  resolver_cache(const resolver_cache &) = delete;
+  resolver_cache &operator=(const resolver_cache &) = delete;
+  ~resolver_cache() {
+    std::unique_lock lock(mu);
+    stopping = true;
+    idle.wait(lock, [this] { return running == 0; });
+  }
+  std::shared_future<resolved_name> Resolve(std::wstring_view host, int port, bool background) {
+    auto key = bela::StringCat(bela::AsciiStrToLower(host), L":", port);
+    std::promise<resolved_name> promise;
+    std::shared_future<resolved_name> result;
+    {
+      std::scoped_lock lock(mu);
+      if (auto it = entries.find(key); it != entries.end() && std::chrono::steady_clock::now() < it->second.expires) {
+        return it->second.result;
+      }
+      result = promise.get_future().share();
+      if (background && stopping) {
+        promise.set_value(resolved_name{.ec = bela::make_error_code(bela::ErrGeneral, L"resolver stopped")});
+        return result;
+      }
+      entries[key] = entry{.result = result};
+      if (background) {
+        running++;
+      }
+    }
+    if (background) {
+      std::thread([this, key, host = std::wstring(host), port, promise = std::move(promise)]() mutable {
+        resolve(key, host, port, std::move(promise));
+        // the destructor returns once running is 0, nothing of this may be touched after the unlock
+        std::scoped_lock lock(mu);
+        running--;
+        idle.notify_all();
+      }).detach();
+      return result;
+    }
+    resolve(key, host, port, std::move(promise));
+    return result;
+  }
+
+private:
+  // Winsock is initialized first, so it is cleaned up after the cache waited for its lookups
+  resolver_cache() { InitializeWinsock(); }
+  struct entry {
+    std::shared_future<resolved_name> result;
+    // pending lookups never expire, waiting on them is cheaper than resolving again
+    std::chrono::steady_clock::time_point expires{std::chrono::steady_clock::time_point::max()};
+  };
+  std::mutex mu;
+  std::condition_variable idle;
+  size_t running{0}; // background lookups
+  bool stopping{false};
+  bela::flat_hash_map<std::wstring, entry> entries;
+  void resolve(const std::wstring &key, std::wstring_view host, int port, std::promise<resolved_name> &&promise) {
+    resolved_name rn;
+    PADDRINFOEX4 rhints = nullptr;
+    if (ResolveName(host, port, &rhints, rn.ec)) {
+      for (auto hi = rhints; hi != nullptr; hi = hi->ai_next) {
+        sockaddr_storage addr{};
+        memcpy(&addr, hi->ai_addr, (std::min)(sizeof(addr), static_cast<size_t>(hi->ai_addrlen)));
+        rn.addresses.emplace_back(addr, static_cast<int>(hi->ai_addrlen));
+      }
+      FreeAddrInfoExW(reinterpret_cast<ADDRINFOEXW *>(rhints)); /// Release
+    }
+    auto ttl = rn.ec ? std::chrono::seconds(0) : cached_ttl(host);
+    {
+      std::scoped_lock lock(mu);
+      if (auto it = entries.find(key); it != entries.end()) {
+        if (ttl.count() == 0) {
+          entries.erase(it);
+        } else {
+          it->second.expires = std::chrono::steady_clock::now() + ttl;
+        }
+      }
+    }
+    promise.set_value(std::move(rn));
+  }
+};
+
+std::optional<Conn> DialInternal(std::wstring_view address, int port, int timeout, const std::atomic_bool *canceled,
+                                 bela::error_code &ec) {
+  InitializeWinsock();
+  // a canceled dial leaves its lookup to the cache, which waits for it at exit
+  auto pending = resolver_cache::Instance().Resolve(address, port, canceled != nullptr);
+  while (canceled != nullptr &&
+         pending.wait_for(std::chrono::milliseconds(dialSlice)) != std::future_status::ready) {
+    if (canceled_dial(canceled, ec)) {
+      return std::nullopt;
+    }
+  }
+  auto rn = pending.get();
+  if (rn.ec) {
+    ec = rn.ec;
     bela::FPrintF(stderr, L"GetAddrInfoExW %s\n", ec);
     return std::nullopt;
   }
-  auto hi = rhints;
   SOCKET sock{BAULK_INVALID_SOCKET};
-  do {
-    sock = socket(rhints->ai_family, SOCK_STREAM, 0);
+  for (const auto &[addr, addrlen] : rn.addresses) {
+    sock = socket(addr.ss_family, SOCK_STREAM, 0);
     if (sock == BAULK_INVALID_SOCKET) {
       ec = make_wsa_error_code(WSAGetLastError(), L"socket() ");
       continue;
     }
-    if (DialTimeoutInternal(sock, hi, timeout, ec)) {
+    if (DialTimeoutInternal(sock, addr, addrlen, timeout, canceled, ec)) {
       break;
     }
     closesocket(sock);
     sock = BAULK_INVALID_SOCKET;
-  } while ((hi = hi->ai_next) != nullptr);
-
+    if (canceled_dial(canceled, ec)) {
+      return std::nullopt;
+    }
+  }
   if (sock == BAULK_INVALID_SOCKET) {
     if (ec) {
       ec = bela::make_error_code(bela::ErrGeneral, L"connect to ", address, L" timeout");
     }
-    FreeAddrInfoExW(reinterpret_cast<ADDRINFOEXW *>(rhints)); /// Release
     return std::nullopt;
   }
-  FreeAddrInfoExW(reinterpret_cast<ADDRINFOEXW *>(rhints)); /// Release
   return std::make_optional<baulk::net::Conn>(sock);
 }
+
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, bela::error_code &ec) {
+  return DialInternal(address, port, timeout, nullptr, ec);
+}
+
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, const std::atomic_bool &canceled,
+                                bela::error_code &ec) {
+  return DialInternal(address, port, timeout, &canceled, ec);
+}
+
+bool Reachable(std::wstring_view url, int timeout, bela::error_code &ec) {
+  auto u = native::crack_url(url, ec);
+  if (!u) {
+    return false;
+  }
+  return DialTimeout(u->host, u->nPort, timeout, ec).has_value();
+}
+
+void ResolveAhead(const std::vector<std::wstring> &urls) {
+  InitializeWinsock();
+  for (const auto &url : urls) {
+    bela::error_code ec;
+    if (auto u = native::crack_url(url, ec); u) {
+      resolver_cache::Instance().Resolve(u->host, u->nPort, true);
+    }
+  }
+}
 } // namespace baulk::net
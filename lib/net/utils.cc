@@ -27,4 +27,23 @@ std::string url_decode(std::wstring_view url) {
   return buf;
 }
 
+// encode a path segment, everything but unreserved characters is percent encoded as UTF-8
+std::wstring url_path_encode(std::wstring_view segment) {
+  constexpr char hex[] = "0123456789ABCDEF";
+  auto u8 = bela::encode_into<wchar_t, char>(segment);
+  std::wstring buf;
+  buf.reserve(u8.size());
+  for (auto c : u8) {
+    auto ch = static_cast<uint8_t>(c);
+    if (bela::ascii_isalnum(static_cast<char8_t>(ch)) || ch == '-' || ch == '.' || ch == '_' || ch == '~') {
+      buf += static_cast<wchar_t>(ch);
+      continue;
+    }
+    buf += L'%';
+    buf += static_cast<wchar_t>(hex[ch >> 4]);
+    buf += static_cast<wchar_t>(hex[ch & 0xF]);
+  }
+  return buf;
+}
+
 } // namespace baulk::net
\ No newline at end of file
@@ -0,0 +1,420 @@
+#!/usr/bin/env python3
+# mkcab.py: writes the cabinet fixtures read by cab_test.cc
+#   mszip.cab        one MSZIP folder
+#   lzx.cab          one LZX folder (window 2^21) with E8 translation, verbatim, aligned and uncompressed blocks
+#   multifolder.cab  stored, MSZIP and two LZX folders (window 2^15 and 2^16, the small window wraps every frame)
+# File contents are generated, cab_test.cc builds the same bytes to compare with. The LZX encoder is a plain
+# greedy matcher, good enough to cover every block type, repeated offsets, long lengths and window wraps.
+import os
+import struct
+import sys
+import zlib
+
+FRAME = 32768
+
+
+# ---------- contents, keep in sync with cab_test.cc ----------
+def xorshift_bytes(size, seed):
+    x = seed
+    out = bytearray(size)
+    for i in range(size):
+        x ^= (x << 13) & 0xFFFFFFFFFFFFFFFF
+        x ^= x >> 7
+        x ^= (x << 17) & 0xFFFFFFFFFFFFFFFF
+        out[i] = x & 0xFF
+    return bytes(out)
+
+
+def readme_text():
+    return b"".join(b"%05d baulk cabinet fixture line, the quick brown fox jumps over the lazy dog\r\n" % i
+                    for i in range(1500))
+
+
+def call_records():
+    # x86 like records: E8 + rel32 + filler, the rel32 values hit every branch of the E8 translation
+    out = bytearray()
+    for k in range(5000):
+        rel = (k * 7919) % 200000 - 100000
+        out += b"\xe8" + struct.pack("<i", rel) + b"baulk-call\x90"
+    return bytes(out)
+
+
+CONTENTS = {
+    "readme.txt": readme_text(),
+    "random.bin": xorshift_bytes(40000, 0x9E3779B97F4A7C15),
+    "calls.bin": call_records(),
+    "zeros.bin": bytes(50000),
+    "empty.txt": b"",
+}
+
+
+# ---------- huffman ----------
+def huffman_lengths(freqs, maxbits):
+    """length limited canonical code lengths (package-merge), the code is always complete"""
+    used = [i for i, f in enumerate(freqs) if f > 0]
+    if len(used) == 0:
+        return [0] * len(freqs)
+    if len(used) == 1:
+        used.append(1 if used[0] == 0 else 0)
+    leaves = sorted((max(freqs[i], 1), (i,)) for i in used)
+    items = list(leaves)
+    for _ in range(maxbits - 1):
+        packages = [(items[k][0] + items[k + 1][0], items[k][1] + items[k + 1][1])
+                    for k in range(0, len(items) - 1, 2)]
+        items = sorted(leaves + packages)
+    lens = [0] * len(freqs)
+    for _, syms in items[:2 * len(used) - 2]:
+        for s in syms:
+            lens[s] += 1
+    return lens
+
+
+def canonical_codes(lens):
+    codes = {}
+    code = 0
+    for bits in range(1, 17):
+        for sym, l in enumerate(lens):
+            if l == bits:
+                codes[sym] = (code, bits)
+                code += 1
+        code <<= 1
+    return codes
+
+
+# ---------- LZX ----------
+EXTRA_BITS = [0] * 51
+POSITION_BASE = [0] * 51
+j = 0
+for i in range(0, 50, 2):
+    EXTRA_BITS[i] = EXTRA_BITS[i + 1] = j
+    if i != 0 and j < 17:
+        j += 1
+EXTRA_BITS[50] = 17
+j = 0
+for i in range(51):
+    POSITION_BASE[i] = j
+    j += 1 << EXTRA_BITS[i]
+
+
+class BitWriter:
+    """16-bit little endian words, most significant bit first"""
+
+    def __init__(self):
+        self.out = bytearray()
+        self.word = 0
+        self.n = 0
+
+    def bits(self, v, n):
+        for i in range(n - 1, -1, -1):
+            self.word = (self.word << 1) | ((v >> i) & 1)
+            self.n += 1
+            if self.n == 16:
+                self.out += struct.pack("<H", self.word)
+                self.word = 0
+                self.n = 0
+
+    def align(self):
+        if self.n:
+            self.bits(0, 16 - self.n)
+
+    def raw(self, data):
+        assert self.n == 0
+        self.out += data
+
+
+def e8_encode(data, filesize):
+    """inverse of the decoder's translateE8, applied to every frame longer than 10 bytes"""
+    out = bytearray(data)
+    for start in range(0, len(out), FRAME):
+        size = min(FRAME, len(out) - start)
+        if size <= 10:
+            continue
+        curpos = start
+        p = start
+        end = start + size - 10
+        while p < end:
+            if out[p] != 0xE8:
+                p += 1
+                curpos += 1
+                continue
+            rel = struct.unpack_from("<i", out, p + 1)[0]
+            if -curpos <= rel < filesize - curpos:
+                struct.pack_into("<i", out, p + 1, rel + curpos)
+            elif filesize - curpos <= rel < filesize:
+                struct.pack_into("<i", out, p + 1, rel - filesize)
+            p += 5
+            curpos += 5
+    return bytes(out)
+
+
+class LzxEncoder:
+    def __init__(self, window_bits, intel_filesize):
+        self.window = 1 << window_bits
+        slots = 50 if window_bits == 21 else (42 if window_bits == 20 else window_bits * 2)
+        self.slots = slots
+        self.nmain = 256 + slots * 8
+        self.intel = intel_filesize
+        self.bw = BitWriter()
+        self.prev_main = [0] * self.nmain
+        self.prev_length = [0] * 249
+        self.R = [1, 1, 1]
+        self.frames = []  # compressed size of each frame
+        self.frame_start = 0
+        self.chains = {}
+
+    def slot_of(self, formatted):
+        s = 0
+        while s + 1 < self.slots and POSITION_BASE[s + 1] <= formatted:
+            s += 1
+        return s
+
+    def find(self, data, pos, limit):
+        maxlen = min(257, limit - pos)
+        if maxlen < 2:
+            return 0, 0
+        best_len, best_off = 0, 0
+        for off in self.R:
+            if off <= pos:
+                n = 0
+                while n < maxlen and data[pos + n] == data[pos + n - off]:
+                    n += 1
+                if n >= 2 and n > best_len:
+                    best_len, best_off = n, off
+        if maxlen >= 3:
+            for cand in reversed(self.chains.get(data[pos:pos + 3], [])[-48:]):
+                off = pos - cand
+                if off > self.window - 3:
+                    break
+                n = 0
+                while n < maxlen and data[pos + n] == data[cand + n]:
+                    n += 1
+                if n > best_len + 1:
+                    best_len, best_off = n, off
+        return best_len, best_off
+
+    def index(self, data, pos, n):
+        for p in range(pos, min(pos + n, len(data) - 2)):
+            self.chains.setdefault(data[p:p + 3], []).append(p)
+
+    def tokens(self, data, start, end):
+        out = []
+        pos = start
+        while pos < end:
+            limit = min(end, (pos // FRAME + 1) * FRAME)
+            n, off = self.find(data, pos, limit)
+            if n < 2 or (n == 2 and off not in self.R):
+                out.append((data[pos],))
+                self.index(data, pos, 1)
+                pos += 1
+                continue
+            if off == self.R[0]:
+                slot, extra, value = 0, 0, 0
+            elif off == self.R[1]:
+                slot, extra, value = 1, 0, 0
+                self.R[0], self.R[1] = self.R[1], self.R[0]
+            elif off == self.R[2]:
+                slot, extra, value = 2, 0, 0
+                self.R[0], self.R[2] = self.R[2], self.R[0]
+            else:
+                slot = self.slot_of(off + 2)
+                extra = EXTRA_BITS[slot]
+                value = off + 2 - POSITION_BASE[slot]
+                self.R = [off, self.R[0], self.R[1]]
+            out.append((n, slot, extra, value))
+            self.index(data, pos, n)
+            pos += n
+        return out
+
+    def write_lens(self, lens, prev):
+        z = [(p - l) % 17 for l, p in zip(lens, prev)]
+        freqs = [0] * 20
+        for v in z:
+            freqs[v] += 1
+        pre = huffman_lengths(freqs, 15)
+        codes = canonical_codes(pre)
+        for l in pre:
+            self.bw.bits(l, 4)
+        for v in z:
+            self.bw.bits(*codes[v])
+
+    def advance(self, pos, end_of_data):
+        """frames end on a 16-bit boundary"""
+        if pos % FRAME == 0 or pos == end_of_data:
+            self.bw.align()
+            self.frames.append(len(self.bw.out) - self.frame_start)
+            self.frame_start = len(self.bw.out)
+
+    def block(self, data, kind, start, end):
+        bw = self.bw
+        if start == 0:
+            bw.bits(1 if self.intel else 0, 1)
+            if self.intel:
+                bw.bits(self.intel >> 16, 16)
+                bw.bits(self.intel & 0xFFFF, 16)
+        size = end - start
+        bw.bits({"verbatim": 1, "aligned": 2, "uncompressed": 3}[kind], 3)
+        bw.bits(size >> 8, 16)
+        bw.bits(size & 0xFF, 8)
+        if kind == "uncompressed":
+            # 1..16 bits of padding, then R0-R2
+            bw.bits(0, 16 - bw.n if bw.n else 16)
+            bw.raw(struct.pack("<III", *self.R))
+            pos = start
+            while pos < end:
+                n = min(end, (pos // FRAME + 1) * FRAME) - pos
+                bw.raw(data[pos:pos + n])
+                self.index(data, pos, n)
+                pos += n
+                if pos == end and size & 1:
+                    bw.raw(b"\0")
+                self.advance(pos, len(data))
+            return
+        toks = self.tokens(data, start, end)
+        main = [0] * self.nmain
+        length = [0] * 249
+        aligned = [0] * 8
+        for t in toks:
+            if len(t) == 1:
+                main[t[0]] += 1
+                continue
+            n, slot, extra, value = t
+            header = min(n - 2, 7)
+            main[256 + slot * 8 + header] += 1
+            if header == 7:
+                length[n - 9] += 1
+            if kind == "aligned" and extra >= 3:
+                aligned[value & 7] += 1
+        if self.intel:
+            main[0xE8] += 1  # E8 translation starts with the first block that can code it
+        main_lens = huffman_lengths(main, 16)
+        length_lens = huffman_lengths(length, 16) if any(length) else [0] * 249
+        if kind == "aligned":
+            aligned_lens = huffman_lengths([max(f, 1) for f in aligned], 7)
+            for l in aligned_lens:
+                bw.bits(l, 3)
+            aligned_codes = canonical_codes(aligned_lens)
+        self.write_lens(main_lens[:256], self.prev_main[:256])
+        self.write_lens(main_lens[256:], self.prev_main[256:])
+        self.write_lens(length_lens, self.prev_length)
+        self.prev_main, self.prev_length = main_lens, length_lens
+        main_codes = canonical_codes(main_lens)
+        length_codes = canonical_codes(length_lens)
+        pos = start
+        for t in toks:
+            if len(t) == 1:
+                bw.bits(*main_codes[t[0]])
+                pos += 1
+            else:
+                n, slot, extra, value = t
+                header = min(n - 2, 7)
+                bw.bits(*main_codes[256 + slot * 8 + header])
+                if header == 7:
+                    bw.bits(*length_codes[n - 9])
+                if kind == "aligned" and extra >= 3:
+                    bw.bits(value >> 3, extra - 3)
+                    bw.bits(*aligned_codes[value & 7])
+                else:
+                    bw.bits(value, extra)
+                pos += n
+            self.advance(pos, len(data))
+
+
+def lzx_compress(data, window_bits, intel_filesize, plan):
+    """plan cycles (kind, size) blocks over data, returns (compressed frames, frame sizes)"""
+    if intel_filesize:
+        data = e8_encode(data, intel_filesize)
+    enc = LzxEncoder(window_bits, intel_filesize)
+    pos = 0
+    k = 0
+    while pos < len(data):
+        kind, size = plan[k % len(plan)]
+        end = min(len(data), pos + size)
+        enc.block(data, kind, pos, end)
+        pos = end
+        k += 1
+    out = bytes(enc.bw.out)
+    blocks = []
+    offset = 0
+    for i, n in enumerate(enc.frames):
+        blocks.append((out[offset:offset + n], min(FRAME, len(data) - i * FRAME)))
+        offset += n
+    return blocks
+
+
+def mszip_compress(data):
+    blocks = []
+    history = b""
+    for pos in range(0, len(data), FRAME):
+        chunk = data[pos:pos + FRAME]
+        c = zlib.compressobj(9, zlib.DEFLATED, -15, zdict=history) if history else zlib.compressobj(
+            9, zlib.DEFLATED, -15)
+        blocks.append((b"CK" + c.compress(chunk) + c.flush(), len(chunk)))
+        history = chunk
+    return blocks
+
+
+def stored(data):
+    return [(data[pos:pos + FRAME], len(data[pos:pos + FRAME])) for pos in range(0, len(data), FRAME)]
+
+
+# ---------- cabinet ----------
+def cabinet(folders):
+    """folders: [(typeCompress, encode, [(name, key)])], files of a folder are stored back to back"""
+    date = ((2021 - 1980) << 9) | (10 << 5) | 20
+    time = (12 << 11) | (30 << 5)
+    entries = []
+    datas = []
+    for index, (compress, encode, files) in enumerate(folders):
+        stream = b""
+        for name, key in files:
+            entries.append(struct.pack("<IIHHHH", len(CONTENTS[key]), len(stream), index, date, time, 0x20) +
+                           name.encode() + b"\0")
+            stream += CONTENTS[key]
+        datas.append((compress, encode(stream)))
+    header_size = 36
+    folders_size = 8 * len(folders)
+    files_size = sum(len(e) for e in entries)
+    offset = header_size + folders_size + files_size
+    folder_table = b""
+    data_area = b""
+    for compress, blocks in datas:
+        folder_table += struct.pack("<IHH", offset + len(data_area), len(blocks), compress)
+        for payload, uncompressed in blocks:
+            assert len(payload) <= FRAME + 6144
+            data_area += struct.pack("<IHH", 0, len(payload), uncompressed) + payload
+    total = offset + len(data_area)
+    header = b"MSCF" + struct.pack("<IIIIIBBHHHHH", 0, total, 0, header_size + folders_size, 0, 3, 1,
+                                   len(folders), len(entries), 0, 0x1234, 0)
+    return header + folder_table + b"".join(entries) + data_area
+
+
+def lzx(window_bits, intel_filesize=0, plan=(("verbatim", 65536),)):
+    return 3 | (window_bits << 8), lambda data: lzx_compress(data, window_bits, intel_filesize, plan)
+
+
+FIXTURES = {
+    "mszip.cab": [
+        (1, mszip_compress, [("readme.txt", "readme.txt"), ("random.bin", "random.bin"), ("empty.txt", "empty.txt"),
+                             ("zeros.bin", "zeros.bin")]),
+    ],
+    "lzx.cab": [
+        (*lzx(21, 60000, (("verbatim", 40000), ("aligned", 30000), ("uncompressed", 3001), ("verbatim", 70000),
+                          ("aligned", 20000))),
+         [("readme.txt", "readme.txt"), ("calls.bin", "calls.bin"), ("random.bin", "random.bin"),
+          ("zeros.bin", "zeros.bin"), ("empty.txt", "empty.txt")]),
+    ],
+    "multifolder.cab": [
+        (0, stored, [("docs\\empty.txt", "empty.txt"), ("docs\\readme.txt", "readme.txt")]),
+        (1, mszip_compress, [("random.bin", "random.bin")]),
+        (*lzx(15, 0, (("aligned", 32768), ("verbatim", 20000), ("uncompressed", 12345))),
+         [("lzx15\\readme.txt", "readme.txt"), ("lzx15\\zeros.bin", "zeros.bin")]),
+        (*lzx(16), [("lzx16\\calls.bin", "calls.bin"), ("lzx16\\random.bin", "random.bin")]),
+    ],
+}
+
+if __name__ == "__main__":
+    outdir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    for name, folders in FIXTURES.items():
+        with open(os.path.join(outdir, name), "wb") as f:
+            f.write(cabinet(folders))
+        print(name)
@@ -0,0 +1,220 @@
+// cab_test: decodes the fixtures written by cab/mkcab.py and compares every file with the bytes it was made from.
+// Folders are decoded on threads of their own, the way the extractor runs them. The cabinet is read through a
+// ReaderAt, the test only needs the portable parts of the reader and also builds outside Windows
+#include <bela/codecvt.hpp>
+#include <baulk/archive/cab.hpp>
+#include <baulk/archive/crc32.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef CAB_FIXTURES_DIR
+#define CAB_FIXTURES_DIR "cab"
+#endif
+
+// contents, keep in sync with mkcab.py
+static std::string xorshiftBytes(size_t size, uint64_t x) {
+  std::string out(size, '\0');
+  for (auto &c : out) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    c = static_cast<char>(x);
+  }
+  return out;
+}
+
+static std::string readmeText() {
+  std::string out;
+  char line[128];
+  for (int i = 0; i < 1500; i++) {
+    auto n = snprintf(line, sizeof(line), "%05d %s\r\n", i,
+                      "baulk cabinet fixture line, the quick brown fox jumps over the lazy dog");
+    out.append(line, static_cast<size_t>(n));
+  }
+  return out;
+}
+
+static std::string callRecords() {
+  std::string out;
+  constexpr std::string_view filler = "baulk-call\x90";
+  for (int k = 0; k < 5000; k++) {
+    auto rel = static_cast<uint32_t>((k * 7919) % 200000 - 100000);
+    out.push_back('\xE8');
+    for (int i = 0; i < 4; i++) {
+      out.push_back(static_cast<char>(rel >> (i * 8)));
+    }
+    out.append(filler);
+  }
+  return out;
+}
+
+struct content {
+  std::string bytes;
+  uint32_t crc32;
+};
+
+struct expected_file {
+  std::string_view name;
+  std::string_view key;
+};
+
+struct fixture {
+  std::string_view cabinet;
+  std::vector<expected_file> files;
+};
+
+static std::string narrow(const bela::error_code &ec) { return bela::encode_into<wchar_t, char>(ec.message); }
+
+static bool decodeCabinet(const fixture &fx, const std::map<std::string_view, content> &contents) {
+  auto path = std::string(CAB_FIXTURES_DIR).append("/").append(fx.cabinet);
+  auto in = std::make_shared<std::ifstream>(path, std::ios::binary | std::ios::ate);
+  if (!*in) {
+    fprintf(stderr, "\x1b[31m%s: unable open %s\x1b[0m\n", fx.cabinet.data(), path.data());
+    return false;
+  }
+  auto size = static_cast<int64_t>(in->tellg());
+  baulk::archive::cab::Reader reader;
+  bela::error_code ec;
+  // the reader serializes its block reads, the stream is never used by two folders at once
+  auto readerAt = [in](std::span<uint8_t> buffer, int64_t pos, bela::error_code &rec) {
+    auto len = static_cast<std::streamsize>(buffer.size());
+    if (!in->seekg(pos) || !in->read(reinterpret_cast<char *>(buffer.data()), len)) {
+      in->clear();
+      rec = bela::make_error_code(bela::ErrGeneral, L"short read at ", pos);
+      return false;
+    }
+    return true;
+  };
+  if (!reader.OpenReader(readerAt, size, ec)) {
+    fprintf(stderr, "\x1b[31m%s: %s\x1b[0m\n", fx.cabinet.data(), narrow(ec).data());
+    return false;
+  }
+  std::mutex mu;
+  std::map<std::string, std::string> out;
+  std::vector<bela::error_code> ecs(reader.Folders().size());
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < reader.Folders().size(); i++) {
+    workers.emplace_back([&, i] {
+      reader.DecompressFolder(
+          i,
+          [&](const baulk::archive::cab::File &file, baulk::archive::cab::Writer &w, bela::error_code &) {
+            std::scoped_lock lock(mu);
+            auto &buffer = out[file.name];
+            w = [&buffer](const void *data, size_t len) {
+              buffer.append(static_cast<const char *>(data), len);
+              return true;
+            };
+            return true;
+          },
+          ecs[i]);
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  bool ok = true;
+  for (size_t i = 0; i < ecs.size(); i++) {
+    if (ecs[i]) {
+      fprintf(stderr, "\x1b[31m%s folder %zu: %s\x1b[0m\n", fx.cabinet.data(), i, narrow(ecs[i]).data());
+      ok = false;
+    }
+  }
+  if (out.size() != fx.files.size()) {
+    fprintf(stderr, "\x1b[31m%s: %zu files extracted, want %zu\x1b[0m\n", fx.cabinet.data(), out.size(),
+            fx.files.size());
+    ok = false;
+  }
+  for (const auto &f : fx.files) {
+    const auto &want = contents.at(f.key);
+    auto it = out.find(std::string(f.name));
+    if (it == out.end()) {
+      fprintf(stderr, "\x1b[31m%s: %s not extracted\x1b[0m\n", fx.cabinet.data(), f.name.data());
+      ok = false;
+      continue;
+    }
+    auto crc = crc32_fast(it->second.data(), it->second.size());
+    if (it->second != want.bytes || crc != want.crc32) {
+      fprintf(stderr, "\x1b[31m%s: %s %zu bytes crc32 %08x, want %zu bytes crc32 %08x\x1b[0m\n", fx.cabinet.data(),
+              f.name.data(), it->second.size(), crc, want.bytes.size(), want.crc32);
+      ok = false;
+      continue;
+    }
+    fprintf(stderr, "%s: %s %zu bytes crc32 %08x\n", fx.cabinet.data(), f.name.data(), it->second.size(), crc);
+  }
+  return ok;
+}
+
+// rejectOverlappingTable moves the first CFDATA block of mszip.cab into its file table, the reader must refuse the
+// table instead of parsing compressed data as file entries
+static bool rejectOverlappingTable() {
+  auto path = std::string(CAB_FIXTURES_DIR).append("/mszip.cab");
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  constexpr size_t coffFilesOffset = 16;
+  constexpr size_t firstFolderOffset = 36; // CFHEADER without reserved fields
+  if (bytes.size() < firstFolderOffset + 4) {
+    fprintf(stderr, "\x1b[31munable read %s\x1b[0m\n", path.data());
+    return false;
+  }
+  uint32_t coffFiles = 0;
+  memcpy(&coffFiles, bytes.data() + coffFilesOffset, sizeof(coffFiles));
+  auto coffCabStart = coffFiles + 4;
+  memcpy(bytes.data() + firstFolderOffset, &coffCabStart, sizeof(coffCabStart));
+  baulk::archive::cab::Reader reader;
+  bela::error_code ec;
+  auto readerAt = [&bytes](std::span<uint8_t> buffer, int64_t pos, bela::error_code &rec) {
+    if (pos < 0 || static_cast<size_t>(pos) + buffer.size() > bytes.size()) {
+      rec = bela::make_error_code(bela::ErrGeneral, L"short read at ", pos);
+      return false;
+    }
+    memcpy(buffer.data(), bytes.data() + pos, buffer.size());
+    return true;
+  };
+  if (reader.OpenReader(readerAt, static_cast<int64_t>(bytes.size()), ec)) {
+    fprintf(stderr, "\x1b[31moverlapping file table accepted\x1b[0m\n");
+    return false;
+  }
+  fprintf(stderr, "overlapping file table: %s\n", narrow(ec).data());
+  return true;
+}
+
+int main() {
+  const std::map<std::string_view, content> contents = {
+      {"readme.txt", {readmeText(), 0x5DC250B5}},
+      {"random.bin", {xorshiftBytes(40000, 0x9E3779B97F4A7C15ULL), 0xB4187ACD}},
+      {"calls.bin", {callRecords(), 0xB2D5D485}},
+      {"zeros.bin", {std::string(50000, '\0'), 0x16B7B325}},
+      {"empty.txt", {std::string(), 0}},
+  };
+  const fixture fixtures[] = {
+      {"mszip.cab",
+       {{"readme.txt", "readme.txt"}, {"random.bin", "random.bin"}, {"empty.txt", "empty.txt"},
+        {"zeros.bin", "zeros.bin"}}},
+      {"lzx.cab",
+       {{"readme.txt", "readme.txt"},
+        {"calls.bin", "calls.bin"},
+        {"random.bin", "random.bin"},
+        {"zeros.bin", "zeros.bin"},
+        {"empty.txt", "empty.txt"}}},
+      {"multifolder.cab",
+       {{"docs/empty.txt", "empty.txt"},
+        {"docs/readme.txt", "readme.txt"},
+        {"random.bin", "random.bin"},
+        {"lzx15/readme.txt", "readme.txt"},
+        {"lzx15/zeros.bin", "zeros.bin"},
+        {"lzx16/calls.bin", "calls.bin"},
+        {"lzx16/random.bin", "random.bin"}}},
+  };
+  int failures = 0;
+  for (const auto &fx : fixtures) {
+    failures += decodeCabinet(fx, contents) ? 0 : 1;
+  }
+  failures += rejectOverlappingTable() ? 0 : 1;
+  fprintf(stderr, "%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// hashbench: throughput of belahash and the zip CRC32 across buffer sizes and SIMD dispatch paths.
+// Every path is checked against the portable digest first, a mismatch fails the run.
+// Output is CSV: algorithm,variant,size,iterations,seconds,mb_per_s[,baseline_mb_per_s,ratio]
+#include <bela/hash.hpp>
+#include <baulk/archive/crc32.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace bela::hash;
+
+struct variant_t {
+  const char *name;
+  uint32_t mask;
+};
+
+constexpr variant_t variants[] = {
+    {"portable", 0},
+    {"sse4.1", cpu_sse41},
+    {"avx2", cpu_sse41 | cpu_avx2},
+    {"avx512", cpu_sse41 | cpu_avx2 | cpu_avx512},
+#if defined(_M_ARM64) || defined(__aarch64__)
+    {"armv8-sha2", cpu_sha},
+#else
+    {"sha-ni", cpu_sha},
+#endif
+};
+
+// digest_fn hashes one message and writes its digest to out (at most 128 bytes), returns the digest size
+using digest_fn = size_t (*)(const uint8_t *data, size_t len, uint8_t *out);
+
+struct algorithm_t {
+  const char *name;
+  digest_fn digest;
+  uint32_t features; // dispatch features that change the code path
+  size_t lanes;      // messages hashed per call
+};
+
+static size_t sha256Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  sha256::Hasher h;
+  h.Initialize();
+  h.Update(data, len);
+  h.Finalize(out, sha256::sha256_hash_size);
+  return sha256::sha256_hash_size;
+}
+
+static size_t sha512Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  sha512::Hasher h;
+  h.Initialize();
+  h.Update(data, len);
+  h.Finalize(out, sha512::sha512_hash_size);
+  return sha512::sha512_hash_size;
+}
+
+static size_t sha3Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  sha3::Hasher h;
+  h.Initialize();
+  h.Update(data, len);
+  h.Finalize(out, sha3::sha3_256_hash_size);
+  return sha3::sha3_256_hash_size;
+}
+
+static size_t sha3x4Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  sha3::Hasher4 h;
+  h.Initialize();
+  const void *input[4] = {data, data, data, data};
+  h.Update(input, len);
+  for (auto &lane : h.lanes) {
+    lane.Finalize(out, sha3::sha3_256_hash_size);
+    out += sha3::sha3_256_hash_size;
+  }
+  return sha3::sha3_256_hash_size * 4;
+}
+
+static size_t blake3Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  blake3::Hasher h;
+  h.Initialize();
+  h.Update(data, len);
+  h.Finalize(out, BLAKE3_OUT_LEN);
+  return BLAKE3_OUT_LEN;
+}
+
+static size_t sm3Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  sm3::Hasher h;
+  h.Initialize();
+  h.Update(data, len);
+  h.Finalize(out, sm3::sm3_digest_length);
+  return sm3::sm3_digest_length;
+}
+
+static size_t crc32Digest(const uint8_t *data, size_t len, uint8_t *out) {
+  baulk::archive::Summator sum(0xFFFFFFFF); // any non-zero target enables the checksum
+  sum.Update(data, len);
+  auto crc = sum.Current();
+  memcpy(out, &crc, sizeof(crc));
+  return sizeof(crc);
+}
+
+constexpr algorithm_t algorithms[] = {
+    {"sha256", sha256Digest, cpu_sha, 1},
+    {"sha512", sha512Digest, 0, 1},
+    {"sha3-256", sha3Digest, cpu_avx512, 1},
+    {"sha3-256x4", sha3x4Digest, cpu_avx2, 4},
+    {"blake3", blake3Digest, cpu_sse41 | cpu_avx2 | cpu_avx512, 1},
+    {"sm3", sm3Digest, 0, 1},
+    {"crc32", crc32Digest, 0, 1},
+};
+
+struct options_t {
+  double seconds{0.2};
+  size_t maxSize{64 * 1024 * 1024};
+  const char *filter{nullptr};
+  const char *baseline{nullptr};
+};
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [--time ms] [--max-size bytes] [--filter algorithm] [--baseline results.csv]\n"
+          "  --time      minimum measuring time per case, default 200\n"
+          "  --max-size  largest buffer, sizes grow 4x from 64 bytes plus a few odd lengths, default 67108864\n"
+          "  --filter    only run algorithms whose name starts with this\n"
+          "  --baseline  CSV from an earlier run, adds the baseline throughput and the ratio\n",
+          prog);
+}
+
+static bool parseOptions(int argc, char **argv, options_t &opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--time") {
+      opts.seconds = strtod(value, nullptr) / 1000;
+    } else if (arg == "--max-size") {
+      opts.maxSize = static_cast<size_t>(strtoull(value, nullptr, 10));
+    } else if (arg == "--filter") {
+      opts.filter = value;
+    } else if (arg == "--baseline") {
+      opts.baseline = value;
+    } else {
+      return false;
+    }
+  }
+  return opts.seconds > 0 && opts.maxSize >= 64;
+}
+
+// bufferSizes: 64 bytes growing 4x, plus lengths that are not a multiple of any block size, so the scalar tails
+// after the SIMD blocks and the partial final block are measured and checked too
+static std::vector<size_t> bufferSizes(size_t maxSize) {
+  std::vector<size_t> sizes{1, 63, 1000, 4097, 1024 * 1024 + 1};
+  for (size_t size = 64; size <= maxSize; size *= 4) {
+    sizes.emplace_back(size);
+  }
+  std::erase_if(sizes, [&](size_t size) { return size > maxSize; });
+  std::sort(sizes.begin(), sizes.end());
+  return sizes;
+}
+
+// loadBaseline reads algorithm,variant,size -> mb_per_s from an earlier run
+static bool loadBaseline(const char *path, std::map<std::string, double> &baseline) {
+  FILE *fd = fopen(path, "r");
+  if (fd == nullptr) {
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), fd) != nullptr) {
+    std::string_view sv(line);
+    std::vector<std::string_view> fields;
+    for (size_t pos = 0;;) {
+      auto end = sv.find_first_of(",\r\n", pos);
+      fields.emplace_back(sv.substr(pos, end == std::string_view::npos ? end : end - pos));
+      if (end == std::string_view::npos || sv[end] != ',') {
+        break;
+      }
+      pos = end + 1;
+    }
+    if (fields.size() < 6 || fields[0] == "algorithm") {
+      continue;
+    }
+    std::string key;
+    key.append(fields[0]).append(",").append(fields[1]).append(",").append(fields[2]);
+    baseline[key] = strtod(std::string(fields[5]).data(), nullptr);
+  }
+  fclose(fd);
+  return true;
+}
+
+// measure runs whole batches of the digest until the time budget is spent
+static void measure(const algorithm_t &a, const uint8_t *data, size_t size, double budget, uint64_t &iterations,
+                    double &seconds) {
+  uint8_t out[128];
+  auto batch = (std::max)(static_cast<size_t>(1), static_cast<size_t>(1024 * 1024) / size);
+  iterations = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (;;) {
+    for (size_t i = 0; i < batch; i++) {
+      a.digest(data, size, out);
+    }
+    iterations += batch;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds >= budget) {
+      return;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  options_t opts;
+  if (!parseOptions(argc, argv, opts)) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::map<std::string, double> baseline;
+  if (opts.baseline != nullptr && !loadBaseline(opts.baseline, baseline)) {
+    fprintf(stderr, "unable open baseline %s\n", opts.baseline);
+    return 1;
+  }
+  std::vector<uint8_t> buffer(opts.maxSize);
+  uint64_t x = 0x9E3779B97F4A7C15ULL;
+  for (auto &b : buffer) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    b = static_cast<uint8_t>(x);
+  }
+  auto supported = SupportedCpuFeatures();
+  printf("algorithm,variant,size,iterations,seconds,mb_per_s%s\n",
+         opts.baseline != nullptr ? ",baseline_mb_per_s,ratio" : "");
+  int mismatches = 0;
+  for (const auto &a : algorithms) {
+    if (opts.filter != nullptr && strncmp(a.name, opts.filter, strlen(opts.filter)) != 0) {
+      continue;
+    }
+    // variants that pick the same code path for this algorithm run once, under the first name
+    std::vector<const variant_t *> paths;
+    std::vector<uint32_t> seen;
+    for (const auto &v : variants) {
+      if ((v.mask & ~supported) != 0) {
+        continue;
+      }
+      auto effective = v.mask & a.features;
+      if (v.mask != 0 && effective == 0) {
+        continue;
+      }
+      if (std::find(seen.begin(), seen.end(), effective) != seen.end()) {
+        continue;
+      }
+      seen.emplace_back(effective);
+      paths.emplace_back(&v);
+    }
+    for (auto size : bufferSizes(opts.maxSize)) {
+      uint8_t expected[128];
+      size_t expectedSize = 0;
+      for (const auto *v : paths) {
+        RestrictCpuFeatures(v->mask);
+        uint8_t out[128];
+        auto n = a.digest(buffer.data(), size, out);
+        if (v->mask == 0) {
+          memcpy(expected, out, n);
+          expectedSize = n;
+        } else if (n != expectedSize || memcmp(expected, out, n) != 0) {
+          fprintf(stderr, "mismatch: %s %s size %zu differs from the portable digest\n", a.name, v->name, size);
+          mismatches++;
+          continue;
+        }
+        uint64_t iterations = 0;
+        double seconds = 0;
+        measure(a, buffer.data(), size, opts.seconds, iterations, seconds);
+        auto mbps = static_cast<double>(iterations) * static_cast<double>(size * a.lanes) / seconds / 1e6;
+        printf("%s,%s,%zu,%llu,%.6f,%.2f", a.name, v->name, size, static_cast<unsigned long long>(iterations), seconds,
+               mbps);
+        if (opts.baseline != nullptr) {
+          auto it = baseline.find(std::string(a.name) + "," + v->name + "," + std::to_string(size));
+          if (it != baseline.end() && it->second > 0) {
+            printf(",%.2f,%.3f", it->second, mbps / it->second);
+          } else {
+            printf(",,");
+          }
+        }
+        printf("\n");
+        fflush(stdout);
+      }
+    }
+  }
+  RestrictCpuFeatures(cpu_all);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+# mkinno.py: writes the Inno Setup fixtures read by inno_test.cc, setup-0 and setup-1 as they follow the loader exe
+#   inno60.bin  6.0 layout: 30 header strings, SHA-1 checksums, one LZMA1 chunk and a stored chunk
+#   inno64.bin  6.4 layout: 32 header strings, SHA-256 checksums, zlib chunks
+#   lzma2.bin   6.2 layout with LZMA2 and bzip2 chunks
+# Only the fields the reader looks at carry meaning, the rest is filler of the right size. File contents are
+# generated, inno_test.cc builds the same bytes to compare with.
+import bz2
+import hashlib
+import lzma
+import os
+import struct
+import sys
+import zlib
+
+BLOCK_CHUNK = 4096
+FILETIME = 133000000000000000  # 2022-06-19
+CALL_INSTRUCTION_BLOCK = 65536
+
+# TSetupFileLocationEntry flags
+TIMESTAMP_IN_UTC = 1 << 2
+CALL_INSTRUCTION_OPTIMIZED = 1 << 4
+CHUNK_COMPRESSED = 1 << 7
+
+
+# ---------- contents, keep in sync with inno_test.cc ----------
+def xorshift_bytes(size, seed):
+    x = seed
+    out = bytearray(size)
+    for i in range(size):
+        x ^= (x << 13) & 0xFFFFFFFFFFFFFFFF
+        x ^= x >> 7
+        x ^= (x << 17) & 0xFFFFFFFFFFFFFFFF
+        out[i] = x & 0xFF
+    return bytes(out)
+
+
+def readme_text():
+    return b"".join(b"%05d baulk inno fixture line, the quick brown fox jumps over the lazy dog\r\n" % i
+                    for i in range(1500))
+
+
+def call_records():
+    # x86 like records: E8/E9 + rel32 + filler, long enough to span several 64 KiB transform blocks
+    out = bytearray()
+    for k in range(12000):
+        rel = (k * 7919) % 200000 - 100000
+        out += (b"\xe8" if k % 3 else b"\xe9") + struct.pack("<i", rel) + b"baulk-call\x90"
+    return bytes(out)
+
+
+CONTENTS = {
+    "readme.txt": readme_text(),
+    "random.bin": xorshift_bytes(40000, 0x9E3779B97F4A7C15),
+    "calls.exe": call_records(),
+    "zeros.bin": bytes(50000),
+    "empty.txt": b"",
+}
+
+
+# ---------- Compression.Base.pas TransformCallInstructions, encode direction ----------
+def transform_call_instructions(data, offset):
+    p = bytearray(data)
+    i = 0
+    while i < len(p) - 4:
+        if p[i] != 0xE8 and p[i] != 0xE9:
+            i += 1
+            continue
+        i += 1
+        if p[i + 3] == 0x00 or p[i + 3] == 0xFF:
+            addr = (offset + i + 4) & 0xFFFFFF
+            rel = p[i] | p[i + 1] << 8 | p[i + 2] << 16
+            if rel & 0x800000:
+                p[i + 3] ^= 0xFF
+            rel = (rel + addr) & 0xFFFFFF
+            p[i:i + 3] = bytes([rel & 0xFF, (rel >> 8) & 0xFF, rel >> 16])
+        i += 4
+    return bytes(p)
+
+
+def call_optimize(data):
+    return b"".join(transform_call_instructions(data[i:i + CALL_INSTRUCTION_BLOCK], i)
+                    for i in range(0, len(data), CALL_INSTRUCTION_BLOCK))
+
+
+# ---------- compressors ----------
+def lzma1(data):
+    # 5 bytes properties (lc=3 lp=0 pb=2, 1 MiB dictionary) + raw lzma
+    dict_size = 1 << 20
+    raw = lzma.compress(data, format=lzma.FORMAT_RAW,
+                        filters=[{"id": lzma.FILTER_LZMA1, "dict_size": dict_size, "lc": 3, "lp": 0, "pb": 2}])
+    return bytes([(2 * 5 + 0) * 9 + 3]) + struct.pack("<I", dict_size) + raw
+
+
+def lzma2(data):
+    # 1 byte dictionary size (code 16: 1 MiB) + raw lzma2
+    raw = lzma.compress(data, format=lzma.FORMAT_RAW, filters=[{"id": lzma.FILTER_LZMA2, "dict_size": 1 << 20}])
+    return bytes([16]) + raw
+
+
+def stored(data):
+    return data
+
+
+METHODS = {
+    "stored": stored,
+    "lzma1": lzma1,
+    "lzma2": lzma2,
+    "zlib": lambda data: zlib.compress(data, 9),
+    "bzip2": lambda data: bz2.compress(data, 9),
+}
+
+
+# ---------- setup-0 records ----------
+def wide(s):
+    b = s.encode("utf-16-le")
+    return struct.pack("<I", len(b)) + b
+
+
+def ansi(b):
+    return struct.pack("<I", len(b)) + b
+
+
+def filler(size, seed):
+    return xorshift_bytes(size, seed) if size > 0 else b""
+
+
+def block(payload, compress):
+    """crc32 of the next 5 bytes, stored size, compressed flag, then 4096-byte chunks with their own crc32"""
+    data = lzma1(payload) if compress else payload
+    stored = b"".join(struct.pack("<I", zlib.crc32(data[i:i + BLOCK_CHUNK])) + data[i:i + BLOCK_CHUNK]
+                      for i in range(0, len(data), BLOCK_CHUNK))
+    size = struct.pack("<IB", len(stored), 1 if compress else 0)
+    return struct.pack("<I", zlib.crc32(size)) + size + stored
+
+
+def language_entry(name):
+    # Name, LanguageName, DialogFontName, TitleFontName, WelcomeFontName, CopyrightFontName, 4 ansi strings,
+    # LanguageID, LanguageCodePage, font sizes, RightToLeft
+    out = wide(name) + wide(name.capitalize()) + wide("Segoe UI") + wide("Arial") + wide("Verdana") + wide("Arial")
+    out += ansi(b"") + ansi(b"{\\rtf1 license}") + ansi(b"") + ansi(b"")
+    return out + struct.pack("<II", 0x0409, 0) + filler(13, 0x11)
+
+
+def custom_message_entry(name, value, language):
+    return wide(name) + wide(value) + struct.pack("<i", language)
+
+
+def type_entry(name):
+    return wide(name) + wide(name.capitalize()) + wide("") + wide("") + filler(30, 0x22)
+
+
+def directory_entry(name):
+    return wide(name) + b"".join(wide("") for _ in range(6)) + filler(27, 0x33)
+
+
+def file_entry(source, dest, location, file_type=0):
+    out = wide(source) + wide(dest) + b"".join(wide("") for _ in range(8))
+    out += filler(20, 0x44)  # MinVersion, OnlyBelowVersion
+    out += struct.pack("<iIqhI", location, 0x20, 0, -1, 0x00010000)
+    return out + bytes([file_type])
+
+
+def location_entry(chunk_offset, suboffset, size, chunk_size, checksum, flags, flags_size):
+    out = struct.pack("<IIIQQQ", 0, 0, chunk_offset, suboffset, size, chunk_size) + checksum
+    out += struct.pack("<QII", FILETIME, 0x00010002, 0x00030004)
+    return out + flags.to_bytes(flags_size, "little")
+
+
+def setup(version, header_strings, header_tail, sha256, chunks, files):
+    """chunks: (method, [content keys]), files: (dest name, chunk index, key index) in entry order"""
+    # setup-1: every chunk is 'zlb' 0x1A + compressed data, files follow each other inside
+    setup1 = bytearray()
+    locations = []
+    for method, keys in chunks:
+        suboffset = 0
+        plain = bytearray()
+        entries = []
+        for key in keys:
+            data = CONTENTS[key]
+            flags = TIMESTAMP_IN_UTC | (CHUNK_COMPRESSED if method != "stored" else 0)
+            if key.endswith(".exe"):
+                flags |= CALL_INSTRUCTION_OPTIMIZED
+                plain += call_optimize(data)
+            else:
+                plain += data
+            digest = hashlib.sha256(data).digest() if sha256 else hashlib.sha1(data).digest()
+            entries.append((suboffset, len(data), digest, flags))
+            suboffset += len(data)
+        compressed = METHODS[method](bytes(plain))
+        for suboffset, size, digest, flags in entries:
+            locations.append(location_entry(len(setup1), suboffset, size, len(compressed), digest, flags, 2))
+        setup1 += b"zlb\x1a" + compressed
+    location_index = []
+    for i, (_, keys) in enumerate(chunks):
+        location_index += [(i, k) for k in range(len(keys))]
+
+    file_entries = []
+    for dest, chunk, key in files:
+        location = location_index.index((chunk, key)) if chunk >= 0 else -1
+        source = chunks[chunk][1][key] if chunk >= 0 else ""
+        file_entries.append(file_entry(source, dest, location))
+
+    header = wide("Baulk Fixture") + wide("baulk-fixture") + wide("{app}")
+    header += b"".join(wide("header string %d" % i) for i in range(header_strings - 3))
+    header += ansi(b"") + ansi(b"license") + ansi(b"") + ansi(b"\x01compiled code\x00\xff")
+    counts = [2, 1, 1, 1, 0, 0, 1, len(file_entries), len(locations), 0, 0, 0, 0, 0, 0, 0]
+    header += struct.pack("<16I", *counts)
+    header += filler(header_tail, 0x55)
+    entries = language_entry("english") + language_entry("german")
+    entries += custom_message_entry("NameAndVersion", "%1 version %2", -1)
+    entries += ansi(b"\x01\x02")  # permission
+    entries += type_entry("full")
+    entries += directory_entry("{app}\\data")
+    entries += b"".join(file_entries)
+    setup0 = version.encode().ljust(64, b"\x00")
+    setup0 += block(header + entries, True)
+    setup0 += block(b"".join(locations), False)
+    return setup0 + bytes(setup1)
+
+
+FIXTURES = {
+    "inno60.bin": lambda: setup(
+        "Inno Setup Setup Data (6.0.0) (u)", 30, 201, False,
+        [("lzma1", ["readme.txt", "calls.exe", "random.bin", "empty.txt"]), ("stored", ["zeros.bin"])],
+        [("{app}\\readme.txt", 0, 0), ("{app}\\bin\\calls.exe", 0, 1), ("{tmp}\\random.bin", 0, 2),
+         ("{app}\\data\\random.bin", 0, 2), ("{app}\\{{braces}.txt", 0, 3), ("{app}\\zeros.bin", 1, 0),
+         ("{sys}\\zeros.bin", 1, 0), ("{app}\\{#Missing}.bin", 0, 3), ("{APP}\\README.TXT", 0, 2)]),
+    "inno64.bin": lambda: setup(
+        "Inno Setup Setup Data (6.4.0) (u)", 32, 237, True,
+        [("zlib", ["readme.txt", "random.bin"]), ("zlib", ["calls.exe", "zeros.bin", "empty.txt"])],
+        [("{app}\\doc\\readme.txt", 0, 0), ("{app}\\random.bin", 0, 1), ("{app}\\calls.exe", 1, 0),
+         ("{app}\\zeros.bin", 1, 1), ("{app}\\empty.txt", 1, 2)]),
+    "lzma2.bin": lambda: setup(
+        "Inno Setup Setup Data (6.2.0) (u)", 30, 223, False,
+        [("lzma2", ["readme.txt", "calls.exe"]), ("bzip2", ["random.bin", "zeros.bin"])],
+        [("{app}\\readme.txt", 0, 0), ("{app}\\calls.exe", 0, 1), ("{app}\\random.bin", 1, 0),
+         ("{app}\\zeros.bin", 1, 1)]),
+}
+
+if __name__ == "__main__":
+    outdir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    for name, make in FIXTURES.items():
+        with open(os.path.join(outdir, name), "wb") as f:
+            f.write(make())
+        print(name)
@@ -0,0 +1,229 @@
+// inno_test: reads the setup data written by inno/mkinno.py and compares every file under {app} with the bytes it
+// was made from. Files are decoded in reverse order as well, every chunk is restarted then. The setup data is read
+// through a ReaderAt, the test only needs the portable parts of the reader and also builds outside Windows
+#include <bela/codecvt.hpp>
+#include <baulk/archive/format.hpp>
+#include <baulk/archive/inno.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#ifndef INNO_FIXTURES_DIR
+#define INNO_FIXTURES_DIR "inno"
+#endif
+
+// contents, keep in sync with mkinno.py
+static std::string xorshiftBytes(size_t size, uint64_t x) {
+  std::string out(size, '\0');
+  for (auto &c : out) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    c = static_cast<char>(x);
+  }
+  return out;
+}
+
+static std::string readmeText() {
+  std::string out;
+  char line[128];
+  for (int i = 0; i < 1500; i++) {
+    auto n = snprintf(line, sizeof(line), "%05d %s\r\n", i,
+                      "baulk inno fixture line, the quick brown fox jumps over the lazy dog");
+    out.append(line, static_cast<size_t>(n));
+  }
+  return out;
+}
+
+static std::string callRecords() {
+  std::string out;
+  constexpr std::string_view filler = "baulk-call\x90";
+  for (int k = 0; k < 12000; k++) {
+    auto rel = static_cast<uint32_t>((k * 7919) % 200000 - 100000);
+    out.push_back(k % 3 != 0 ? '\xE8' : '\xE9');
+    for (int i = 0; i < 4; i++) {
+      out.push_back(static_cast<char>(rel >> (i * 8)));
+    }
+    out.append(filler);
+  }
+  return out;
+}
+
+struct expected_file {
+  std::string_view name;
+  std::string_view key;
+};
+
+struct fixture {
+  std::string_view setup;
+  std::vector<expected_file> files;
+};
+
+static std::string narrow(const bela::error_code &ec) { return bela::encode_into<wchar_t, char>(ec.message); }
+
+static std::string readFixture(std::string_view name) {
+  auto path = std::string(INNO_FIXTURES_DIR).append("/").append(name);
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static baulk::archive::inno::ReaderAt memoryReaderAt(const std::string &bytes) {
+  return [&bytes](std::span<uint8_t> buffer, int64_t pos, bela::error_code &rec) {
+    if (pos < 0 || static_cast<size_t>(pos) + buffer.size() > bytes.size()) {
+      rec = bela::make_error_code(bela::ErrGeneral, L"short read at ", pos);
+      return false;
+    }
+    memcpy(buffer.data(), bytes.data() + pos, buffer.size());
+    return true;
+  };
+}
+
+static bool decodeSetup(const fixture &fx, const std::map<std::string_view, std::string> &contents, bool reverse) {
+  auto bytes = readFixture(fx.setup);
+  if (bytes.empty()) {
+    fprintf(stderr, "\x1b[31m%s: unable read fixture\x1b[0m\n", fx.setup.data());
+    return false;
+  }
+  baulk::archive::inno::Reader reader;
+  bela::error_code ec;
+  if (!reader.OpenReader(memoryReaderAt(bytes), static_cast<int64_t>(bytes.size()), ec)) {
+    fprintf(stderr, "\x1b[31m%s: %s\x1b[0m\n", fx.setup.data(), narrow(ec).data());
+    return false;
+  }
+  std::vector<const baulk::archive::inno::File *> files;
+  for (const auto &file : reader.Files()) {
+    files.emplace_back(&file);
+  }
+  if (reverse) {
+    std::reverse(files.begin(), files.end());
+  }
+  bool ok = true;
+  std::map<std::string, std::string> out;
+  for (const auto *file : files) {
+    auto &buffer = out[file->name];
+    if (!reader.Decompress(
+            *file,
+            [&buffer](const void *data, size_t len) {
+              buffer.append(static_cast<const char *>(data), len);
+              return true;
+            },
+            ec)) {
+      fprintf(stderr, "\x1b[31m%s: %s: %s\x1b[0m\n", fx.setup.data(), file->name.data(), narrow(ec).data());
+      ok = false;
+    }
+  }
+  if (out.size() != fx.files.size()) {
+    fprintf(stderr, "\x1b[31m%s: %zu files listed, want %zu\x1b[0m\n", fx.setup.data(), out.size(), fx.files.size());
+    ok = false;
+  }
+  for (const auto &f : fx.files) {
+    const auto &want = contents.at(f.key);
+    auto it = out.find(std::string(f.name));
+    if (it == out.end()) {
+      fprintf(stderr, "\x1b[31m%s: %s not listed\x1b[0m\n", fx.setup.data(), f.name.data());
+      ok = false;
+      continue;
+    }
+    if (it->second != want) {
+      fprintf(stderr, "\x1b[31m%s: %s %zu bytes, want %zu bytes of %s\x1b[0m\n", fx.setup.data(), f.name.data(),
+              it->second.size(), want.size(), f.key.data());
+      ok = false;
+      continue;
+    }
+    if (!reverse) {
+      fprintf(stderr, "%s: %s %zu bytes\n", fx.setup.data(), f.name.data(), it->second.size());
+    }
+  }
+  return ok;
+}
+
+// rejectCorruptData flips one byte of the stored chunk of inno60.bin, the checksum must catch it
+static bool rejectCorruptData() {
+  auto bytes = readFixture("inno60.bin");
+  auto pos = bytes.rfind("zlb\x1a");
+  if (pos == std::string::npos || pos + 1000 > bytes.size()) {
+    fprintf(stderr, "\x1b[31munable find the stored chunk of inno60.bin\x1b[0m\n");
+    return false;
+  }
+  bytes[pos + 1000] ^= 0x01;
+  baulk::archive::inno::Reader reader;
+  bela::error_code ec;
+  if (!reader.OpenReader(memoryReaderAt(bytes), static_cast<int64_t>(bytes.size()), ec)) {
+    fprintf(stderr, "\x1b[31mcorrupt data: %s\x1b[0m\n", narrow(ec).data());
+    return false;
+  }
+  for (const auto &file : reader.Files()) {
+    if (file.name != "zeros.bin") {
+      continue;
+    }
+    if (reader.Decompress(file, [](const void *, size_t) { return true; }, ec)) {
+      fprintf(stderr, "\x1b[31mcorrupt data accepted\x1b[0m\n");
+      return false;
+    }
+    fprintf(stderr, "corrupt data: %s\n", narrow(ec).data());
+    return true;
+  }
+  fprintf(stderr, "\x1b[31mcorrupt data: zeros.bin not listed\x1b[0m\n");
+  return false;
+}
+
+// declineUnsupported: ANSI and pre 5.5 setup data goes to innoextract, the reader must answer ErrAnotherWay
+static bool declineUnsupported() {
+  auto bytes = readFixture("inno60.bin");
+  constexpr std::string_view ansiId = "Inno Setup Setup Data (5.1.0)";
+  memset(bytes.data(), 0, 64);
+  memcpy(bytes.data(), ansiId.data(), ansiId.size());
+  baulk::archive::inno::Reader reader;
+  bela::error_code ec;
+  if (reader.OpenReader(memoryReaderAt(bytes), static_cast<int64_t>(bytes.size()), ec)) {
+    fprintf(stderr, "\x1b[31mANSI setup data accepted\x1b[0m\n");
+    return false;
+  }
+  if (ec != baulk::archive::ErrAnotherWay) {
+    fprintf(stderr, "\x1b[31mANSI setup data: %s, want ErrAnotherWay\x1b[0m\n", narrow(ec).data());
+    return false;
+  }
+  fprintf(stderr, "ANSI setup data: %s\n", narrow(ec).data());
+  return true;
+}
+
+int main() {
+  const std::map<std::string_view, std::string> contents = {
+      {"readme.txt", readmeText()},
+      {"random.bin", xorshiftBytes(40000, 0x9E3779B97F4A7C15ULL)},
+      {"calls.exe", callRecords()},
+      {"zeros.bin", std::string(50000, '\0')},
+      {"empty.txt", std::string()},
+  };
+  // {tmp}, {sys} and names with unresolved constants are left out, the later README.TXT entry replaces readme.txt
+  const fixture fixtures[] = {
+      {"inno60.bin",
+       {{"README.TXT", "random.bin"},
+        {"bin/calls.exe", "calls.exe"},
+        {"data/random.bin", "random.bin"},
+        {"{braces}.txt", "empty.txt"},
+        {"zeros.bin", "zeros.bin"}}},
+      {"inno64.bin",
+       {{"doc/readme.txt", "readme.txt"},
+        {"random.bin", "random.bin"},
+        {"calls.exe", "calls.exe"},
+        {"zeros.bin", "zeros.bin"},
+        {"empty.txt", "empty.txt"}}},
+      {"lzma2.bin",
+       {{"readme.txt", "readme.txt"},
+        {"calls.exe", "calls.exe"},
+        {"random.bin", "random.bin"},
+        {"zeros.bin", "zeros.bin"}}},
+  };
+  int failures = 0;
+  for (const auto &fx : fixtures) {
+    failures += decodeSetup(fx, contents, false) ? 0 : 1;
+    failures += decodeSetup(fx, contents, true) ? 0 : 1;
+  }
+  failures += rejectCorruptData() ? 0 : 1;
+  failures += declineUnsupported() ? 0 : 1;
+  fprintf(stderr, "%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
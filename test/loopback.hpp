@@ -0,0 +1,272 @@
+// loopback: HTTP stand-in on 127.0.0.1 shared by the download tests. Serves a random payload with Range support
+// and small documents, counts connections and records the Range requests so a test can check what was asked for.
+// Winsock on Windows, POSIX sockets elsewhere
+#ifndef BAULK_TEST_LOOPBACK_HPP
+#define BAULK_TEST_LOOPBACK_HPP
+#include <bela/terminal.hpp>
+#include <bela/hash.hpp>
+#include <baulk/net/client.hpp>
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace loopback {
+#if !defined(_WIN32)
+using SOCKET = int;
+constexpr SOCKET INVALID_SOCKET = -1;
+inline int closesocket(SOCKET s) { return close(s); }
+#endif
+
+struct options {
+  size_t payloadSize{0};
+  size_t connectionRate{0}; // bytes per second on one connection, 0 does not throttle
+  bool keepAlive{true};     // false closes the connection after every response
+};
+
+class server {
+public:
+  server(const options &opts_) : opts(opts_) {}
+  server(const server &) = delete;
+  server &operator=(const server &) = delete;
+  ~server() {
+    if (listener != INVALID_SOCKET) {
+      closesocket(listener);
+    }
+  }
+  // Document serves body as application/json at path, add documents before Start
+  void Document(std::string path, std::string body) { documents.emplace(std::move(path), std::move(body)); }
+  bool Start(bela::error_code &ec);
+  std::wstring URL(std::wstring_view path) const { return bela::StringCat(L"http://127.0.0.1:", port, path); }
+  const std::wstring &Hash() const { return hash; }
+  size_t PayloadSize() const { return payload.size(); }
+  // Drop breaks the next n responses halfway through their body
+  void Drop(int n) { dropBudget = n; }
+  int Accepted() const { return accepted.load(); }
+  std::vector<int64_t> RangeStarts() {
+    std::scoped_lock lock(rangeMutex);
+    return rangeStarts;
+  }
+  void ClearRangeStarts() {
+    std::scoped_lock lock(rangeMutex);
+    rangeStarts.clear();
+  }
+
+private:
+  options opts;
+  SOCKET listener{INVALID_SOCKET};
+  int port{0};
+  std::vector<char> payload;
+  std::wstring hash;
+  std::map<std::string, std::string, std::less<>> documents;
+  std::atomic_int dropBudget{0};
+  std::atomic_int accepted{0};
+  std::mutex rangeMutex;
+  std::vector<int64_t> rangeStarts; // first byte of every Range request served
+  void serveConnection(SOCKET s);
+  bool sendBody(SOCKET s, const char *data, size_t size);
+};
+
+inline bool readRequest(SOCKET s, std::string &pending, std::string &request) {
+  char buffer[4096];
+  size_t end = 0;
+  while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+    auto n = recv(s, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return false;
+    }
+    pending.append(buffer, static_cast<size_t>(n));
+  }
+  request = pending.substr(0, end + 4);
+  pending.erase(0, end + 4);
+  return true;
+}
+
+inline bool sendFull(SOCKET s, const char *data, size_t size) {
+  while (size > 0) {
+#if defined(_WIN32)
+    auto n = send(s, data, static_cast<int>((std::min)(size, static_cast<size_t>(1024 * 1024))), 0);
+#else
+    // a client that gave up must not end the test with SIGPIPE
+    auto n = send(s, data, (std::min)(size, static_cast<size_t>(1024 * 1024)), MSG_NOSIGNAL);
+#endif
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// sendBody paces the body to connectionRate when it is set
+inline bool server::sendBody(SOCKET s, const char *data, size_t size) {
+  if (opts.connectionRate == 0) {
+    return sendFull(s, data, size);
+  }
+  constexpr size_t chunk = 64 * 1024;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t sent = 0; sent < size;) {
+    auto n = (std::min)(chunk, size - sent);
+    if (!sendFull(s, data + sent, n)) {
+      return false;
+    }
+    sent += n;
+    std::this_thread::sleep_until(start + std::chrono::microseconds(sent * 1000000 / opts.connectionRate));
+  }
+  return true;
+}
+
+inline void server::serveConnection(SOCKET s) {
+  accepted++;
+  // header and body go out in separate sends, Nagle would hold the body back for the delayed ACK of the client
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+  auto connection = opts.keepAlive ? "keep-alive" : "close";
+  std::string pending;
+  std::string request;
+  while (readRequest(s, pending, request)) {
+    char header[512];
+    auto path = std::string_view(request).substr(0, request.find(' ', 4)).substr(4);
+    if (auto it = documents.find(path); request.starts_with("GET ") && it != documents.end()) {
+      auto hn = snprintf(header, sizeof(header),
+                         "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                         "Connection: %s\r\n\r\n",
+                         it->second.size(), connection);
+      if (!sendFull(s, header, static_cast<size_t>(hn)) || !sendFull(s, it->second.data(), it->second.size()) ||
+          !opts.keepAlive) {
+        break;
+      }
+      continue;
+    }
+    size_t first = 0;
+    size_t last = payload.size() - 1;
+    bool ranged = false;
+    if (auto pos = request.find("Range: bytes="); pos != std::string::npos) {
+      ranged = true;
+      auto spec = request.substr(pos + 13, request.find("\r\n", pos) - pos - 13);
+      first = static_cast<size_t>(strtoull(spec.data(), nullptr, 10));
+      if (auto dash = spec.find('-'); dash + 1 < spec.size()) {
+        last = static_cast<size_t>(strtoull(spec.data() + dash + 1, nullptr, 10));
+      }
+      std::scoped_lock lock(rangeMutex);
+      rangeStarts.push_back(static_cast<int64_t>(first));
+    }
+    auto length = last - first + 1;
+    auto hn = ranged ? snprintf(header, sizeof(header),
+                                "HTTP/1.1 206 Partial Content\r\nContent-Length: %zu\r\n"
+                                "Content-Range: bytes %zu-%zu/%zu\r\nAccept-Ranges: bytes\r\nConnection: %s\r\n\r\n",
+                                length, first, last, payload.size(), connection)
+                     : snprintf(header, sizeof(header),
+                                "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n"
+                                "Accept-Ranges: bytes\r\nConnection: %s\r\n\r\n",
+                                length, connection);
+    if (!sendFull(s, header, static_cast<size_t>(hn))) {
+      break;
+    }
+    if (dropBudget.fetch_sub(1) > 0) {
+      sendBody(s, payload.data() + first, length / 2);
+      break;
+    }
+    if (!sendBody(s, payload.data() + first, length) || !opts.keepAlive) {
+      break;
+    }
+  }
+  closesocket(s);
+}
+
+// Start fills the payload with xorshift bytes and accepts connections on a thread of its own
+inline bool server::Start(bela::error_code &ec) {
+#if defined(_WIN32)
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+    ec = bela::make_system_error_code(L"WSAStartup: ");
+    return false;
+  }
+  int addrlen = sizeof(sockaddr_in);
+#else
+  socklen_t addrlen = sizeof(sockaddr_in);
+#endif
+  payload.resize(opts.payloadSize);
+  uint64_t x = 0x9E3779B97F4A7C15ULL;
+  for (auto &c : payload) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    c = static_cast<char>(x);
+  }
+  bela::hash::sha256::Hasher h;
+  h.Initialize();
+  h.Update(payload.data(), payload.size());
+  hash = bela::StringCat(L"SHA256:", h.Finalize());
+  listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (listener == INVALID_SOCKET || bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 16) != 0 || getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen) != 0) {
+#if defined(_WIN32)
+    ec = bela::make_system_error_code(L"listen: ");
+#else
+    ec = bela::make_error_code(errno, L"listen: ", bela::encode_into<char, wchar_t>(strerror(errno)));
+#endif
+    return false;
+  }
+  port = ntohs(addr.sin_port);
+  std::thread([this] {
+    for (;;) {
+      auto s = accept(listener, nullptr, nullptr);
+      if (s == INVALID_SOCKET) {
+        return;
+      }
+      std::thread([this, s] { serveConnection(s); }).detach();
+    }
+  }).detach();
+  return true;
+}
+
+struct download_result {
+  bool ok{false};
+  double seconds{0};
+  std::filesystem::path file; // already removed, a broken run leaves its part file for the next one
+  bela::error_code ec;
+};
+
+// Download runs one WinGet into the temp folder
+inline download_result Download(const std::wstring &url, const std::wstring &hash, uint32_t connections) {
+  download_result r;
+  auto start = std::chrono::steady_clock::now();
+  auto file = baulk::net::WinGet(url,
+                                 {
+                                     .hash_value = hash,
+                                     .cwd = std::filesystem::temp_directory_path(),
+                                     .force_overwrite = true,
+                                     .connections = connections,
+                                 },
+                                 r.ec);
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (file) {
+    r.ok = true;
+    r.file = std::move(*file);
+    std::error_code e;
+    std::filesystem::remove(r.file, e);
+  }
+  return r;
+}
+
+} // namespace loopback
+
+#endif
@@ -0,0 +1,80 @@
+// netbench: download path of baulk::net against a loopback HTTP stand-in. Measures WinGet throughput by
+// connection count, how many TCP connections a run of small requests opens, and that a broken single stream
+// download resumes from its part file instead of starting over.
+// Output is CSV: case,connections,bytes,seconds,mb_per_s,accepted,result
+#include "loopback.hpp"
+
+constexpr size_t payloadSize = 64 * 1024 * 1024;
+constexpr std::string_view smallBody = R"({"name":"netbench","version":"1.0.0"})";
+
+static void printRow(std::wstring_view name, uint32_t connections, size_t bytes, double seconds, int connects,
+                     bool ok) {
+  bela::FPrintF(stdout, L"%s,%d,%d,%.3f,%.1f,%d,%s\n", name, connections, bytes, seconds,
+                seconds > 0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0, connects, ok ? L"ok" : L"fail");
+}
+
+// download runs one WinGet, a broken run keeps its part file for the next case to resume
+static bool download(loopback::server &srv, std::wstring_view name, uint32_t connections, bool expected) {
+  auto before = srv.Accepted();
+  auto r = loopback::Download(srv.URL(L"/payload.bin"), srv.Hash(), connections);
+  auto ok = r.ok == expected;
+  printRow(name, connections, r.ok ? payloadSize : 0, r.seconds, srv.Accepted() - before, ok);
+  if (!r.ok && expected) {
+    bela::FPrintF(stderr, L"%s: %s\n", name, r.ec);
+  }
+  return ok;
+}
+
+// reuse issues small requests back to back, pooled sessions keep them on one or a few connections
+static bool reuse(loopback::server &srv, int requests) {
+  auto url = srv.URL(L"/small.json");
+  auto before = srv.Accepted();
+  auto start = std::chrono::steady_clock::now();
+  size_t bytes = 0;
+  bool ok = true;
+  for (int i = 0; i < requests; i++) {
+    bela::error_code ec;
+    auto resp = baulk::net::RestGet(url, ec);
+    if (!resp || resp->StatusCode() != 200 || resp->Content() != smallBody) {
+      bela::FPrintF(stderr, L"reuse: request %d: %s\n", i, ec);
+      ok = false;
+      break;
+    }
+    bytes += resp->Content().size();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto connects = srv.Accepted() - before;
+  ok = ok && connects < requests;
+  printRow(L"reuse", 1, bytes, elapsed, connects, ok);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  loopback::server srv({.payloadSize = payloadSize});
+  srv.Document("/small.json", std::string(smallBody));
+  bela::error_code ec;
+  if (!srv.Start(ec)) {
+    bela::FPrintF(stderr, L"%s\n", ec);
+    return 1;
+  }
+  baulk::net::HttpClient::DefaultClient().SetDebugMode(argc > 1 && strcmp(argv[1], "-d") == 0);
+
+  bela::FPrintF(stdout, L"case,connections,bytes,seconds,mb_per_s,accepted,result\n");
+  int failures = 0;
+  for (uint32_t connections : {1, 2, 4, 8}) {
+    failures += download(srv, L"throughput", connections, true) ? 0 : 1;
+  }
+  failures += reuse(srv, 32) ? 0 : 1;
+  // the single stream breaks halfway, the second run must continue from the part file
+  srv.Drop(1);
+  failures += download(srv, L"broken", 1, false) ? 0 : 1;
+  srv.ClearRangeStarts();
+  auto resumed = download(srv, L"resume", 1, true);
+  if (auto starts = srv.RangeStarts(); resumed && (starts.empty() || starts.front() <= 0)) {
+    bela::FPrintF(stderr, L"resume: the download started over instead of requesting the missing range\n");
+    resumed = false;
+  }
+  failures += resumed ? 0 : 1;
+  bela::FPrintF(stderr, L"%s\n", failures == 0 ? L"PASS" : L"FAIL");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+// rangeget: segmented WinGet against a local HTTP stand-in that honors Range and throttles every connection
+#include "loopback.hpp"
+#include <algorithm>
+#include <fstream>
+#include "../lib/net/file.hpp"
+
+constexpr size_t payloadSize = 48 * 1024 * 1024;
+constexpr size_t connectionRate = 8 * 1024 * 1024; // bytes per second on one connection
+
+static bool download(loopback::server &srv, uint32_t connections, bool expected) {
+  auto r = loopback::Download(srv.URL(L"/payload.bin"), srv.Hash(), connections);
+  if (!r.ok) {
+    bela::FPrintF(stderr, L"connections %d: %s (%.2fs)\n", connections, r.ec, r.seconds);
+    return !expected;
+  }
+  bela::FPrintF(stderr, L"connections %d: %s %.2fs %.1f MB/s\n", connections, r.file.wstring(), r.seconds,
+                static_cast<double>(payloadSize) / r.seconds / 1e6);
+  return expected;
+}
+
+// unfinishedRanges reads the segment table of a broken download, the resume must request start + done of each
+// unfinished segment and nothing else
+static std::vector<int64_t> unfinishedRanges(const std::filesystem::path &part) {
+  using namespace baulk::net::net_internal;
+  std::vector<int64_t> starts;
+  std::ifstream in(part, std::ios::binary);
+  part_overlay_data overlay{};
+  in.seekg(-static_cast<std::streamoff>(sizeof(overlay)), std::ios::end);
+  if (!in.read(reinterpret_cast<char *>(&overlay), sizeof(overlay)) ||
+      memcmp(overlay.magic, part_magic, sizeof(part_magic)) != 0) {
+    return starts;
+  }
+  std::vector<part_segment> segments(overlay.segment_count);
+  in.seekg(overlay.total_bytes + overlay.state_size);
+  in.read(reinterpret_cast<char *>(segments.data()), segments.size() * sizeof(part_segment));
+  for (const auto &seg : segments) {
+    if (seg.Remaining() != 0) {
+      starts.push_back(seg.start + seg.done);
+    }
+  }
+  return starts;
+}
+
+int main(int argc, char **argv) {
+  // one response per connection, every segment worker opens its own
+  loopback::server srv({.payloadSize = payloadSize, .connectionRate = connectionRate, .keepAlive = false});
+  bela::error_code ec;
+  if (!srv.Start(ec)) {
+    bela::FPrintF(stderr, L"%s\n", ec);
+    return 1;
+  }
+  baulk::net::HttpClient::DefaultClient().SetDebugMode(argc > 1 && strcmp(argv[1], "-d") == 0);
+
+  int failures = 0;
+  failures += download(srv, 1, true) ? 0 : 1;
+  failures += download(srv, 4, true) ? 0 : 1;
+  // the next connections break halfway through their range, the second run resumes the segments from the part overlay
+  srv.Drop(2);
+  failures += download(srv, 4, false) ? 0 : 1;
+  auto expected = unfinishedRanges(std::filesystem::temp_directory_path() / L"payload.bin.part");
+  srv.ClearRangeStarts();
+  failures += download(srv, 4, true) ? 0 : 1;
+  auto rangeStarts = srv.RangeStarts();
+  std::sort(expected.begin(), expected.end());
+  std::sort(rangeStarts.begin(), rangeStarts.end());
+  if (expected.empty() || rangeStarts != expected) {
+    bela::FPrintF(stderr, L"resume: requested %d ranges, the part file has %d unfinished segments\n",
+                  rangeStarts.size(), expected.size());
+    for (auto start : rangeStarts) {
+      bela::FPrintF(stderr, L"  requested from %d%s\n", start,
+                    std::find(expected.begin(), expected.end(), start) == expected.end() ? L" (unexpected)" : L"");
+    }
+    failures++;
+  }
+  bela::FPrintF(stderr, L"%s\n", failures == 0 ? L"PASS" : L"FAIL");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+//
+#include <baulk/archive.hpp>
+#include <baulk/archive/extractor.hpp>
+#include <bela/terminal.hpp>
+#include <bela/path.hpp>
+
+int uncab(std::wstring_view path) {
+  auto destination = bela::EndsWithIgnoreCase(path, L".cab") ? std::wstring(path.substr(0, path.size() - 4))
+                                                             : bela::StringCat(path, L".out");
+  bela::error_code ec;
+  int64_t baseOffset = 0;
+  baulk::archive::file_format_t afmt{};
+  auto fd = baulk::archive::OpenFile(path, baseOffset, afmt, ec);
+  if (!fd) {
+    bela::FPrintF(stderr, L"unable open cab file %s error: %s\n", path, ec);
+    return 1;
+  }
+  baulk::archive::cab::Extractor extractor(baulk::archive::ExtractorOptions{.overwrite_mode = true});
+  if (!extractor.OpenReader(*fd, destination, bela::SizeUnInitialized, baseOffset, ec)) {
+    bela::FPrintF(stderr, L"unable open cab file %s error: %s\n", path, ec);
+    return 1;
+  }
+  if (!extractor.Extract(
+          [](const baulk::archive::cab::File &file, const std::wstring &relative_name) {
+            bela::FPrintF(stderr, L" x %s\n", relative_name);
+            return true;
+          },
+          nullptr, ec)) {
+    bela::FPrintF(stderr, L"unable extract file: %s error: %s\n", path, ec);
+    return 1;
+  }
+  bela::FPrintF(stderr, L"extract %d bytes\n", extractor.UncompressedSize());
+  return 0;
+}
+
+int wmain(int argc, wchar_t **argv) {
+  if (argc < 2) {
+    bela::FPrintF(stderr, L"usage: %s cabfile\n", argv[0]);
+    return 1;
+  }
+  return uncab(argv[1]);
+}
@@ -94,7 +94,7 @@ bool Extractor::extractDir(const File &file, std::wstring_view dir, bela::error_
 }
 
 bool Extractor::extractFile(const File &file, bela::error_code &ec) {
-  auto dest = baulk::archive::JoinSanitizePath(destination, file.name, file.IsFileNameUTF8());
+  auto dest = baulk::archive::JoinSanitizePath(destination, file.name, file.IsFileNameUTF8(), reader.CodePage());
   if (!dest) {
     bela::FPrintF(stderr, L"skip dangerous path %s\n", file.name);
     return true;
@@ -0,0 +1,61 @@
+// xmlscan: incremental text_scanner against pugixml, the document is fed in chunks of every size
+#include <bela/terminal.hpp>
+#include <xml.hpp>
+
+constexpr std::string_view atom = R"(<?xml version="1.0" encoding="UTF-8"?>
+<feed xmlns="http://www.w3.org/2005/Atom" xmlns:media="http://search.yahoo.com/mrss/" xml:lang="en-US">
+  <id>tag:github.com,2008:/baulk/bucket/commits/master</id>
+  <link type="text/html" rel="alternate" href="https://github.com/baulk/bucket/commits/master"/>
+  <title>Recent Commits to bucket:master</title>
+  <!-- <entry><id>tag:github.com,2008:Grit::Commit/commented</id></entry> -->
+  <updated>2021-10-20T20:09:08+08:00</updated>
+  <entry>
+    <id>tag:github.com,2008:Grit::Commit/5e0b1b4d4d1a5eeae5fc7c2a4a1b0e2f7d2a8c11</id>
+    <link type="text/html" rel="alternate" href="https://github.com/baulk/bucket/commit/5e0b1b4?a=1&amp;b=>"/>
+    <title>
+        update golang &amp; &lt;nodejs&gt;
+    </title>
+    <content type="html"><![CDATA[<pre>update golang</pre>]]></content>
+  </entry>
+  <entry>
+    <id>tag:github.com,2008:Grit::Commit/0000000000000000000000000000000000000000</id>
+  </entry>
+</feed>
+)";
+
+static bool scan(std::initializer_list<std::string_view> path, std::string_view expected) {
+  for (size_t chunk = 1; chunk <= atom.size(); chunk = chunk < 16 ? chunk + 1 : chunk * 2) {
+    baulk::xml::text_scanner scanner(path);
+    size_t offset = 0;
+    while (offset < atom.size() && !scanner.Feed(atom.substr(offset, chunk))) {
+      offset += chunk;
+    }
+    if (!scanner.Found() || scanner.Text() != expected) {
+      bela::FPrintF(stderr, L"\x1b[31mchunk %d: '%s' expected '%s'\x1b[0m\n", chunk, scanner.Text(), expected);
+      return false;
+    }
+  }
+  return true;
+}
+
+int wmain() {
+  bela::error_code ec;
+  auto doc = baulk::xml::parse_string(atom, ec);
+  if (!doc) {
+    bela::FPrintF(stderr, L"unable parse xml: %s\n", ec);
+    return 1;
+  }
+  auto entry = doc->child("feed").child("entry");
+  int failures = 0;
+  failures += scan({"feed", "entry", "id"}, entry.child("id").text().as_string()) ? 0 : 1;
+  failures += scan({"feed", "title"}, doc->child("feed").child("title").text().as_string()) ? 0 : 1;
+  failures += scan({"feed", "entry", "title"}, entry.child("title").text().as_string()) ? 0 : 1;
+  failures += scan({"feed", "entry", "content"}, entry.child("content").text().as_string()) ? 0 : 1;
+  baulk::xml::text_scanner missing({"feed", "entry", "author"});
+  if (missing.Feed(atom) || missing.Found()) {
+    bela::FPrintF(stderr, L"\x1b[31mfeed/entry/author should not be found\x1b[0m\n");
+    failures++;
+  }
+  bela::FPrintF(stderr, L"%s\n", failures == 0 ? L"PASS" : L"FAIL");
+  return failures == 0 ? 0 : 1;
+}
@@ -42,7 +42,9 @@ std::optional<command_t> ParseArgv(int argc, wchar_t **argv) {
       .Add(L"https-proxy", cli::required_argument, 1001) // option
       .Add(L"force-delete", cli::no_argument, 1002)
       .Add(L"trace", cli::no_argument, 'T')
-      .Add(L"bucket");
+      .Add(L"bucket")
+      .Add(L"b3sum")
+      .Add(L"sha256sum");
 
   bela::error_code ec;
   auto result = pa.Execute(
@@ -124,6 +126,7 @@ std::optional<command_t> ParseArgv(int argc, wchar_t **argv) {
       {L"freeze", baulk::commands::cmd_freeze, true},         // freeze
       {L"unfreeze", baulk::commands::cmd_unfreeze, true},     // unfreeze
       {L"cleancache", baulk::commands::cmd_cleancache, true}, // cleancache
+      {L"serve", baulk::commands::cmd_serve, true},           // serve download cache
       {L"bucket", baulk::commands::cmd_bucket, true},         // bucket command
       {L"b3sum", baulk::commands::cmd_b3sum, false},          // b3sum
       {L"sha256sum", baulk::commands::cmd_sha256sum, false},  // sha256sum
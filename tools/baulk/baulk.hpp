@@ -13,6 +13,23 @@ extern bool IsForceDelete;
 extern bool IsQuietMode;
 extern bool IsTraceMode;
 
+// quiet_scope turns on quiet mode while several extractors run at once, their per file progress would interleave.
+// The previous mode comes back when the scope ends
+class quiet_scope {
+public:
+  explicit quiet_scope(bool enable) : saved(IsQuietMode) {
+    if (enable) {
+      IsQuietMode = true;
+    }
+  }
+  quiet_scope(const quiet_scope &) = delete;
+  quiet_scope &operator=(const quiet_scope &) = delete;
+  ~quiet_scope() { IsQuietMode = saved; }
+
+private:
+  bool saved;
+};
+
 /// defines
 [[maybe_unused]] constexpr std::wstring_view BucketsDirName = L"buckets";
 enum BucketObserveMode {
@@ -74,6 +91,8 @@ bool InitializeContext(std::wstring_view profile, bela::error_code &ec);
 bool InitializeExecutor(bela::error_code &ec);
 std::wstring_view Profile();
 std::wstring_view LocaleName();
+// MirrorServer: 'baulk serve' base URL from BAULK_MIRROR or the profile, empty when not configured
+std::wstring_view MirrorServer();
 Buckets &LoadedBuckets();
 compiler::Executor &LinkExecutor();
 bool IsFrozenedPackage(std::wstring_view pkgName);
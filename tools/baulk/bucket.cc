@@ -3,34 +3,70 @@
 #include <bela/process.hpp>
 #include <bela/str_split_narrow.hpp>
 #include <bela/semver.hpp>
+#include <bela/io.hpp>
+#include <bela/strip.hpp>
 #include <baulk/json_utils.hpp>
 #include <baulk/vfs.hpp>
 #include <baulk/net.hpp>
 #include <baulk/fs.hpp>
 #include <xml.hpp>
+#include <mutex>
 #include "baulk.hpp"
 #include "bucket.hpp"
 #include "extractor.hpp"
 
 namespace baulk {
-// BucketNewestWithGithub github archive style bucket check latest
-std::optional<std::wstring> BucketNewestWithGithub(std::wstring_view bucketurl, bela::error_code &ec) {
+// BucketNewestWithGithub github archive style bucket check latest, an unchanged feed (304) returns known
+std::optional<std::wstring> BucketNewestWithGithub(std::wstring_view bucketurl, std::wstring_view known,
+                                                   BucketValidators &validators, bela::error_code &ec) {
   // default branch atom
   auto rss = bela::StringCat(bucketurl, L"/commits.atom");
   baulk::DbgPrint(L"Fetch RSS %s", rss);
-  auto resp = baulk::net::RestGet(rss, ec);
+  baulk::net::headers_t headers;
+  if (!known.empty()) {
+    if (!validators.etag.empty()) {
+      headers.emplace(L"If-None-Match", validators.etag);
+    }
+    if (!validators.lastModified.empty()) {
+      headers.emplace(L"If-Modified-Since", validators.lastModified);
+    }
+  }
+  // the newest commit is the first entry, reading stops there instead of receiving the whole feed
+  baulk::xml::text_scanner title({"feed", "title"});
+  baulk::xml::text_scanner newest({"feed", "entry", "id"});
+  size_t received = 0;
+  auto resp = baulk::net::RestStream(
+      rss, headers,
+      [&](std::string_view chunk) {
+        received += chunk.size();
+        title.Feed(chunk);
+        return !newest.Feed(chunk);
+      },
+      ec);
   if (!resp) {
     return std::nullopt;
   }
-  auto doc = baulk::xml::parse_string(resp->Content(), ec);
-  if (!doc) {
+  if (resp->StatusCode() == 304) {
+    baulk::DbgPrint(L"bucket commits not modified since: %s", known);
+    return std::make_optional<std::wstring>(known);
+  }
+  if (resp->StatusCode() != 200) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"response: ", resp->StatusCode(), L" status: ", resp->StatusLine());
+    return std::nullopt;
+  }
+  validators = BucketValidators{};
+  if (auto it = resp->Headers().find(L"ETag"); it != resp->Headers().end()) {
+    validators.etag = it->second;
+  }
+  if (auto it = resp->Headers().find(L"Last-Modified"); it != resp->Headers().end()) {
+    validators.lastModified = it->second;
+  }
+  baulk::DbgPrint(L"bucket commits: %s (read %d bytes)", bela::encode_into<char, wchar_t>(title.Text()), received);
+  if (!newest.Found()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"bucket feed has no commit entry");
     return std::nullopt;
   }
-  std::string_view title{doc->child("feed").child("title").text().as_string()};
-  baulk::DbgPrint(L"bucket commits: %s", title);
-  // first entry child
-  auto entry = doc->child("feed").child("entry");
-  std::string_view id{entry.child("id").text().as_string()};
+  auto id = bela::StripAsciiWhitespace(newest.Text());
   if (auto pos = id.find('/'); pos != std::string_view::npos) {
     return std::make_optional(bela::encode_into<char, wchar_t>(id.substr(pos + 1)));
   }
@@ -62,9 +98,10 @@ std::optional<std::wstring> BucketRepoNewest(std::wstring_view giturl, bela::err
 }
 
 // BucketNewest
-std::optional<std::wstring> BucketNewest(const baulk::Bucket &bucket, bela::error_code &ec) {
+std::optional<std::wstring> BucketNewest(const baulk::Bucket &bucket, std::wstring_view known,
+                                         BucketValidators &validators, bela::error_code &ec) {
   if (bucket.mode == baulk::BucketObserveMode::Github) {
-    return BucketNewestWithGithub(bucket.url, ec);
+    return BucketNewestWithGithub(bucket.url, known, validators, ec);
   }
   if (bucket.mode != baulk::BucketObserveMode::Git) {
     ec = bela::make_error_code(bela::ErrGeneral, L"Unsupported bucket mode: ", static_cast<int>(bucket.mode));
@@ -92,7 +129,152 @@ bool BucketRepoUpdate(const baulk::Bucket &bucket, bela::error_code &ec) {
   return true;
 }
 
-bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view id, bela::error_code &ec) {
+// github_repo: owner/repo of a bucket hosted on github.com
+std::optional<std::wstring> github_repo(std::wstring_view url) {
+  if (!bela::ConsumePrefix(&url, L"https://github.com/")) {
+    return std::nullopt;
+  }
+  while (bela::ConsumeSuffix(&url, L"/")) {
+  }
+  bela::ConsumeSuffix(&url, L".git");
+  if (auto pos = url.find('/'); pos == std::wstring_view::npos || pos == 0 || url.find('/', pos + 1) != url.npos) {
+    return std::nullopt;
+  }
+  return std::make_optional<std::wstring>(url);
+}
+
+// a repository path from the compare result must stay inside the bucket folder
+bool is_bucket_path(std::wstring_view path) {
+  std::vector<std::wstring_view> elems = bela::StrSplit(path, bela::ByChar('/'));
+  for (auto e : elems) {
+    if (e.empty() || e == L"." || e == L".." || e.find_first_of(L":\\") != std::wstring_view::npos) {
+      return false;
+    }
+  }
+  return !elems.empty();
+}
+
+// bucket_change: a file of the bucket changed between two commits, content is fetched before anything is applied
+struct bucket_change {
+  std::wstring path;    // file to write, empty when the file was removed
+  std::wstring removed; // file to delete, the old name of a renamed file
+  std::string content;
+};
+
+// raw_path percent encodes every segment of a bucket path, manifest names may hold spaces, '#', '%' or non-ASCII
+inline std::wstring raw_path(std::wstring_view path) {
+  std::wstring out;
+  for (;;) {
+    auto pos = path.find('/');
+    out.append(net::url_path_encode(path.substr(0, pos)));
+    if (pos == std::wstring_view::npos) {
+      return out;
+    }
+    out.push_back(L'/');
+    path.remove_prefix(pos + 1);
+  }
+}
+
+// BucketDeltaUpdate fetches only the files changed between two commits of a github bucket. The folder is left
+// untouched when the compare result is incomplete or a file cannot be fetched, the caller then downloads the archive
+bool BucketDeltaUpdate(const baulk::Bucket &bucket, std::wstring_view previous, std::wstring_view id,
+                       bela::error_code &ec) {
+  auto repo = github_repo(bucket.url);
+  if (!repo) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"not a github.com bucket");
+    return false;
+  }
+  auto bucketReal = bela::StringCat(baulk::vfs::AppBuckets(), L"\\", bucket.name);
+  if (!bela::PathExists(bucketReal)) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"bucket folder not exists");
+    return false;
+  }
+  // https://docs.github.com/en/rest/commits/commits#compare-two-commits
+  auto compare = bela::StringCat(L"https://api.github.com/repos/", *repo, L"/compare/", previous, L"...", id);
+  baulk::DbgPrint(L"Fetch compare %s", compare);
+  baulk::net::headers_t headers;
+  headers.emplace(L"Accept", L"application/vnd.github+json");
+  auto resp = baulk::net::RestGet(compare, headers, ec);
+  if (!resp) {
+    return false;
+  }
+  if (resp->StatusCode() != 200) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"compare response: ", resp->StatusCode());
+    return false;
+  }
+  std::vector<bucket_change> changes;
+  try {
+    auto j = nlohmann::json::parse(resp->Content());
+    // behind or diverged: the previous commit is no longer an ancestor, eg: force pushed
+    if (auto status = j.value("status", std::string()); status != "ahead") {
+      ec = bela::make_error_code(bela::ErrGeneral, L"compare status: ", bela::encode_into<char, wchar_t>(status));
+      return false;
+    }
+    const auto &files = j.at("files");
+    // the compare result lists at most 300 files
+    if (!files.is_array() || files.size() >= 300) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"too many changed files");
+      return false;
+    }
+    for (const auto &f : files) {
+      auto status = f.value("status", std::string());
+      auto filename = bela::encode_into<char, wchar_t>(f.at("filename").get<std::string_view>());
+      bucket_change c;
+      if (status == "removed") {
+        c.removed = std::move(filename);
+      } else {
+        c.path = std::move(filename);
+      }
+      if (status == "renamed") {
+        c.removed = bela::encode_into<char, wchar_t>(f.value("previous_filename", std::string()));
+      }
+      if ((!c.path.empty() && !is_bucket_path(c.path)) || (!c.removed.empty() && !is_bucket_path(c.removed))) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"unexpected path: ", c.path, c.removed);
+        return false;
+      }
+      changes.emplace_back(std::move(c));
+    }
+  } catch (const std::exception &e) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"decode compare: ", bela::encode_into<char, wchar_t>(e.what()));
+    return false;
+  }
+  for (auto &c : changes) {
+    if (c.path.empty()) {
+      continue;
+    }
+    auto raw = bela::StringCat(L"https://raw.githubusercontent.com/", *repo, L"/", id, L"/", raw_path(c.path));
+    baulk::DbgPrint(L"Fetch %s", raw);
+    auto file = baulk::net::RestGet(raw, ec);
+    if (!file) {
+      return false;
+    }
+    if (file->StatusCode() != 200) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"fetch ", c.path, L" response: ", file->StatusCode());
+      return false;
+    }
+    c.content = file->Content();
+  }
+  std::filesystem::path root(bucketReal);
+  for (const auto &c : changes) {
+    std::error_code e;
+    if (!c.removed.empty()) {
+      std::filesystem::remove(root / c.removed, e);
+    }
+    if (c.path.empty()) {
+      continue;
+    }
+    auto target = root / c.path;
+    std::filesystem::create_directories(target.parent_path(), e);
+    if (!bela::io::WriteTextAtomic(c.content, target.native(), ec)) {
+      return false;
+    }
+  }
+  bela::FPrintF(stderr, L"baulk: bucket \x1b[36m%s\x1b[0m %d files changed\n", bucket.name, changes.size());
+  return true;
+}
+
+bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view previous, std::wstring_view id,
+                  bela::error_code &ec) {
   if (bucket.mode == baulk::BucketObserveMode::Git) {
     return BucketRepoUpdate(bucket, ec);
   }
@@ -100,6 +282,13 @@ bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view id, bela::error
     ec = bela::make_error_code(bela::ErrGeneral, L"Unsupported bucket mode: ", static_cast<int>(bucket.mode));
     return false;
   }
+  if (!previous.empty()) {
+    if (BucketDeltaUpdate(bucket, previous, id, ec)) {
+      return true;
+    }
+    baulk::DbgPrint(L"bucket: %s delta update: %s, download the archive", bucket.name, ec);
+    ec.clear();
+  }
   // https://github.com/baulk/bucket/archive/master.zip
   auto master = bela::StringCat(bucket.url, L"/archive/", id, L".zip");
   if (!baulk::fs::MakeDirectories(baulk::vfs::AppTemp(), ec)) {
@@ -118,6 +307,10 @@ bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view id, bela::error
                                               .hash_value = L"",
                                               .cwd = baulk::vfs::AppTemp(),
                                               .force_overwrite = true,
+                                              // buckets updating at the same time must not draw progress bars
+                                              .progress = baulk::IsQuietMode
+                                                              ? baulk::net::download_progress([](int64_t, int64_t) {})
+                                                              : nullptr,
                                           },
                                           ec);
         archive_file) {
@@ -139,6 +332,9 @@ bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view id, bela::error
     return false;
   }
   auto bucketReal = bela::StringCat(baulk::vfs::AppBuckets(), L"\\", bucket.name);
+  // buckets download concurrently, their folders are swapped one at a time
+  static std::mutex swapMutex;
+  std::scoped_lock lock(swapMutex);
   if (bela::PathExists(bucketReal)) {
     bela::fs::ForceDeleteFolders(bucketReal, ec);
   }
@@ -10,8 +10,17 @@
 namespace baulk {
 constexpr long ErrPackageNotYetPorted = bela::ErrUnimplemented + 1000;
 
-std::optional<std::wstring> BucketNewest(const baulk::Bucket &bucket, bela::error_code &ec);
-bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view id, bela::error_code &ec);
+// BucketValidators: cache validators of the newest commit probe, kept in buckets.lock.json
+struct BucketValidators {
+  std::wstring etag;
+  std::wstring lastModified;
+};
+// BucketNewest returns known when the probe is unchanged since the validators were recorded
+std::optional<std::wstring> BucketNewest(const baulk::Bucket &bucket, std::wstring_view known,
+                                         BucketValidators &validators, bela::error_code &ec);
+// BucketUpdate fetches only the changed files when the previous id is known, the whole bucket otherwise
+bool BucketUpdate(const baulk::Bucket &bucket, std::wstring_view previous, std::wstring_view id,
+                  bela::error_code &ec);
 // PackageMeta from file
 std::optional<baulk::Package> PackageMeta(const Bucket &bucket, std::wstring_view pkgName, bela::error_code &ec);
 
@@ -1,35 +1,69 @@
 //
 #include <bela/terminal.hpp>
+#include <bela/numbers.hpp>
 #include <baulk/hash.hpp>
 #include <baulk/fs.hpp>
+#include <baulk/argv.hpp>
 #include "commands.hpp"
 
 namespace baulk::commands {
 
 void usage_b3sum() {
-  bela::FPrintF(stderr, LR"(Usage: baulk b3sum [file] ...
+  bela::FPrintF(stderr, LR"(Usage: baulk b3sum [option] [file] ...
 Print BLAKE3 (256-bit) checksums.
+  -j|--jobs        Number of files hashed in parallel, default: number of processors
+  --mmap           Map files into memory instead of reading them
 
 Example:
   baulk b3sum baulk.zip
+  baulk b3sum -j 8 *.zip
 
 )");
 }
 
 int cmd_b3sum(const argv_t &argv) {
-  if (argv.empty()) {
-    usage_b3sum();
+  baulk::hash::file_hash_options opts;
+  baulk::cli::ParseArgv pa(argv);
+  pa.Add(L"jobs", baulk::cli::required_argument, L'j').Add(L"mmap", baulk::cli::no_argument, 1001);
+  bela::error_code ec;
+  auto ret = pa.Execute(
+      [&](int val, const wchar_t *oa, const wchar_t *) {
+        switch (val) {
+        case L'j':
+          if (!bela::SimpleAtoi(oa, &opts.jobs)) {
+            ec = bela::make_error_code(bela::ErrGeneral, L"unable parse jobs: ", oa);
+            return false;
+          }
+          break;
+        case 1001:
+          opts.mmap = true;
+          break;
+        default:
+          return false;
+        }
+        return true;
+      },
+      ec);
+  if (!ret) {
+    bela::FPrintF(stderr, L"baulk b3sum: \x1b[31m%s\x1b[0m\n", ec);
     return 1;
   }
-  bela::error_code ec;
-  for (const auto a : argv) {
-    auto hv = baulk::hash::FileHash(a, baulk::hash::hash_t::BLAKE3, ec);
-    if (!hv) {
-      bela::FPrintF(stderr, L"File: %s cannot calculate blake3 checksum: \x1b[31m%s\x1b[0m\n", a, ec);
-      continue;
-    }
-    bela::FPrintF(stdout, L"%s %s\n", *hv, baulk::fs::FileName(a));
+  if (pa.Argv().empty()) {
+    usage_b3sum();
+    return 1;
   }
+  std::vector<std::filesystem::path> files(pa.Argv().begin(), pa.Argv().end());
+  baulk::hash::FileHashes(files, baulk::hash::hash_t::BLAKE3, opts,
+                          [&](const std::filesystem::path &file, const std::optional<std::wstring> &hv,
+                              const bela::error_code &e) {
+                            if (!hv) {
+                              bela::FPrintF(stderr,
+                                            L"File: %s cannot calculate blake3 checksum: \x1b[31m%s\x1b[0m\n",
+                                            file.native(), e);
+                              return;
+                            }
+                            bela::FPrintF(stdout, L"%s %s\n", *hv, baulk::fs::FileName(file.native()));
+                          });
   return 0;
 }
-} // namespace baulk::commands
\ No newline at end of file
+} // namespace baulk::commands
@@ -14,7 +14,7 @@ Supported formats:
   zip (family) archive, supported methods: deflate, deflate64, zstd, bzip2, xz, lzma, Ppmd.
   tar, tar.gz, tar.xz, tar.bz2, tar.xz, tar.zstd
   gz, xz, bzip2, zstd,
-  msi
+  msi, cab (mszip, lzx), nsis
   self-extracting archive
   7z supported archive
 
@@ -36,6 +36,7 @@ Command:
   b3sum            Calculate the BLAKE3 checksum of a file
   sha256sum        Calculate the SHA256 checksum of a file
   cleancache       Cleanup download cache
+  serve            Serve the download cache to other baulk clients
   bucket           Add, delete or list buckets
   untar            Extract files in a tar archive. support: tar.xz tar.bz2 tar.gz tar.zstd
   unzip            Extract compressed files in a ZIP archive
@@ -91,6 +92,7 @@ int cmd_help(const baulk::commands::argv_t &argv) {
       {L"b3sum", baulk::commands::usage_b3sum},           // b3sum
       {L"sha256sum", baulk::commands::usage_sha256sum},   // sha256sum
       {L"cleancache", baulk::commands::usage_cleancache}, // cleancache
+      {L"serve", baulk::commands::usage_serve},           // serve
       {L"bucket", baulk::commands::usage_bucket},         // bucket command
       {L"untar", baulk::commands::usage_untar},           // untar
       {L"unzip", baulk::commands::usage_unzip},           // unzip
@@ -28,7 +28,7 @@ public:
   PackageInstaller() = default;
   PackageInstaller(const PackageInstaller &) = delete;
   PackageInstaller &operator=(const PackageInstaller &) = delete;
-  bool Install(std::wstring_view pkgname);
+  std::optional<baulk::Package> Resolve(std::wstring_view pkgname);
 
 private:
   void Update(std::wstring_view name);
@@ -46,25 +46,25 @@ void PackageInstaller::Update(std::wstring_view name) {
   updated = true;
 }
 
-bool PackageInstaller::Install(std::wstring_view name) {
+std::optional<baulk::Package> PackageInstaller::Resolve(std::wstring_view name) {
   bela::error_code ec;
   auto pkg = baulk::PackageMetaEx(name, ec);
   if (!pkg) {
     if (ec.code != baulk::ErrPackageNotYetPorted) {
       bela::FPrintF(stderr, L"\x1b[31mbaulk: %s\x1b[0m\n", ec);
-      return false;
+      return std::nullopt;
     }
     Update(name);
     if (pkg = baulk::PackageMetaEx(name, ec); !pkg) {
       bela::FPrintF(stderr, L"\x1b[31mbaulk: %s\x1b[0m\n", ec);
-      return false;
+      return std::nullopt;
     }
   }
   if (pkg->urls.empty()) {
     bela::FPrintF(stderr, L"baulk: '%s' not support \x1b[31m%s\x1b[0m\n", name, architecture());
-    return false;
+    return std::nullopt;
   }
-  return baulk::package::PackageInstall(*pkg);
+  return pkg;
 }
 
 void usage_install() {
@@ -92,9 +92,16 @@ int cmd_install(const argv_t &argv) {
   if (!InitializeExecutor(ec)) {
     DbgPrint(L"baulk install: unable initialize compiler executor: %s", ec);
   }
+  // resolve every package first, so the downloads can run at the same time
   PackageInstaller installer;
-  for (auto pkg : argv) {
-    installer.Install(pkg);
+  std::vector<baulk::Package> pkgs;
+  for (auto name : argv) {
+    if (auto pkg = installer.Resolve(name); pkg) {
+      pkgs.emplace_back(std::move(*pkg));
+    }
+  }
+  if (!pkgs.empty()) {
+    baulk::package::PackageInstall(pkgs);
   }
   return 0;
 }
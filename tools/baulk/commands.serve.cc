@@ -0,0 +1,489 @@
+// serve command: share the download cache with other baulk clients on the LAN
+#include <bela/terminal.hpp>
+#include <bela/numbers.hpp>
+#include <bela/strip.hpp>
+#include <bela/match.hpp>
+#include <baulk/argv.hpp>
+#include <baulk/cdn.hpp>
+#include <baulk/hash.hpp>
+#include <baulk/net.hpp>
+#include <baulk/vfs.hpp>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "baulk.hpp"
+#include "commands.hpp"
+
+namespace baulk::commands {
+constexpr int defaultServePort = 8450;
+constexpr int maxServeConnections = 256;
+constexpr size_t maxRequestHeader = 16 * 1024;
+// idle keep-alive connections are closed after this, milliseconds
+constexpr DWORD idleTimeout = 30 * 1000;
+// file data is read and sent in blocks of this size
+constexpr DWORD sendBlockSize = 256 * 1024;
+// index of verified digests in the download folder
+constexpr std::wstring_view verifiedIndexName = L"baulk.verified.json";
+// (file, hash) pairs known not to match, the table is dropped when it grows past this
+constexpr size_t maxRejected = 4096;
+
+void usage_serve() {
+  bela::FPrintF(stderr, LR"(Usage: baulk serve [<args>]
+Serve the download cache to other baulk clients by archive hash
+
+  -L|--listen      Listen address. default: 0.0.0.0:%d
+  --fetch-missing  Download archives that are not cached yet from the url a client sends along
+
+Clients use the mirror when BAULK_MIRROR or "mirror" in the profile is set, eg: http://buildcache:%d
+
+Example:
+  baulk serve
+  baulk serve --listen [::]:8450 --fetch-missing
+
+)",
+                defaultServePort, defaultServePort);
+}
+
+struct serve_request {
+  std::string method;
+  std::string target;
+  std::string range;
+  std::string mirrorURL;
+  bool keepAlive{true};
+};
+
+// rejected_hash: a file and hash that did not match, valid while the file keeps its size and write time
+struct rejected_hash {
+  std::uintmax_t size{0};
+  std::filesystem::file_time_type mtime;
+};
+
+struct byte_range {
+  int64_t first{0};
+  int64_t last{0};
+  bool partial{false};
+};
+
+// cache_server: hash addressed archives from the download folder, one thread per connection
+class cache_server {
+public:
+  cache_server(bool fetchMissing_) : fetchMissing(fetchMissing_) {}
+  cache_server(const cache_server &) = delete;
+  cache_server &operator=(const cache_server &) = delete;
+  int Run(std::wstring_view listen);
+
+private:
+  std::filesystem::path downloads{vfs::AppTemp()};
+  bool fetchMissing{false};
+  std::atomic_int connections{0};
+  // the first client of a large archive hashes it, later clients of the same file wait and read the index
+  std::mutex verifyMutex;
+  bela::flat_hash_map<std::wstring, std::shared_ptr<std::mutex>> verifying;
+  bela::flat_hash_map<std::wstring, rejected_hash> rejected; // lower case 'filename\nhash', guarded by verifyMutex
+  std::mutex fetchMutex;
+  bela::flat_hash_set<std::wstring> fetching;
+  void serve(SOCKET s, std::wstring remote);
+  bool respond(SOCKET s, const serve_request &r, std::wstring_view remote);
+  std::shared_ptr<std::mutex> verifyLock(const std::wstring &filename);
+  std::optional<std::filesystem::path> lookup(const cdn &c);
+  void fetch(const cdn &c, std::string_view upstream);
+};
+
+static bool sendAll(SOCKET s, std::string_view data) {
+  while (!data.empty()) {
+    auto n = send(s, data.data(), static_cast<int>((std::min)(data.size(), static_cast<size_t>(INT_MAX))), 0);
+    if (n <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// response headers are plain ASCII
+static bool sendHeader(SOCKET s, std::wstring_view header) {
+  return sendAll(s, bela::encode_into<wchar_t, char>(header));
+}
+
+static bool sendStatus(SOCKET s, int code, std::wstring_view text, bool keepAlive) {
+  return sendHeader(s, bela::StringCat(L"HTTP/1.1 ", code, L" ", text, L"\r\nContent-Length: 0\r\nConnection: ",
+                                       keepAlive ? L"keep-alive" : L"close", L"\r\n\r\n"));
+}
+
+// readRequest reads one request header, bytes after it stay in pending for the next request
+static std::optional<serve_request> readRequest(SOCKET s, std::string &pending) {
+  size_t end = 0;
+  char buffer[4096];
+  while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+    if (pending.size() > maxRequestHeader) {
+      return std::nullopt;
+    }
+    auto n = recv(s, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return std::nullopt;
+    }
+    pending.append(buffer, static_cast<size_t>(n));
+  }
+  std::string_view header(pending.data(), end);
+  serve_request r;
+  auto lineEnd = header.find("\r\n");
+  auto requestLine = header.substr(0, lineEnd);
+  auto sp1 = requestLine.find(' ');
+  auto sp2 = requestLine.rfind(' ');
+  if (sp1 == std::string_view::npos || sp2 == sp1) {
+    return std::nullopt;
+  }
+  r.method = requestLine.substr(0, sp1);
+  r.target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+  r.keepAlive = requestLine.substr(sp2 + 1) != "HTTP/1.0";
+  auto mirrorKey = bela::encode_into<wchar_t, char>(BaulkMirrorURL);
+  while (lineEnd != std::string_view::npos) {
+    header.remove_prefix(lineEnd + 2);
+    lineEnd = header.find("\r\n");
+    auto line = header.substr(0, lineEnd);
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+    auto name = line.substr(0, colon);
+    auto value = bela::StripAsciiWhitespace(line.substr(colon + 1));
+    if (bela::EqualsIgnoreCase(name, "Range")) {
+      r.range = value;
+    } else if (bela::EqualsIgnoreCase(name, mirrorKey)) {
+      r.mirrorURL = value;
+    } else if (bela::EqualsIgnoreCase(name, "Connection")) {
+      r.keepAlive = !bela::EqualsIgnoreCase(value, "close");
+    }
+  }
+  pending.erase(0, end + 4);
+  return std::make_optional(std::move(r));
+}
+
+// parseRange supports one range, bytes=a-b, bytes=a- and bytes=-n. A range that is not understood is ignored
+static bool parseRange(std::string_view spec, int64_t size, byte_range &br) {
+  br = byte_range{.first = 0, .last = size - 1, .partial = false};
+  if (!bela::ConsumePrefix(&spec, "bytes=") || spec.find(',') != std::string_view::npos) {
+    return true;
+  }
+  auto dash = spec.find('-');
+  if (dash == std::string_view::npos) {
+    return true;
+  }
+  auto a = bela::StripAsciiWhitespace(spec.substr(0, dash));
+  auto b = bela::StripAsciiWhitespace(spec.substr(dash + 1));
+  int64_t first = 0;
+  int64_t last = size - 1;
+  if (a.empty()) {
+    int64_t suffix = 0;
+    if (!bela::SimpleAtoi(b, &suffix) || suffix <= 0) {
+      return true;
+    }
+    first = (std::max)(size - suffix, int64_t{0});
+  } else {
+    if (!bela::SimpleAtoi(a, &first) || (!b.empty() && !bela::SimpleAtoi(b, &last))) {
+      return true;
+    }
+    last = (std::min)(last, size - 1);
+  }
+  if (first >= size || first > last) {
+    return false;
+  }
+  br = byte_range{.first = first, .last = last, .partial = true};
+  return true;
+}
+
+std::shared_ptr<std::mutex> cache_server::verifyLock(const std::wstring &filename) {
+  std::lock_guard lock(verifyMutex);
+  auto &m = verifying[bela::AsciiStrToLower(filename)];
+  if (!m) {
+    m = std::make_shared<std::mutex>();
+  }
+  return m;
+}
+
+// lookup answers a wrong hash from the rejected table or the digest index, a client cannot make the server hash an
+// unchanged archive again by sending hashes that do not match
+std::optional<std::filesystem::path> cache_server::lookup(const cdn &c) {
+  auto file = downloads / c.filename;
+  std::error_code e;
+  if (!std::filesystem::is_regular_file(file, e)) {
+    return std::nullopt;
+  }
+  rejected_hash current{.size = std::filesystem::file_size(file, e),
+                        .mtime = std::filesystem::last_write_time(file, e)};
+  auto rejectKey = bela::AsciiStrToLower(bela::StringCat(c.filename, L"\n", c.hash));
+  {
+    std::lock_guard lock(verifyMutex);
+    if (auto it = rejected.find(rejectKey);
+        it != rejected.end() && it->second.size == current.size && it->second.mtime == current.mtime) {
+      return std::nullopt;
+    }
+  }
+  auto m = verifyLock(c.filename);
+  std::lock_guard lock(*m);
+  bela::error_code ec;
+  if (!baulk::hash::HashEqualCached(file, c.hash, downloads / verifiedIndexName, ec)) {
+    DbgPrint(L"serve: %s does not match %s: %s", file.native(), c.hash, ec);
+    std::lock_guard rejectLock(verifyMutex);
+    if (rejected.size() >= maxRejected) {
+      rejected.clear();
+    }
+    rejected.insert_or_assign(std::move(rejectKey), current);
+    return std::nullopt;
+  }
+  return std::make_optional(std::move(file));
+}
+
+// fetchable: the cache folder also holds the digest index, part files and json state, clients cannot replace them
+static bool fetchable(std::wstring_view filename) {
+  return !bela::EqualsIgnoreCase(filename, verifiedIndexName) && !bela::EndsWithIgnoreCase(filename, L".part") &&
+         !bela::EndsWithIgnoreCase(filename, L".json");
+}
+
+// fetch downloads a missing archive in the background, clients fall back to upstream until it is cached.
+// A file that exists but does not match the hash is left alone, the client's hash may be the wrong one
+void cache_server::fetch(const cdn &c, std::string_view upstream) {
+  auto url = bela::encode_into<char, wchar_t>(upstream);
+  if (!bela::StartsWithIgnoreCase(url, L"https://") && !bela::StartsWithIgnoreCase(url, L"http://")) {
+    return;
+  }
+  if (!fetchable(c.filename)) {
+    DbgPrint(L"serve: refuse to fetch reserved name %s", c.filename);
+    return;
+  }
+  if (std::error_code e; std::filesystem::exists(downloads / c.filename, e)) {
+    bela::FPrintF(stderr, L"serve: %s exists and does not match %s, not fetched\n", c.filename, c.hash);
+    return;
+  }
+  {
+    std::lock_guard lock(fetchMutex);
+    if (!fetching.emplace(c.filename).second) {
+      return;
+    }
+  }
+  std::thread([this, c, url = std::move(url)] {
+    bela::FPrintF(stderr, L"serve: fetch \x1b[36m%s\x1b[0m from %s\n", c.filename, url);
+    bela::error_code ec;
+    auto file = baulk::net::WinGet(url,
+                                   {
+                                       .hash_value = c.hash,
+                                       .cwd = downloads,
+                                       .destination = downloads / c.filename,
+                                       .force_overwrite = true,
+                                       .progress = [](int64_t, int64_t) {},
+                                   },
+                                   ec);
+    if (file) {
+      bela::FPrintF(stderr, L"serve: cached \x1b[32m%s\x1b[0m\n", c.filename);
+    } else {
+      bela::FPrintF(stderr, L"serve: fetch %s error: \x1b[31m%s\x1b[0m\n", c.filename, ec);
+    }
+    std::lock_guard lock(fetchMutex);
+    fetching.erase(c.filename);
+  }).detach();
+}
+
+bool cache_server::respond(SOCKET s, const serve_request &r, std::wstring_view remote) {
+  auto head = r.method == "HEAD";
+  if (!head && r.method != "GET") {
+    sendStatus(s, 405, L"Method Not Allowed", false);
+    return false;
+  }
+  auto target = std::string_view(r.target);
+  if (auto pos = target.find('?'); pos != std::string_view::npos) {
+    target = target.substr(0, pos);
+  }
+  auto path = bela::encode_into<char, wchar_t>(net::url_decode(bela::encode_into<char, wchar_t>(target)));
+  auto c = cdn::Parse(path);
+  if (!c) {
+    DbgPrint(L"serve: %s %s bad request", remote, path);
+    return sendStatus(s, 400, L"Bad Request", r.keepAlive) && r.keepAlive;
+  }
+  auto file = lookup(*c);
+  if (!file) {
+    bela::FPrintF(stderr, L"serve: %s %s \x1b[33mnot cached\x1b[0m\n", remote, c->filename);
+    if (fetchMissing && !r.mirrorURL.empty()) {
+      fetch(*c, r.mirrorURL);
+    }
+    return sendStatus(s, 404, L"Not Found", r.keepAlive) && r.keepAlive;
+  }
+  auto fd = CreateFileW(file->c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (fd == INVALID_HANDLE_VALUE) {
+    return sendStatus(s, 404, L"Not Found", r.keepAlive) && r.keepAlive;
+  }
+  auto closer = bela::finally([&] { CloseHandle(fd); });
+  LARGE_INTEGER li;
+  if (GetFileSizeEx(fd, &li) != TRUE) {
+    sendStatus(s, 500, L"Internal Server Error", false);
+    return false;
+  }
+  auto size = static_cast<int64_t>(li.QuadPart);
+  byte_range br;
+  if (!parseRange(r.range, size, br)) {
+    sendHeader(s, bela::StringCat(L"HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */", size,
+                                  L"\r\nContent-Length: 0\r\n\r\n"));
+    return r.keepAlive;
+  }
+  auto length = size == 0 ? 0 : br.last - br.first + 1;
+  auto header = bela::StringCat(br.partial ? L"HTTP/1.1 206 Partial Content\r\n" : L"HTTP/1.1 200 OK\r\n",
+                                L"Content-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\nContent-Length: ",
+                                length, L"\r\n", BaulkChecksumKey, L": ", c->hash, L"\r\nConnection: ",
+                                r.keepAlive ? L"keep-alive" : L"close", L"\r\n");
+  if (br.partial) {
+    bela::StrAppend(&header, L"Content-Range: bytes ", br.first, L"-", br.last, L"/", size, L"\r\n");
+  }
+  header.append(L"\r\n");
+  if (!sendHeader(s, header)) {
+    return false;
+  }
+  if (head || length == 0) {
+    return r.keepAlive;
+  }
+  // TransmitFile would skip the copy, but client editions of Windows allow only two of them at a time
+  auto buffer = std::make_unique<char[]>(sendBlockSize);
+  for (auto offset = br.first; offset <= br.last;) {
+    OVERLAPPED o{};
+    o.Offset = static_cast<DWORD>(offset);
+    o.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD n = 0;
+    auto want = static_cast<DWORD>((std::min)(br.last - offset + 1, static_cast<int64_t>(sendBlockSize)));
+    if (ReadFile(fd, buffer.get(), want, &n, &o) != TRUE || n == 0) {
+      DbgPrint(L"serve: %s %s ReadFile: %s", remote, c->filename, bela::make_system_error_code());
+      return false;
+    }
+    if (!sendAll(s, std::string_view(buffer.get(), n))) {
+      return false;
+    }
+    offset += n;
+  }
+  bela::FPrintF(stderr, L"serve: %s %s \x1b[32m%d\x1b[0m bytes %d-%d\n", remote, c->filename, length, br.first,
+                br.last);
+  return r.keepAlive;
+}
+
+void cache_server::serve(SOCKET s, std::wstring remote) {
+  auto closer = bela::finally([&] {
+    closesocket(s);
+    connections--;
+  });
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&idleTimeout), sizeof(idleTimeout));
+  std::string pending;
+  for (;;) {
+    auto r = readRequest(s, pending);
+    if (!r) {
+      return;
+    }
+    if (!respond(s, *r, remote)) {
+      return;
+    }
+  }
+}
+
+static std::wstring remoteAddress(const sockaddr_storage &addr) {
+  wchar_t buffer[64] = {0};
+  DWORD len = ARRAYSIZE(buffer);
+  if (WSAAddressToStringW(reinterpret_cast<LPSOCKADDR>(const_cast<sockaddr_storage *>(&addr)),
+                          static_cast<DWORD>(sizeof(addr)), nullptr, buffer, &len) != 0) {
+    return L"unknown";
+  }
+  return buffer;
+}
+
+int cache_server::Run(std::wstring_view listen) {
+  std::wstring_view host = listen;
+  int port = defaultServePort;
+  // host:port, [v6]:port or a bare host
+  if (auto pos = listen.rfind(':');
+      pos != std::wstring_view::npos && listen.find(']', pos) == std::wstring_view::npos) {
+    host = listen.substr(0, pos);
+    if (!bela::SimpleAtoi(listen.substr(pos + 1), &port) || port <= 0 || port > 65535) {
+      bela::FPrintF(stderr, L"baulk serve: invalid listen address '%s'\n", listen);
+      return 1;
+    }
+  }
+  if (bela::ConsumePrefix(&host, L"[")) {
+    bela::ConsumeSuffix(&host, L"]");
+  }
+  WSADATA wsaData;
+  if (auto err = WSAStartup(MAKEWORD(2, 2), &wsaData); err != 0) {
+    bela::FPrintF(stderr, L"baulk serve: WSAStartup: %s\n", bela::make_system_error_code());
+    return 1;
+  }
+  auto wsaCleanup = bela::finally([] { WSACleanup(); });
+  ADDRINFOW hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  hints.ai_flags = AI_PASSIVE;
+  PADDRINFOW result = nullptr;
+  auto hostName = std::wstring(host);
+  if (GetAddrInfoW(hostName.empty() ? nullptr : hostName.data(), std::to_wstring(port).data(), &hints, &result) != 0) {
+    bela::FPrintF(stderr, L"baulk serve: resolve '%s': %s\n", listen, bela::make_system_error_code());
+    return 1;
+  }
+  auto freeResult = bela::finally([&] { FreeAddrInfoW(result); });
+  auto listener = socket(result->ai_family, SOCK_STREAM, IPPROTO_TCP);
+  if (listener == INVALID_SOCKET) {
+    bela::FPrintF(stderr, L"baulk serve: socket: %s\n", bela::make_system_error_code());
+    return 1;
+  }
+  auto closer = bela::finally([&] { closesocket(listener); });
+  if (bind(listener, result->ai_addr, static_cast<int>(result->ai_addrlen)) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0) {
+    bela::FPrintF(stderr, L"baulk serve: listen '%s': %s\n", listen, bela::make_system_error_code());
+    return 1;
+  }
+  bela::FPrintF(stderr, L"baulk serve: \x1b[32m%s\x1b[0m on port \x1b[36m%d\x1b[0m%s\n", downloads.native(), port,
+                fetchMissing ? L", fetching missing archives" : L"");
+  for (;;) {
+    sockaddr_storage addr{};
+    int addrlen = sizeof(addr);
+    auto s = accept(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen);
+    if (s == INVALID_SOCKET) {
+      bela::FPrintF(stderr, L"baulk serve: accept: %s\n", bela::make_system_error_code());
+      return 1;
+    }
+    if (connections.fetch_add(1) >= maxServeConnections) {
+      connections--;
+      sendStatus(s, 503, L"Service Unavailable", false);
+      closesocket(s);
+      continue;
+    }
+    std::thread([this, s, remote = remoteAddress(addr)] { serve(s, remote); }).detach();
+  }
+}
+
+int cmd_serve(const argv_t &argv) {
+  baulk::cli::ParseArgv pa(argv);
+  pa.Add(L"listen", baulk::cli::required_argument, L'L').Add(L"fetch-missing", baulk::cli::no_argument, 1001);
+  std::wstring listen = bela::StringCat(L"0.0.0.0:", defaultServePort);
+  bool fetchMissing = false;
+  bela::error_code ec;
+  auto ret = pa.Execute(
+      [&](int val, const wchar_t *oa, const wchar_t *) {
+        switch (val) {
+        case L'L':
+          listen = oa;
+          break;
+        case 1001:
+          fetchMissing = true;
+          break;
+        default:
+          return false;
+        }
+        return true;
+      },
+      ec);
+  if (!ret) {
+    bela::FPrintF(stderr, L"baulk serve: \x1b[31m%s\x1b[0m\n", ec);
+    return 1;
+  }
+  cache_server server(fetchMissing);
+  return server.Run(listen);
+}
+
+} // namespace baulk::commands
@@ -10,6 +10,9 @@
 #include <baulk/fs.hpp>
 #include <baulk/json_utils.hpp>
 #include "bucket.hpp"
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "commands.hpp"
 
@@ -17,6 +20,7 @@ namespace baulk::commands {
 struct bucket_metadata {
   std::wstring latest;
   std::string updated;
+  BucketValidators validators;
 };
 
 class BucketUpdater {
@@ -32,6 +36,7 @@ public:
   bool Update(const baulk::Bucket &bucket);
 
 private:
+  std::mutex mu; // buckets update concurrently, status is shared
   bucket_status_t status;
   std::wstring lockFile;
   bool updated{false};
@@ -52,8 +57,14 @@ bool BucketUpdater::Initialize() {
       auto name = a["name"].get<std::string_view>();
       auto latest = a["latest"].get<std::string_view>();
       auto time = a["time"].get<std::string_view>();
-      status.emplace(bela::encode_into<char, wchar_t>(name),
-                     bucket_metadata{bela::encode_into<char, wchar_t>(latest), std::string(time)});
+      bucket_metadata bm{bela::encode_into<char, wchar_t>(latest), std::string(time)};
+      if (auto it = a.find("etag"); it != a.end() && it->is_string()) {
+        bm.validators.etag = bela::encode_into<char, wchar_t>(it->get<std::string_view>());
+      }
+      if (auto it = a.find("last_modified"); it != a.end() && it->is_string()) {
+        bm.validators.lastModified = bela::encode_into<char, wchar_t>(it->get<std::string_view>());
+      }
+      status.emplace(bela::encode_into<char, wchar_t>(name), std::move(bm));
     }
   } catch (const std::exception &e) {
     bela::FPrintF(stderr, L"baulk update: decode metadata. error: %s\n", e.what());
@@ -73,6 +84,12 @@ bool BucketUpdater::Immobilized() {
       o["name"] = bela::encode_into<wchar_t, char>(b.first);
       o["latest"] = bela::encode_into<wchar_t, char>(b.second.latest);
       o["time"] = b.second.updated;
+      if (!b.second.validators.etag.empty()) {
+        o["etag"] = bela::encode_into<wchar_t, char>(b.second.validators.etag);
+      }
+      if (!b.second.validators.lastModified.empty()) {
+        o["last_modified"] = bela::encode_into<wchar_t, char>(b.second.validators.lastModified);
+      }
       j.push_back(std::move(o));
     }
     auto meta = j.dump(4);
@@ -91,23 +108,39 @@ bool BucketUpdater::Immobilized() {
 
 bool BucketUpdater::Update(const baulk::Bucket &bucket) {
   bela::error_code ec;
-  auto latest = baulk::BucketNewest(bucket, ec);
+  std::wstring known;
+  BucketValidators validators;
+  {
+    std::scoped_lock lock(mu);
+    if (auto it = status.find(bucket.name); it != status.end()) {
+      known = it->second.latest;
+      validators = it->second.validators;
+    }
+  }
+  auto latest = baulk::BucketNewest(bucket, known, validators, ec);
   if (!latest) {
     bela::FPrintF(stderr, L"baulk update \x1b[34m%s\x1b[0m error: \x1b[31m%s\x1b[0m\n", bucket.name, ec);
     return false;
   }
-  auto it = status.find(bucket.name);
-  if (it != status.end() && bela::EqualsIgnoreCase(it->second.latest, *latest)) {
+  if (!known.empty() && bela::EqualsIgnoreCase(known, *latest)) {
     baulk::DbgPrint(L"bucket: %s is up to date. id: %s", bucket.name, *latest);
+    // the feed may change without a new commit, keep its validators current
+    std::scoped_lock lock(mu);
+    if (auto &bm = status[bucket.name]; bm.validators.etag != validators.etag ||
+                                        bm.validators.lastModified != validators.lastModified) {
+      bm.validators = std::move(validators);
+      updated = true;
+    }
     return true;
   }
   baulk::DbgPrint(L"bucket: %s latest id: %s", bucket.name, *latest);
-  if (!baulk::BucketUpdate(bucket, *latest, ec)) {
+  if (!baulk::BucketUpdate(bucket, known, *latest, ec)) {
     bela::FPrintF(stderr, L"bucke download \x1b[34m%s\x1b[0m error: \x1b[31m%s\x1b[0m\n", bucket.name, ec);
     return false;
   }
   bela::FPrintF(stderr, L"\x1b[32m'%s' is up to date: %s\x1b[0m\n", bucket.name, *latest);
-  status[bucket.name] = bucket_metadata{*latest, bela::FormatTime<char>(bela::Now())};
+  std::scoped_lock lock(mu);
+  status[bucket.name] = bucket_metadata{*latest, bela::FormatTime<char>(bela::Now()), std::move(validators)};
   updated = true;
   return true;
 }
@@ -153,13 +186,31 @@ Update bucket metadata.
 )");
 }
 
+// buckets updated at the same time
+constexpr size_t bucket_jobs = 4;
+
 int UpdateBucket(bool showUpdatable) {
   BucketUpdater updater;
   if (!updater.Initialize()) {
     return 1;
   }
-  for (const auto &bucket : baulk::LoadedBuckets()) {
-    updater.Update(bucket);
+  // freshness checks and downloads mostly wait on round trips, a few buckets update at once
+  const auto &buckets = baulk::LoadedBuckets();
+  std::atomic_size_t next{0};
+  auto workers = (std::min)(bucket_jobs, buckets.size());
+  {
+    baulk::quiet_scope quiet(workers > 1);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; i++) {
+      threads.emplace_back([&] {
+        for (auto k = next.fetch_add(1); k < buckets.size(); k = next.fetch_add(1)) {
+          updater.Update(buckets[k]);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
   }
   if (!updater.Immobilized()) {
     return 1;
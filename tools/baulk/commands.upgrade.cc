@@ -45,6 +45,7 @@ int cmd_upgrade(const argv_t &argv) {
     baulk::DbgPrint(L"baulk upgrade: unable initialize compiler executor: %s", ec);
   }
 
+  std::vector<baulk::Package> pkgs;
   bela::fs::Finder finder;
   if (finder.First(vfs::AppLocks(), L"*.json", ec)) {
     do {
@@ -62,11 +63,14 @@ int cmd_upgrade(const argv_t &argv) {
       }
       baulk::Package pkg;
       if (baulk::PackageUpdatableMeta(*localMeta, pkg)) {
-        baulk::package::PackageInstall(pkg);
+        pkgs.emplace_back(std::move(pkg));
         continue;
       }
     } while (finder.Next());
   }
+  if (!pkgs.empty()) {
+    baulk::package::PackageInstall(pkgs);
+  }
   return 0;
 }
 int cmd_update_and_upgrade(const argv_t &argv) {
@@ -1,9 +1,11 @@
 // baulk context
 #include <version.hpp>
 #include <bela/io.hpp>
+#include <bela/env.hpp>
 #include <baulk/vfs.hpp>
 #include <baulk/json_utils.hpp>
 #include <baulk/fs.hpp>
+#include <baulk/net/client.hpp>
 #include "baulk.hpp"
 
 namespace baulk {
@@ -42,6 +44,7 @@ public:
     return std::find(pkgs.begin(), pkgs.end(), pkgName) != pkgs.end();
   }
   std::wstring_view LocaleName() const { return localeName; }
+  std::wstring_view MirrorServer() const { return mirrorServer; }
   std::wstring_view Profile() const { return profile; }
   auto &LoadedBuckets() { return buckets; }
   auto &LinkExecutor() { return executor; }
@@ -49,7 +52,8 @@ public:
 private:
   bool initializeInternal(const std::wstring &profile_, bela::error_code &ec);
   Context() = default;
-  std::wstring localeName; // mirrors
+  std::wstring localeName;   // mirrors
+  std::wstring mirrorServer; // baulk serve on the LAN, tried before package urls
   std::wstring profile;
   Buckets buckets;
   std::vector<std::wstring> pkgs;
@@ -85,6 +89,19 @@ bool Context::initializeInternal(const std::wstring &profile_, bela::error_code
 
   auto jv = jo->view();
   localeName = jv.fetch("locale", localeName);
+  if (mirrorServer.empty()) {
+    mirrorServer = jv.fetch("mirror");
+  }
+  // "download": {"connections": 16, "host_connections": 6, "rate_limit": bytes per second}
+  if (auto dv = jv.subview("download"); dv) {
+    net::transfer_limits limits;
+    limits.connections = dv->fetch_as_integer("connections", limits.connections);
+    limits.host_connections = dv->fetch_as_integer("host_connections", limits.host_connections);
+    limits.rate = dv->fetch_as_integer("rate_limit", limits.rate);
+    DbgPrint(L"Download connections %d per host %d rate limit %d", limits.connections, limits.host_connections,
+             limits.rate);
+    net::SetTransferLimits(limits);
+  }
   auto svs = jv.subviews("bucket");
   for (auto sv : svs) {
     buckets.emplace_back(
@@ -113,6 +130,7 @@ bool Context::Initialize(std::wstring_view profile_, bela::error_code &ec) {
   }
 
   localeName = baulk_internal::default_locale_name();
+  mirrorServer = bela::GetEnv(L"BAULK_MIRROR");
   if (IsDebugMode) {
 
     DbgPrint(L"Baulk %s [%s] time: %s", BAULK_VERSION, vfs::AppMode(), BAULK_BUILD_TIME);
@@ -127,6 +145,7 @@ bool Context::Initialize(std::wstring_view profile_, bela::error_code &ec) {
     DbgPrint(L"Baulk AppBuckets  '%s'", vfs::AppBuckets());
     DbgPrint(L"Baulk AppLinks    '%s'", vfs::AppLinks());
     DbgPrint(L"Baulk Locale Name '%s'", localeName);
+    DbgPrint(L"Baulk Mirror      '%s'", mirrorServer);
   }
 
   if (profile_.empty()) {
@@ -143,6 +162,7 @@ bool InitializeContext(std::wstring_view profile, bela::error_code &ec) {
 }
 bool InitializeExecutor(bela::error_code &ec) { return Context::Instance().InitializeExecutor(ec); }
 std::wstring_view LocaleName() { return Context::Instance().LocaleName(); }
+std::wstring_view MirrorServer() { return Context::Instance().MirrorServer(); }
 std::wstring_view Profile() { return Context::Instance().Profile(); }
 Buckets &LoadedBuckets() { return Context::Instance().LoadedBuckets(); }
 compiler::Executor &LinkExecutor() { return Context::Instance().LinkExecutor(); }
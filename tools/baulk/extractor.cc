@@ -84,6 +84,111 @@ bool ZipExtractor::Extract(bela::error_code &ec) {
   return true;
 }
 
+class NsisExtractor final : public Extractor {
+public:
+  NsisExtractor(bela::io::FD &&fd_, const std::filesystem::path &archive_file_,
+                const std::filesystem::path &destination_, const ExtractorOptions &opts)
+      : fd(std::move(fd_)), extractor(opts), archive_file(archive_file_), destination(destination_) {}
+  bool Extract(bela::error_code &ec);
+  bool Initialize(int64_t size, int64_t offset, bela::error_code &ec) {
+    return extractor.OpenReader(fd, destination, size, offset, ec);
+  }
+
+private:
+  bela::io::FD fd;
+  std::filesystem::path archive_file;
+  std::filesystem::path destination;
+  baulk::archive::nsis::Extractor extractor;
+};
+
+bool NsisExtractor::Extract(bela::error_code &ec) {
+  bela::FPrintF(stderr, L"Extracting \x1b[36m%v\x1b[0m ...\n", archive_file.filename());
+  bela::terminal::terminal_size termsz;
+  terminal_size_initialize(termsz);
+  if (!extractor.Extract(
+          [&](const baulk::archive::nsis::File &file, const std::wstring &relative_name) -> bool {
+            progress_show(termsz, relative_name);
+            return true;
+          },
+          nullptr, ec)) {
+    return false;
+  }
+  if (!baulk::IsDebugMode && !baulk::IsQuietMode) {
+    bela::FPrintF(stderr, L"\n");
+  }
+  return true;
+}
+
+class CabExtractor final : public Extractor {
+public:
+  CabExtractor(bela::io::FD &&fd_, const std::filesystem::path &archive_file_,
+               const std::filesystem::path &destination_, const ExtractorOptions &opts)
+      : fd(std::move(fd_)), extractor(opts), archive_file(archive_file_), destination(destination_) {}
+  bool Extract(bela::error_code &ec);
+  bool Initialize(int64_t size, int64_t offset, bela::error_code &ec) {
+    return extractor.OpenReader(fd, destination, size, offset, ec);
+  }
+
+private:
+  bela::io::FD fd;
+  std::filesystem::path archive_file;
+  std::filesystem::path destination;
+  baulk::archive::cab::Extractor extractor;
+};
+
+bool CabExtractor::Extract(bela::error_code &ec) {
+  bela::FPrintF(stderr, L"Extracting \x1b[36m%v\x1b[0m ...\n", archive_file.filename());
+  bela::terminal::terminal_size termsz;
+  terminal_size_initialize(termsz);
+  if (!extractor.Extract(
+          [&](const baulk::archive::cab::File &file, const std::wstring &relative_name) -> bool {
+            progress_show(termsz, relative_name);
+            return true;
+          },
+          nullptr, ec)) {
+    return false;
+  }
+  if (!baulk::IsDebugMode && !baulk::IsQuietMode) {
+    bela::FPrintF(stderr, L"\n");
+  }
+  return true;
+}
+
+class InnoExtractor final : public Extractor {
+public:
+  InnoExtractor(bela::io::FD &&fd_, const std::filesystem::path &archive_file_,
+                const std::filesystem::path &destination_, const ExtractorOptions &opts)
+      : fd(std::move(fd_)), extractor(opts), archive_file(archive_file_), destination(destination_) {}
+  bool Extract(bela::error_code &ec);
+  bool Initialize(int64_t size, int64_t offset, bela::error_code &ec) {
+    return extractor.OpenReader(fd, destination, size, offset, ec);
+  }
+
+private:
+  bela::io::FD fd;
+  std::filesystem::path archive_file;
+  std::filesystem::path destination;
+  baulk::archive::inno::Extractor extractor;
+};
+
+bool InnoExtractor::Extract(bela::error_code &ec) {
+  bela::FPrintF(stderr, L"Extracting \x1b[36m%v\x1b[0m ...\n", archive_file.filename());
+  bela::terminal::terminal_size termsz;
+  terminal_size_initialize(termsz);
+  if (!extractor.Extract(
+          [&](const baulk::archive::inno::File &file, const std::wstring &relative_name) -> bool {
+            progress_show(termsz, relative_name);
+            return true;
+          },
+          nullptr, ec)) {
+    return false;
+  }
+  if (!baulk::IsDebugMode && !baulk::IsQuietMode) {
+    bela::FPrintF(stderr, L"\n");
+  }
+  return true;
+}
+
 // tar or gz and other archive
 class UniversalExtractor final : public Extractor {
 public:
@@ -201,17 +306,63 @@ bool UniversalExtractor::Extract(bela::error_code &ec) {
 
 class MsiExtractor final : public Extractor {
 public:
-  MsiExtractor(const std::filesystem::path &archive_file_, const std::filesystem::path &destination_)
-      : archive_file(archive_file_), destination(destination_) {}
+  MsiExtractor(const std::filesystem::path &archive_file_, const std::filesystem::path &destination_,
+               const ExtractorOptions &opts_)
+      : archive_file(archive_file_), destination(destination_), opts(opts_) {}
   bool Extract(bela::error_code &ec);
 
 private:
+  bool native_extract(bela::error_code &ec);
+  bool admin_extract(bela::error_code &ec);
   std::filesystem::path archive_file;
   std::filesystem::path destination;
+  ExtractorOptions opts;
 };
 
+// native_extract streams files out of the embedded cabinets without running msiexec
+bool MsiExtractor::native_extract(bela::error_code &ec) {
+  auto fd = bela::io::NewFile(archive_file.native(), ec);
+  if (!fd) {
+    return false;
+  }
+  auto size = fd->Size(ec);
+  if (size == bela::SizeUnInitialized) {
+    return false;
+  }
+  baulk::archive::msi::NativeExtractor extractor(opts);
+  if (!extractor.OpenReader(*fd, destination, size, ec)) {
+    return false;
+  }
+  bela::terminal::terminal_size termsz;
+  terminal_size_initialize(termsz);
+  if (!extractor.Extract(
+          [&](const baulk::archive::msi::File &file, const std::wstring &relative_name) -> bool {
+            progress_show(termsz, relative_name);
+            return true;
+          },
+          nullptr, ec)) {
+    return false;
+  }
+  if (!baulk::IsDebugMode && !baulk::IsQuietMode) {
+    bela::FPrintF(stderr, L"\n");
+  }
+  return true;
+}
+
 bool MsiExtractor::Extract(bela::error_code &ec) {
   bela::FPrintF(stderr, L"Extracting \x1b[36m%v\x1b[0m ...\n", archive_file.filename());
+  if (native_extract(ec)) {
+    return baulk::archive::msi::MakeFlattened(destination, ec);
+  }
+  if (ec != baulk::archive::ErrAnotherWay) {
+    return false;
+  }
+  baulk::DbgPrint(L"msi native extract: %v, fallback to administrative install", ec);
+  ec.clear();
+  return admin_extract(ec);
+}
+
+bool MsiExtractor::admin_extract(bela::error_code &ec) {
   baulk::archive::msi::Extractor extractor;
   baulk::ProgressBar bar;
   bar.FileName(bela::StringCat(L"Extracting ", archive_file.filename()));
@@ -319,6 +470,44 @@ inline std::optional<std::wstring> lookup_sevenzip() {
   return std::nullopt;
 }
 
+inline std::optional<std::wstring> lookup_innoextract() {
+  bela::error_code ec;
+  baulk::vfs::InitializeFastPathFs(ec);
+  if (auto innoextract = bela::StringCat(baulk::vfs::AppLinks(), L"\\innoextract.exe");
+      bela::PathExists(innoextract)) {
+    return std::make_optional(std::move(innoextract));
+  }
+  std::wstring innoextract;
+  if (bela::env::LookPath(L"innoextract.exe", innoextract, true)) {
+    return std::make_optional(std::move(innoextract));
+  }
+  return std::nullopt;
+}
+
+// InnoextractExtractor runs an external innoextract.exe for the installers the native reader declines: versions
+// before 5.5 or ANSI builds, encrypted files and disk spanning
+class InnoextractExtractor final : public Extractor {
+public:
+  InnoextractExtractor(const std::wstring &innoextract_, const std::filesystem::path &archive_file_,
+                       const std::filesystem::path &destination_)
+      : innoextract(innoextract_), archive_file(archive_file_), destination(destination_) {}
+  bool Extract(bela::error_code &ec) {
+    bela::FPrintF(stderr, L"Extracting \x1b[36m%v\x1b[0m with innoextract ...\n", archive_file.filename());
+    bela::process::Process process;
+    if (process.Execute(innoextract, L"--silent", L"--exclude-temp", L"--collisions=overwrite", L"-d",
+                        destination.native(), archive_file.native()) != 0) {
+      ec = process.ErrorCode();
+      return false;
+    }
+    return true;
+  }
+
+private:
+  std::wstring innoextract;
+  std::filesystem::path archive_file;
+  std::filesystem::path destination;
+};
+
 class _7zExtractor final : public Extractor {
 public:
   _7zExtractor(const std::filesystem::path &archive_file_, const std::filesystem::path &destination_,
@@ -381,8 +570,48 @@ std::shared_ptr<Extractor> MakeExtractor(const std::filesystem::path &archive_fi
     [[fallthrough]];
   case baulk::archive::file_format_t::tar:
     return std::make_shared<UniversalExtractor>(std::move(*fd), archive_file, destination, opts, baseOffset, afmt);
-  case baulk::archive::file_format_t::cab:
-    [[fallthrough]];
+  case baulk::archive::file_format_t::nsis: {
+    auto e = std::make_shared<NsisExtractor>(std::move(*fd), archive_file, destination, opts);
+    if (e->Initialize(bela::SizeUnInitialized, baseOffset, ec)) {
+      return e;
+    }
+    if (ec != baulk::archive::ErrAnotherWay) {
+      return nullptr;
+    }
+    baulk::DbgPrint(L"nsis native reader: %v, fallback to 7z", ec);
+    ec.clear();
+    return std::make_shared<_7zExtractor>(archive_file, destination, afmt);
+  }
+  case baulk::archive::file_format_t::cab: {
+    auto e = std::make_shared<CabExtractor>(std::move(*fd), archive_file, destination, opts);
+    if (e->Initialize(bela::SizeUnInitialized, baseOffset, ec)) {
+      return e;
+    }
+    if (ec != baulk::archive::ErrAnotherWay) {
+      return nullptr;
+    }
+    baulk::DbgPrint(L"cab native reader: %v, fallback to 7z", ec);
+    ec.clear();
+    return std::make_shared<_7zExtractor>(archive_file, destination, afmt);
+  }
+  case baulk::archive::file_format_t::inno: {
+    auto e = std::make_shared<InnoExtractor>(std::move(*fd), archive_file, destination, opts);
+    if (e->Initialize(bela::SizeUnInitialized, baseOffset, ec)) {
+      return e;
+    }
+    if (ec != baulk::archive::ErrAnotherWay) {
+      return nullptr;
+    }
+    baulk::DbgPrint(L"inno native reader: %v, fallback to innoextract", ec);
+    auto innoextract = lookup_innoextract();
+    if (!innoextract) {
+      ec = bela::make_error_code(baulk::archive::ErrNoOverlayArchive, L"Inno Setup installer, ", ec.message,
+                                 L", innoextract.exe not found");
+      return nullptr;
+    }
+    ec.clear();
+    return std::make_shared<InnoextractExtractor>(*innoextract, archive_file, destination);
+  }
   case baulk::archive::file_format_t::deb:
     [[fallthrough]];
   case baulk::archive::file_format_t::dmg:
@@ -393,14 +622,12 @@ std::shared_ptr<Extractor> MakeExtractor(const std::filesystem::path &archive_fi
     [[fallthrough]];
   case baulk::archive::file_format_t::rar:
     [[fallthrough]];
-  case baulk::archive::file_format_t::nsis:
-    [[fallthrough]];
   case baulk::archive::file_format_t::_7z:
     fd->Assgin(INVALID_HANDLE_VALUE, false);
     return std::make_shared<_7zExtractor>(archive_file, destination, afmt);
   case baulk::archive::file_format_t::msi:
     fd->Assgin(INVALID_HANDLE_VALUE, false);
-    return std::make_shared<MsiExtractor>(archive_file, destination);
+    return std::make_shared<MsiExtractor>(archive_file, destination, opts);
   case baulk::archive::file_format_t::exe:
     ec = bela::make_error_code(baulk::archive::ErrNoOverlayArchive, L"no overlay archive");
     return nullptr;
@@ -426,7 +653,7 @@ bool extract_exe(const std::filesystem::path &archive_file, const std::filesyste
 
 bool extract_msi(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
                  bela::error_code &ec) {
-  MsiExtractor extractor(archive_file, destination);
+  MsiExtractor extractor(archive_file, destination, baulk::archive::ExtractorOptions{});
   if (!extractor.Extract(ec)) {
     baulk::DbgPrint(L"extract msi archive: %v error %v", archive_file.filename(), ec);
     return false;
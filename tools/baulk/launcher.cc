@@ -7,6 +7,8 @@
 #include <bela/io.hpp>
 #include <bela/str_split.hpp>
 #include <bela/datetime.hpp>
+#include <bela/phmap.hpp>
+#include <mutex>
 #include <baulk/fs.hpp>
 #include <baulk/vfs.hpp>
 #include <baulk/json_utils.hpp>
@@ -115,6 +117,54 @@ std::wstring GenerateLinkSource(std::wstring_view target, bool isConsole) {
   return bela::Substitute(launcher_internal::windowstemplate, escapetarget);
 }
 
+// ExecutableProber caches pe probe results per run. Entries are keyed by (path, size, mtime), so a file rewritten
+// during the run is probed again
+class ExecutableProber {
+public:
+  struct Result {
+    bool isConsole{false};
+    std::optional<bela::pe::Version> version;
+  };
+  ExecutableProber(const ExecutableProber &) = delete;
+  ExecutableProber &operator=(const ExecutableProber &) = delete;
+  static ExecutableProber &Instance() {
+    static ExecutableProber prober;
+    return prober;
+  }
+  const Result &Probe(std::wstring_view realexe) {
+    Key key{.path = bela::AsciiStrToLower(realexe)};
+    WIN32_FILE_ATTRIBUTE_DATA wdata;
+    if (GetFileAttributesExW(key.path.data(), GetFileExInfoStandard, &wdata) == TRUE) {
+      key.size = static_cast<int64_t>(wdata.nFileSizeHigh) << 32 | wdata.nFileSizeLow;
+      key.mtime = static_cast<int64_t>(wdata.ftLastWriteTime.dwHighDateTime) << 32 |
+                  wdata.ftLastWriteTime.dwLowDateTime;
+    }
+    std::scoped_lock lock(mtx);
+    if (auto it = results.find(key); it != results.end()) {
+      return it->second;
+    }
+    Result result;
+    result.isConsole = bela::pe::IsSubsystemConsole(realexe);
+    bela::error_code ec;
+    result.version = bela::pe::Lookup(realexe, ec);
+    return results.emplace(std::move(key), std::move(result)).first->second;
+  }
+
+private:
+  ExecutableProber() = default;
+  struct Key {
+    std::wstring path;
+    int64_t size{0};
+    int64_t mtime{0};
+    bool operator==(const Key &other) const {
+      return size == other.size && mtime == other.mtime && path == other.path;
+    }
+    friend size_t hash_value(const Key &k) { return phmap::HashState().combine(0, k.path, k.size, k.mtime); }
+  };
+  std::mutex mtx;
+  bela::node_hash_map<Key, Result> results;
+};
+
 class Builder {
 public:
   Builder() = default;
@@ -174,7 +224,8 @@ bool Builder::Compile(const baulk::Package &pkg, std::wstring_view source, std::
   if (!realexe) {
     return false;
   }
-  auto isConsole = bela::pe::IsSubsystemConsole(*realexe);
+  const auto &probed = ExecutableProber::Instance().Probe(*realexe);
+  auto isConsole = probed.isConsole;
   DbgPrint(L"executable %s is subsystem console: %v\n", *realexe, isConsole);
   auto name = StripExtension(linkMeta.alias);
   auto cxxSourceName = bela::StringCat(name, L".cc");
@@ -185,7 +236,7 @@ bool Builder::Compile(const baulk::Package &pkg, std::wstring_view source, std::
     return false;
   }
   bool rcwrited = false;
-  if (auto vi = bela::pe::Lookup(source, ec); vi) {
+  if (auto vi = probed.version; vi) {
     baulk::rc::Writer w;
     if (vi->CompanyName.empty()) {
       vi->CompanyName = bela::StringCat(pkg.name, L" contributors");
@@ -9,7 +9,15 @@
 #include <baulk/vfs.hpp>
 #include <baulk/json_utils.hpp>
 #include <baulk/net.hpp>
+#include <baulk/cdn.hpp>
 #include <baulk/hash.hpp>
+#include <baulk/indicators.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <semaphore>
+#include <thread>
 #include "bucket.hpp"
 #include "launcher.hpp"
 #include "pkg.hpp"
@@ -84,7 +92,7 @@ bool PackageForceDelete(std::wstring_view pkgName, bela::error_code &ec) {
   return true;
 }
 
-// Package cached
+// Package cached, digests verified earlier are remembered in the downloads folder
 std::optional<std::filesystem::path> PackageCached(const std::filesystem::path &downloads, std::wstring_view filename,
                                                    std::wstring_view hash) {
   std::filesystem::path archive_file = downloads / filename;
@@ -93,7 +101,7 @@ std::optional<std::filesystem::path> PackageCached(const std::filesystem::path &
     return std::nullopt;
   }
   bela::error_code ec;
-  if (!baulk::hash::HashEqual(archive_file, hash, ec)) {
+  if (!baulk::hash::HashEqualCached(archive_file, hash, downloads / L"baulk.verified.json", ec)) {
     bela::FPrintF(stderr, L"package file %s error: %s\n", filename, ec);
     return std::nullopt;
   }
@@ -136,8 +144,9 @@ bool PackageMakeLinks(const baulk::Package &pkg) {
   return true;
 }
 
-// single exe package
-bool expand_fallback_exe(const baulk::Package &pkg, const std::filesystem::path &archive_file) {
+// single exe package, the package to record gains a link to the copied exe
+std::optional<baulk::Package> expand_fallback_exe(const baulk::Package &pkg,
+                                                  const std::filesystem::path &archive_file) {
   std::filesystem::path packages(baulk::vfs::AppPackages());
   auto pkgRoot = packages / pkg.name;
   auto oldPath = packages / bela::StringCat(pkg.name, L".out");
@@ -148,56 +157,63 @@ bool expand_fallback_exe(const baulk::Package &pkg, const std::filesystem::path
     if (std::filesystem::rename(pkgRoot, oldPath, e); e) {
       ec = e;
       bela::FPrintF(stderr, L"baulk rename %s to %s error: \x1b[31m%s\x1b[0m\n", pkgRoot, oldPath, ec);
-      return false;
+      return std::nullopt;
     }
   }
   if (!std::filesystem::create_directories(pkgRoot, e)) {
     ec = e;
     bela::FPrintF(stderr, L"baulk rename %s to %s error: \x1b[31m%s\x1b[0m\n", pkgRoot, oldPath, ec);
     std::filesystem::rename(oldPath, pkgRoot, e);
-    return false;
+    return std::nullopt;
   }
   auto exePath = pkgRoot / exefile;
   if (!std::filesystem::copy_file(archive_file, exePath, std::filesystem::copy_options::overwrite_existing, e)) {
     ec = e;
     bela::FPrintF(stderr, L"baulk rename %s to %s error: \x1b[31m%s\x1b[0m\n", pkgRoot, oldPath, ec);
     std::filesystem::rename(oldPath, pkgRoot, e);
-    return false;
+    return std::nullopt;
   }
+  std::filesystem::remove_all(oldPath, e);
   auto pkgCopy = pkg;
   pkgCopy.links.emplace_back(exefile, exefile);
   pkgCopy.mask |= MaskCompatibilityMode; // keep launcher
-  if (!PackageLocalMetaWrite(pkgCopy, ec)) {
-    bela::FPrintF(stderr, L"baulk unable write local meta: %s\n", ec);
-    return false;
-  }
-  std::filesystem::remove_all(oldPath, e);
-  return PackageMakeLinks(pkgCopy);
+  return std::make_optional(std::move(pkgCopy));
 }
 
-bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archive_file) {
+// PackageUnpack extracts the archive and moves it into the package folder, returns the package to record.
+// It only touches the folders of this package, so unpacks of different packages may run at the same time
+std::optional<baulk::Package> PackageUnpack(const baulk::Package &pkg, const std::filesystem::path &archive_file) {
   auto fn = baulk::resolve_extract_handle(pkg.extension);
   if (!fn) {
     bela::FPrintF(stderr, L"baulk unsupport package extension: %s\n", pkg.extension);
-    return false;
+    return std::nullopt;
   }
   std::filesystem::path strict_folder;
-  auto destination = baulk::make_unqiue_extracted_destination(archive_file, strict_folder);
+  std::optional<std::filesystem::path> destination;
+  std::error_code e;
+  {
+    // reserve the folder, archives of two packages may strip to the same name
+    static std::mutex destinationMutex;
+    std::lock_guard lock(destinationMutex);
+    if (destination = baulk::make_unqiue_extracted_destination(archive_file, strict_folder); destination) {
+      std::filesystem::create_directories(*destination, e);
+    }
+  }
   if (!destination) {
     bela::FPrintF(stderr, L"destination '%v' already exists\n", strict_folder);
-    return false;
+    return std::nullopt;
   }
   bela::error_code ec;
   if (!fn(archive_file, *destination, ec)) {
     if (ec == baulk::archive::ErrNoOverlayArchive) {
+      std::filesystem::remove_all(*destination, e);
       return expand_fallback_exe(pkg, archive_file);
     }
     bela::FPrintF(stderr, L"baulk extract: %v error: %v\n", archive_file.filename(), ec);
-    return false;
+    return std::nullopt;
   }
   std::filesystem::path packages(baulk::vfs::AppPackages());
   auto pkgRoot = packages / pkg.name;
-  std::error_code e;
   // rename failed
   if (![&]() -> bool {
         std::wstring oldPath;
@@ -220,9 +236,14 @@ bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archi
         }
         return true;
       }()) {
-    return false;
+    return std::nullopt;
   }
-  // create a links
+  return std::make_optional(pkg);
+}
+
+// PackageCommit writes the local meta and the links of an unpacked package
+bool PackageCommit(const baulk::Package &pkg) {
+  bela::error_code ec;
   if (!PackageLocalMetaWrite(pkg, ec)) {
     bela::FPrintF(stderr, L"baulk unable write local meta: %s\n", ec);
     return false;
@@ -230,6 +251,14 @@ bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archi
   return PackageMakeLinks(pkg);
 }
 
+bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archive_file) {
+  auto unpacked = PackageUnpack(pkg, archive_file);
+  if (!unpacked) {
+    return false;
+  }
+  return PackageCommit(*unpacked);
+}
+
 bool DependenciesExists(const std::vector<std::wstring_view> &dv) {
   for (const auto d : dv) {
     auto pkglock = bela::StringCat(vfs::AppLocks(), L"\\", d, L".json");
@@ -248,99 +277,392 @@ void DisplayDependencies(const baulk::Package &pkg) {
                 bela::StrJoin(pkg.venv.dependencies, L"\n    "));
 }
 
-bool PackageInstall(const baulk::Package &pkg) {
+void DisplayNotes(const baulk::Package &pkg) {
+  if (!pkg.suggest.empty()) {
+    bela::FPrintF(stderr, L"'%s' suggests installing: '\x1b[32m%s\x1b[0m'\n", pkg.name,
+                  bela::StrJoin(pkg.suggest, L"\x1b[0m' or '\x1b[32m"));
+  }
+  if (!pkg.notes.empty()) {
+    bela::FPrintF(stderr, L"'%s' notes\n-----\n%s\n", pkg.name, pkg.notes);
+  }
+  DisplayDependencies(pkg);
+}
+
+// install_plan: what installing a package takes after comparing it with the installed version
+enum class install_plan {
+  done,     // nothing to do
+  links,    // rebuild links of the installed version
+  download, // download, unpack and link the package
+};
+
+install_plan PackageInstallPlan(const baulk::Package &pkg) {
   bela::error_code ec;
   auto pkgLocal = baulk::PackageLocalMeta(pkg.name, ec);
-  if (pkgLocal) {
-    bela::version pkgVersion(pkg.version);
-    bela::version localVersion(pkgLocal->version);
-    // new version less installed version or weights < weigths
-    if (pkgVersion < localVersion || (pkgVersion == localVersion && pkg.weights <= pkgLocal->weights)) {
-      if ((pkgLocal->mask & MaskCompatibilityMode) != 0) {
-        bela::FPrintF(stderr,
-                      L"baulk already installed \x1b[35m%s\x1b[0m/\x1b[34m%s\x1b[0m version \x1b[32m%s\x1b[0m "
-                      L"[\x1b[36mCompatibility Mode\x1b[0m]\n",
-                      pkg.name, pkg.bucket, pkgLocal->version);
-        return true;
-      }
-      return PackageMakeLinks(pkg);
-    }
-    if (baulk::IsFrozenedPackage(pkg.name) && !baulk::IsForceMode) {
-      // Since the metadata has been updated, we cannot rebuild the frozen
-      // package launcher
+  if (!pkgLocal) {
+    return install_plan::download;
+  }
+  bela::version pkgVersion(pkg.version);
+  bela::version localVersion(pkgLocal->version);
+  // new version less installed version or weights < weigths
+  if (pkgVersion < localVersion || (pkgVersion == localVersion && pkg.weights <= pkgLocal->weights)) {
+    if ((pkgLocal->mask & MaskCompatibilityMode) != 0) {
       bela::FPrintF(stderr,
-                    L"baulk \x1b[31mskip upgrade\x1b[0m "
-                    L"\x1b[35m%s\x1b[0m(\x1b[31mfrozen\x1b[0m) from "
-                    L"\x1b[33m%s\x1b[0m@\x1b[34m%s\x1b[0m to "
-                    L"\x1b[32m%s\x1b[0m@\x1b[34m%s\x1b[0m.\n",
-                    pkg.name, pkgLocal->version, pkgLocal->bucket, pkg.version, pkg.bucket);
-      return true;
+                    L"baulk already installed \x1b[35m%s\x1b[0m/\x1b[34m%s\x1b[0m version \x1b[32m%s\x1b[0m "
+                    L"[\x1b[36mCompatibility Mode\x1b[0m]\n",
+                    pkg.name, pkg.bucket, pkgLocal->version);
+      return install_plan::done;
     }
+    return install_plan::links;
+  }
+  if (baulk::IsFrozenedPackage(pkg.name) && !baulk::IsForceMode) {
+    // Since the metadata has been updated, we cannot rebuild the frozen
+    // package launcher
     bela::FPrintF(stderr,
-                  L"baulk will upgrade \x1b[35m%s\x1b[0m from "
+                  L"baulk \x1b[31mskip upgrade\x1b[0m "
+                  L"\x1b[35m%s\x1b[0m(\x1b[31mfrozen\x1b[0m) from "
                   L"\x1b[33m%s\x1b[0m@\x1b[34m%s\x1b[0m to "
-                  L"\x1b[32m%s\x1b[0m@\x1b[34m%s\x1b[0m\n",
+                  L"\x1b[32m%s\x1b[0m@\x1b[34m%s\x1b[0m.\n",
                   pkg.name, pkgLocal->version, pkgLocal->bucket, pkg.version, pkg.bucket);
+    return install_plan::done;
   }
-  auto url = baulk::net::BestUrl(pkg.urls, LocaleName());
+  bela::FPrintF(stderr,
+                L"baulk will upgrade \x1b[35m%s\x1b[0m from "
+                L"\x1b[33m%s\x1b[0m@\x1b[34m%s\x1b[0m to "
+                L"\x1b[32m%s\x1b[0m@\x1b[34m%s\x1b[0m\n",
+                pkg.name, pkgLocal->version, pkgLocal->bucket, pkg.version, pkg.bucket);
+  return install_plan::download;
+}
+
+// download_request: where a package comes from and how its download is reported
+struct download_request {
+  std::wstring url;
+  std::wstring filename;
+  uint32_t connections{4};
+  baulk::net::download_progress progress;
+};
+
+// latency and throughput of mirrors seen by earlier installs
+inline std::filesystem::path MirrorTable() {
+  return std::filesystem::path(bela::StringCat(vfs::AppData(), L"\\baulk\\baulk.mirrors.json"));
+}
+
+std::optional<download_request> PackageDownloadRequest(const baulk::Package &pkg) {
+  auto url = baulk::net::BestUrl(pkg.urls, LocaleName(), MirrorTable());
   if (url.empty()) {
     bela::FPrintF(stderr, L"baulk: \x1b[31m%s\x1b[0m no valid url\n", pkg.name);
-    return false;
+    return std::nullopt;
   }
   DbgPrint(L"baulk '%s/%s' url: '%s'\n", pkg.name, pkg.version, url);
+  return std::make_optional(download_request{.url = std::wstring(url), .filename = net::url_path_name(url)});
+}
+
+// a mirror that does not accept connections is skipped for the rest of the run, a dead mirror costs one short dial
+// instead of a WinHTTP connect timeout per package
+constexpr int mirrorDialTimeout = 1500;
+static std::atomic_bool mirrorDown{false};
+
+// PackageMirrorDownload fetches the archive from the 'baulk serve' mirror by its hash, the upstream url is sent
+// along so a mirror that fetches missing archives has it for the next client. The mirror writes '<file>.mirror.part'
+// so a miss does not truncate or delete the '<file>.part' an interrupted upstream download left behind
+std::optional<std::filesystem::path> PackageMirrorDownload(const baulk::Package &pkg, const download_request &req,
+                                                          const std::filesystem::path &downloads) {
+  auto mirror = MirrorServer();
+  if (mirror.empty() || pkg.hash.empty() || mirrorDown) {
+    return std::nullopt;
+  }
+  if (bela::error_code ec; !baulk::net::Reachable(mirror, mirrorDialTimeout, ec)) {
+    if (!mirrorDown.exchange(true)) {
+      bela::FPrintF(stderr, L"baulk: mirror \x1b[33m%s\x1b[0m unreachable, skipped: %s\n", mirror, ec);
+    }
+    return std::nullopt;
+  }
+  auto url = baulk::cdn{.hash = pkg.hash, .filename = req.filename}.URL(mirror);
+  DbgPrint(L"baulk '%s/%s' mirror: '%s'\n", pkg.name, pkg.version, url);
+  baulk::net::download_options opts{
+      .hash_value = pkg.hash,
+      .cwd = downloads,
+      .destination = downloads / bela::StringCat(req.filename, L".mirror"),
+      .force_overwrite = true,
+      .connections = req.connections,
+      .progress = req.progress,
+  };
+  opts.headers.emplace(std::wstring(BaulkMirrorURL), req.url);
+  bela::error_code ec;
+  auto archive_file = baulk::net::WinGet(url, opts, ec);
+  if (!archive_file) {
+    DbgPrint(L"baulk '%s' not on mirror: %s", req.filename, ec);
+    return std::nullopt;
+  }
+  auto destination = downloads / req.filename;
+  std::error_code e;
+  std::filesystem::rename(*archive_file, destination, e);
+  if (e) {
+    bela::FPrintF(stderr, L"baulk: rename %s error: %s\n", *archive_file, bela::fromascii(e.message()));
+    return std::nullopt;
+  }
+  return std::make_optional(std::move(destination));
+}
+
+// PackageDownload returns the verified archive of a package, from the download cache when it is there
+std::optional<std::filesystem::path> PackageDownload(const baulk::Package &pkg, const download_request &req) {
   std::filesystem::path downloads(vfs::AppTemp());
-  auto filename = net::url_path_name(url);
   if (!pkg.hash.empty()) {
-    DbgPrint(L"baulk '%s/%s' filename: '%s'\n", pkg.name, pkg.version, filename);
-    if (auto archive_file = PackageCached(downloads, filename, pkg.hash); archive_file) {
-      return PackageExpand(pkg, *archive_file);
+    DbgPrint(L"baulk '%s/%s' filename: '%s'\n", pkg.name, pkg.version, req.filename);
+    if (auto archive_file = PackageCached(downloads, req.filename, pkg.hash); archive_file) {
+      return archive_file;
     }
   }
+  bela::error_code ec;
   if (!baulk::fs::MakeDirectories(downloads, ec)) {
     bela::FPrintF(stderr, L"baulk: unable make %s error: %s\n", downloads, ec);
-    return false;
+    return std::nullopt;
   }
-  bela::FPrintF(stderr, L"baulk: download '\x1b[36m%s\x1b[0m' \nurl: \x1b[36m%s\x1b[0m\n", filename, url);
+  if (auto archive_file = PackageMirrorDownload(pkg, req, downloads); archive_file) {
+    return archive_file;
+  }
+  bela::FPrintF(stderr, L"\x1b[2K\rbaulk: download '\x1b[36m%s\x1b[0m' \nurl: \x1b[36m%s\x1b[0m\n", req.filename,
+                req.url);
   std::optional<std::filesystem::path> archive_file;
   for (int i = 0; i < 4; i++) {
     if (i != 0) {
-      bela::FPrintF(stderr, L"baulk: download '\x1b[33m%s\x1b[0m' retries: \x1b[33m%d\x1b[0m\n", filename, i);
+      bela::FPrintF(stderr, L"\x1b[2K\rbaulk: download '\x1b[33m%s\x1b[0m' retries: \x1b[33m%d\x1b[0m\n",
+                    req.filename, i);
     }
+    auto begin = std::chrono::steady_clock::now();
     //  downloads, pkg.hash, true
-    if (archive_file = baulk::net::WinGet(url,
+    if (archive_file = baulk::net::WinGet(req.url,
                                           {
                                               .hash_value = pkg.hash,
                                               .cwd = downloads,
                                               .force_overwrite = true,
+                                              .connections = req.connections,
+                                              .progress = req.progress,
                                           },
                                           ec);
         !archive_file) {
-      bela::FPrintF(stderr, L"baulk: download '%s' error: \x1b[31m%s\x1b[0m\n", filename, ec);
+      bela::FPrintF(stderr, L"\x1b[2K\rbaulk: download '%s' error: \x1b[31m%s\x1b[0m\n", req.filename, ec);
       continue;
     }
-    // hash not check
-    if (pkg.hash.empty()) {
-      break;
-    }
-    if (hash::HashEqual(*archive_file, pkg.hash, ec)) {
-      break;
+    // WinGet hashes the file while downloading and fails on checksum mismatch
+    std::error_code e;
+    if (auto size = std::filesystem::file_size(*archive_file, e); !e) {
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+      baulk::net::RecordThroughput(MirrorTable(), req.url, static_cast<int64_t>(size), seconds);
     }
-    bela::FPrintF(stderr, L"baulk download '%s' error: \x1b[31m%s\x1b[0m\n", archive_file->filename(), ec);
+    break;
   }
+  return archive_file;
+}
+
+bool PackageInstall(const baulk::Package &pkg) {
+  switch (PackageInstallPlan(pkg)) {
+  case install_plan::done:
+    return true;
+  case install_plan::links:
+    return PackageMakeLinks(pkg);
+  default:
+    break;
+  }
+  auto req = PackageDownloadRequest(pkg);
+  if (!req) {
+    return false;
+  }
+  auto archive_file = PackageDownload(pkg, *req);
   if (!archive_file) {
     return false;
   }
   if (!PackageExpand(pkg, *archive_file)) {
     return false;
   }
-  if (!pkg.suggest.empty()) {
-    bela::FPrintF(stderr, L"'%s' suggests installing: '\x1b[32m%s\x1b[0m'\n", pkg.name,
-                  bela::StrJoin(pkg.suggest, L"\x1b[0m' or '\x1b[32m"));
+  DisplayNotes(pkg);
+  return true;
+}
+
+// packages downloaded at the same time, and the connections they share
+constexpr size_t download_jobs = 4;
+constexpr uint32_t download_connections = 8;
+
+// install_job: one package moving through download -> unpack -> commit
+struct install_job {
+  const baulk::Package *pkg{nullptr};
+  install_plan plan{install_plan::done};
+  std::optional<download_request> req;
+  std::optional<baulk::Package> unpacked;
+  bool serial{false}; // shares its archive name with an earlier job, runs alone when its turn comes
+  bool finished{false};
+  std::atomic_int64_t current{0};
+  std::atomic_int64_t total{0};
+};
+
+// install_scheduler downloads packages concurrently, unpacks them on a bounded pipeline and commits them in order
+class install_scheduler {
+public:
+  install_scheduler(const std::vector<const baulk::Package *> &pkgs) : jobs(pkgs.size()) {
+    for (size_t i = 0; i < pkgs.size(); i++) {
+      jobs[i].pkg = pkgs[i];
+    }
   }
-  if (!pkg.notes.empty()) {
-    bela::FPrintF(stderr, L"'%s' notes\n-----\n%s\n", pkg.name, pkg.notes);
+  install_scheduler(const install_scheduler &) = delete;
+  install_scheduler &operator=(const install_scheduler &) = delete;
+  bool Execute();
+
+private:
+  std::vector<install_job> jobs;
+  std::vector<size_t> queue; // jobs to download, in order
+  std::atomic_size_t next{0};
+  std::mutex mu;
+  std::condition_variable cv;
+  std::counting_semaphore<64> unpackSlots{1};
+  std::mutex exclusiveUnpack; // msi may fall back to msiexec, which runs one installation at a time
+  baulk::ProgressBar bar;
+  void download_worker();
+  void unpack(install_job &job, const std::filesystem::path &archive_file);
+  void report();
+  void finish(install_job &job) {
+    {
+      std::lock_guard lock(mu);
+      job.finished = true;
+    }
+    cv.notify_all();
   }
-  DisplayDependencies(pkg);
-  return true;
+};
+
+void install_scheduler::report() {
+  int64_t current = 0;
+  int64_t total = 0;
+  for (const auto &job : jobs) {
+    current += job.current.load(std::memory_order_relaxed);
+    total += job.total.load(std::memory_order_relaxed);
+  }
+  bar.Maximum(static_cast<uint64_t>(total));
+  bar.Update(static_cast<uint64_t>(current));
+}
+
+void install_scheduler::unpack(install_job &job, const std::filesystem::path &archive_file) {
+  unpackSlots.acquire();
+  auto release = bela::finally([&] { unpackSlots.release(); });
+  if (bela::EqualsIgnoreCase(job.pkg->extension, L"msi")) {
+    std::lock_guard lock(exclusiveUnpack);
+    job.unpacked = PackageUnpack(*job.pkg, archive_file);
+    return;
+  }
+  job.unpacked = PackageUnpack(*job.pkg, archive_file);
+}
+
+void install_scheduler::download_worker() {
+  for (;;) {
+    auto i = next.fetch_add(1);
+    if (i >= queue.size()) {
+      return;
+    }
+    auto &job = jobs[queue[i]];
+    if (auto archive_file = PackageDownload(*job.pkg, *job.req); archive_file) {
+      job.current = job.total.load();
+      unpack(job, *archive_file);
+    }
+    finish(job);
+  }
+}
+
+bool install_scheduler::Execute() {
+  // resolve the hosts of every package to download while the mirrors of the first ones are chosen
+  std::vector<std::wstring> urls;
+  for (auto &job : jobs) {
+    if (job.plan = PackageInstallPlan(*job.pkg); job.plan == install_plan::download) {
+      urls.insert(urls.end(), job.pkg->urls.begin(), job.pkg->urls.end());
+    }
+  }
+  baulk::net::ResolveAhead(urls);
+  std::vector<std::wstring> filenames;
+  for (auto &job : jobs) {
+    if (job.plan != install_plan::download) {
+      continue;
+    }
+    if (job.req = PackageDownloadRequest(*job.pkg); !job.req) {
+      continue;
+    }
+    auto name = bela::AsciiStrToLower(job.req->filename);
+    if (std::find(filenames.begin(), filenames.end(), name) != filenames.end()) {
+      job.serial = true;
+      continue;
+    }
+    filenames.emplace_back(std::move(name));
+    queue.emplace_back(static_cast<size_t>(&job - jobs.data()));
+  }
+  auto workers = (std::min)(download_jobs, queue.size());
+  baulk::quiet_scope quiet(workers > 1);
+  if (workers > 1) {
+    for (auto i : queue) {
+      auto &job = jobs[i];
+      job.req->connections = (std::max)(download_connections / static_cast<uint32_t>(workers), 1U);
+      job.req->progress = [this, &job](int64_t current, int64_t total) {
+        job.current = current;
+        job.total = total;
+        report();
+      };
+    }
+    auto slots = (std::clamp)(std::thread::hardware_concurrency() / 2, 1U, 4U);
+    unpackSlots.release(static_cast<ptrdiff_t>(slots - 1));
+    bar.FileName(bela::StringCat(queue.size(), L" packages"));
+    bar.Execute();
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; i++) {
+    threads.emplace_back([this] { download_worker(); });
+  }
+  bool ok = true;
+  // links and local meta are written in the order of the packages, on this thread
+  for (auto &job : jobs) {
+    switch (job.plan) {
+    case install_plan::done:
+      continue;
+    case install_plan::links:
+      ok = PackageMakeLinks(*job.pkg) && ok;
+      continue;
+    default:
+      break;
+    }
+    if (!job.req) {
+      ok = false;
+      continue;
+    }
+    if (job.serial) {
+      // the earlier job with this archive name is committed, its file is free again
+      job.req->connections = download_connections;
+      job.req->progress = nullptr;
+      if (auto archive_file = PackageDownload(*job.pkg, *job.req); archive_file) {
+        job.unpacked = PackageUnpack(*job.pkg, *archive_file);
+      }
+    } else {
+      std::unique_lock lock(mu);
+      cv.wait(lock, [&] { return job.finished; });
+    }
+    if (!job.unpacked || !PackageCommit(*job.unpacked)) {
+      ok = false;
+      continue;
+    }
+    DisplayNotes(*job.pkg);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  bar.MarkCompleted();
+  bar.Finish();
+  return ok;
+}
+
+bool PackageInstall(const std::vector<baulk::Package> &pkgs) {
+  std::vector<const baulk::Package *> unique;
+  for (const auto &pkg : pkgs) {
+    if (std::none_of(unique.begin(), unique.end(),
+                     [&](const baulk::Package *p) { return bela::EqualsIgnoreCase(p->name, pkg.name); })) {
+      unique.emplace_back(&pkg);
+    }
+  }
+  if (unique.size() == 1) {
+    return PackageInstall(*unique.front());
+  }
+  install_scheduler scheduler(unique);
+  return scheduler.Execute();
 }
 } // namespace baulk::package
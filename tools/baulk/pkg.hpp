@@ -5,6 +5,8 @@
 
 namespace baulk::package {
 bool PackageInstall(const baulk::Package &pkg);
+// PackageInstall downloads the packages concurrently, links and local meta are still written in order
+bool PackageInstall(const std::vector<baulk::Package> &pkgs);
 bool PackageForceDelete(std::wstring_view pkgname, bela::error_code &ec);
 }; // namespace baulk::package
 